@@ -20,6 +20,7 @@
 
 #include <QApplication>
 
+#include "Engine/RenderProfiler.h"
 #include "Gui/GuiApplicationManager.h"
 
 static void setShutDownSignal(int signalId);
@@ -30,10 +31,10 @@ main(int argc,
      char *argv[])
 {
     bool isBackground;
-    QString projectName,mainProcessServerName;
+    QString projectName,mainProcessServerName,profileFilename;
     QStringList writers;
     std::list<std::pair<int,int> > frameRanges;
-    AppManager::parseCmdLineArgs(argc,argv,&isBackground,projectName,writers,frameRanges,mainProcessServerName);
+    AppManager::parseCmdLineArgs(argc,argv,&isBackground,projectName,writers,frameRanges,mainProcessServerName,profileFilename);
 
     setShutDownSignal(SIGINT);   // shut down on ctrl-c
     setShutDownSignal(SIGTERM);   // shut down on killall
@@ -49,12 +50,19 @@ main(int argc,
 
             return 1;
         }
+        if ( !profileFilename.isEmpty() ) {
+            Natron::RenderProfiler::setEnabled(true);
+        }
         AppManager manager;
 
         if ( !manager.load(argc,argv,projectName,writers,frameRanges,mainProcessServerName) ) {
             AppManager::printUsage(argv[0]);
             return 1;
         } else {
+            if ( !profileFilename.isEmpty() && !AppManager::writeRenderProfile(profileFilename) ) {
+                return 1;
+            }
+
             return 0;
         }
     } else {
@@ -0,0 +1,402 @@
+//  Natron
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "BenchmarkEffects.h"
+
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include <QStringList>
+
+#include "Engine/AppManager.h"
+#include "Engine/Image.h"
+#include "Engine/KnobTypes.h"
+#include "Engine/LibraryBinary.h"
+#include "Engine/Node.h"
+#include "Engine/RotoContext.h"
+
+using namespace Natron;
+
+namespace {
+template <class EFFECT>
+void
+registerBenchmarkPlugin()
+{
+    boost::shared_ptr<EffectInstance> effect( EFFECT::BuildEffect( boost::shared_ptr<Natron::Node>() ) );
+    std::map<std::string,void*> functions;
+
+    functions.insert( std::make_pair("BuildEffect", (void*)&EFFECT::BuildEffect) );
+    LibraryBinary *binary = new LibraryBinary(functions);
+    assert(binary);
+
+    std::list<std::string> grouping;
+    effect->getPluginGrouping(&grouping);
+    QStringList qgrouping;
+
+    for (std::list<std::string>::iterator it = grouping.begin(); it != grouping.end(); ++it) {
+        qgrouping.push_back( it->c_str() );
+    }
+    appPTR->registerPlugin(qgrouping, effect->getPluginID().c_str(), effect->getPluginLabel().c_str(), "", "", "", false, false, binary, false,
+                           effect->getMajorVersion(), effect->getMinorVersion());
+}
+
+void
+addRGBAComponents(std::list<Natron::ImageComponentsEnum>* comps)
+{
+    comps->push_back(Natron::eImageComponentRGBA);
+}
+
+void
+addFloatDepth(std::list<Natron::ImageBitDepthEnum>* depths)
+{
+    depths->push_back(Natron::eImageBitDepthFloat);
+}
+}
+
+void
+BenchmarkEffects::registerPlugins()
+{
+    registerBenchmarkPlugin<BenchmarkGenerator>();
+    registerBenchmarkPlugin<BenchmarkBlur>();
+    registerBenchmarkPlugin<BenchmarkRotoMask>();
+}
+
+//////////////////////////////// BenchmarkGenerator
+
+BenchmarkGenerator::BenchmarkGenerator(boost::shared_ptr<Natron::Node> node)
+    : Natron::EffectInstance(node)
+      , _firstFrame(1)
+      , _lastFrame(100)
+{
+    setSupportsRenderScaleMaybe(eSupportsYes);
+}
+
+void
+BenchmarkGenerator::addAcceptedComponents(int /*inputNb*/,
+                                          std::list<Natron::ImageComponentsEnum>* comps)
+{
+    addRGBAComponents(comps);
+}
+
+void
+BenchmarkGenerator::addSupportedBitDepth(std::list<Natron::ImageBitDepthEnum>* depths) const
+{
+    addFloatDepth(depths);
+}
+
+void
+BenchmarkGenerator::setFrameRange(int first,
+                                  int last)
+{
+    _firstFrame = first;
+    _lastFrame = last;
+}
+
+void
+BenchmarkGenerator::getFrameRange(SequenceTime *first,
+                                  SequenceTime *last)
+{
+    *first = _firstFrame;
+    *last = _lastFrame;
+}
+
+Natron::StatusEnum
+BenchmarkGenerator::getRegionOfDefinition(U64 hash,
+                                          SequenceTime time,
+                                          const RenderScale & scale,
+                                          int view,
+                                          RectD* rod)
+{
+    calcDefaultRegionOfDefinition(hash, time, view, scale, rod);
+
+    return eStatusOK;
+}
+
+Natron::StatusEnum
+BenchmarkGenerator::render(SequenceTime time,
+                           const RenderScale& /*originalScale*/,
+                           const RenderScale & mappedScale,
+                           const RectI & roi,
+                           int /*view*/,
+                           bool /*isSequentialRender*/,
+                           bool /*isRenderResponseToUserInteraction*/,
+                           boost::shared_ptr<Natron::Image> output)
+{
+    if ( (output->getComponents() != eImageComponentRGBA) || (output->getBitDepth() != eImageBitDepthFloat) ) {
+        throw std::runtime_error("Host gave image with wrong components or bitdepth");
+    }
+
+    ///The pattern is defined in canonical coordinates so that every mipmap level shows the same image
+    const double sx = 1. / mappedScale.x;
+    const double sy = 1. / mappedScale.y;
+    const double phase = time * 0.1;
+
+    for (int y = roi.y1; y < roi.y2; ++y) {
+        float* dst = (float*)output->pixelAt(roi.x1, y);
+        assert(dst);
+        const double cy = y * sy;
+        for (int x = roi.x1; x < roi.x2; ++x, dst += 4) {
+            const double cx = x * sx;
+            const bool checker = ( ( (int)std::floor(cx / 64.) + (int)std::floor(cy / 64.) + time ) & 1 ) != 0;
+            dst[0] = (float)( 0.5 + 0.5 * std::sin(cx * 0.01 + phase) );
+            dst[1] = (float)( 0.5 + 0.5 * std::cos(cy * 0.01 - phase) );
+            dst[2] = checker ? 1.f : 0.f;
+            dst[3] = 1.f;
+        }
+    }
+
+    return eStatusOK;
+}
+
+//////////////////////////////// BenchmarkBlur
+
+BenchmarkBlur::BenchmarkBlur(boost::shared_ptr<Natron::Node> node)
+    : Natron::EffectInstance(node)
+      , _size()
+{
+    setSupportsRenderScaleMaybe(eSupportsYes);
+}
+
+void
+BenchmarkBlur::addAcceptedComponents(int /*inputNb*/,
+                                     std::list<Natron::ImageComponentsEnum>* comps)
+{
+    addRGBAComponents(comps);
+}
+
+void
+BenchmarkBlur::addSupportedBitDepth(std::list<Natron::ImageBitDepthEnum>* depths) const
+{
+    addFloatDepth(depths);
+}
+
+void
+BenchmarkBlur::initializeKnobs()
+{
+    boost::shared_ptr<Page_Knob> page = Natron::createKnob<Page_Knob>(this, "Controls");
+
+    _size = Natron::createKnob<Int_Knob>(this, "Size");
+    _size->setName("size");
+    _size->setHintToolTip("Half-width of the box, in pixels at full resolution.");
+    _size->setMinimum(0);
+    _size->setDisplayMinimum(0);
+    _size->setDisplayMaximum(100);
+    _size->setDefaultValue(10);
+    page->addKnob(_size);
+}
+
+void
+BenchmarkBlur::setSize(int size)
+{
+    _size->setValue(size, 0);
+}
+
+void
+BenchmarkBlur::getRegionsOfInterest(SequenceTime /*time*/,
+                                    const RenderScale & /*scale*/,
+                                    const RectD & /*outputRoD*/,
+                                    const RectD & renderWindow,
+                                    int /*view*/,
+                                    EffectInstance::RoIMap* ret)
+{
+    EffectInstance* input = getInput(0);
+
+    if (!input) {
+        return;
+    }
+    double size = _size->getValue();
+    RectD roi = renderWindow;
+    roi.x1 -= size;
+    roi.y1 -= size;
+    roi.x2 += size;
+    roi.y2 += size;
+    ret->insert( std::make_pair(input, roi) );
+}
+
+Natron::StatusEnum
+BenchmarkBlur::render(SequenceTime time,
+                      const RenderScale& originalScale,
+                      const RenderScale & mappedScale,
+                      const RectI & roi,
+                      int view,
+                      bool /*isSequentialRender*/,
+                      bool /*isRenderResponseToUserInteraction*/,
+                      boost::shared_ptr<Natron::Image> output)
+{
+    EffectInstance* input = getInput(0);
+
+    if (!input) {
+        return eStatusFailed;
+    }
+
+    RectI roiPixel;
+    boost::shared_ptr<Image> srcImg = getImage(0, time, originalScale, view, NULL, eImageComponentRGBA, eImageBitDepthFloat,
+                                               input->getPreferredAspectRatio(), false, &roiPixel);
+    if (!srcImg) {
+        return eStatusFailed;
+    }
+    if ( srcImg->getMipMapLevel() != output->getMipMapLevel() ) {
+        throw std::runtime_error("Host gave image with wrong scale");
+    }
+
+    const RectI & srcBounds = srcImg->getBounds();
+    const int radius = std::max(0, (int)( _size->getValue() * mappedScale.x + 0.5 ) );
+    const float norm = 1.f / (2 * radius + 1);
+
+    ///Horizontal pass over all the rows the vertical pass needs, source pixels outside of the source image
+    ///are clamped to its edges
+    const int y1 = roi.y1 - radius;
+    const int y2 = roi.y2 + radius;
+    const int width = roi.width();
+    std::vector<float> tmp( (std::size_t)width * (y2 - y1) * 4 );
+
+    for (int y = y1; y < y2; ++y) {
+        const int sy = std::min(std::max(y, srcBounds.y1), srcBounds.y2 - 1);
+        float* dst = &tmp[(std::size_t)(y - y1) * width * 4];
+        for (int x = roi.x1; x < roi.x2; ++x, dst += 4) {
+            float sum[4] = { 0.f, 0.f, 0.f, 0.f };
+            for (int k = -radius; k <= radius; ++k) {
+                const int sx = std::min(std::max(x + k, srcBounds.x1), srcBounds.x2 - 1);
+                const float* src = (const float*)srcImg->pixelAt(sx, sy);
+                assert(src);
+                for (int c = 0; c < 4; ++c) {
+                    sum[c] += src[c];
+                }
+            }
+            for (int c = 0; c < 4; ++c) {
+                dst[c] = sum[c] * norm;
+            }
+        }
+    }
+
+    ///Vertical pass into the output
+    for (int y = roi.y1; y < roi.y2; ++y) {
+        float* dst = (float*)output->pixelAt(roi.x1, y);
+        assert(dst);
+        for (int x = 0; x < width; ++x, dst += 4) {
+            float sum[4] = { 0.f, 0.f, 0.f, 0.f };
+            for (int k = -radius; k <= radius; ++k) {
+                const float* src = &tmp[( (std::size_t)(y + k - y1) * width + x ) * 4];
+                for (int c = 0; c < 4; ++c) {
+                    sum[c] += src[c];
+                }
+            }
+            for (int c = 0; c < 4; ++c) {
+                dst[c] = sum[c] * norm;
+            }
+        }
+    }
+
+    return eStatusOK;
+} // render
+
+//////////////////////////////// BenchmarkRotoMask
+
+BenchmarkRotoMask::BenchmarkRotoMask(boost::shared_ptr<Natron::Node> node)
+    : Natron::EffectInstance(node)
+      , _roto()
+{
+    setSupportsRenderScaleMaybe(eSupportsYes);
+}
+
+BenchmarkRotoMask::~BenchmarkRotoMask()
+{
+}
+
+void
+BenchmarkRotoMask::addAcceptedComponents(int /*inputNb*/,
+                                         std::list<Natron::ImageComponentsEnum>* comps)
+{
+    addRGBAComponents(comps);
+}
+
+void
+BenchmarkRotoMask::addSupportedBitDepth(std::list<Natron::ImageBitDepthEnum>* depths) const
+{
+    addFloatDepth(depths);
+}
+
+void
+BenchmarkRotoMask::initializeKnobs()
+{
+    ///The context is private to this effect: the node does not know about it, hence the render
+    ///of the node does not try to fetch a roto mask for an input
+    _roto.reset( new RotoContext( getNode().get() ) );
+    _roto->createBaseLayer();
+}
+
+void
+BenchmarkRotoMask::makeShapes(int count,
+                              int pointsPerShape)
+{
+    assert(_roto);
+    RenderScale scale;
+    scale.x = scale.y = 1.;
+    RectD format;
+    calcDefaultRegionOfDefinition(0, 0, 0, scale, &format);
+
+    const double pi = 3.14159265358979323846;
+    const double radius = std::min( format.width(), format.height() ) / 8.;
+    for (int i = 0; i < count; ++i) {
+        ///Shapes are spread along a diagonal of the format, their outline is a star so that
+        ///the bezier segments are not trivial to rasterize
+        const double t = count > 1 ? (double)i / (count - 1) : 0.5;
+        const double cx = format.x1 + radius + t * (format.width() - 2 * radius);
+        const double cy = format.y1 + radius + t * (format.height() - 2 * radius);
+        boost::shared_ptr<Bezier> shape;
+        for (int p = 0; p < pointsPerShape; ++p) {
+            const double angle = 2. * pi * p / pointsPerShape;
+            const double r = (p % 2) ? radius * 0.5 : radius;
+            const double x = cx + r * std::cos(angle);
+            const double y = cy + r * std::sin(angle);
+            if (!shape) {
+                shape = _roto->makeBezier(x, y, "Bezier");
+            } else {
+                shape->addControlPoint(x, y);
+            }
+        }
+        if (shape) {
+            shape->setCurveFinished(true);
+        }
+    }
+}
+
+Natron::StatusEnum
+BenchmarkRotoMask::getRegionOfDefinition(U64 hash,
+                                         SequenceTime time,
+                                         const RenderScale & scale,
+                                         int view,
+                                         RectD* rod)
+{
+    calcDefaultRegionOfDefinition(hash, time, view, scale, rod);
+
+    return eStatusOK;
+}
+
+Natron::StatusEnum
+BenchmarkRotoMask::render(SequenceTime time,
+                          const RenderScale& originalScale,
+                          const RenderScale & /*mappedScale*/,
+                          const RectI & roi,
+                          int view,
+                          bool /*isSequentialRender*/,
+                          bool /*isRenderResponseToUserInteraction*/,
+                          boost::shared_ptr<Natron::Image> output)
+{
+    assert(_roto);
+    RectD rod;
+    calcDefaultRegionOfDefinition(getHash(), time, view, originalScale, &rod);
+
+    boost::shared_ptr<Natron::Image> mask = _roto->renderMask(true, roi, eImageComponentRGBA, getHash(), _roto->getAge(), rod, time,
+                                                              eImageBitDepthFloat, view, output->getMipMapLevel(),
+                                                              std::list<boost::shared_ptr<Natron::Image> >(), false);
+    if (!mask) {
+        return eStatusFailed;
+    }
+    output->pasteFrom(*mask, roi, false);
+
+    return eStatusOK;
+}
@@ -0,0 +1,350 @@
+//  Natron
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef NATRON_BENCHMARKS_BENCHMARKEFFECTS_H_
+#define NATRON_BENCHMARKS_BENCHMARKEFFECTS_H_
+
+#ifndef Q_MOC_RUN
+#include <boost/shared_ptr.hpp>
+#endif
+#include "Engine/EffectInstance.h"
+
+#define PLUGINID_NATRON_BENCHMARK_GENERATOR (NATRON_ORGANIZATION_DOMAIN_TOPLEVEL "." NATRON_ORGANIZATION_DOMAIN_SUB ".benchmark.Generator")
+#define PLUGINID_NATRON_BENCHMARK_BLUR      (NATRON_ORGANIZATION_DOMAIN_TOPLEVEL "." NATRON_ORGANIZATION_DOMAIN_SUB ".benchmark.Blur")
+#define PLUGINID_NATRON_BENCHMARK_ROTOMASK  (NATRON_ORGANIZATION_DOMAIN_TOPLEVEL "." NATRON_ORGANIZATION_DOMAIN_SUB ".benchmark.RotoMask")
+
+class Int_Knob;
+class RotoContext;
+
+/**
+ * @brief The effects used by the benchmarks. They do not depend on any OpenFX bundle so that the benchmarks
+ * measure the render engine only and give the same results on every machine.
+ **/
+namespace BenchmarkEffects {
+/**
+ * @brief Registers the benchmark effects as built-in plug-ins of the application.
+ **/
+void registerPlugins();
+}
+
+/**
+ * @brief Generates a deterministic RGBA float pattern over the project format that changes with time.
+ **/
+class BenchmarkGenerator
+    : public Natron::EffectInstance
+{
+public:
+
+    static Natron::EffectInstance* BuildEffect(boost::shared_ptr<Natron::Node> n)
+    {
+        return new BenchmarkGenerator(n);
+    }
+
+    BenchmarkGenerator(boost::shared_ptr<Natron::Node> node);
+
+    virtual int getMajorVersion() const OVERRIDE FINAL WARN_UNUSED_RETURN
+    {
+        return 1;
+    }
+
+    virtual int getMinorVersion() const OVERRIDE FINAL WARN_UNUSED_RETURN
+    {
+        return 0;
+    }
+
+    virtual int getMaxInputCount() const OVERRIDE FINAL WARN_UNUSED_RETURN
+    {
+        return 0;
+    }
+
+    virtual bool isGenerator() const OVERRIDE FINAL WARN_UNUSED_RETURN
+    {
+        return true;
+    }
+
+    virtual bool isInputOptional(int /*inputNb*/) const OVERRIDE FINAL WARN_UNUSED_RETURN
+    {
+        return false;
+    }
+
+    virtual std::string getPluginID() const OVERRIDE FINAL WARN_UNUSED_RETURN
+    {
+        return PLUGINID_NATRON_BENCHMARK_GENERATOR;
+    }
+
+    virtual std::string getPluginLabel() const OVERRIDE FINAL WARN_UNUSED_RETURN
+    {
+        return "BenchmarkGenerator";
+    }
+
+    virtual std::string getDescription() const OVERRIDE FINAL WARN_UNUSED_RETURN
+    {
+        return "Generates a pattern that changes with time, used to benchmark the render engine.";
+    }
+
+    virtual void getPluginGrouping(std::list<std::string>* grouping) const OVERRIDE FINAL
+    {
+        grouping->push_back(PLUGIN_GROUP_OTHER);
+    }
+
+    virtual void addAcceptedComponents(int inputNb,std::list<Natron::ImageComponentsEnum>* comps) OVERRIDE FINAL;
+    virtual void addSupportedBitDepth(std::list<Natron::ImageBitDepthEnum>* depths) const OVERRIDE FINAL;
+
+    virtual EffectInstance::RenderSafetyEnum renderThreadSafety() const OVERRIDE FINAL WARN_UNUSED_RETURN
+    {
+        return EffectInstance::eRenderSafetyFullySafeFrame;
+    }
+
+    virtual bool supportsTiles() const OVERRIDE FINAL WARN_UNUSED_RETURN
+    {
+        return true;
+    }
+
+    virtual bool supportsMultiResolution() const OVERRIDE FINAL WARN_UNUSED_RETURN
+    {
+        return true;
+    }
+
+    virtual bool isFrameVarying() const OVERRIDE FINAL WARN_UNUSED_RETURN
+    {
+        return true;
+    }
+
+    /**
+     * @brief The frame range the generator produces, used by the writer-style benchmarks.
+     **/
+    void setFrameRange(int first,int last);
+
+    virtual void getFrameRange(SequenceTime *first,SequenceTime *last) OVERRIDE FINAL;
+
+private:
+
+    virtual Natron::StatusEnum getRegionOfDefinition(U64 hash,SequenceTime time, const RenderScale & scale, int view, RectD* rod) OVERRIDE FINAL WARN_UNUSED_RETURN;
+
+    virtual Natron::StatusEnum render(SequenceTime time,
+                                      const RenderScale& originalScale,
+                                      const RenderScale & mappedScale,
+                                      const RectI & roi, //!< renderWindow in pixel coordinates
+                                      int view,
+                                      bool isSequentialRender,
+                                      bool isRenderResponseToUserInteraction,
+                                      boost::shared_ptr<Natron::Image> output) OVERRIDE FINAL WARN_UNUSED_RETURN;
+
+    int _firstFrame,_lastFrame;
+};
+
+/**
+ * @brief A separable box blur of its input. Its cost grows with the size parameter and its region of
+ * interest is larger than the render window, like most spatial filters.
+ **/
+class BenchmarkBlur
+    : public Natron::EffectInstance
+{
+public:
+
+    static Natron::EffectInstance* BuildEffect(boost::shared_ptr<Natron::Node> n)
+    {
+        return new BenchmarkBlur(n);
+    }
+
+    BenchmarkBlur(boost::shared_ptr<Natron::Node> node);
+
+    virtual int getMajorVersion() const OVERRIDE FINAL WARN_UNUSED_RETURN
+    {
+        return 1;
+    }
+
+    virtual int getMinorVersion() const OVERRIDE FINAL WARN_UNUSED_RETURN
+    {
+        return 0;
+    }
+
+    virtual int getMaxInputCount() const OVERRIDE FINAL WARN_UNUSED_RETURN
+    {
+        return 1;
+    }
+
+    virtual bool isInputOptional(int /*inputNb*/) const OVERRIDE FINAL WARN_UNUSED_RETURN
+    {
+        return false;
+    }
+
+    virtual std::string getPluginID() const OVERRIDE FINAL WARN_UNUSED_RETURN
+    {
+        return PLUGINID_NATRON_BENCHMARK_BLUR;
+    }
+
+    virtual std::string getPluginLabel() const OVERRIDE FINAL WARN_UNUSED_RETURN
+    {
+        return "BenchmarkBlur";
+    }
+
+    virtual std::string getDescription() const OVERRIDE FINAL WARN_UNUSED_RETURN
+    {
+        return "A box blur, used to benchmark the render engine.";
+    }
+
+    virtual void getPluginGrouping(std::list<std::string>* grouping) const OVERRIDE FINAL
+    {
+        grouping->push_back(PLUGIN_GROUP_OTHER);
+    }
+
+    virtual std::string getInputLabel (int /*inputNb*/) const OVERRIDE FINAL WARN_UNUSED_RETURN
+    {
+        return "Source";
+    }
+
+    virtual void addAcceptedComponents(int inputNb,std::list<Natron::ImageComponentsEnum>* comps) OVERRIDE FINAL;
+    virtual void addSupportedBitDepth(std::list<Natron::ImageBitDepthEnum>* depths) const OVERRIDE FINAL;
+
+    virtual EffectInstance::RenderSafetyEnum renderThreadSafety() const OVERRIDE FINAL WARN_UNUSED_RETURN
+    {
+        return EffectInstance::eRenderSafetyFullySafeFrame;
+    }
+
+    virtual bool supportsTiles() const OVERRIDE FINAL WARN_UNUSED_RETURN
+    {
+        return true;
+    }
+
+    virtual bool supportsMultiResolution() const OVERRIDE FINAL WARN_UNUSED_RETURN
+    {
+        return true;
+    }
+
+    virtual void initializeKnobs() OVERRIDE FINAL;
+
+    /**
+     * @brief Sets the half-width of the box, in pixels at scale 1
+     **/
+    void setSize(int size);
+
+private:
+
+    virtual void getRegionsOfInterest(SequenceTime time,
+                                      const RenderScale & scale,
+                                      const RectD & outputRoD,
+                                      const RectD & renderWindow,
+                                      int view,
+                                      EffectInstance::RoIMap* ret) OVERRIDE FINAL;
+
+    virtual Natron::StatusEnum render(SequenceTime time,
+                                      const RenderScale& originalScale,
+                                      const RenderScale & mappedScale,
+                                      const RectI & roi, //!< renderWindow in pixel coordinates
+                                      int view,
+                                      bool isSequentialRender,
+                                      bool isRenderResponseToUserInteraction,
+                                      boost::shared_ptr<Natron::Image> output) OVERRIDE FINAL WARN_UNUSED_RETURN;
+
+    boost::shared_ptr<Int_Knob> _size;
+};
+
+/**
+ * @brief Renders the shapes of its own RotoContext, so that the benchmarks exercise the roto renderer
+ * without the Roto OpenFX plug-in.
+ **/
+class BenchmarkRotoMask
+    : public Natron::EffectInstance
+{
+public:
+
+    static Natron::EffectInstance* BuildEffect(boost::shared_ptr<Natron::Node> n)
+    {
+        return new BenchmarkRotoMask(n);
+    }
+
+    BenchmarkRotoMask(boost::shared_ptr<Natron::Node> node);
+
+    virtual ~BenchmarkRotoMask();
+
+    virtual int getMajorVersion() const OVERRIDE FINAL WARN_UNUSED_RETURN
+    {
+        return 1;
+    }
+
+    virtual int getMinorVersion() const OVERRIDE FINAL WARN_UNUSED_RETURN
+    {
+        return 0;
+    }
+
+    virtual int getMaxInputCount() const OVERRIDE FINAL WARN_UNUSED_RETURN
+    {
+        return 0;
+    }
+
+    virtual bool isGenerator() const OVERRIDE FINAL WARN_UNUSED_RETURN
+    {
+        return true;
+    }
+
+    virtual bool isInputOptional(int /*inputNb*/) const OVERRIDE FINAL WARN_UNUSED_RETURN
+    {
+        return false;
+    }
+
+    virtual std::string getPluginID() const OVERRIDE FINAL WARN_UNUSED_RETURN
+    {
+        return PLUGINID_NATRON_BENCHMARK_ROTOMASK;
+    }
+
+    virtual std::string getPluginLabel() const OVERRIDE FINAL WARN_UNUSED_RETURN
+    {
+        return "BenchmarkRotoMask";
+    }
+
+    virtual std::string getDescription() const OVERRIDE FINAL WARN_UNUSED_RETURN
+    {
+        return "Renders roto shapes, used to benchmark the render engine.";
+    }
+
+    virtual void getPluginGrouping(std::list<std::string>* grouping) const OVERRIDE FINAL
+    {
+        grouping->push_back(PLUGIN_GROUP_OTHER);
+    }
+
+    virtual void addAcceptedComponents(int inputNb,std::list<Natron::ImageComponentsEnum>* comps) OVERRIDE FINAL;
+    virtual void addSupportedBitDepth(std::list<Natron::ImageBitDepthEnum>* depths) const OVERRIDE FINAL;
+
+    virtual EffectInstance::RenderSafetyEnum renderThreadSafety() const OVERRIDE FINAL WARN_UNUSED_RETURN
+    {
+        return EffectInstance::eRenderSafetyFullySafe;
+    }
+
+    virtual bool supportsTiles() const OVERRIDE FINAL WARN_UNUSED_RETURN
+    {
+        return false;
+    }
+
+    virtual bool supportsMultiResolution() const OVERRIDE FINAL WARN_UNUSED_RETURN
+    {
+        return true;
+    }
+
+    virtual void initializeKnobs() OVERRIDE FINAL;
+
+    /**
+     * @brief Adds count polygonal shapes with the given number of points, spread over the project format.
+     * This must be called on the main thread.
+     **/
+    void makeShapes(int count,int pointsPerShape);
+
+private:
+
+    virtual Natron::StatusEnum getRegionOfDefinition(U64 hash,SequenceTime time, const RenderScale & scale, int view, RectD* rod) OVERRIDE FINAL WARN_UNUSED_RETURN;
+
+    virtual Natron::StatusEnum render(SequenceTime time,
+                                      const RenderScale& originalScale,
+                                      const RenderScale & mappedScale,
+                                      const RectI & roi, //!< renderWindow in pixel coordinates
+                                      int view,
+                                      bool isSequentialRender,
+                                      bool isRenderResponseToUserInteraction,
+                                      boost::shared_ptr<Natron::Image> output) OVERRIDE FINAL WARN_UNUSED_RETURN;
+
+    boost::shared_ptr<RotoContext> _roto;
+};
+
+#endif // NATRON_BENCHMARKS_BENCHMARKEFFECTS_H_
@@ -0,0 +1,730 @@
+//  Natron
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+/**
+ * NatronBenchmark renders a few fixed graphs made of synthetic effects the way the viewer and the writers
+ * do, and reports for each scenario the throughput, the memory used and the cache behaviour as JSON.
+ * It also times how long the file dialog takes to list a large synthetic render directory, and compares the latency
+ * of the disk cache hits on raw and compressed entries.
+ * The graphs and the images are deterministic so that reports of two builds can be compared.
+ **/
+
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QStringList>
+
+#include "Global/MemoryInfo.h"
+#include "Engine/AppInstance.h"
+#include "Engine/AppManager.h"
+#include "Engine/DirectoryScanner.h"
+#include "Engine/DiskCacheNode.h"
+#include "Engine/EffectInstance.h"
+#include "Engine/Image.h"
+#include "Engine/Node.h"
+#include "Engine/Project.h"
+#include "Engine/RenderPriorityScheduler.h"
+#include "Engine/RenderProfiler.h"
+#include "Engine/Settings.h"
+#include "Engine/TimeLine.h"
+
+#include "BenchmarkEffects.h"
+
+using namespace Natron;
+
+namespace {
+struct BenchmarkOptions
+{
+    int frames;
+    int threads; //< 0 means the number of cores
+    int blurSize;
+    int rotoShapes;
+    int scanFiles; //< files of the synthetic directory, 0 to skip the directory scan
+    std::string output; //< empty means stdout
+
+    BenchmarkOptions()
+        : frames(20)
+          , threads(0)
+          , blurSize(10)
+          , rotoShapes(20)
+          , scanFiles(20000)
+          , output()
+    {
+    }
+};
+
+struct BenchmarkResult
+{
+    std::string name;
+    int frames;
+    double seconds;
+    U64 cacheHits;
+    U64 cacheMisses;
+    U64 bytesAllocated;
+    U64 cachesMemory; //< memory held by the caches at the end of the scenario
+    U64 peakRSS;
+    U64 currentRSS;
+    U64 actionsCacheHits;
+    U64 actionsCacheMisses;
+    RenderPoolStats pools[eRenderPriorityCount];
+    bool succeeded;
+
+    BenchmarkResult()
+        : name()
+          , frames(0)
+          , seconds(0.)
+          , cacheHits(0)
+          , cacheMisses(0)
+          , bytesAllocated(0)
+          , cachesMemory(0)
+          , peakRSS(0)
+          , currentRSS(0)
+          , actionsCacheHits(0)
+          , actionsCacheMisses(0)
+          , pools()
+          , succeeded(true)
+    {
+    }
+};
+
+struct DirectoryScanResult
+{
+    int files;
+    double statListingSeconds; //< listing the directory with QDir, which reads the info of every file
+    double listingSeconds; //< listing the directory the way the file dialog does
+    double groupingSeconds; //< grouping the files into sequences the way the file dialog does
+    int sequences; //< sequences and single files found
+    bool succeeded;
+
+    DirectoryScanResult()
+        : files(0)
+          , statListingSeconds(0.)
+          , listingSeconds(0.)
+          , groupingSeconds(0.)
+          , sequences(0)
+          , succeeded(true)
+    {
+    }
+};
+
+void
+printUsage(const char* programName)
+{
+    std::cout << "Usage: " << programName << " [options]\n"
+              << "Renders synthetic graphs and writes a JSON report of the render performance.\n"
+              << "Options:\n"
+              << "  --frames <n>    Number of frames rendered by each scenario (default 20)\n"
+              << "  --threads <n>   Number of render threads, 0 for the number of cores (default 0)\n"
+              << "  --blur <n>      Size of the blurs of the filter graph (default 10)\n"
+              << "  --shapes <n>    Number of shapes of the roto graph (default 20)\n"
+              << "  --scan <n>      Number of files of the directory scanned by the file dialog scenario, 0 to skip it (default 20000)\n"
+              << "  --output <file> Write the report to file instead of the standard output\n";
+}
+
+bool
+parseIntArg(const QStringList & args,
+            int* i,
+            int minValue,
+            int* value)
+{
+    if ( *i + 1 >= args.size() ) {
+        return false;
+    }
+    bool ok;
+    int v = args[*i + 1].toInt(&ok);
+    if ( !ok || (v < minValue) ) {
+        return false;
+    }
+    *value = v;
+    ++*i;
+
+    return true;
+}
+
+bool
+parseArgs(const QStringList & args,
+          BenchmarkOptions* options)
+{
+    for (int i = 1; i < args.size(); ++i) {
+        const QString & a = args[i];
+        if (a == "--frames") {
+            if ( !parseIntArg(args, &i, 1, &options->frames) ) {
+                return false;
+            }
+        } else if (a == "--threads") {
+            if ( !parseIntArg(args, &i, 0, &options->threads) ) {
+                return false;
+            }
+        } else if (a == "--blur") {
+            if ( !parseIntArg(args, &i, 0, &options->blurSize) ) {
+                return false;
+            }
+        } else if (a == "--shapes") {
+            if ( !parseIntArg(args, &i, 1, &options->rotoShapes) ) {
+                return false;
+            }
+        } else if (a == "--scan") {
+            if ( !parseIntArg(args, &i, 0, &options->scanFiles) ) {
+                return false;
+            }
+        } else if ( (a == "--output") && (i + 1 < args.size()) ) {
+            options->output = args[++i].toStdString();
+        } else {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+boost::shared_ptr<Natron::Node>
+createNode(AppInstance* app,
+           const QString & pluginID)
+{
+    boost::shared_ptr<Natron::Node> ret = app->createNode( CreateNodeArgs(pluginID,
+                                                                          "",
+                                                                          -1,-1,-1,false,INT_MIN,INT_MIN,false,true,
+                                                                          QString(),CreateNodeArgs::DefaultValuesList()) );
+
+    if (!ret) {
+        throw std::runtime_error("Could not create a node of type " + pluginID.toStdString());
+    }
+
+    return ret;
+}
+
+void
+connectNodes(AppInstance* app,
+             const boost::shared_ptr<Natron::Node> & input,
+             const boost::shared_ptr<Natron::Node> & output)
+{
+    if ( !app->getProject()->connectNodes(0, input, output.get()) ) {
+        throw std::runtime_error("Could not connect " + input->getName_mt_safe() + " to " + output->getName_mt_safe());
+    }
+}
+
+/**
+ * @brief Sums the actions cache counters of all the nodes of the project.
+ **/
+void
+getActionsCacheCounters(AppInstance* app,
+                        U64* hits,
+                        U64* misses)
+{
+    *hits = 0;
+    *misses = 0;
+    const std::vector<boost::shared_ptr<Natron::Node> > nodes = app->getProject()->getCurrentNodes();
+    for (std::size_t i = 0; i < nodes.size(); ++i) {
+        EffectInstance::ActionsCacheStatistics s;
+        nodes[i]->getLiveInstance()->getActionsCacheStatistics(&s);
+        const EffectInstance::ActionsCacheCounters* counters[] = {
+            &s.regionOfDefinition, &s.isIdentity, &s.framesNeeded, &s.regionsOfInterest, &s.timeDomain, &s.transformConcatenation
+        };
+        for (std::size_t c = 0; c < sizeof(counters) / sizeof(counters[0]); ++c) {
+            *hits += counters[c]->hits;
+            *misses += counters[c]->misses;
+        }
+    }
+}
+
+/**
+ * @brief Measures what happens between its construction and finish().
+ **/
+class ScenarioRecorder
+{
+public:
+
+    ScenarioRecorder(AppInstance* app,
+                     const std::string & name,
+                     bool clearCaches)
+        : _app(app)
+          , _timer()
+          , _actionsHitsStart(0)
+          , _actionsMissesStart(0)
+    {
+        _result.name = name;
+        if (clearCaches) {
+            appPTR->clearAllCaches();
+        }
+        RenderProfiler::clear();
+        RenderProfiler::setEnabled(true);
+        RenderPriorityScheduler::clearStatistics();
+        getActionsCacheCounters(_app, &_actionsHitsStart, &_actionsMissesStart);
+        _timer.start();
+    }
+
+    BenchmarkResult finish(int frames,
+                           bool succeeded)
+    {
+        _result.seconds = _timer.nsecsElapsed() * 1e-9;
+        RenderProfiler::setEnabled(false);
+
+        _result.frames = frames;
+        _result.succeeded = succeeded;
+
+        RenderProfile profile;
+        RenderProfiler::getProfile(&profile);
+        for (RenderProfile::const_iterator it = profile.begin(); it != profile.end(); ++it) {
+            for (NodeProfile::const_iterator it2 = it->second.begin(); it2 != it->second.end(); ++it2) {
+                _result.cacheHits += it2->second.cacheHits;
+                _result.cacheMisses += it2->second.cacheMisses;
+                _result.bytesAllocated += it2->second.bytesAllocated;
+            }
+        }
+
+        U64 hits,misses;
+        getActionsCacheCounters(_app, &hits, &misses);
+        _result.actionsCacheHits = hits - _actionsHitsStart;
+        _result.actionsCacheMisses = misses - _actionsMissesStart;
+        _result.cachesMemory = appPTR->getCachesTotalMemorySize();
+        _result.peakRSS = getPeakRSS();
+        _result.currentRSS = getCurrentRSS();
+        RenderPriorityScheduler::getStatistics(_result.pools);
+
+        return _result;
+    }
+
+private:
+
+    AppInstance* _app;
+    QElapsedTimer _timer;
+    U64 _actionsHitsStart,_actionsMissesStart;
+    BenchmarkResult _result;
+};
+
+/**
+ * @brief Renders the frames of the effect like the viewer does: the whole region of definition at the given mipmap level,
+ * frame by frame, as a response to a user interaction.
+ **/
+bool
+renderViewerFrames(AppInstance* app,
+                   EffectInstance* effect,
+                   int first,
+                   int last,
+                   unsigned int mipMapLevel)
+{
+    RenderScale scale;
+
+    scale.x = scale.y = Natron::Image::getScaleFromMipMapLevel(mipMapLevel);
+    const double par = effect->getPreferredAspectRatio();
+
+    for (int time = first; time <= last; ++time) {
+        U64 nodeHash = effect->getHash();
+        RectD rod;
+        bool isProjectFormat;
+        Natron::StatusEnum stat = effect->getRegionOfDefinition_public(nodeHash, time, scale, 0, &rod, &isProjectFormat);
+        if ( (stat == eStatusFailed) || rod.isNull() ) {
+            return false;
+        }
+        RectI renderWindow;
+        rod.toPixelEnclosing(mipMapLevel, par, &renderWindow);
+
+        Node::ParallelRenderArgsSetter frameRenderArgs(effect->getNode().get(),
+                                                       time,
+                                                       0,
+                                                       true,
+                                                       false,
+                                                       false,
+                                                       nodeHash,
+                                                       false,
+                                                       app->getTimeLine().get());
+        boost::shared_ptr<Image> img = effect->renderRoI( EffectInstance::RenderRoIArgs(time,
+                                                                                        scale,
+                                                                                        mipMapLevel,
+                                                                                        0,
+                                                                                        false,
+                                                                                        renderWindow,
+                                                                                        rod,
+                                                                                        Natron::eImageComponentRGBA,
+                                                                                        Natron::eImageBitDepthFloat) );
+        if (!img) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+BenchmarkResult
+runViewerScenario(AppInstance* app,
+                  const std::string & name,
+                  EffectInstance* effect,
+                  int frames,
+                  unsigned int mipMapLevel,
+                  bool clearCaches)
+{
+    ScenarioRecorder recorder(app, name, clearCaches);
+    bool ok;
+
+    try {
+        ok = renderViewerFrames(app, effect, 1, frames, mipMapLevel);
+    } catch (const std::exception & e) {
+        std::cerr << name << ": " << e.what() << std::endl;
+        ok = false;
+    }
+
+    return recorder.finish(frames, ok);
+}
+
+/**
+ * @brief Fills the cache of the DiskCache node with frames stored raw or compressed, then renders the same frames
+ * again so that each of them is a cache hit. The DiskCache node keeps no entry in RAM, every hit reads the entry back
+ * from the slab files and compressed entries are decoded, hence the hit scenarios compare the latency of both layouts.
+ * The slab files are usually still in the file-system cache of the system when they are read back.
+ **/
+void
+runDiskCacheHitScenarios(AppInstance* app,
+                         EffectInstance* diskCache,
+                         int frames,
+                         std::vector<BenchmarkResult>* results)
+{
+    for (int compressed = 0; compressed < 2; ++compressed) {
+        appPTR->setDiskCachesCompression(compressed != 0, false);
+        const std::string layout = compressed ? "Compressed" : "Raw";
+        results->push_back( runViewerScenario(app, "diskCacheFill" + layout, diskCache, frames, 0, true) );
+        results->push_back( runViewerScenario(app, "diskCacheHit" + layout, diskCache, frames, 0, false) );
+    }
+
+    boost::shared_ptr<Settings> settings = appPTR->getCurrentSettings();
+    appPTR->setDiskCachesCompression( settings->isDiskCacheCompressionEnabled(), settings->isDiskCacheFloatAsHalfEnabled() );
+}
+
+BenchmarkResult
+runWriterScenario(AppInstance* app,
+                  const std::string & name,
+                  Natron::OutputEffectInstance* writer,
+                  int frames)
+{
+    ScenarioRecorder recorder(app, name, true);
+    AppInstance::RenderWork w;
+
+    w.writer = writer;
+    w.firstFrame = 1;
+    w.lastFrame = frames;
+    std::list<AppInstance::RenderWork> works;
+    works.push_back(w);
+
+    bool ok = true;
+    try {
+        ///This is blocking since the application runs in background
+        app->startWritersRendering(works);
+    } catch (const std::exception & e) {
+        std::cerr << name << ": " << e.what() << std::endl;
+        ok = false;
+    }
+
+    return recorder.finish(frames, ok);
+}
+
+QString
+getLettersName(int i)
+{
+    QString ret;
+
+    do {
+        ret.prepend( QChar('a' + i % 26) );
+        i /= 26;
+    } while (i > 0);
+
+    return ret;
+}
+
+/**
+ * @brief Creates a directory of empty files like a render directory: a few long sequences, padded or not,
+ * and some files that do not belong to any sequence.
+ **/
+bool
+createSyntheticDirectory(const QString & path,
+                         int files)
+{
+    if ( !QDir().mkpath(path) ) {
+        return false;
+    }
+    for (int i = 0; i < files; ++i) {
+        QString name;
+        switch (i % 10) {
+        case 0:
+            name = QString("notes_%1.txt").arg( getLettersName(i) );
+            break;
+        case 1:
+        case 2:
+        case 3:
+            name = QString("plate.%1.tif").arg(i);
+            break;
+        case 4:
+        case 5:
+            name = QString("shotB_v002.%1.dpx").arg(i, 5, 10, QChar('0'));
+            break;
+        default:
+            name = QString("shotA.%1.exr").arg(i, 7, 10, QChar('0'));
+            break;
+        }
+        QFile f( path + '/' + name );
+        if ( !f.open(QIODevice::WriteOnly) ) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void
+removeSyntheticDirectory(const QString & path)
+{
+    QDir dir(path);
+    QStringList names = dir.entryList(QDir::Files | QDir::Hidden);
+
+    for (int i = 0; i < names.size(); ++i) {
+        dir.remove(names[i]);
+    }
+    QDir().rmdir(path);
+}
+
+/**
+ * @brief Lists and groups the files of a synthetic directory the way the file dialog does.
+ **/
+DirectoryScanResult
+runDirectoryScan(int files)
+{
+    DirectoryScanResult result;
+
+    result.files = files;
+    QString path = QDir::tempPath() + QString("/NatronBenchmarkScan%1").arg( QCoreApplication::applicationPid() );
+    if ( !createSyntheticDirectory(path, files) ) {
+        std::cerr << "Could not create the directory " << path.toStdString() << std::endl;
+        removeSyntheticDirectory(path);
+        result.succeeded = false;
+
+        return result;
+    }
+
+    const QDir::Filters filters = QDir::AllEntries | QDir::NoDotAndDotDot;
+    QElapsedTimer timer;
+    timer.start();
+    QFileInfoList infos = QDir(path).entryInfoList(filters, QDir::Name);
+    for (int i = 0; i < infos.size(); ++i) {
+        ///What the file dialog used to read for each file
+        (void)infos[i].size();
+        (void)infos[i].lastModified();
+    }
+    result.statListingSeconds = timer.nsecsElapsed() * 1e-9;
+
+    timer.restart();
+    DirectoryEntries entries;
+    result.succeeded = listDirectory(path, filters, false, &entries);
+    sortDirectoryEntries(QDir::Name, false, &entries);
+    result.listingSeconds = timer.nsecsElapsed() * 1e-9;
+
+    timer.restart();
+    FileSequenceGrouper grouper(path, false);
+    const std::size_t batchSize = 2048;
+    for (std::size_t start = 0; start < entries.size(); start += batchSize) {
+        QStringList names;
+        for (std::size_t i = start; i < std::min(entries.size(), start + batchSize); ++i) {
+            names.push_back(entries[i].name);
+        }
+        std::vector<boost::shared_ptr<SequenceParsing::SequenceFromFiles> > sequences;
+        std::vector<bool> created;
+        grouper.addFiles(names, &sequences, &created);
+        for (std::size_t i = 0; i < created.size(); ++i) {
+            if (created[i]) {
+                ++result.sequences;
+            }
+        }
+    }
+    result.groupingSeconds = timer.nsecsElapsed() * 1e-9;
+
+    if ( (int)entries.size() != files ) {
+        result.succeeded = false;
+    }
+    removeSyntheticDirectory(path);
+
+    return result;
+} // runDirectoryScan
+
+void
+writePoolsReport(std::ostream & stream,
+                 const RenderPoolStats* pools)
+{
+    static const char* names[eRenderPriorityCount] = { "interactive", "playback", "background" };
+
+    stream << "      \"pools\": {\n";
+    for (int i = 0; i < (int)eRenderPriorityCount; ++i) {
+        const RenderPoolStats & p = pools[i];
+        stream << "        \"" << names[i] << "\": { "
+               << "\"renders\": " << p.renders << ", "
+               << "\"peakRenders\": " << p.peakActiveRenders << ", "
+               << "\"poolTasks\": " << p.poolTasks << ", "
+               << "\"peakPoolTasks\": " << p.peakActivePoolTasks << ", "
+               << "\"poolBusyTime\": " << p.poolBusyTime << ", "
+               << "\"preemptions\": " << p.preemptions << ", "
+               << "\"preemptedTime\": " << p.preemptedTime
+               << ( i + 1 == (int)eRenderPriorityCount ? " }\n" : " },\n" );
+    }
+    stream << "      },\n";
+}
+
+void
+writeReport(std::ostream & stream,
+            const BenchmarkOptions & options,
+            const std::vector<BenchmarkResult> & results,
+            const DirectoryScanResult & scan)
+{
+    std::streamsize oldPrecision = stream.precision(9);
+
+    stream << "{\n  \"frames\": " << options.frames << ",\n  \"threads\": " << options.threads
+           << ",\n  \"blurSize\": " << options.blurSize << ",\n  \"rotoShapes\": " << options.rotoShapes
+           << ",\n  \"scenarios\": [\n";
+    for (std::size_t i = 0; i < results.size(); ++i) {
+        const BenchmarkResult & r = results[i];
+        stream << "    {\n"
+               << "      \"name\": \"" << r.name << "\",\n"
+               << "      \"succeeded\": " << (r.succeeded ? "true" : "false") << ",\n"
+               << "      \"frames\": " << r.frames << ",\n"
+               << "      \"seconds\": " << r.seconds << ",\n"
+               << "      \"framesPerSecond\": " << (r.seconds > 0. ? r.frames / r.seconds : 0.) << ",\n"
+               << "      \"cacheHits\": " << r.cacheHits << ",\n"
+               << "      \"cacheMisses\": " << r.cacheMisses << ",\n"
+               << "      \"bytesAllocated\": " << r.bytesAllocated << ",\n"
+               << "      \"cachesMemory\": " << r.cachesMemory << ",\n"
+               << "      \"actionsCacheHits\": " << r.actionsCacheHits << ",\n"
+               << "      \"actionsCacheMisses\": " << r.actionsCacheMisses << ",\n";
+        writePoolsReport(stream, r.pools);
+        stream << "      \"peakRSS\": " << r.peakRSS << ",\n"
+               << "      \"currentRSS\": " << r.currentRSS << "\n"
+               << ( i + 1 == results.size() ? "    }\n" : "    },\n" );
+    }
+    stream << "  ],\n  \"directoryScan\": {\n"
+           << "    \"succeeded\": " << (scan.succeeded ? "true" : "false") << ",\n"
+           << "    \"files\": " << scan.files << ",\n"
+           << "    \"statListingSeconds\": " << scan.statListingSeconds << ",\n"
+           << "    \"listingSeconds\": " << scan.listingSeconds << ",\n"
+           << "    \"groupingSeconds\": " << scan.groupingSeconds << ",\n"
+           << "    \"sequences\": " << scan.sequences << "\n"
+           << "  }\n}\n";
+    stream.precision(oldPrecision);
+}
+
+std::vector<BenchmarkResult>
+runBenchmarks(AppInstance* app,
+              const BenchmarkOptions & options)
+{
+    ///Filter graph: Generator -> Blur -> Blur -> DiskCache
+    boost::shared_ptr<Natron::Node> generator = createNode(app, PLUGINID_NATRON_BENCHMARK_GENERATOR);
+    boost::shared_ptr<Natron::Node> blur1 = createNode(app, PLUGINID_NATRON_BENCHMARK_BLUR);
+    boost::shared_ptr<Natron::Node> blur2 = createNode(app, PLUGINID_NATRON_BENCHMARK_BLUR);
+    boost::shared_ptr<Natron::Node> diskCache = createNode(app, PLUGINID_NATRON_DISKCACHE);
+
+    connectNodes(app, generator, blur1);
+    connectNodes(app, blur1, blur2);
+    connectNodes(app, blur2, diskCache);
+
+    dynamic_cast<BenchmarkGenerator*>( generator->getLiveInstance() )->setFrameRange(1, options.frames);
+    dynamic_cast<BenchmarkBlur*>( blur1->getLiveInstance() )->setSize(options.blurSize);
+    dynamic_cast<BenchmarkBlur*>( blur2->getLiveInstance() )->setSize(options.blurSize);
+
+    ///Roto graph
+    boost::shared_ptr<Natron::Node> roto = createNode(app, PLUGINID_NATRON_BENCHMARK_ROTOMASK);
+    dynamic_cast<BenchmarkRotoMask*>( roto->getLiveInstance() )->makeShapes(options.rotoShapes, 16);
+
+    std::vector<BenchmarkResult> results;
+    EffectInstance* filterOutput = blur2->getLiveInstance();
+
+    results.push_back( runViewerScenario(app, "viewerCold", filterOutput, options.frames, 0, true) );
+    ///Same frames again: everything should come from the cache
+    results.push_back( runViewerScenario(app, "viewerWarm", filterOutput, options.frames, 0, false) );
+    results.push_back( runViewerScenario(app, "viewerProxy", filterOutput, options.frames, 1, true) );
+    results.push_back( runViewerScenario(app, "roto", roto->getLiveInstance(), options.frames, 0, true) );
+    runDiskCacheHitScenarios(app, diskCache->getLiveInstance(), options.frames, &results);
+    results.push_back( runWriterScenario(app, "writer", dynamic_cast<Natron::OutputEffectInstance*>( diskCache->getLiveInstance() ),
+                                         options.frames) );
+
+    return results;
+}
+}
+
+int
+main(int argc,
+     char *argv[])
+{
+    QStringList args;
+
+    for (int i = 0; i < argc; ++i) {
+        args.push_back( QString(argv[i]) );
+    }
+
+    BenchmarkOptions options;
+    if ( !parseArgs(args, &options) ) {
+        printUsage(argv[0]);
+
+        return 1;
+    }
+
+    AppManager manager;
+    int managerArgc = 1;
+    if ( !manager.load(managerArgc, argv, QString(), QStringList(), std::list<std::pair<int,int> >(), QString()) ) {
+        std::cerr << "Failed to initialize " NATRON_APPLICATION_NAME << std::endl;
+
+        return 1;
+    }
+    AppInstance* app = manager.getTopLevelInstance();
+    assert(app);
+
+    BenchmarkEffects::registerPlugins();
+    manager.setNumberOfThreads(options.threads);
+
+    ///Start from empty caches so that the results do not depend on what previous sessions left on disk
+    manager.clearAllCaches();
+
+    std::vector<BenchmarkResult> results;
+    DirectoryScanResult scan;
+    int ret = 0;
+    try {
+        results = runBenchmarks(app, options);
+        if (options.scanFiles > 0) {
+            scan = runDirectoryScan(options.scanFiles);
+        }
+    } catch (const std::exception & e) {
+        std::cerr << e.what() << std::endl;
+        ret = 1;
+    }
+
+    if (ret == 0) {
+        if ( options.output.empty() ) {
+            writeReport(std::cout, options, results, scan);
+        } else {
+            std::ofstream ofile(options.output.c_str(), std::ofstream::out);
+            if ( !ofile.good() ) {
+                std::cerr << "Failed to open " << options.output << std::endl;
+                ret = 1;
+            } else {
+                writeReport(ofile, options, results, scan);
+            }
+        }
+        for (std::size_t i = 0; i < results.size(); ++i) {
+            if (!results[i].succeeded) {
+                ret = 1;
+            }
+        }
+        if (!scan.succeeded) {
+            ret = 1;
+        }
+    }
+
+    app->quit();
+    manager.setNumberOfThreads(0);
+
+    return ret;
+} // main
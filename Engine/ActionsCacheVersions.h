@@ -0,0 +1,98 @@
+//  Natron
+//
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef NATRON_ENGINE_ACTIONSCACHEVERSIONS_H_
+#define NATRON_ENGINE_ACTIONSCACHEVERSIONS_H_
+
+#include <list>
+#include <cstddef>
+
+#include "Global/GlobalDefines.h"
+
+namespace Natron {
+
+/**
+ * @brief The results of the actions of an effect for its last few hashes, the most recently used first.
+ * VersionType must have a constructor taking the hash, a member hash, a member effectsDestroyedCount
+ * holding the number of effects destroyed when its results referencing other effects were computed,
+ * and a function dropResultsReferencingEffects().
+ *
+ * This class is not MT-safe: the actions cache of the effect locks around it.
+ **/
+template <typename VersionType>
+class ActionsCacheVersions
+{
+public:
+
+    explicit ActionsCacheVersions(std::size_t maxVersions)
+        : _versions()
+          , _maxVersions(maxVersions)
+    {
+    }
+
+    /**
+     * @brief Returns the results stored for the given hash, or NULL. If found, the version becomes the most recently used.
+     **/
+    VersionType* find(U64 hash)
+    {
+        for (typename VersionsList::iterator it = _versions.begin(); it != _versions.end(); ++it) {
+            if (it->hash == hash) {
+                if ( it != _versions.begin() ) {
+                    _versions.splice(_versions.begin(), _versions, it);
+                }
+
+                return &_versions.front();
+            }
+        }
+
+        return 0;
+    }
+
+    /**
+     * @brief Same as find but creates the version if needed, evicting the least recently used one.
+     **/
+    VersionType* getOrCreate(U64 hash)
+    {
+        VersionType* found = find(hash);
+
+        if (found) {
+            return found;
+        }
+        _versions.push_front( VersionType(hash) );
+        while (_versions.size() > _maxVersions) {
+            _versions.pop_back();
+        }
+
+        return &_versions.front();
+    }
+
+    /**
+     * @brief Drops the results referencing other effects if an effect was destroyed since they were computed.
+     **/
+    static void dropDanglingResults(VersionType* version,
+                                    int effectsDestroyedCount)
+    {
+        if (version->effectsDestroyedCount != effectsDestroyedCount) {
+            version->dropResultsReferencingEffects();
+            version->effectsDestroyedCount = effectsDestroyedCount;
+        }
+    }
+
+    std::size_t size() const
+    {
+        return _versions.size();
+    }
+
+private:
+
+    typedef std::list<VersionType> VersionsList;
+
+    VersionsList _versions;
+    std::size_t _maxVersions;
+};
+} // namespace Natron
+
+#endif // NATRON_ENGINE_ACTIONSCACHEVERSIONS_H_
@@ -26,6 +26,7 @@
 #include "Engine/Plugin.h"
 #include "Engine/AppManager.h"
 #include "Engine/Node.h"
+#include "Engine/PreviewScheduler.h"
 #include "Engine/ViewerInstance.h"
 #include "Engine/BlockingBackgroundRender.h"
 #include "Engine/NodeSerialization.h"
@@ -40,12 +41,14 @@ struct AppInstancePrivate
     boost::shared_ptr<Natron::Project> _currentProject; //< ptr to the project
     int _appID; //< the unique ID of this instance (or window)
     bool _projectCreatedWithLowerCaseIDs;
+    boost::scoped_ptr<PreviewScheduler> previewScheduler; //< renders the previews of the nodes
     
     AppInstancePrivate(int appID,
                        AppInstance* app)
     : _currentProject( new Natron::Project(app) )
     , _appID(appID)
     , _projectCreatedWithLowerCaseIDs(false)
+    , previewScheduler( new PreviewScheduler(app) )
     {
     }
 };
@@ -66,12 +69,20 @@ AppInstance::~AppInstance()
 {
     appPTR->removeInstance(_imp->_appID);
 
+    _imp->previewScheduler->quitThread();
+
     ///Clear nodes now, not in the destructor of the project as
     ///deleting nodes might reference the project.
     _imp->_currentProject->clearNodes(false);
     _imp->_currentProject->discardAppPointer();
 }
 
+PreviewScheduler*
+AppInstance::getPreviewScheduler() const
+{
+    return _imp->previewScheduler.get();
+}
+
 void
 AppInstance::checkForNewVersion() const
 {
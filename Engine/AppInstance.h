@@ -37,6 +37,7 @@ class KnobSerialization;
 class KnobHolder;
 class ViewerInstance;
 class ProcessHandler;
+class PreviewScheduler;
 namespace Natron {
 class Node;
 class Project;
@@ -183,6 +184,11 @@ public:
     boost::shared_ptr<Natron::Project> getProject() const;
     boost::shared_ptr<TimeLine> getTimeLine() const;
 
+    /**
+     * @brief Returns the thread that renders the previews of the nodes of this app.
+     **/
+    PreviewScheduler* getPreviewScheduler() const;
+
     /*true if the user is NOT scrubbing the timeline*/
     virtual bool shouldRefreshPreview() const
     {
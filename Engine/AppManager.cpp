@@ -15,8 +15,10 @@
 #include <sys/resource.h> // for getrlimit
 #endif
 
+#include <algorithm>
 #include <clocale>
 #include <cstddef>
+#include <iostream>
 #include <QDebug>
 #include <QTextCodec>
 #include <QAbstractSocket>
@@ -43,6 +45,8 @@
 #include "Engine/Format.h"
 #include "Engine/Log.h"
 #include "Engine/Cache.h"
+#include "Engine/MemoryPressureMonitor.h"
+#include "Engine/RenderProfiler.h"
 #include "Engine/Variant.h"
 #include "Engine/Knob.h"
 #include "Engine/Rect.h"
@@ -52,7 +56,7 @@
 BOOST_CLASS_EXPORT(Natron::FrameParams)
 BOOST_CLASS_EXPORT(Natron::ImageParams)
 
-#define NATRON_CACHE_VERSION 2
+#define NATRON_CACHE_VERSION 5
 
 using namespace Natron;
 
@@ -71,6 +75,7 @@ struct AppManagerPrivate
     boost::shared_ptr<Natron::Cache<Natron::Image> >  _nodeCache; //< Images cache
     boost::shared_ptr<Natron::Cache<Natron::Image> >  _diskCache; //< Images disk cache (used by DiskCache nodes)
     boost::shared_ptr<Natron::Cache<Natron::FrameEntry> > _viewerCache; //< Viewer textures cache
+    boost::scoped_ptr<Natron::MemoryPressureMonitor> memoryMonitor; //< trims the caches when the system runs low on RAM
     
     mutable QMutex diskCachesLocationMutex;
     QString diskCachesLocation;
@@ -84,9 +89,6 @@ struct AppManagerPrivate
     U64 _nodesGlobalMemoryUse; //< how much memory all the nodes are using (besides the cache)
     mutable QMutex _ofxLogMutex;
     QString _ofxLog;
-    size_t maxCacheFiles; //< the maximum number of files the application can open for caching. This is the hard limit * 0.9
-    size_t currentCacheFilesCount; //< the number of cache files currently opened in the application
-    mutable QMutex currentCacheFilesCountMutex; //< protects currentCacheFilesCount
     
 
     std::string currentOCIOConfigPath; //< the currentOCIO config path
@@ -127,6 +129,7 @@ struct AppManagerPrivate
         , _nodeCache()
         , _diskCache()
         , _viewerCache()
+        , memoryMonitor()
         , diskCachesLocationMutex()
         , diskCachesLocation()
         ,_backgroundIPC(0)
@@ -136,9 +139,6 @@ struct AppManagerPrivate
         ,_nodesGlobalMemoryUse(0)
         ,_ofxLogMutex()
         ,_ofxLog()
-        ,maxCacheFiles(0)
-        ,currentCacheFilesCount(0)
-        ,currentCacheFilesCountMutex()
         ,idealThreadCount(0)
         ,nThreadsToRender(0)
         ,nThreadsPerEffect(0)
@@ -147,7 +147,7 @@ struct AppManagerPrivate
         ,runningThreadsCount()
         ,lastProjectLoadedCreatedDuringRC2Or3(false)
     {
-        setMaxCacheFiles();
+        setMaxOpenFiles();
         
         runningThreadsCount = 0;
     }
@@ -169,9 +169,9 @@ struct AppManagerPrivate
     void cleanUpCacheDiskStructure(const QString & cachePath);
 
     /**
-     * @brief Called on startup to initialize the max opened files
+     * @brief Called on startup to raise the max opened files to the hard limit
      **/
-    void setMaxCacheFiles();
+    void setMaxOpenFiles();
     
     Natron::Plugin* findPluginById(const QString& oldId,int major, int minor) const;
 };
@@ -211,6 +211,8 @@ AppManager::printUsage(const std::string& programName)
                              " name following the this argument. If no such node exists in the project file, the process will abort."
                              "Note that if you don't pass the --writer argument, it will try to start rendering with all the writers in the project's file. After the writer node name you can pass an optional frame range in the format "
                              " firstFrame-lastFrame (e.g: 10-40). ").toStdString() << std::endl;
+    std::cout << QObject::tr("[--profile <file path>] Measures the time, cache hits and memory spent by each node at each frame "
+                             "and writes them as JSON in the given file once the rendering is done.").toStdString() << std::endl;
     std::cout << QObject::tr("An example of usage of the renderer can be: \n"
                              "./NatronRenderer -w MyWriter 1-100 /Users/Me/MyNatronProjects/MyProject.ntp").toStdString() << std::endl;
 
@@ -233,7 +235,8 @@ AppManager::parseCmdLineArgs(int argc,
                              QString & projectFilename,
                              QStringList & writers,
                              std::list<std::pair<int,int> >& frameRanges,
-                             QString & mainProcessServerName)
+                             QString & mainProcessServerName,
+                             QString & profileFilename)
 {
     if (!argv) {
         return false;
@@ -242,6 +245,7 @@ AppManager::parseCmdLineArgs(int argc,
     *isBackground = false;
     bool expectWriterNameOnNextArg = false;
     bool expectPipeFileNameOnNextArg = false;
+    bool expectProfileFileNameOnNextArg = false;
     bool expectedFrameRange = false;
     QStringList args;
     for (int i = 0; i < argc; ++i) {
@@ -251,7 +255,7 @@ AppManager::parseCmdLineArgs(int argc,
     for (int i = 0; i < args.size(); ++i) {
         
         if ( args.at(i).contains("." NATRON_PROJECT_FILE_EXT) ) {
-            if (expectWriterNameOnNextArg || expectPipeFileNameOnNextArg) {
+            if (expectWriterNameOnNextArg || expectPipeFileNameOnNextArg || expectProfileFileNameOnNextArg) {
                 AppManager::printUsage(argv[0]);
 
                 return false;
@@ -263,7 +267,7 @@ AppManager::parseCmdLineArgs(int argc,
             projectFilename = args.at(i);
             continue;
         } else if ( (args.at(i) == "--background") || (args.at(i) == "-b") ) {
-            if (expectWriterNameOnNextArg  || expectPipeFileNameOnNextArg) {
+            if (expectWriterNameOnNextArg || expectPipeFileNameOnNextArg || expectProfileFileNameOnNextArg) {
                 AppManager::printUsage(argv[0]);
 
                 return false;
@@ -275,7 +279,7 @@ AppManager::parseCmdLineArgs(int argc,
             *isBackground = true;
             continue;
         } else if ( (args.at(i) == "--writer") || (args.at(i) == "-w") ) {
-            if (expectWriterNameOnNextArg  || expectPipeFileNameOnNextArg) {
+            if (expectWriterNameOnNextArg || expectPipeFileNameOnNextArg || expectProfileFileNameOnNextArg) {
                 AppManager::printUsage(argv[0]);
 
                 return false;
@@ -287,7 +291,7 @@ AppManager::parseCmdLineArgs(int argc,
             expectWriterNameOnNextArg = true;
             continue;
         } else if (args.at(i) == "--IPCpipe") {
-            if (expectWriterNameOnNextArg || expectPipeFileNameOnNextArg) {
+            if (expectWriterNameOnNextArg || expectPipeFileNameOnNextArg || expectProfileFileNameOnNextArg) {
                 AppManager::printUsage(argv[0]);
 
                 return false;
@@ -298,6 +302,18 @@ AppManager::parseCmdLineArgs(int argc,
             }
             expectPipeFileNameOnNextArg = true;
             continue;
+        } else if (args.at(i) == "--profile") {
+            if (expectWriterNameOnNextArg || expectPipeFileNameOnNextArg || expectProfileFileNameOnNextArg) {
+                AppManager::printUsage(argv[0]);
+
+                return false;
+            }
+            if (expectedFrameRange) {
+                expectedFrameRange = false;
+                appendFakeFrameRange(frameRanges);
+            }
+            expectProfileFileNameOnNextArg = true;
+            continue;
         }
         
         if (expectedFrameRange) {
@@ -348,9 +364,14 @@ AppManager::parseCmdLineArgs(int argc,
             expectPipeFileNameOnNextArg = false;
             continue;
         }
+        if (expectProfileFileNameOnNextArg) {
+            profileFilename = args.at(i);
+            expectProfileFileNameOnNextArg = false;
+            continue;
+        }
     }
 
-    if (expectWriterNameOnNextArg || expectPipeFileNameOnNextArg) {
+    if (expectWriterNameOnNextArg || expectPipeFileNameOnNextArg || expectProfileFileNameOnNextArg) {
         AppManager::printUsage(argv[0]);
         
         return false;
@@ -361,6 +382,21 @@ AppManager::parseCmdLineArgs(int argc,
     return true;
 } // parseCmdLineArgs
 
+bool
+AppManager::writeRenderProfile(const QString & filename)
+{
+    std::string error;
+
+    if ( !RenderProfiler::writeReport(filename.toStdString(), &error) ) {
+        std::cerr << error << std::endl;
+
+        return false;
+    }
+    std::cout << QObject::tr("Render profile written to ").toStdString() << filename.toStdString() << std::endl;
+
+    return true;
+}
+
 AppManager::AppManager()
     : QObject()
     , _imp( new AppManagerPrivate() )
@@ -419,6 +455,11 @@ AppManager::~AppManager()
 {
     assert( _imp->_appInstances.empty() );
     
+    ///Stop trimming the caches before they are saved and destroyed
+    if (_imp->memoryMonitor) {
+        _imp->memoryMonitor->quitThread();
+    }
+
     for (PluginsMap::iterator it = _imp->_plugins.begin(); it != _imp->_plugins.end(); ++it) {
         for (PluginMajorsOrdered::iterator it2 = it->second.begin(); it2 != it->second.end(); ++it2) {
             delete *it2;
@@ -445,7 +486,7 @@ AppManager::~AppManager()
     ///Caches may have launched some threads to delete images, wait for them to be done
     QThreadPool::globalInstance()->waitForDone();
     
-    ///Kill caches now because decreaseNCacheFilesOpened can be called
+    ///Kill caches now, the deleter threads may still release entries
     _imp->_nodeCache->waitForDeleterThread();
     _imp->_diskCache->waitForDeleterThread();
     _imp->_viewerCache->waitForDeleterThread();
@@ -563,7 +604,7 @@ AppManager::loadInternal(const QString & projectFilename,
     initGui();
 
 
-    size_t maxCacheRAM = _imp->_settings->getRamMaximumPercent() * getSystemTotalRAM();
+    size_t maxCacheRAM = _imp->_settings->getRamMaximumPercent() * getSystemTotalRAM_conditionnally();
     U64 maxViewerDiskCache = _imp->_settings->getMaximumViewerDiskCacheSize();
     U64 playbackSize = maxCacheRAM * _imp->_settings->getRamPlaybackMaximumPercent();
     U64 viewerCacheSize = maxViewerDiskCache + playbackSize;
@@ -573,9 +614,13 @@ AppManager::loadInternal(const QString & projectFilename,
     _imp->_nodeCache.reset( new Cache<Image>("NodeCache",NATRON_CACHE_VERSION, maxCacheRAM - playbackSize,1.) );
     _imp->_diskCache.reset( new Cache<Image>("DiskCache",NATRON_CACHE_VERSION, maxDiskCacheNode,0.) );
     _imp->_viewerCache.reset( new Cache<FrameEntry>("ViewerCache",NATRON_CACHE_VERSION,viewerCacheSize,(double)playbackSize / (double)viewerCacheSize) );
+    setDiskCachesCompression( _imp->_settings->isDiskCacheCompressionEnabled(), _imp->_settings->isDiskCacheFloatAsHalfEnabled() );
 
     setLoadingStatus( tr("Restoring the image cache...") );
     _imp->restoreCaches();
+    
+    _imp->memoryMonitor.reset( new MemoryPressureMonitor() );
+    _imp->memoryMonitor->start(QThread::LowPriority);
 
     setLoadingStatus( tr("Restoring user settings...") );
 
@@ -907,6 +952,14 @@ AppManager::setPlaybackCacheMaximumSize(double p)
     _imp->_viewerCache->setMaximumInMemorySize( (double)playbackSize / (double)maxDiskCacheSize );
 }
 
+void
+AppManager::setDiskCachesCompression(bool enabled,
+                                     bool floatAsHalf)
+{
+    _imp->_diskCache->setDiskCompression(enabled, floatAsHalf);
+    _imp->_viewerCache->setDiskCompression(enabled, floatAsHalf);
+}
+
 void
 AppManager::loadAllPlugins()
 {
@@ -1361,7 +1414,11 @@ bool
 AppManager::getImage(const Natron::ImageKey & key,
                      std::list<boost::shared_ptr<Natron::Image> >* returnValue) const
 {
-    return _imp->_nodeCache->get(key,returnValue);
+    bool ret = _imp->_nodeCache->get(key,returnValue);
+
+    RenderProfiler::recordCacheAccess(ret, 0);
+
+    return ret;
 }
 
 bool
@@ -1370,13 +1427,21 @@ AppManager::getImageOrCreate(const Natron::ImageKey & key,
                              ImageLocker* imageLocker,
                              boost::shared_ptr<Natron::Image>* returnValue) const
 {
-    return _imp->_nodeCache->getOrCreate(key,params,imageLocker,returnValue);
+    bool ret = _imp->_nodeCache->getOrCreate(key,params,imageLocker,returnValue);
+
+    RenderProfiler::recordCacheAccess(ret, ret ? 0 : params->getElementsCount() );
+
+    return ret;
 }
 
 bool
 AppManager::getImage_diskCache(const Natron::ImageKey & key,std::list<boost::shared_ptr<Natron::Image> >* returnValue) const
 {
-    return _imp->_diskCache->get(key, returnValue);
+    bool ret = _imp->_diskCache->get(key, returnValue);
+
+    RenderProfiler::recordCacheAccess(ret, 0);
+
+    return ret;
 }
 
 bool
@@ -1384,7 +1449,11 @@ AppManager::getImageOrCreate_diskCache(const Natron::ImageKey & key,const boost:
                                 ImageLocker* imageLocker,
                                 boost::shared_ptr<Natron::Image>* returnValue) const
 {
-    return _imp->_diskCache->getOrCreate(key, params, imageLocker, returnValue);
+    bool ret = _imp->_diskCache->getOrCreate(key, params, imageLocker, returnValue);
+
+    RenderProfiler::recordCacheAccess(ret, ret ? 0 : params->getElementsCount() );
+
+    return ret;
 }
 
 
@@ -1469,6 +1538,7 @@ AppManager::registerEngineMetaTypes() const
     qRegisterMetaType<Natron::StandardButtons>();
     qRegisterMetaType<RectI>();
     qRegisterMetaType<RectD>();
+    qRegisterMetaType<Natron::CacheEventsBatch>("Natron::CacheEventsBatch");
 #if QT_VERSION < 0x050000
     qRegisterMetaType<QAbstractSocket::SocketState>("SocketState");
 #endif
@@ -1514,13 +1584,30 @@ AppManager::setDiskCacheLocation(const QString& path)
 {
     
     QDir d(path);
-    QMutexLocker k(&_imp->diskCachesLocationMutex);
-    if (d.exists() && !path.isEmpty()) {
-        _imp->diskCachesLocation = path;
-    } else {
-        _imp->diskCachesLocation = Natron::StandardPaths::writableLocation(Natron::StandardPaths::eStandardLocationCache);
+    bool changed;
+    {
+        QMutexLocker k(&_imp->diskCachesLocationMutex);
+        QString oldLocation = _imp->diskCachesLocation;
+        if (d.exists() && !path.isEmpty()) {
+            _imp->diskCachesLocation = path;
+        } else {
+            _imp->diskCachesLocation = Natron::StandardPaths::writableLocation(Natron::StandardPaths::eStandardLocationCache);
+        }
+        changed = _imp->diskCachesLocation != oldLocation;
     }
     
+    ///The caches are created once the settings are loaded, they create their slab files in the new location
+    if (changed) {
+        if (_imp->_nodeCache) {
+            _imp->_nodeCache->onCacheLocationChanged();
+        }
+        if (_imp->_diskCache) {
+            _imp->_diskCache->onCacheLocationChanged();
+        }
+        if (_imp->_viewerCache) {
+            _imp->_viewerCache->onCacheLocationChanged();
+        }
+    }
 }
 
 const QString&
@@ -1647,38 +1734,6 @@ AppManagerPrivate::checkForCacheDiskStructure(const QString & cachePath)
 
         return false;
     }
-    QDir directory(cachePath);
-    QStringList files = directory.entryList(QDir::AllDirs);
-
-
-    /*Now counting actual data files in the cache*/
-    /*check if there's 256 subfolders, otherwise reset cache.*/
-    int count = 0; // -1 because of the restoreFile
-    int subFolderCount = 0;
-    for (int i = 0; i < files.size(); ++i) {
-        QString subFolder(cachePath);
-        subFolder.append( QDir::separator() );
-        subFolder.append(files[i]);
-        if ( ( subFolder.right(1) == QString(".") ) || ( subFolder.right(2) == QString("..") ) ) {
-            continue;
-        }
-        QDir d(subFolder);
-        if ( d.exists() ) {
-            ++subFolderCount;
-            QStringList items = d.entryList();
-            for (int j = 0; j < items.size(); ++j) {
-                if ( ( items[j] != QString(".") ) && ( items[j] != QString("..") ) ) {
-                    ++count;
-                }
-            }
-        }
-    }
-    if (subFolderCount < 256) {
-        qDebug() << cachePath << " doesn't contain sub-folders indexed from 00 to FF. Reseting.";
-        cleanUpCacheDiskStructure(cachePath);
-
-        return false;
-    }
 
     return true;
 }
@@ -1698,31 +1753,11 @@ AppManagerPrivate::cleanUpCacheDiskStructure(const QString & cachePath)
     }
 #endif
     cacheFolder.mkpath(".");
-
-    QStringList etr = cacheFolder.entryList(QDir::NoDotAndDotDot);
-    // if not 256 subdirs, we re-create the cache
-    if (etr.size() < 256) {
-        foreach(QString e, etr) {
-            cacheFolder.rmdir(e);
-        }
-    }
-    for (U32 i = 0x00; i <= 0xF; ++i) {
-        for (U32 j = 0x00; j <= 0xF; ++j) {
-            std::ostringstream oss;
-            oss << std::hex <<  i;
-            oss << std::hex << j;
-            std::string str = oss.str();
-            cacheFolder.mkdir( str.c_str() );
-        }
-    }
 }
 
 void
-AppManagerPrivate::setMaxCacheFiles()
+AppManagerPrivate::setMaxOpenFiles()
 {
-    /*Default to something reasonnable if the code below would happen to not work for some reason*/
-    size_t hardMax = NATRON_MAX_CACHE_FILES_OPENED;
-
 #if defined(Q_OS_UNIX) && defined(RLIMIT_NOFILE)
     /*
        Avoid 'Too many open files' on Unix.
@@ -1741,12 +1776,9 @@ AppManagerPrivate::setMaxCacheFiles()
                 // rlim_cur above OPEN_MAX even if rlim_max > OPEN_MAX.
                 if (rl.rlim_cur > OPEN_MAX) {
                     rl.rlim_cur = OPEN_MAX;
-                    hardMax = rl.rlim_cur;
                     setrlimit(RLIMIT_NOFILE, &rl);
                 }
 #             endif
-            } else {
-                hardMax = rl.rlim_cur;
             }
         }
     }
@@ -1795,51 +1827,6 @@ AppManagerPrivate::setMaxCacheFiles()
        }
      */
 #endif
-
-    maxCacheFiles = hardMax * 0.9;
-}
-
-bool
-AppManager::isNCacheFilesOpenedCapped() const
-{
-    QMutexLocker l(&_imp->currentCacheFilesCountMutex);
-
-    return _imp->currentCacheFilesCount >= _imp->maxCacheFiles;
-}
-
-size_t
-AppManager::getNCacheFilesOpened() const
-{
-    QMutexLocker l(&_imp->currentCacheFilesCountMutex);
-
-    return _imp->currentCacheFilesCount;
-}
-
-void
-AppManager::increaseNCacheFilesOpened()
-{
-    QMutexLocker l(&_imp->currentCacheFilesCountMutex);
-
-    ++_imp->currentCacheFilesCount;
-#ifdef DEBUG
-    if (_imp->currentCacheFilesCount > _imp->maxCacheFiles) {
-        qDebug() << "Cache has more files opened than the limit allowed: " << _imp->currentCacheFilesCount << " / " << _imp->maxCacheFiles;
-    }
-#endif
-#ifdef NATRON_DEBUG_CACHE
-    qDebug() << "N Cache Files Opened: " << _imp->currentCacheFilesCount;
-#endif
-}
-
-void
-AppManager::decreaseNCacheFilesOpened()
-{
-    QMutexLocker l(&_imp->currentCacheFilesCountMutex);
-
-    --_imp->currentCacheFilesCount;
-#ifdef NATRON_DEBUG_CACHE
-    qDebug() << "NFiles Opened: " << _imp->currentCacheFilesCount;
-#endif
 }
 
 void
@@ -1984,42 +1971,55 @@ AppManager::isNodeCacheAlmostFull() const
 void
 AppManager::checkCacheFreeMemoryIsGoodEnough()
 {
-    ///Before allocating the memory check that there's enough space to fit in memory
-    size_t systemRAMToKeepFree = getSystemTotalRAM() * appPTR->getCurrentSettings()->getUnreachableRamPercent();
-    size_t totalFreeRAM = getAmountFreePhysicalRAM();
-    
+    ///The system memory is sampled by the memory pressure monitor thread, which also trims the caches.
+    ///If the last sample shows that the RAM is running out, ask it to trim again without waiting for its next interval.
+    if ( _imp->memoryMonitor && (_imp->memoryMonitor->getPressure() == eMemoryPressureHigh) ) {
+        _imp->memoryMonitor->requestSample();
+    }
+}
 
-    double playbackRAMPercent = appPTR->getCurrentSettings()->getRamPlaybackMaximumPercent();
-    while (totalFreeRAM <= systemRAMToKeepFree) {
-        
+size_t
+AppManager::getTotalRAM() const
+{
+    if (_imp->memoryMonitor) {
+        return _imp->memoryMonitor->getTotalRAM();
+    }
+
+    return getSystemTotalRAM_conditionnally();
+}
+
+void
+AppManager::trimCachesUnderMemoryPressure(size_t bytesToFree)
+{
+    ///Caches are trimmed by batches so that the lock of a cache is taken once per batch and not once per entry
+    const size_t batchSize = 64 * 1024 * 1024;
+    double playbackRAMPercent = getCurrentSettings()->getRamPlaybackMaximumPercent();
+    size_t freed = 0;
+
+    while (freed < bytesToFree) {
+        size_t batch = std::min(bytesToFree - freed, batchSize);
         size_t nodeCacheSize =  _imp->_nodeCache->getMemoryCacheSize();
         size_t viewerRamCacheSize =  _imp->_viewerCache->getMemoryCacheSize();
         
         ///If the viewer cache represents more memory than the node cache, clear some of the viewer cache
+        size_t batchFreed;
         if (nodeCacheSize == 0 || (viewerRamCacheSize / (double)nodeCacheSize) > playbackRAMPercent) {
-#ifdef NATRON_DEBUG_CACHE
-            qDebug() << "Total system free RAM is below the threshold: " << printAsRAM(totalFreeRAM)
-                     << ", clearing last recently used ViewerCache texture...";
-#endif
-            
-            if (!_imp->_viewerCache->evictLRUInMemoryEntry()) {
-                break;
+            batchFreed = _imp->_viewerCache->evictLRUInMemoryEntries(batch);
+            if (batchFreed == 0) {
+                batchFreed = _imp->_nodeCache->evictLRUInMemoryEntries(batch);
             }
-            
-            
         } else {
-#ifdef NATRON_DEBUG_CACHE
-            qDebug() << "Total system free RAM is below the threshold: " << printAsRAM(totalFreeRAM)
-                     << ", clearing last recently used NodeCache image...";
-#endif
-            if (!_imp->_nodeCache->evictLRUInMemoryEntry()) {
-                break;
+            batchFreed = _imp->_nodeCache->evictLRUInMemoryEntries(batch);
+            if (batchFreed == 0) {
+                batchFreed = _imp->_viewerCache->evictLRUInMemoryEntries(batch);
             }
         }
-        
-        totalFreeRAM = getAmountFreePhysicalRAM();
+        if (batchFreed == 0) {
+            ///Everything left in the caches is in use
+            break;
+        }
+        freed += batchFreed;
     }
-
 }
 
 void
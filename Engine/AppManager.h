@@ -206,6 +206,11 @@ public:
 
     void setPlaybackCacheMaximumSize(double p);
 
+    /**
+     * @brief Sets how the playback cache and the DiskCache node cache compress the entries they put on disk.
+     **/
+    void setDiskCachesCompression(bool enabled,bool floatAsHalf);
+
     void removeFromNodeCache(const boost::shared_ptr<Natron::Image> & image);
     void removeFromViewerCache(const boost::shared_ptr<Natron::FrameEntry> & texture);
     
@@ -242,7 +247,14 @@ public:
                                  QString & projectFilename,
                                  QStringList & writers,
                                  std::list<std::pair<int,int> >& frameRanges,
-                                 QString & mainProcessServerName);
+                                 QString & mainProcessServerName,
+                                 QString & profileFilename);
+
+    /**
+     * @brief Writes the render profile recorded so far (see RenderProfiler) to the given file.
+     * Errors are reported on the standard error.
+     **/
+    static bool writeRenderProfile(const QString & filename);
 
     /**
      * @brief Called when the instance is exited
@@ -285,16 +297,24 @@ public:
                         int major,
                         int minor);
 
-    bool isNCacheFilesOpenedCapped() const;
-    size_t getNCacheFilesOpened() const;
-    void increaseNCacheFilesOpened();
-    void decreaseNCacheFilesOpened();
-
     /**
-     * @brief Called by the caches to check that there's enough free memory on the computer to perform the allocation.
-     * WARNING: This functin may remove some entries from the caches.
+     * @brief Called by the caches before an allocation. This only checks the memory pressure level measured by
+     * the memory pressure monitor thread and wakes it up if the RAM is running out, it does not query the system.
      **/
     void checkCacheFreeMemoryIsGoodEnough();
+
+    /**
+     * @brief Returns the RAM the application may use (see getSystemTotalRAM_conditionnally()) as last sampled by the
+     * memory pressure monitor thread, so that it can be called for each frame without reading the cgroup files.
+     **/
+    size_t getTotalRAM() const WARN_UNUSED_RETURN;
+
+    /**
+     * @brief Called by the memory pressure monitor thread to release at least bytesToFree bytes from the in-memory
+     * portion of the caches, if possible. The viewer cache and the node cache are trimmed so that their balance
+     * follows the playback RAM percentage of the settings.
+     **/
+    void trimCachesUnderMemoryPressure(size_t bytesToFree);
     
     void onCheckerboardSettingsChanged() { emit checkerboardSettingsChanged(); }
     
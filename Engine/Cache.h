@@ -53,6 +53,7 @@ CLANG_DIAG_ON(unused-parameter)
 #include "Engine/FrameEntrySerialization.h"
 #include "Engine/FrameParamsSerialization.h"
 #include "Engine/CacheEntry.h"
+#include "Engine/CacheSignalEmitter.h"
 #include "Engine/LRUHashTable.h"
 #include "Engine/StandardPaths.h"
 #include "Engine/ImageLocker.h"
@@ -64,7 +65,7 @@ CLANG_DIAG_ON(unused-parameter)
 //Beyond that percentage of occupation, the cache will start evicting LRU entries
 #define NATRON_CACHE_LIMIT_PERCENT 0.9
 
-///When defined, number of opened files, memory size and disk size of the cache are printed whenever there's activity.
+///When defined, memory size and disk size of the cache are printed whenever there's activity.
 //#define NATRON_DEBUG_CACHE
 
 namespace Natron {
@@ -185,61 +186,6 @@ private:
 };
 
     
-class CacheSignalEmitter
-    : public QObject
-{
-    Q_OBJECT
-
-public:
-    CacheSignalEmitter()
-    {
-    }
-
-    ~CacheSignalEmitter()
-    {
-    }
-
-    void emitSignalClearedInMemoryPortion()
-    {
-        emit clearedInMemoryPortion();
-    }
-
-    void emitClearedDiskPortion()
-    {
-        emit clearedDiskPortion();
-    }
-
-    void emitAddedEntry(SequenceTime time)
-    {
-        emit addedEntry(time);
-    }
-
-    void emitRemovedEntry(SequenceTime time,
-                          int storage)
-    {
-        emit removedEntry(time,storage);
-    }
-
-    void emitEntryStorageChanged(SequenceTime time,
-                                 int oldStorage,
-                                 int newStorage)
-    {
-        emit entryStorageChanged(time,oldStorage,newStorage);
-    }
-
-signals:
-
-    void clearedInMemoryPortion();
-
-    void clearedDiskPortion();
-
-    void addedEntry(SequenceTime);
-    void removedEntry(SequenceTime,int);
-    void entryStorageChanged(SequenceTime,int,int);
-};
-
-
-    
 /*
  * ValueType must be derived of CacheEntryHelper
  */
@@ -262,14 +208,16 @@ public:
         typename EntryType::key_type key;
         ParamsTypePtr params;
         std::size_t size; //< the data size in bytes
-        std::string filePath; //< we need to serialize it as several entries can have the same hash, hence we index them
+        CacheSlabExtent extent; //< where the data lives in the slab files of the cache
+        bool compressed; //< the extent holds the data compressed with CacheCodec
         
         SerializedEntry()
         : hash(0)
         , key()
         , params()
         , size(0)
-        , filePath()
+        , extent()
+        , compressed(false)
         {
             
         }
@@ -282,7 +230,10 @@ public:
             ar & boost::serialization::make_nvp("Key",key);
             ar & boost::serialization::make_nvp("Params",params);
             ar & boost::serialization::make_nvp("Size",size);
-            ar & boost::serialization::make_nvp("Filename",filePath);
+            ar & boost::serialization::make_nvp("SlabIndex",extent.slab);
+            ar & boost::serialization::make_nvp("SlabOffset",extent.offset);
+            ar & boost::serialization::make_nvp("SlabExtentSize",extent.size);
+            ar & boost::serialization::make_nvp("Compressed",compressed);
         }
         
         template<class Archive>
@@ -293,7 +244,10 @@ public:
             ar & boost::serialization::make_nvp("Key",key);
             ar & boost::serialization::make_nvp("Params",params);
             ar & boost::serialization::make_nvp("Size",size);
-            ar & boost::serialization::make_nvp("Filename",filePath);
+            ar & boost::serialization::make_nvp("SlabIndex",extent.slab);
+            ar & boost::serialization::make_nvp("SlabOffset",extent.offset);
+            ar & boost::serialization::make_nvp("SlabExtentSize",extent.size);
+            ar & boost::serialization::make_nvp("Compressed",compressed);
         }
         
         BOOST_SERIALIZATION_SPLIT_MEMBER()
@@ -375,8 +329,12 @@ private:
          is called by an external object that have a const ref to the cache.
      */
     mutable std::size_t _memoryCacheSize;     // current size of the cache in bytes
-    mutable std::size_t _diskCacheSize;
-    mutable QMutex _sizeLock; // protects _memoryCacheSize & _diskCacheSize & _maximumInMemorySize & _maximumCacheSize
+    mutable std::size_t _diskCacheSize; // size of the data of the entries on disk, as if they were not compressed
+    mutable std::size_t _diskCacheStoredSize; // bytes used in the slab files, this is what is compared to the maximum size
+    bool _compressDiskEntries;
+    bool _diskFloatAsHalf;
+    mutable QMutex _sizeLock; // protects _memoryCacheSize & _diskCacheSize & _diskCacheStoredSize & _maximumInMemorySize & _maximumCacheSize
+                              // & _compressDiskEntries & _diskFloatAsHalf
     
     mutable QMutex _lock; //protects _memoryCache & _diskCache
 
@@ -386,6 +344,10 @@ private:
          when we call get() and we want this function to be const.*/
     mutable CacheContainer _memoryCache;
     mutable CacheContainer _diskCache;
+    
+    ///Entries evicted from the memory portion that are waiting to be written to the slab files by
+    ///writeBackEvictedEntries(), protected by _lock. They are in neither portion meanwhile.
+    mutable std::list<EntryTypePtr> _entriesToWriteBack;
     const std::string _cacheName;
     const unsigned int _version;
 
@@ -401,6 +363,15 @@ private:
     mutable Natron::DeleterThread<EntryType> _deleterThread;
     mutable QWaitCondition _memoryFullCondition; //< protected by _sizeLock
     
+    ///The slab files backing the disk portion, created on first use because the cache location
+    ///is only known once the settings are loaded
+    mutable QMutex _slabAllocatorLock;
+    mutable boost::shared_ptr<CacheSlabAllocator> _slabAllocator;
+    
+    ///The slab files of the previous cache locations, still used by the entries that were in use when the
+    ///location changed. Protected by _slabAllocatorLock
+    std::list<boost::shared_ptr<CacheSlabAllocator> > _retiredSlabAllocators;
+    
 public:
 
 
@@ -416,11 +387,15 @@ public:
           ,_maximumCacheSize(maximumCacheSize)
           ,_memoryCacheSize(0)
           ,_diskCacheSize(0)
+          ,_diskCacheStoredSize(0)
+          ,_compressDiskEntries(false)
+          ,_diskFloatAsHalf(false)
           ,_sizeLock()
           ,_lock()
           , _getLock()
           ,_memoryCache()
           ,_diskCache()
+          ,_entriesToWriteBack()
           ,_cacheName(cacheName)
           ,_version(version)
           ,_signalEmitter(new CacheSignalEmitter)
@@ -428,6 +403,9 @@ public:
           ,_tearingDown(false)
           ,_deleterThread(this)
           ,_memoryFullCondition()
+          ,_slabAllocatorLock()
+          ,_slabAllocator()
+          ,_retiredSlabAllocators()
     {
     }
 
@@ -437,6 +415,7 @@ public:
         _tearingDown = true;
         _memoryCache.clear();
         _diskCache.clear();
+        _entriesToWriteBack.clear();
         delete _signalEmitter;
         
     }
@@ -461,13 +440,19 @@ public:
              std::list<EntryTypePtr>* returnValue) const
     {
 
-        ///Be atomic, so it cannot be created by another thread in the meantime
-        QMutexLocker getlocker(&_getLock);
-
-        ///lock the cache before reading it.
-        QMutexLocker locker(&_lock);
-        return getInternal(key,returnValue);
+        bool ret;
+        {
+            ///Be atomic, so it cannot be created by another thread in the meantime
+            QMutexLocker getlocker(&_getLock);
+            
+            ///lock the cache before reading it.
+            QMutexLocker locker(&_lock);
+            ret = getInternal(key,returnValue);
+        }
+        ///Outside of _getLock too, so that the other look-ups do not wait for it
+        writeBackEvictedEntries();
         
+        return ret;
     } // get
     
     /**
@@ -512,20 +497,6 @@ private:
         ///Before allocating the memory check that there's enough space to fit in memory
         appPTR->checkCacheFreeMemoryIsGoodEnough();
         
-        
-        ///Just in case, we don't allow more than X files to be removed at once.
-        int safeCounter = 0;
-        ///If too many files are opened, fall-back on RAM storage.
-        while ( appPTR->isNCacheFilesOpenedCapped() && safeCounter < 1000 ) {
-#ifdef NATRON_DEBUG_CACHE
-            qDebug() << "Reached maximum cache files opened limit,clearing last recently used one...";
-#endif
-            if ( !evictLRUDiskEntry() ) {
-                break;
-            }
-            ++safeCounter;
-        }
-        
         U64 memoryCacheSize,maximumInMemorySize;
         {
             QMutexLocker k(&_sizeLock);
@@ -593,8 +564,7 @@ private:
             
             
             try {
-                returnValue->reset( new EntryType(key,params,this,storage,
-                                                  storage == Natron::eStorageModeDisk ? QString( getCachePath() + QDir::separator() ).toStdString() : std::string()) );
+                returnValue->reset( new EntryType(key,params,this,storage) );
                 
                 ///Don't call allocateMemory() here because we're still under the lock and we might force tons of threads to wait unnecesserarily
                 
@@ -652,6 +622,7 @@ public:
         ///Make sure the shared_ptrs live in this list and are destroyed not while under the lock
         ///so that the memory freeing (which might be expensive for large images) doesn't happen while under the lock
         
+        bool found = false;
         {
             ///Be atomic, so it cannot be created by another thread in the meantime
             QMutexLocker getlocker(&_getLock);
@@ -666,15 +637,22 @@ public:
                 for (typename std::list<EntryTypePtr>::iterator it = entries.begin(); it != entries.end(); ++it) {
                     if (*(*it)->getParams() == *params) {
                         *returnValue = *it;
-                        return true;
+                        found = true;
+                        break;
                     }
                 }
             }
             
-            createInternal(key,params,imageLocker,returnValue);
-            return false;
+            if (!found) {
+                createInternal(key,params,imageLocker,returnValue);
+            }
             
         } // getlocker
+        
+        ///The entries evicted to make room are written to the disk outside of _getLock and _lock
+        writeBackEvictedEntries();
+        
+        return found;
     }
     
     /**
@@ -697,6 +675,7 @@ public:
             }
             evictedFromMemory = _memoryCache.evict();
         }
+        getSlabAllocator()->removeUnusedSlabs();
 
         if (_signalEmitter) {
             _signalEmitter->blockSignals(false);
@@ -726,8 +705,15 @@ public:
             evictedFromDisk.second->removeAnyBackingFile();
             evictedFromDisk = _diskCache.evict();
         }
+        ///Give the disk space back: the slabs of the entries still in use are kept
+        getSlabAllocator()->removeUnusedSlabs();
+        {
+            QMutexLocker k(&_slabAllocatorLock);
+            for (std::list<boost::shared_ptr<CacheSlabAllocator> >::iterator it = _retiredSlabAllocators.begin(); it != _retiredSlabAllocators.end(); ++it) {
+                (*it)->removeUnusedSlabs();
+            }
+        }
 
-        
         _signalEmitter->blockSignals(false);
         _signalEmitter->emitClearedDiskPortion();
     }
@@ -741,51 +727,19 @@ public:
             ///block signals otherwise the we would be spammed of notifications
             _signalEmitter->blockSignals(true);
         }
-        QMutexLocker locker(&_lock);
-        std::pair<hash_type,EntryTypePtr> evictedFromMemory = _memoryCache.evict();
-        while (evictedFromMemory.second) {
-            ///move back the entry on disk if it can be store on disk
-            if ( evictedFromMemory.second->isStoredOnDisk() ) {
-                evictedFromMemory.second->deallocate();
-                /*insert it back into the disk portion */
-
-                U64 diskCacheSize,maximumCacheSize;
-                {
-                    QMutexLocker k(&_sizeLock);
-                    diskCacheSize = _diskCacheSize;
-                    maximumCacheSize = _maximumCacheSize;
+        {
+            QMutexLocker locker(&_lock);
+            std::pair<hash_type,EntryTypePtr> evictedFromMemory = _memoryCache.evict();
+            while (evictedFromMemory.second) {
+                ///move back the entry on disk if it can be store on disk
+                if ( evictedFromMemory.second->isStoredOnDisk() ) {
+                    _entriesToWriteBack.push_back(evictedFromMemory.second);
                 }
                 
-                /*before that we need to clear the disk cache if it exceeds the maximum size allowed*/
-                while (diskCacheSize + evictedFromMemory.second->size() >= maximumCacheSize) {
-                    
-                    {
-                        std::pair<hash_type,EntryTypePtr> evictedFromDisk = _diskCache.evict();
-                        //if the cache couldn't evict that means all entries are used somewhere and we shall not remove them!
-                        //we'll let the user of these entries purge the extra entries left in the cache later on
-                        if (!evictedFromDisk.second) {
-                            break;
-                        }
-                        ///Erase the file from the disk if we reach the limit.
-                        evictedFromDisk.second->removeAnyBackingFile();
-                    }
-                    {
-                        QMutexLocker k(&_sizeLock);
-                        diskCacheSize = _diskCacheSize;
-                        maximumCacheSize = _maximumCacheSize;
-                    }
-                }
-
-                /*update the disk cache size*/
-                CacheIterator existingDiskCacheEntry = _diskCache( evictedFromMemory.second->getHashKey() );
-                /*if the entry doesn't exist on the disk cache,make a new list and insert it*/
-                if ( existingDiskCacheEntry == _diskCache.end() ) {
-                    _diskCache.insert(evictedFromMemory.second->getHashKey(),evictedFromMemory.second);
-                }
+                evictedFromMemory = _memoryCache.evict();
             }
-
-            evictedFromMemory = _memoryCache.evict();
         }
+        writeBackEvictedEntries();
 
         _signalEmitter->blockSignals(false);
         _signalEmitter->emitSignalClearedInMemoryPortion();
@@ -825,6 +779,7 @@ public:
                 occupationPercentage = (double)memoryCacheSize / maximumInMemorySize;
             }
         }
+        writeBackEvictedEntries();
     }
     
     /**
@@ -862,9 +817,34 @@ public:
             QMutexLocker locker(&_lock);
             ret = tryEvictEntry(entriesToBeDeleted);
         }
+        writeBackEvictedEntries();
         return ret;
     }
 
+    /**
+     * @brief Removes the last recently used entries from the in-memory portion of the cache until at least
+     * bytesToFree bytes of RAM were released, taking the lock only once. Returns the amount of RAM released,
+     * which is less than bytesToFree if there was nothing left to evict.
+     **/
+    std::size_t evictLRUInMemoryEntries(std::size_t bytesToFree) const
+    {
+        ///Make sure the shared_ptrs live in this list and are destroyed not while under the lock
+        std::list<EntryTypePtr> entriesToBeDeleted;
+        std::size_t freed = 0;
+        {
+            QMutexLocker locker(&_lock);
+            while (freed < bytesToFree) {
+                std::size_t evictedSize = 0;
+                if ( !tryEvictEntry(entriesToBeDeleted, &evictedSize) ) {
+                    break;
+                }
+                freed += evictedSize;
+            }
+        }
+        writeBackEvictedEntries();
+        return freed;
+    }
+
     /**
      * @brief Removes the last recently used entry from the disk cache.
      * This is expensive since it takes the lock. Returns false
@@ -925,10 +905,7 @@ public:
         
         _memoryCacheSize += size;
         _signalEmitter->emitAddedEntry(time);
-
-        if (storage == Natron::eStorageModeDisk) {
-            appPTR->increaseNCacheFilesOpened();
-        }
+        Q_UNUSED(storage);
 #ifdef NATRON_DEBUG_CACHE
         qDebug() << cacheName().c_str() << " memory size: " << printAsRAM(_memoryCacheSize);
 #endif
@@ -989,8 +966,6 @@ public:
             qDebug() << cacheName().c_str() << " memory size: " << printAsRAM(_memoryCacheSize);
             qDebug() << cacheName().c_str() << " disk size: " << printAsRAM(_diskCacheSize);
 #endif
-            ///We switched from RAM to DISK that means the MemoryFile object has been destroyed hence the file has been closed.
-            appPTR->decreaseNCacheFilesOpened();
         } else if (oldStorage == Natron::eStorageModeDisk) {
             _memoryCacheSize += size;
             _diskCacheSize = size > _diskCacheSize ? 0 : _diskCacheSize - size;
@@ -998,8 +973,6 @@ public:
             qDebug() << cacheName().c_str() << " memory size: " << printAsRAM(_memoryCacheSize);
             qDebug() << cacheName().c_str() << " disk size: " << printAsRAM(_diskCacheSize);
 #endif
-            ///We switched from DISK to RAM that means the MemoryFile object has been created and the file opened
-            appPTR->increaseNCacheFilesOpened();
         } else {
             if (newStorage == Natron::eStorageModeRAM) {
                 _memoryCacheSize += size;
@@ -1012,9 +985,71 @@ public:
         
     }
 
-    virtual void backingFileClosed() const OVERRIDE FINAL
+    virtual void notifyEntryStoredSizeChanged(std::size_t oldSize,
+                                              std::size_t newSize) const OVERRIDE FINAL
     {
-        appPTR->decreaseNCacheFilesOpened();
+        if (_tearingDown) {
+            return;
+        }
+        QMutexLocker k(&_sizeLock);
+
+        _diskCacheStoredSize = oldSize > _diskCacheStoredSize ? 0 : _diskCacheStoredSize - oldSize;
+        _diskCacheStoredSize += newSize;
+#ifdef NATRON_DEBUG_CACHE
+        qDebug() << cacheName().c_str() << " disk size: " << printAsRAM(_diskCacheSize) << " stored in " << printAsRAM(_diskCacheStoredSize);
+#endif
+    }
+
+    virtual bool isDiskCompressionEnabled(bool* floatAsHalf) const OVERRIDE FINAL
+    {
+        QMutexLocker k(&_sizeLock);
+
+        *floatAsHalf = _diskFloatAsHalf;
+
+        return _compressDiskEntries;
+    }
+
+    /**
+     * @brief Entries put on disk from now on are compressed if enabled is true, entries already on disk
+     * are left as is. @see CacheCodec
+     * @param floatAsHalf If true, 32-bit floating point data is stored as half floats, this is lossy.
+     **/
+    void setDiskCompression(bool enabled,
+                            bool floatAsHalf)
+    {
+        QMutexLocker k(&_sizeLock);
+
+        _compressDiskEntries = enabled;
+        _diskFloatAsHalf = floatAsHalf;
+    }
+
+    virtual CacheSlabAllocator* getSlabAllocator() const OVERRIDE FINAL
+    {
+        QMutexLocker k(&_slabAllocatorLock);
+        if (!_slabAllocator) {
+            _slabAllocator.reset( new CacheSlabAllocator( getCachePath().toStdString() ) );
+        }
+        return _slabAllocator.get();
+    }
+
+    /**
+     * @brief To be called when the location of the disk caches changes: the entries put on disk from now on
+     * go in slab files of the new location. The entries on disk that are not in use are removed. The slab files
+     * of the previous location are kept for the entries still in use, but these entries are not saved anymore.
+     **/
+    void onCacheLocationChanged()
+    {
+        clearDiskPortion();
+        
+        QString cachePath = getCachePath();
+        QDir(cachePath).mkpath(".");
+        
+        QMutexLocker k(&_slabAllocatorLock);
+        if ( _slabAllocator && ( _slabAllocator->getDirectory() != cachePath.toStdString() ) ) {
+            ///The next call to getSlabAllocator() creates the allocator of the new location
+            _retiredSlabAllocators.push_back(_slabAllocator);
+            _slabAllocator.reset();
+        }
     }
 
     // const data member: no need to take the lock
@@ -1085,6 +1120,15 @@ public:
         QMutexLocker k(&_sizeLock); return _diskCacheSize;
     }
 
+    /**
+     * @brief Returns the number of bytes the cache uses in its slab files. This is less than
+     * getDiskCacheSize() when disk entries are compressed.
+     **/
+    std::size_t getDiskCacheStoredSize() const
+    {
+        QMutexLocker k(&_sizeLock); return _diskCacheStoredSize;
+    }
+
     CacheSignalEmitter* activateSignalEmitter() const
     {
         return _signalEmitter;
@@ -1230,22 +1274,20 @@ public:
         clearInMemoryPortion();
         QMutexLocker l(&_lock);     // must be locked
 
+        ///Only the entries in the slab files of the current location can be restored
+        CacheSlabAllocator* slabs = getSlabAllocator();
         for (CacheIterator it = _diskCache.begin(); it != _diskCache.end(); ++it) {
             std::list<EntryTypePtr> & listOfValues  = getValueFromIterator(it);
             for (typename std::list<EntryTypePtr>::const_iterator it2 = listOfValues.begin(); it2 != listOfValues.end(); ++it2) {
-                if ( (*it2)->isStoredOnDisk() ) {
+                if ( (*it2)->isStoredOnDisk() && ( (*it2)->getDiskSlabAllocator() == slabs ) ) {
                     SerializedEntry serialization;
                     serialization.hash = (*it2)->getHashKey();
                     serialization.params = (*it2)->getParams();
                     serialization.key = (*it2)->getKey();
                     serialization.size = (*it2)->dataSize();
-                    serialization.filePath = (*it2)->getFilePath();
+                    serialization.extent = (*it2)->getDiskExtent();
+                    serialization.compressed = (*it2)->isDiskCompressed();
                     tableOfContents->push_back(serialization);
-#ifdef DEBUG
-                    if (!CacheAPI::checkFileNameMatchesHash(serialization.filePath, serialization.hash)) {
-                        qDebug() << "WARNING: Cache entry filename is not the same as the serialized hash key";
-                    }
-#endif
                 }
             }
         }
@@ -1275,23 +1317,18 @@ public:
                 qDebug() << "WARNING: serialized hash key different than the restored one";
             }
             
-#ifdef DEBUG
-            if (!checkFileNameMatchesHash(it->filePath, it->hash)) {
-                qDebug() << "WARNING: Cache entry filename is not the same as the serialized hash key";
-            }
-#endif
-            
             EntryType* value = NULL;
 
             Natron::StorageModeEnum storage = Natron::eStorageModeDisk;
 
             try {
-                value = new EntryType(it->key,it->params,this,storage,it->filePath);
+                value = new EntryType(it->key,it->params,this,storage);
                 
                 ///This will not put the entry back into RAM, instead we just insert back the entry into the disk cache
-                value->restoreMetaDataFromFile(it->size);
+                value->restoreMetaDataFromExtent(it->extent, it->size, it->compressed);
             } catch (const std::bad_alloc & e) {
                 qDebug() << e.what();
+                delete value;
                 continue;
             }
 
@@ -1383,18 +1420,13 @@ private:
                         std::list<EntryTypePtr> entriesToBeDeleted;
                         
                         //now clear extra entries from the disk cache so it doesn't exceed the RAM limit.
+                        ///The evicted entries leave the RAM once written back by the caller, count them as freed already
                         while (memoryCacheSize > maximumInMemorySize) {
-                            if ( !tryEvictEntry(entriesToBeDeleted) ) {
+                            std::size_t evictedSize = 0;
+                            if ( !tryEvictEntry(entriesToBeDeleted, &evictedSize) ) {
                                 break;
                             }
-                            
-                            {
-                                QMutexLocker k(&_sizeLock);
-                                memoryCacheSize = _memoryCacheSize;
-                                maximumInMemorySize = _maximumInMemorySize;
-                                
-                            }
-
+                            memoryCacheSize = evictedSize > memoryCacheSize ? 0 : memoryCacheSize - evictedSize;
                         }
                         
                         returnValue->push_back(*it);
@@ -1448,7 +1480,23 @@ private:
         }
     }
     
-    bool tryEvictEntry(std::list<EntryTypePtr>& entriesToBeDeleted) const
+    /**
+     * @brief Returns the size the entries on disk may take, that is what the in-memory portion leaves of the cache.
+     * Must be called with _sizeLock held.
+     **/
+    U64 getDiskBudget_internal() const
+    {
+        assert( !_sizeLock.tryLock() );
+        return _maximumCacheSize > _maximumInMemorySize ? _maximumCacheSize - _maximumInMemorySize : 0;
+    }
+    
+    /**
+     * @brief Evicts the last recently used entry of the memory portion. Entries stored on disk are queued for
+     * writeBackEvictedEntries(), which the caller must call once _lock is released: compressing and writing
+     * the data of an entry must not block the other threads using the cache.
+     **/
+    bool tryEvictEntry(std::list<EntryTypePtr>& entriesToBeDeleted,
+                       std::size_t* evictedSize = NULL) const
     {
         assert( !_lock.tryLock() );
         std::pair<hash_type,EntryTypePtr> evicted = _memoryCache.evict();
@@ -1457,27 +1505,72 @@ private:
         if (!evicted.second) {
             return false;
         }
+        if (evictedSize) {
+            *evictedSize = evicted.second->size();
+        }
         /*if it is stored on disk, remove it from memory*/
 
         if ( evicted.second->isStoredOnDisk() ) {
             assert( evicted.second.unique() );
-            
-            ///This is EXPENSIVE! it calls msync
-            evicted.second->deallocate();
-            
-            /*insert it back into the disk portion */
-            
-            U64 diskCacheSize,maximumCacheSize,maximumInMemorySize;
-            {
-                QMutexLocker k(&_sizeLock);
-                diskCacheSize = _diskCacheSize;
-                maximumInMemorySize = _maximumInMemorySize;
-                maximumCacheSize = _maximumCacheSize;
-            }
+            _entriesToWriteBack.push_back(evicted.second);
+        } else {
+            entriesToBeDeleted.push_back(evicted.second);
+        }
 
-            /*before that we need to clear the disk cache if it exceeds the maximum size allowed*/
-            while ( ( diskCacheSize  + evicted.second->size() ) >= (maximumCacheSize - maximumInMemorySize) ) {
+        return true;
+    }
+    
+    /**
+     * @brief Writes the entries evicted by tryEvictEntry() to the slab files and inserts them in the disk portion.
+     * Must be called without _lock: the compression and the copy to the slab files happen outside of it, only the
+     * insertion in the disk portion takes it.
+     **/
+    void writeBackEvictedEntries() const
+    {
+        std::list<EntryTypePtr> entries;
+        {
+            QMutexLocker locker(&_lock);
+            entries.swap(_entriesToWriteBack);
+        }
+        if ( entries.empty() ) {
+            return;
+        }
+        
+        ///No other thread can reach these entries: they were evicted and are in neither portion
+        for (typename std::list<EntryTypePtr>::iterator it = entries.begin(); it != entries.end();) {
+            try {
+                ///Compresses the data if needed and schedules the write-back of the extent, this does not wait for the disk.
+                ///The stored size of the entry is published under _sizeLock by notifyEntryStoredSizeChanged
+                (*it)->deallocate();
+                ++it;
+            } catch (const std::exception & e) {
+                qDebug() << e.what();
+                (*it)->scheduleForDestruction();
+                it = entries.erase(it);
+            }
+        }
+        
+        ///Make sure the shared_ptrs live in this list and are destroyed not while under the lock
+        std::list<EntryTypePtr> entriesToBeDeleted;
+        {
+            QMutexLocker locker(&_lock);
+            
+            for (typename std::list<EntryTypePtr>::iterator it = entries.begin(); it != entries.end(); ++it) {
+                /*insert it back into the disk portion */
+                
+                U64 diskStoredSize,diskBudget;
                 {
+                    QMutexLocker k(&_sizeLock);
+                    diskStoredSize = _diskCacheStoredSize;
+                    diskBudget = getDiskBudget_internal();
+                }
+                
+                /*before that we need to clear the disk cache if it exceeds the maximum size allowed*/
+                ///The extent of the entry was allocated (and compressed) by deallocate(), hence diskStoredSize
+                ///already counts it: the entries already on disk must fit in what remains of the budget.
+                const U64 incomingStoredSize = (*it)->getStoredSize();
+                U64 otherEntriesStoredSize = diskStoredSize > incomingStoredSize ? diskStoredSize - incomingStoredSize : 0;
+                while ( (otherEntriesStoredSize > 0) && (otherEntriesStoredSize + incomingStoredSize > diskBudget) ) {
                     std::pair<hash_type,EntryTypePtr> evictedFromDisk = _diskCache.evict();
                     //if the cache couldn't evict that means all entries are used somewhere and we shall not remove them!
                     //we'll let the user of these entries purge the extra entries left in the cache later on
@@ -1485,32 +1578,25 @@ private:
                         break;
                     }
                     
-                    ///Erase the file from the disk if we reach the limit.
+                    ///Give the extent back to the slab allocator if we reach the limit.
                     evictedFromDisk.second->scheduleForDestruction();
                     
+                    ///The extent is only freed once the entry is destroyed, outside of the lock
+                    std::size_t evictedStoredSize = evictedFromDisk.second->getStoredSize();
+                    otherEntriesStoredSize = evictedStoredSize > otherEntriesStoredSize ? 0 : otherEntriesStoredSize - evictedStoredSize;
                     
                     entriesToBeDeleted.push_back(evictedFromDisk.second);
                 }
-                {
-                    QMutexLocker k(&_sizeLock);
-                    diskCacheSize = _diskCacheSize;
-                    maximumInMemorySize = _maximumInMemorySize;
-                    maximumCacheSize = _maximumCacheSize;
+                
+                CacheIterator existingDiskCacheEntry = _diskCache( (*it)->getHashKey() );
+                /*if the entry doesn't exist on the disk cache,make a new list and insert it*/
+                if ( existingDiskCacheEntry == _diskCache.end() ) {
+                    _diskCache.insert( (*it)->getHashKey(),*it );
+                } else {   /*append to the existing list*/
+                    getValueFromIterator(existingDiskCacheEntry).push_back(*it);
                 }
             }
-
-            CacheIterator existingDiskCacheEntry = _diskCache(evicted.first);
-            /*if the entry doesn't exist on the disk cache,make a new list and insert it*/
-            if ( existingDiskCacheEntry == _diskCache.end() ) {
-                _diskCache.insert(evicted.first,evicted.second);
-            } else {   /*append to the existing list*/
-                getValueFromIterator(existingDiskCacheEntry).push_back(evicted.second);
-            }
-        } else {
-            entriesToBeDeleted.push_back(evicted.second);
         }
-
-        return true;
     }
 };
 }
@@ -0,0 +1,551 @@
+//  Natron
+//
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "CacheCodec.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring> // for memcpy
+
+#include <QtConcurrentMap>
+
+#include "Engine/Lut.h"
+
+using namespace Natron;
+
+/*
+   Layout of compressed data:
+
+   Header
+   U32 blockSizes[blockCount] : the compressed size of each block. If kBlockStoredFlag is set, the block
+                                could not be compressed and only its bytes were shuffled.
+   blocks, one after another
+ */
+
+namespace {
+const U32 kMagic = 0x315a434e; // "NCZ1"
+const U32 kFlagFloatAsHalf = 0x1;
+const U32 kBlockStoredFlag = 0x80000000;
+
+struct Header
+{
+    U32 magic;
+    U32 flags;
+    U64 uncompressedSize; //< size of the data given to compress()
+    U32 elementSize; //< element size used to shuffle the blocks, halved when floats are packed as halves
+    U32 blockCount;
+};
+
+const int kMinMatch = 4;
+const int kHashLog = 14;
+const std::size_t kMaxOffset = 65535;
+
+inline U32
+read32(const unsigned char* p)
+{
+    U32 v;
+
+    std::memcpy(&v, p, 4);
+
+    return v;
+}
+
+inline U32
+hashSequence(U32 v)
+{
+    return (v * 2654435761U) >> (32 - kHashLog);
+}
+
+inline std::size_t
+compressBound(std::size_t size)
+{
+    return size + size / 255 + 16;
+}
+
+///Regroups the n-th bytes of all elements together
+void
+shuffle(const unsigned char* src,
+        std::size_t size,
+        int elementSize,
+        unsigned char* dst)
+{
+    if (elementSize <= 1) {
+        std::memcpy(dst, src, size);
+
+        return;
+    }
+    std::size_t count = size / elementSize;
+    for (int j = 0; j < elementSize; ++j) {
+        unsigned char* plane = dst + j * count;
+        const unsigned char* s = src + j;
+        for (std::size_t i = 0; i < count; ++i, s += elementSize) {
+            plane[i] = *s;
+        }
+    }
+    ///Bytes that do not make a whole element are left as is at the end
+    std::memcpy(dst + count * elementSize, src + count * elementSize, size - count * elementSize);
+}
+
+///Works on tiles of elements that fit in the L1 cache, reading one plane at a time
+template <int elementSize>
+void
+unshuffleElements(const unsigned char* src,
+                  std::size_t count,
+                  unsigned char* dst)
+{
+    const std::size_t tileSize = 4096 / elementSize;
+
+    for (std::size_t tile = 0; tile < count; tile += tileSize) {
+        const std::size_t tileEnd = std::min(tile + tileSize, count);
+        for (int j = 0; j < elementSize; ++j) {
+            const unsigned char* plane = src + j * count;
+            unsigned char* d = dst + tile * elementSize + j;
+            for (std::size_t i = tile; i < tileEnd; ++i, d += elementSize) {
+                *d = plane[i];
+            }
+        }
+    }
+}
+
+void
+unshuffle(const unsigned char* src,
+          std::size_t size,
+          int elementSize,
+          unsigned char* dst)
+{
+    std::size_t count = size / elementSize;
+
+    ///Specialize the common pixel sizes of the images and textures so that the copies are unrolled
+    switch (elementSize) {
+    case 1:
+        std::memcpy(dst, src, size);
+
+        return;
+    case 2:
+        unshuffleElements<2>(src, count, dst);
+        break;
+    case 4:
+        unshuffleElements<4>(src, count, dst);
+        break;
+    case 8:
+        unshuffleElements<8>(src, count, dst);
+        break;
+    case 16:
+        unshuffleElements<16>(src, count, dst);
+        break;
+    default: {
+        unsigned char* d = dst;
+        for (std::size_t i = 0; i < count; ++i) {
+            for (int j = 0; j < elementSize; ++j) {
+                *d++ = src[j * count + i];
+            }
+        }
+        break;
+    }
+    }
+    std::memcpy(dst + count * elementSize, src + count * elementSize, size - count * elementSize);
+}
+
+inline unsigned char*
+writeLength(unsigned char* op,
+            std::size_t length)
+{
+    while (length >= 255) {
+        *op++ = 255;
+        length -= 255;
+    }
+    *op++ = (unsigned char)length;
+
+    return op;
+}
+
+inline bool
+readLength(const unsigned char** ip,
+           const unsigned char* iend,
+           std::size_t* length)
+{
+    unsigned char b;
+
+    do {
+        if (*ip >= iend) {
+            return false;
+        }
+        b = *(*ip)++;
+        *length += b;
+    } while (b == 255);
+
+    return true;
+}
+
+/**
+ * A sequence is a token byte (literals count in the high nibble, match length - kMinMatch in the low nibble,
+ * 15 meaning that more length bytes follow), the literals, then the 16-bit offset of the match.
+ * The last sequence has no match.
+ **/
+unsigned char*
+writeSequence(unsigned char* op,
+              const unsigned char* literals,
+              std::size_t literalsCount,
+              std::size_t offset,
+              std::size_t matchLength)
+{
+    unsigned char* token = op++;
+    std::size_t matchCode = matchLength - kMinMatch;
+
+    *token = (unsigned char)( ( (literalsCount < 15 ? literalsCount : 15) << 4 ) | (matchCode < 15 ? matchCode : 15) );
+    if (literalsCount >= 15) {
+        op = writeLength(op, literalsCount - 15);
+    }
+    std::memcpy(op, literals, literalsCount);
+    op += literalsCount;
+    *op++ = (unsigned char)(offset & 0xff);
+    *op++ = (unsigned char)(offset >> 8);
+    if (matchCode >= 15) {
+        op = writeLength(op, matchCode - 15);
+    }
+
+    return op;
+}
+
+unsigned char*
+writeLastLiterals(unsigned char* op,
+                  const unsigned char* literals,
+                  std::size_t literalsCount)
+{
+    *op++ = (unsigned char)( (literalsCount < 15 ? literalsCount : 15) << 4 );
+    if (literalsCount >= 15) {
+        op = writeLength(op, literalsCount - 15);
+    }
+    std::memcpy(op, literals, literalsCount);
+
+    return op + literalsCount;
+}
+
+///dst must hold at least compressBound(size) bytes
+std::size_t
+lzCompress(const unsigned char* src,
+           std::size_t size,
+           unsigned char* dst)
+{
+    unsigned char* op = dst;
+    const unsigned char* anchor = src;
+    const unsigned char* ip = src;
+    const unsigned char* const iend = src + size;
+
+    if (size >= kMinMatch + 8) {
+        const unsigned char* const matchLimit = iend - kMinMatch;
+        ///Positions are stored + 1 so that 0 means no position
+        std::vector<U32> table(1 << kHashLog, 0);
+
+        while (ip <= matchLimit) {
+            U32 sequence = read32(ip);
+            U32 & slot = table[hashSequence(sequence)];
+            const unsigned char* ref = slot ? src + slot - 1 : NULL;
+            slot = (U32)(ip - src) + 1;
+
+            if ( ref && ( (std::size_t)(ip - ref) <= kMaxOffset ) && (read32(ref) == sequence) ) {
+                const unsigned char* matchEnd = ip + kMinMatch;
+                const unsigned char* refEnd = ref + kMinMatch;
+                while (matchEnd < iend && *matchEnd == *refEnd) {
+                    ++matchEnd;
+                    ++refEnd;
+                }
+                op = writeSequence(op, anchor, ip - anchor, ip - ref, matchEnd - ip);
+                ip = matchEnd;
+                anchor = ip;
+            } else {
+                ///Step faster through data that does not compress
+                ip += 1 + ( (ip - anchor) >> 6 );
+            }
+        }
+    }
+
+    op = writeLastLiterals(op, anchor, iend - anchor);
+
+    return op - dst;
+}
+
+bool
+lzDecompress(const unsigned char* src,
+             std::size_t srcSize,
+             unsigned char* dst,
+             std::size_t dstSize)
+{
+    const unsigned char* ip = src;
+    const unsigned char* const iend = src + srcSize;
+    unsigned char* op = dst;
+    unsigned char* const oend = dst + dstSize;
+
+    for (;;) {
+        if (ip >= iend) {
+            return false;
+        }
+        unsigned int token = *ip++;
+        std::size_t literalsCount = token >> 4;
+        if ( (literalsCount == 15) && !readLength(&ip, iend, &literalsCount) ) {
+            return false;
+        }
+        if ( ( (std::size_t)(iend - ip) < literalsCount ) || ( (std::size_t)(oend - op) < literalsCount ) ) {
+            return false;
+        }
+        std::memcpy(op, ip, literalsCount);
+        op += literalsCount;
+        ip += literalsCount;
+        if (ip == iend) {
+            break;
+        }
+
+        if (iend - ip < 2) {
+            return false;
+        }
+        std::size_t offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        std::size_t matchLength = token & 15;
+        if ( (matchLength == 15) && !readLength(&ip, iend, &matchLength) ) {
+            return false;
+        }
+        matchLength += kMinMatch;
+        if ( (offset == 0) || ( offset > (std::size_t)(op - dst) ) || ( (std::size_t)(oend - op) < matchLength ) ) {
+            return false;
+        }
+        const unsigned char* match = op - offset;
+        if (offset >= matchLength) {
+            std::memcpy(op, match, matchLength);
+            op += matchLength;
+        } else if (offset == 1) {
+            std::memset(op, *match, matchLength);
+            op += matchLength;
+        } else {
+            ///The match overlaps the bytes being written: it repeats the last offset bytes, which can be
+            ///copied in chunks that double in size each time
+            unsigned char* const matchEnd = op + matchLength;
+            while (op < matchEnd) {
+                std::size_t chunk = std::min( (std::size_t)(op - match), (std::size_t)(matchEnd - op) );
+                std::memcpy(op, match, chunk);
+                op += chunk;
+            }
+        }
+    }
+
+    return op == oend;
+} // lzDecompress
+
+struct BlockJob
+{
+    const unsigned char* src; //< compress: the original data of the block, decompress: the compressed block
+    std::size_t srcSize;
+    unsigned char* dst; //< decompress only: where the original data of the block goes
+    std::size_t size; //< size of the block once shuffled, halved when floats are packed
+    int elementSize;
+    bool floatAsHalf;
+    std::vector<unsigned char> encoded; //< compress only: the compressed block
+    bool stored; //< the block is stored shuffled but not compressed
+    bool ok;
+};
+
+void
+compressBlock(BlockJob & job)
+{
+    std::vector<unsigned char> shuffled(job.size);
+
+    if (job.floatAsHalf) {
+        std::vector<unsigned short> halves(job.size / 2);
+        Color::to_half_row( (const float*)job.src, (int)halves.size(), &halves.front() );
+        shuffle( (const unsigned char*)&halves.front(), job.size, job.elementSize, &shuffled.front() );
+    } else {
+        shuffle( job.src, job.size, job.elementSize, &shuffled.front() );
+    }
+
+    job.encoded.resize( compressBound(job.size) );
+    std::size_t encodedSize = lzCompress( &shuffled.front(), job.size, &job.encoded.front() );
+    if (encodedSize >= job.size) {
+        job.encoded.swap(shuffled);
+        job.stored = true;
+    } else {
+        job.encoded.resize(encodedSize);
+        job.stored = false;
+    }
+    job.ok = true;
+}
+
+void
+decompressBlock(BlockJob & job)
+{
+    std::vector<unsigned char> decoded;
+    const unsigned char* shuffled = job.src;
+
+    if (!job.stored) {
+        decoded.resize(job.size);
+        if ( !lzDecompress(job.src, job.srcSize, &decoded.front(), job.size) ) {
+            job.ok = false;
+
+            return;
+        }
+        shuffled = &decoded.front();
+    } else if (job.srcSize != job.size) {
+        job.ok = false;
+
+        return;
+    }
+
+    if (job.floatAsHalf) {
+        std::vector<unsigned short> halves(job.size / 2);
+        unshuffle( shuffled, job.size, job.elementSize, (unsigned char*)&halves.front() );
+        float* dst = (float*)job.dst;
+        for (std::size_t i = 0; i < halves.size(); ++i) {
+            dst[i] = Color::halfToFloat(halves[i]);
+        }
+    } else {
+        unshuffle(shuffled, job.size, job.elementSize, job.dst);
+    }
+    job.ok = true;
+}
+
+void
+runJobs(std::vector<BlockJob> & jobs,
+        void (*function)(BlockJob &))
+{
+    if (jobs.size() == 1) {
+        function(jobs.front());
+    } else if ( !jobs.empty() ) {
+        QtConcurrent::blockingMap(jobs, function);
+    }
+}
+} // anon namespace
+
+void
+CacheCodec::compress(const void* src,
+                     std::size_t size,
+                     int elementSize,
+                     bool floatAsHalf,
+                     std::vector<char>* dst)
+{
+    assert(dst);
+    floatAsHalf = floatAsHalf && size % sizeof(float) == 0;
+
+    Header header;
+    header.magic = kMagic;
+    header.flags = floatAsHalf ? kFlagFloatAsHalf : 0;
+    header.uncompressedSize = size;
+    elementSize = std::max(elementSize, 1);
+    header.elementSize = floatAsHalf ? std::max(elementSize / 2, 1) : elementSize;
+
+    std::size_t streamSize = floatAsHalf ? size / 2 : size;
+    header.blockCount = (U32)( (streamSize + NATRON_CACHE_CODEC_BLOCK_SIZE - 1) / NATRON_CACHE_CODEC_BLOCK_SIZE );
+
+    std::vector<BlockJob> jobs(header.blockCount);
+    for (U32 i = 0; i < header.blockCount; ++i) {
+        BlockJob & job = jobs[i];
+        std::size_t streamOffset = (std::size_t)i * NATRON_CACHE_CODEC_BLOCK_SIZE;
+        job.size = std::min( (std::size_t)NATRON_CACHE_CODEC_BLOCK_SIZE, streamSize - streamOffset );
+        job.src = (const unsigned char*)src + (floatAsHalf ? streamOffset * 2 : streamOffset);
+        job.srcSize = floatAsHalf ? job.size * 2 : job.size;
+        job.dst = NULL;
+        job.elementSize = header.elementSize;
+        job.floatAsHalf = floatAsHalf;
+        job.stored = false;
+        job.ok = false;
+    }
+    runJobs(jobs, compressBlock);
+
+    std::size_t totalSize = sizeof(Header) + header.blockCount * sizeof(U32);
+    for (U32 i = 0; i < header.blockCount; ++i) {
+        totalSize += jobs[i].encoded.size();
+    }
+    dst->resize(totalSize);
+
+    char* op = &dst->front();
+    std::memcpy( op, &header, sizeof(Header) );
+    op += sizeof(Header);
+    for (U32 i = 0; i < header.blockCount; ++i) {
+        U32 blockSize = (U32)jobs[i].encoded.size() | (jobs[i].stored ? kBlockStoredFlag : 0);
+        std::memcpy( op, &blockSize, sizeof(U32) );
+        op += sizeof(U32);
+    }
+    for (U32 i = 0; i < header.blockCount; ++i) {
+        if ( !jobs[i].encoded.empty() ) {
+            std::memcpy( op, &jobs[i].encoded.front(), jobs[i].encoded.size() );
+            op += jobs[i].encoded.size();
+        }
+    }
+    assert(op == &dst->front() + totalSize);
+} // compress
+
+std::size_t
+CacheCodec::getUncompressedSize(const char* src,
+                                std::size_t srcSize)
+{
+    Header header;
+
+    if ( !src || (srcSize < sizeof(Header)) ) {
+        return 0;
+    }
+    std::memcpy( &header, src, sizeof(Header) );
+    if (header.magic != kMagic) {
+        return 0;
+    }
+
+    return (std::size_t)header.uncompressedSize;
+}
+
+bool
+CacheCodec::decompress(const char* src,
+                       std::size_t srcSize,
+                       void* dst,
+                       std::size_t dstSize)
+{
+    Header header;
+
+    if ( !src || (srcSize < sizeof(Header)) ) {
+        return false;
+    }
+    std::memcpy( &header, src, sizeof(Header) );
+    if ( (header.magic != kMagic) || (header.uncompressedSize != dstSize) || (header.elementSize == 0) ) {
+        return false;
+    }
+    bool floatAsHalf = header.flags & kFlagFloatAsHalf;
+    std::size_t streamSize = floatAsHalf ? dstSize / 2 : dstSize;
+    if ( header.blockCount != (streamSize + NATRON_CACHE_CODEC_BLOCK_SIZE - 1) / NATRON_CACHE_CODEC_BLOCK_SIZE ) {
+        return false;
+    }
+
+    const char* blockSizes = src + sizeof(Header);
+    const char* ip = blockSizes + header.blockCount * sizeof(U32);
+    const char* const iend = src + srcSize;
+    if (ip > iend) {
+        return false;
+    }
+
+    std::vector<BlockJob> jobs(header.blockCount);
+    for (U32 i = 0; i < header.blockCount; ++i) {
+        U32 blockSize;
+        std::memcpy( &blockSize, blockSizes + i * sizeof(U32), sizeof(U32) );
+
+        BlockJob & job = jobs[i];
+        std::size_t streamOffset = (std::size_t)i * NATRON_CACHE_CODEC_BLOCK_SIZE;
+        job.size = std::min( (std::size_t)NATRON_CACHE_CODEC_BLOCK_SIZE, streamSize - streamOffset );
+        job.stored = blockSize & kBlockStoredFlag;
+        job.srcSize = blockSize & ~kBlockStoredFlag;
+        if ( job.srcSize > (std::size_t)(iend - ip) ) {
+            return false;
+        }
+        job.src = (const unsigned char*)ip;
+        ip += job.srcSize;
+        job.dst = (unsigned char*)dst + (floatAsHalf ? streamOffset * 2 : streamOffset);
+        job.elementSize = header.elementSize;
+        job.floatAsHalf = floatAsHalf;
+        job.ok = false;
+    }
+    runJobs(jobs, decompressBlock);
+
+    for (U32 i = 0; i < header.blockCount; ++i) {
+        if (!jobs[i].ok) {
+            return false;
+        }
+    }
+
+    return true;
+} // decompress
@@ -0,0 +1,58 @@
+//  Natron
+//
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef NATRON_ENGINE_CACHECODEC_H_
+#define NATRON_ENGINE_CACHECODEC_H_
+
+#include <cstddef>
+#include <vector>
+
+#include "Global/GlobalDefines.h"
+
+namespace Natron {
+/**
+ * @brief The codec used by the disk caches to compress the entries they write to their slab files.
+ *
+ * It is built for decoding speed rather than ratio: the data is split in independent blocks of
+ * NATRON_CACHE_CODEC_BLOCK_SIZE bytes which are encoded and decoded in parallel. In each block the
+ * bytes are first regrouped by their position in a pixel (byte shuffling), so that the same byte of
+ * a channel in neighbouring pixels end up next to each other, then compressed with a byte oriented
+ * LZ77 scheme that does not need any entropy coding.
+ *
+ * The codec is lossless, except when 32-bit floats are packed to half floats.
+ **/
+namespace CacheCodec {
+/**
+ * @brief Compresses size bytes from src into dst, which is resized to the compressed size.
+ * @param elementSize The size in bytes of the elements of the data, typically the size of a pixel.
+ * @param floatAsHalf If true, the data is made of 32-bit floats that are stored as half floats.
+ * Values are rounded to the nearest half float, hence this is lossy.
+ **/
+void compress(const void* src,
+              std::size_t size,
+              int elementSize,
+              bool floatAsHalf,
+              std::vector<char>* dst);
+
+/**
+ * @brief Returns the size of the data that was compressed in src, or 0 if src does not hold data
+ * written by compress().
+ **/
+std::size_t getUncompressedSize(const char* src,
+                                std::size_t srcSize);
+
+/**
+ * @brief Decompresses the data compressed in src to dst. dstSize must be the size returned by
+ * getUncompressedSize(). Returns false if the compressed data is corrupted.
+ **/
+bool decompress(const char* src,
+                std::size_t srcSize,
+                void* dst,
+                std::size_t dstSize);
+}
+}
+
+#endif // NATRON_ENGINE_CACHECODEC_H_
@@ -3,7 +3,8 @@
 
 #include <iostream>
 #include <cassert>
-#include <cstdio> // for std::remove
+#include <cstring> // for memcpy
+#include <algorithm>
 #include <stdexcept>
 #include <vector>
 #include <fstream>
@@ -16,7 +17,9 @@
 #include <boost/scoped_ptr.hpp>
 #endif
 #include "Engine/Hash64.h"
-#include "Engine/MemoryFile.h"
+#include "Engine/CacheCodec.h"
+#include "Engine/CacheSlabAllocator.h"
+#include "Engine/LazyMemory.h"
 #include "Engine/NonKeyParams.h"
 #include <SequenceParsing.h> // for removePath
 
@@ -26,7 +29,10 @@ namespace Natron {
 
 
 /** @brief Buffer represents  an internal buffer that can be allocated on different devices.
- * For now the class is simple and can only be either on disk using mmap or in RAM using malloc.
+ * For now the class is simple and can only be either on disk in an extent of a slab file
+ * (@see CacheSlabAllocator) or in RAM, where only the pages written are allocated (@see LazyMemory).
+ * A disk buffer may also be compressed: it then lives in RAM while it is allocated and is
+ * compressed to an extent when deallocated, @see CacheCodec.
  * The cost parameter given to the allocate() function is a hint that the Buffer classes uses
  * to select a device to use. By default -1 means it should not allocate any memory,
  * 0 means RAM and >= 1 means the data will be stored on disk using mmap. We could see this
@@ -46,10 +52,15 @@ public:
 
 
     Buffer()
-        : _path()
-          , _buffer()
-          , _backingFile()
+        : _buffer()
+          , _slabs(NULL)
+          , _extent()
+          , _byteSize(0)
+          , _mappedData(NULL)
           , _storageMode(eStorageModeRAM)
+          , _compressed(false)
+          , _elementSize(sizeof(DataType))
+          , _floatAsHalf(false)
     {
     }
 
@@ -58,42 +69,50 @@ public:
         deallocate();
     }
 
+    /**
+     * @brief Allocates the buffer. Disk buffers are allocated in the given slab allocator.
+     * @param elementSize If strictly positive, the buffer is compressed on disk, @see CacheCodec::compress
+     **/
     void allocate( U64 count,
                    Natron::StorageModeEnum storage,
-                   std::string path = std::string() )
+                   CacheSlabAllocator* slabs = NULL,
+                   int elementSize = 0,
+                   bool floatAsHalf = false )
     {
         /*allocate should be called only once.*/
-        assert( _path.empty() );
-        assert( ( (_buffer.size() == 0) && !_backingFile ) || ( (_buffer.size() != 0) && !_backingFile ) || (!(_buffer.size() != 0) && _backingFile) );
-        if ( (_buffer.size() > 0) || _backingFile ) {
+        assert( _extent.isNull() );
+        if ( (_buffer.size() > 0) || !_extent.isNull() ) {
             return;
         }
 
-
-        if (storage == Natron::eStorageModeDisk) {
+        if ( (storage == Natron::eStorageModeDisk) && slabs && (elementSize > 0) ) {
+            ///The extent is only allocated when the buffer is compressed
             _storageMode = eStorageModeDisk;
-            _path = path;
-            try {
-                _backingFile.reset( new MemoryFile(_path,MemoryFile::eFileOpenModeEnumIfExistsKeepElseCreate) );
-            } catch (const std::runtime_error & r) {
-                std::cout << r.what() << std::endl;
+            _slabs = slabs;
+            _compressed = true;
+            _elementSize = elementSize;
+            _floatAsHalf = floatAsHalf;
+            _byteSize = count * sizeof(DataType);
+            _buffer.resize(count);
 
-                ///if opening the file mapping failed, just call allocate again, but this time on RA%!
-                _backingFile.reset();
-                _path.clear();
-                allocate(count,Natron::eStorageModeRAM, path);
+            return;
+        }
 
-                return;
-            }
+        if ( (storage == Natron::eStorageModeDisk) && slabs ) {
+            if ( slabs->allocate(count * sizeof(DataType), &_extent) ) {
+                _storageMode = eStorageModeDisk;
+                _slabs = slabs;
+                _byteSize = count * sizeof(DataType);
+                _mappedData = (DataType*)_slabs->data(_extent);
 
-            if ( !path.empty() && (count != 0) ) {
-                //if the backing file has already the good size and we just wanted to re-open the mapping
-                _backingFile->resize(count);
+                return;
             }
-        } else if (storage == Natron::eStorageModeRAM) {
-            _storageMode = eStorageModeRAM;
-            _buffer.resize(count);
+            std::cout << "Failed to allocate " << count * sizeof(DataType) << " bytes in the disk cache, falling back on RAM" << std::endl;
+            _extent = CacheSlabExtent();
         }
+        
+        _storageMode = eStorageModeRAM;
+        _buffer.resize(count);
     }
 
     /**
@@ -104,44 +123,136 @@ public:
      **/
     void reallocate(U64 count)
     {
-        if (_storageMode == eStorageModeRAM) {
+        if ( (_storageMode == eStorageModeRAM) || _compressed ) {
             assert(_buffer.size() > 0); // could be 0 if we allocate 0...
             _buffer.resize(count);
+            _byteSize = count * sizeof(DataType);
         } else if (_storageMode == eStorageModeDisk) {
-            assert(_backingFile);
-            _backingFile->resize( count * sizeof(DataType) );
+            assert(_slabs && _mappedData);
+            U64 newByteSize = count * sizeof(DataType);
+            if (newByteSize <= _extent.size) {
+                _byteSize = newByteSize;
+                return;
+            }
+            CacheSlabExtent newExtent;
+            if ( !_slabs->allocate(newByteSize, &newExtent) ) {
+                throw std::bad_alloc();
+            }
+            DataType* newData = (DataType*)_slabs->data(newExtent);
+            std::memcpy( newData, _mappedData, std::min(_byteSize, newByteSize) );
+            _slabs->deallocate(_extent);
+            _extent = newExtent;
+            _byteSize = newByteSize;
+            _mappedData = newData;
         }
     }
     
-    const std::string& getFilePath() const {
-        return _path;
+    const CacheSlabExtent& getDiskExtent() const {
+        return _extent;
+    }
+    
+    CacheSlabAllocator* getSlabAllocator() const
+    {
+        return _slabs;
     }
 
-    void reOpenFileMapping() const
+    /**
+     * @brief Returns the number of bytes used by the buffer in the slab files.
+     **/
+    std::size_t getStoredSize() const
     {
-        assert(!_backingFile && _storageMode == eStorageModeDisk);
-        try{
-            _backingFile.reset( new MemoryFile(_path,MemoryFile::eFileOpenModeEnumIfExistsKeepElseCreate) );
-        } catch (const std::exception & e) {
-            _backingFile.reset();
-            throw std::bad_alloc();
+        return _extent.size;
+    }
+
+    /**
+     * @brief Maps back the disk data of the buffer. The slab files are never unmapped, this
+     * does not involve any system call.
+     * A compressed buffer is decompressed to RAM and its extent is freed: it will be compressed
+     * again when deallocated since the data may be modified in the meantime.
+     * WARNING: This function throws a std::runtime_error if the data could not be decompressed.
+     **/
+    void reOpenFileMapping()
+    {
+        assert( !isAllocated() && _storageMode == eStorageModeDisk && _slabs && (_compressed || !_extent.isNull()) );
+        if (_compressed) {
+            if ( _extent.isNull() ) {
+                ///Nothing was written for an empty buffer
+                return;
+            }
+            _buffer.resize( _byteSize / sizeof(DataType) );
+            if ( !CacheCodec::decompress(_slabs->data(_extent), _extent.size, _buffer.data(), _byteSize) ) {
+                _buffer.clear();
+                throw std::runtime_error("Corrupted compressed data in the disk cache");
+            }
+            _slabs->deallocate(_extent);
+            _extent = CacheSlabExtent();
+        } else {
+            _mappedData = (DataType*)_slabs->data(_extent);
         }
     }
 
-    void restoreBufferFromFile(const std::string & path)
+    /**
+     * @brief Makes the buffer point to an extent written during a previous session.
+     * The data is not mapped until reOpenFileMapping() is called.
+     **/
+    void restoreBufferFromExtent(CacheSlabAllocator* slabs,
+                                 const CacheSlabExtent & extent,
+                                 std::size_t byteSize,
+                                 bool compressed)
     {
-        _path = path;
+        assert(slabs);
+        if ( !slabs->restore(extent) ) {
+            throw std::bad_alloc();
+        }
+        _slabs = slabs;
+        _extent = extent;
+        _byteSize = byteSize;
         _storageMode = eStorageModeDisk;
+        _compressed = compressed;
     }
 
+    /**
+     * @brief Sets how the buffer is compressed the next time it is deallocated, @see allocate()
+     **/
+    void setCompressionLayout(int elementSize,
+                              bool floatAsHalf)
+    {
+        _elementSize = elementSize;
+        _floatAsHalf = floatAsHalf;
+    }
+
+    /**
+     * @brief Frees the RAM used by the buffer. The data of disk buffers is kept in the slab files
+     * and can be brought back with reOpenFileMapping().
+     * WARNING: This function throws a std::runtime_error if the data could not be written.
+     **/
     void deallocate()
     {
         if (_storageMode == eStorageModeRAM) {
             _buffer.clear();
+        } else if (_compressed) {
+            if ( !_buffer.empty() ) {
+                std::vector<char> compressedData;
+                CacheCodec::compress(_buffer.data(), _byteSize, _elementSize, _floatAsHalf, &compressedData);
+                CacheSlabExtent extent;
+                if ( !_slabs->allocate(compressedData.size(), &extent) ) {
+                    throw std::runtime_error("Failed to write compressed data to the disk cache.");
+                }
+                std::memcpy( _slabs->data(extent), &compressedData.front(), compressedData.size() );
+                _slabs->flush(extent);
+                _slabs->release(extent);
+                if ( !_extent.isNull() ) {
+                    _slabs->deallocate(_extent);
+                }
+                _extent = extent;
+                _buffer.clear();
+            }
         } else {
-            if (_backingFile) {
-                bool flushOk = _backingFile->flush();
-                _backingFile.reset();
+            if (_mappedData) {
+                ///Don't wait for the write-back, the extent stays reserved until removeAnyBackingFile()
+                bool flushOk = _slabs->flush(_extent);
+                _slabs->release(_extent);
+                _mappedData = NULL;
                 if (!flushOk) {
                     throw std::runtime_error("Failed to flush RAM data to backing file.");
                 }
@@ -149,20 +260,24 @@ public:
         }
     }
 
-    bool removeAnyBackingFile() const
+    void removeAnyBackingFile()
     {
-        if (_storageMode == eStorageModeDisk) {
-            if (_backingFile) {
-                _backingFile->remove();
-                _backingFile.reset();
-                return true;
-            } else {
-                int ret_code = std::remove( _path.c_str() );
-                (void)ret_code;
-                return false;
-            }
+        if (_storageMode != eStorageModeDisk) {
+            return;
+        }
+        if ( !_extent.isNull() ) {
+            _slabs->deallocate(_extent);
+            _extent = CacheSlabExtent();
+        }
+        _mappedData = NULL;
+        if (_compressed) {
+            _buffer.clear();
         }
-        return false;
+    }
+
+    bool isCompressed() const
+    {
+        return _compressed;
     }
 
     /**
@@ -170,37 +285,33 @@ public:
      **/
     size_t size() const
     {
-        if (_storageMode == eStorageModeRAM) {
+        if ( (_storageMode == eStorageModeRAM) || _compressed ) {
             return _buffer.size() * sizeof(DataType);
         } else {
-            return _backingFile ? _backingFile->size() : 0;
+            return _mappedData ? _byteSize : 0;
         }
     }
 
     bool isAllocated() const
     {
-        return (_buffer.size() > 0) || ( _backingFile && _backingFile->data() );
+        return (_buffer.size() > 0) || _mappedData;
     }
 
     DataType* writable()
     {
-        if (_storageMode == eStorageModeDisk) {
-            if (_backingFile) {
-                return (DataType*)_backingFile->data();
-            } else {
-                return NULL;
-            }
+        if ( (_storageMode == eStorageModeDisk) && !_compressed ) {
+            return _mappedData;
         } else {
-            return &_buffer.front();
+            return _buffer.data();
         }
     }
 
     const DataType* readable() const
     {
-        if (_storageMode == eStorageModeDisk) {
-            return (const DataType*)_backingFile->data();
+        if ( (_storageMode == eStorageModeDisk) && !_compressed ) {
+            return _mappedData;
         } else {
-            return &_buffer.front();
+            return _buffer.data();
         }
     }
 
@@ -211,13 +322,15 @@ public:
 
 private:
 
-    std::string _path;
-    std::vector<DataType> _buffer;
-
-    /*mutable so the reOpenFileMapping function can reopen the mmaped file. It doesn't
-       change the underlying data*/
-    mutable boost::scoped_ptr<MemoryFile> _backingFile;
+    LazyMemory<DataType> _buffer; //< RAM buffers and compressed disk buffers while allocated, pages are allocated when written
+    CacheSlabAllocator* _slabs; //< the allocator owning _extent, owned by the cache
+    CacheSlabExtent _extent;
+    std::size_t _byteSize;
+    DataType* _mappedData; //< non NULL while the disk data is mapped
     Natron::StorageModeEnum _storageMode;
+    bool _compressed; //< the extent holds the data compressed with CacheCodec
+    int _elementSize; //< @see CacheCodec::compress
+    bool _floatAsHalf;
 };
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -252,9 +365,10 @@ public:
     virtual void notifyMemoryDeallocated() const = 0;
 
     /**
-     * @brief To be called when a backing file has been closed
+     * @brief Returns the allocator of the disk portion of the cache, in which the
+     * disk-cached entries are stored.
      **/
-    virtual void backingFileClosed() const = 0;
+    virtual CacheSlabAllocator* getSlabAllocator() const = 0;
 
     /**
      * @brief To be called whenever an entry is deallocated from memory and put back on disk or whenever
@@ -262,60 +376,20 @@ public:
      **/
     virtual void notifyEntryStorageChanged(Natron::StorageModeEnum oldStorage,Natron::StorageModeEnum newStorage,
                                            int time,size_t size) const = 0;
+
+    /**
+     * @brief To be called whenever the number of bytes used by an entry in the slab files changes.
+     * For compressed entries this is the compressed size.
+     **/
+    virtual void notifyEntryStoredSizeChanged(size_t oldSize,size_t newSize) const = 0;
+
+    /**
+     * @brief Returns true if the disk-cached entries should be compressed in the slab files.
+     * @param floatAsHalf [out] True if 32-bit floating point data should be stored as half floats.
+     **/
+    virtual bool isDiskCompressionEnabled(bool* floatAsHalf) const = 0;
     
     
-#ifdef DEBUG
-    static bool checkFileNameMatchesHash(const std::string &originalFileName,U64 hash)
-    {
-        
-        std::string filename = originalFileName;
-        std::string path = SequenceParsing::removePath(filename);
-        //remove extension from filename
-        {
-            size_t lastdot = filename.find_last_of('.');
-            if (lastdot != std::string::npos) {
-                filename.erase(lastdot, std::string::npos);
-            }
-        }
-        
-        //remove index if it has one
-        {
-            std::size_t foundSep = filename.find_last_of('_');
-            if (foundSep != std::string::npos) {
-                filename.erase(foundSep, std::string::npos);
-            }
-        }
-        
-        QString hashKeyStr(filename.c_str());
-        
-        //prepend the 2 digits of the containing directory
-        {
-            if (path.size() > 0) {
-                if (path[path.size() - 1] == '\\' || path[path.size() -1] == '/') {
-                    path.erase(path.size() - 1, 1);
-                }
-                
-                std::size_t foundSep = path.find_last_of('/');
-                if (foundSep == std::string::npos) {
-                    foundSep = path.find_last_of('\\');
-                }
-                assert(foundSep != std::string::npos);
-                std::string enclosingDirName = path.substr(foundSep + 1, std::string::npos);
-                hashKeyStr.prepend(enclosingDirName.c_str());
-            }
-        }
-        
-        
-        U64 hashKey = hashKeyStr.toULongLong(0,16); //< to hex (base 16)
-        if (hashKey == hash) {
-            return true;
-        } else {
-            return false;
-        }
-        
-    }
-#endif
-    
 };
 
 
@@ -383,14 +457,12 @@ public:
     CacheEntryHelper(const KeyType & key,
                      const boost::shared_ptr<ParamsType> & params,
                      const CacheAPI* cache,
-                     Natron::StorageModeEnum storage,
-                     const std::string & path)
+                     Natron::StorageModeEnum storage)
         : _key(key)
           , _params(params)
           , _data()
           , _cache(cache)
           , _removeBackingFileBeforeDestruction(false)
-          , _requestedPath(path)
           , _requestedStorage(storage)
     {
     }
@@ -406,14 +478,12 @@ public:
     void setCacheEntry(const KeyType & key,
                        const boost::shared_ptr<ParamsType> & params,
                        const CacheAPI* cache,
-                       Natron::StorageModeEnum storage,
-                       const std::string & path)
+                       Natron::StorageModeEnum storage)
     {
         assert(!_params && _cache == NULL);
         _key = key;
         _params = params;
         _cache = cache;
-        _requestedPath = path;
         _requestedStorage = storage;
     }
 
@@ -428,37 +498,69 @@ public:
             return;
         }
 
-        allocate(_params->getElementsCount(),_requestedStorage,_requestedPath);
+        int compressedElementSize = 0;
+        bool floatAsHalf = false;
+        if ( _cache && (_requestedStorage == Natron::eStorageModeDisk) && _cache->isDiskCompressionEnabled(&floatAsHalf) ) {
+            bool isFloat;
+            getCompressionLayout(&compressedElementSize, &isFloat);
+            floatAsHalf = floatAsHalf && isFloat;
+        }
+
+        _data.allocate( _params->getElementsCount(),_requestedStorage,_cache ? _cache->getSlabAllocator() : NULL,
+                        compressedElementSize, floatAsHalf );
         onMemoryAllocated(false);
 
         if (_cache) {
             _cache->notifyEntryAllocated( getTime(),size(),_data.getStorageMode() );
+            notifyStoredSizeChanged(0);
         }
     }
     
     /**
-     * @brief To be called for disk-cached entries when restoring them from a file.
-     * The file-path will be the one passed to the constructor
+     * @brief To be called for disk-cached entries when restoring them from the slab files of a previous session.
+     * @param compressed True if the extent holds data compressed with CacheCodec.
+     * WARNING: This function throws a std::bad_alloc if the extent could not be restored.
      **/
-    void restoreMetaDataFromFile(std::size_t size)
+    void restoreMetaDataFromExtent(const CacheSlabExtent & extent,
+                                   std::size_t size,
+                                   bool compressed)
     {
         if (!_cache || _requestedStorage != Natron::eStorageModeDisk) {
             return;
         }
         
-        assert(!_requestedPath.empty());
-        
-        restoreBufferFromFile(_requestedPath);
+        _data.restoreBufferFromExtent(_cache->getSlabAllocator(), extent, size, compressed);
+        if (compressed) {
+            int elementSize;
+            bool isFloat;
+            bool floatAsHalf = false;
+            _cache->isDiskCompressionEnabled(&floatAsHalf);
+            getCompressionLayout(&elementSize, &isFloat);
+            _data.setCompressionLayout(elementSize, floatAsHalf && isFloat);
+        }
         
         if (_cache) {
             _cache->notifyEntryStorageChanged(Natron::eStorageModeNone, Natron::eStorageModeDisk, getTime(),size);
+            notifyStoredSizeChanged(0);
         }
         onMemoryAllocated(true);
     }
 
+    /**
+     * @brief Describes the data of the entry to the disk cache codec, @see CacheCodec::compress
+     * @param elementSize [out] The size of a pixel in bytes
+     * @param isFloat [out] True if the data is made of 32-bit floats, which may be stored as half floats
+     **/
+    virtual void getCompressionLayout(int* elementSize,
+                                      bool* isFloat) const
+    {
+        *elementSize = sizeof(DataType);
+        *isFloat = false;
+    }
+
     /**
      * @brief Called right away once the buffer is allocated. Used in debug mode to initialize image with a default color.
-     * @param diskRestoration If true, this is called by restoreMetaDataFromFile() and the memory is in fact not allocated, this should
+     * @param diskRestoration If true, this is called by restoreMetaDataFromExtent() and the memory is in fact not allocated, this should
      * just restore meta-data
      **/
     virtual void onMemoryAllocated(bool /*diskRestoration*/)
@@ -471,55 +573,46 @@ public:
         return _key;
     }
     
-    const std::string& getFilePath() const {
-        return _data.getFilePath();
+    const CacheSlabExtent& getDiskExtent() const {
+        return _data.getDiskExtent();
     }
-
-    typename AbstractCacheEntry<KeyType>::hash_type getHashKey() const OVERRIDE FINAL
+    
+    ///The allocator owning the disk extent, NULL if the entry was never put on disk
+    CacheSlabAllocator* getDiskSlabAllocator() const
     {
-        return _key.getHash();
+        return _data.getSlabAllocator();
     }
 
-    std::string generateStringFromHash(const std::string & path,U64 hashKey) const
+    bool isDiskCompressed() const
     {
-        std::string name(path);
+        return _data.isCompressed();
+    }
 
-        if ( path.empty() ) {
-            QDir subfolder( path.c_str() );
-            if ( !subfolder.exists() ) {
-                std::cout << "(" << std::hex <<
-                    this << ") " <<   "Something is wrong in cache... couldn't find : " << path << std::endl;
-                throw std::invalid_argument(path);
-            }
-        }
-        QString hashKeyStr = QString::number(hashKey,16); //< hex is base 16
-        for (int i = 0; i < 2; ++i) {
-            if (i >= hashKeyStr.size()) {
-                break;
-            }
-            name.push_back(hashKeyStr[i].toAscii());
-        }
-        name.append("/");
-        int i = 2;
-        while (i < hashKeyStr.size()) {
-            name.push_back(hashKeyStr[i].toAscii());
-            ++i;
-        }
-        
-        name.append("." NATRON_CACHE_FILE_EXT);
+    /**
+     * @brief Returns the number of bytes used by the entry in the slab files of the cache.
+     **/
+    std::size_t getStoredSize() const
+    {
+        return _data.getStoredSize();
+    }
 
-        return name;
+    typename AbstractCacheEntry<KeyType>::hash_type getHashKey() const OVERRIDE FINAL
+    {
+        return _key.getHash();
     }
 
     /** @brief This function is called by the get() function of the Cache when the entry is
      * living only in the disk portion of the cache. No locking is required here because the
      * caller is already preventing other threads to call this function.
      **/
-    void reOpenFileMapping() const
+    void reOpenFileMapping()
     {
+        std::size_t storedSize = _data.getStoredSize();
+
         _data.reOpenFileMapping();
         if (_cache) {
             _cache->notifyEntryStorageChanged( Natron::eStorageModeDisk, Natron::eStorageModeRAM,getTime(), size() );
+            notifyStoredSizeChanged(storedSize);
         }
     }
 
@@ -531,10 +624,12 @@ public:
         std::size_t sz = size();
         bool dataAllocated = _data.isAllocated();
         int time = getTime();
+        std::size_t storedSize = _data.getStoredSize();
         
         _data.deallocate();
         
         if (_cache) {
+            notifyStoredSizeChanged(storedSize);
             if ( isStoredOnDisk() ) {
                 if (dataAllocated) {
                     _cache->notifyEntryStorageChanged( Natron::eStorageModeRAM, Natron::eStorageModeDisk, time, sz );
@@ -573,19 +668,18 @@ public:
     }
 
     /**
-     * @brief An entry stored on disk is effectively destroyed when its backing file is removed.
+     * @brief An entry stored on disk is effectively destroyed when its extent is given back to the slab allocator.
      **/
-    void removeAnyBackingFile() const
+    void removeAnyBackingFile()
     {
         if (!isStoredOnDisk()) {
             return;
         }
         
         bool isAlloc = _data.isAllocated();
-        bool hasRemovedFile = _data.removeAnyBackingFile();
-        if (hasRemovedFile) {
-            _cache->backingFileClosed();
-        }
+        std::size_t storedSize = _data.getStoredSize();
+        _data.removeAnyBackingFile();
+        notifyStoredSizeChanged(storedSize);
         if ( isAlloc ) {
             _cache->notifyEntryDestroyed(getTime(), _params->getElementsCount() * sizeof(DataType),Natron::eStorageModeRAM);
         } else {
@@ -616,79 +710,24 @@ protected:
 
     void reallocate(U64 elemCount)
     {
+        std::size_t storedSize = _data.getStoredSize();
+
         _params->setElementsCount(elemCount);
         _data.reallocate(elemCount);
         if (_cache) {
             size_t oldSize = size();
             _cache->notifyEntrySizeChanged( oldSize,size(),_data.getStorageMode() );
+            notifyStoredSizeChanged(storedSize);
         }
     }
 
 private:
 
-    static bool fileExists(const std::string& filename)
+    void notifyStoredSizeChanged(std::size_t oldStoredSize) const
     {
-        std::ifstream f(filename.c_str());
-        bool ret = f.good();
-        f.close();
-        return ret;
-    }
-
-    /** @brief This function is called in allocateMeory(...) and before the object is exposed
-     * to other threads. Hence this function doesn't need locking mechanism at all.
-     * We must ensure that this function is called ONLY by allocateMemory(), that's why
-     * it is private.
-     **/
-    void allocate( U64 count,
-                   Natron::StorageModeEnum storage,
-                   std::string path = std::string() )
-    {
-        std::string fileName;
-
-        if (storage == Natron::eStorageModeDisk) {
-            
-            typename AbstractCacheEntry<KeyType>::hash_type hashKey = getHashKey();
-            try {
-                fileName = generateStringFromHash(path,hashKey);
-            } catch (const std::invalid_argument & e) {
-                std::cout << "Path is empty but required for disk caching: " << e.what() << std::endl;
-                return;
-            }
-            
-            assert(!fileName.empty());
-            //Check if the filename already exists, if so append a 0-based index after the hash (separated by a '_')
-            //and try again
-            int index = 0;
-            if (fileExists(fileName)) {
-                fileName.insert(fileName.size() - 4,"_0");
-            }
-            while (fileExists(fileName)) {
-                ++index;
-                std::stringstream ss;
-                ss << index;
-                fileName.replace(fileName.size() - 1,std::string::npos,ss.str());
-            }
-#ifdef DEBUG
-            if (!CacheAPI::checkFileNameMatchesHash(fileName, hashKey)) {
-                qDebug() << "WARNING: Cache entry filename is not the same as the serialized hash key";
-            }
-#endif
-        }
-        _data.allocate(count, storage, fileName);
-    }
-
-    /** @brief This function is called in allocateMeory() and before the object is exposed
-     * to other threads. Hence this function doesn't need locking mechanism at all.
-     * We must ensure that this function is called ONLY by allocateMemory(), that's why
-     * it is private.
-     **/
-    void restoreBufferFromFile(const std::string & path)
-    {
-        if (!fileExists(path)) {
-            throw std::bad_alloc();
+        if ( _cache && ( oldStoredSize != _data.getStoredSize() ) ) {
+            _cache->notifyEntryStoredSizeChanged( oldStoredSize, _data.getStoredSize() );
         }
-        _data.restoreBufferFromFile(path);
-       
     }
 
 protected:
@@ -698,7 +737,6 @@ protected:
     Buffer<DataType> _data;
     const CacheAPI* _cache;
     bool _removeBackingFileBeforeDestruction;
-    std::string _requestedPath;
     Natron::StorageModeEnum _requestedStorage;
 };
 }
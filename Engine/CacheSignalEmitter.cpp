@@ -0,0 +1,184 @@
+//  Natron
+//
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "CacheSignalEmitter.h"
+
+#include <algorithm>
+#include <cassert>
+
+#include <QtCore/QTimer>
+
+///The minimum time between 2 deliveries of the changes of a cache, i.e: at most 25 batches per second
+#define NATRON_CACHE_EVENTS_DELIVERY_INTERVAL_MS 40
+
+using namespace Natron;
+
+CacheEventsBatch::CacheEventsBatch()
+    : _memoryCleared(false)
+      , _diskCleared(false)
+      , _entries()
+{
+}
+
+void
+CacheEventsBatch::addEntry(SequenceTime time,
+                           int storage)
+{
+    _entries[time] = CacheEntryEvent(CacheEntryEvent::eTypeAdded, storage);
+}
+
+void
+CacheEventsBatch::removeEntry(SequenceTime time)
+{
+    _entries[time] = CacheEntryEvent(CacheEntryEvent::eTypeRemoved, eStorageModeNone);
+}
+
+void
+CacheEventsBatch::changeEntryStorage(SequenceTime time,
+                                     int newStorage)
+{
+    EntriesEvents::iterator found = _entries.find(time);
+
+    if ( found == _entries.end() ) {
+        _entries.insert( std::make_pair( time, CacheEntryEvent(CacheEntryEvent::eTypeStorageChanged, newStorage) ) );
+    } else if (found->second.type != CacheEntryEvent::eTypeRemoved) {
+        ///An entry added since the last delivery is now just added somewhere else
+        found->second.storage = newStorage;
+    }
+}
+
+void
+CacheEventsBatch::clearStorage(int storage)
+{
+    if (storage == eStorageModeRAM) {
+        _memoryCleared = true;
+    } else if (storage == eStorageModeDisk) {
+        _diskCleared = true;
+    }
+    ///The entries that were put there since the last delivery are gone too
+    for (EntriesEvents::iterator it = _entries.begin(); it != _entries.end(); ++it) {
+        if ( (it->second.type != CacheEntryEvent::eTypeRemoved) && (it->second.storage == storage) ) {
+            it->second = CacheEntryEvent(CacheEntryEvent::eTypeRemoved, eStorageModeNone);
+        }
+    }
+}
+
+bool
+CacheEventsBatch::isEmpty() const
+{
+    return !_memoryCleared && !_diskCleared && _entries.empty();
+}
+
+CacheSignalEmitter::CacheSignalEmitter()
+    : QObject()
+      , _pendingMutex()
+      , _pending()
+      , _deliveryScheduled(false)
+      , _lastDelivery()
+{
+    QObject::connect( this, SIGNAL( eventsPending() ), this, SLOT( onEventsPending() ), Qt::QueuedConnection );
+}
+
+CacheSignalEmitter::~CacheSignalEmitter()
+{
+}
+
+void
+CacheSignalEmitter::emitSignalClearedInMemoryPortion()
+{
+    if ( signalsBlocked() ) {
+        return;
+    }
+    QMutexLocker k(&_pendingMutex);
+    _pending.clearStorage(eStorageModeRAM);
+    scheduleDelivery();
+}
+
+void
+CacheSignalEmitter::emitClearedDiskPortion()
+{
+    if ( signalsBlocked() ) {
+        return;
+    }
+    QMutexLocker k(&_pendingMutex);
+    _pending.clearStorage(eStorageModeDisk);
+    scheduleDelivery();
+}
+
+void
+CacheSignalEmitter::emitAddedEntry(SequenceTime time)
+{
+    if ( signalsBlocked() ) {
+        return;
+    }
+    QMutexLocker k(&_pendingMutex);
+    _pending.addEntry(time, eStorageModeRAM);
+    scheduleDelivery();
+}
+
+void
+CacheSignalEmitter::emitRemovedEntry(SequenceTime time,
+                                     int /*storage*/)
+{
+    if ( signalsBlocked() ) {
+        return;
+    }
+    QMutexLocker k(&_pendingMutex);
+    _pending.removeEntry(time);
+    scheduleDelivery();
+}
+
+void
+CacheSignalEmitter::emitEntryStorageChanged(SequenceTime time,
+                                            int /*oldStorage*/,
+                                            int newStorage)
+{
+    if ( signalsBlocked() ) {
+        return;
+    }
+    QMutexLocker k(&_pendingMutex);
+    _pending.changeEntryStorage(time, newStorage);
+    scheduleDelivery();
+}
+
+void
+CacheSignalEmitter::scheduleDelivery()
+{
+    ///Private, shouldn't lock
+    assert( !_pendingMutex.tryLock() );
+
+    if (!_deliveryScheduled) {
+        _deliveryScheduled = true;
+        emit eventsPending();
+    }
+}
+
+void
+CacheSignalEmitter::onEventsPending()
+{
+    qint64 sinceLastDelivery = _lastDelivery.isValid() ? _lastDelivery.elapsed() : NATRON_CACHE_EVENTS_DELIVERY_INTERVAL_MS;
+
+    if (sinceLastDelivery >= NATRON_CACHE_EVENTS_DELIVERY_INTERVAL_MS) {
+        flushEvents();
+    } else {
+        QTimer::singleShot( NATRON_CACHE_EVENTS_DELIVERY_INTERVAL_MS - (int)sinceLastDelivery, this, SLOT( flushEvents() ) );
+    }
+}
+
+void
+CacheSignalEmitter::flushEvents()
+{
+    CacheEventsBatch batch;
+    {
+        QMutexLocker k(&_pendingMutex);
+        std::swap(batch, _pending);
+        _deliveryScheduled = false;
+    }
+    _lastDelivery.start();
+    if ( !batch.isEmpty() ) {
+        emit entriesChanged(batch);
+    }
+}
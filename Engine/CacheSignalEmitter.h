@@ -0,0 +1,161 @@
+//  Natron
+//
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef NATRON_ENGINE_CACHESIGNALEMITTER_H_
+#define NATRON_ENGINE_CACHESIGNALEMITTER_H_
+
+#include <map>
+
+#include "Global/GlobalDefines.h"
+CLANG_DIAG_OFF(deprecated)
+#include <QtCore/QMutex>
+#include <QtCore/QObject>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QMetaType>
+CLANG_DIAG_ON(deprecated)
+
+namespace Natron {
+
+/**
+ * @brief What happened to the entries of a cache at a given time since the last batch was delivered.
+ **/
+struct CacheEntryEvent
+{
+    enum TypeEnum
+    {
+        eTypeAdded = 0,
+        eTypeRemoved,
+        eTypeStorageChanged
+    };
+
+    TypeEnum type;
+    int storage; //< the Natron::StorageModeEnum where the entries are now, meaningless for eTypeRemoved
+
+    CacheEntryEvent()
+        : type(eTypeRemoved)
+          , storage(0)
+    {
+    }
+
+    CacheEntryEvent(TypeEnum type,
+                    int storage)
+        : type(type)
+          , storage(storage)
+    {
+    }
+};
+
+/**
+ * @brief The changes made to a cache between 2 deliveries, coalesced so that only the last state of each time remains.
+ * Observers must first apply the clears, then the entries events: the events that happened before a clear were
+ * already folded into it.
+ **/
+class CacheEventsBatch
+{
+public:
+
+    typedef std::map<SequenceTime,CacheEntryEvent> EntriesEvents;
+
+    CacheEventsBatch();
+
+    void addEntry(SequenceTime time,int storage);
+
+    void removeEntry(SequenceTime time);
+
+    void changeEntryStorage(SequenceTime time,int newStorage);
+
+    /**
+     * @brief All entries stored in the given Natron::StorageModeEnum were removed.
+     **/
+    void clearStorage(int storage);
+
+    bool isEmpty() const;
+
+    bool isMemoryCleared() const
+    {
+        return _memoryCleared;
+    }
+
+    bool isDiskCleared() const
+    {
+        return _diskCleared;
+    }
+
+    ///Sorted by time, so that observers can walk them as ranges
+    const EntriesEvents & getEntriesEvents() const
+    {
+        return _entries;
+    }
+
+private:
+
+    bool _memoryCleared;
+    bool _diskCleared;
+    EntriesEvents _entries;
+};
+
+/**
+ * @brief Notifies the observers of a cache of its changes. Entries are added and removed by render threads at a very high
+ * rate during playback: rather than posting one event per change to the main thread, the changes are accumulated in a
+ * CacheEventsBatch and delivered with entriesChanged at most every NATRON_CACHE_EVENTS_DELIVERY_INTERVAL_MS.
+ * Nothing is recorded while signals are blocked.
+ **/
+class CacheSignalEmitter
+    : public QObject
+{
+    Q_OBJECT
+
+public:
+    CacheSignalEmitter();
+
+    virtual ~CacheSignalEmitter();
+
+    void emitSignalClearedInMemoryPortion();
+
+    void emitClearedDiskPortion();
+
+    void emitAddedEntry(SequenceTime time);
+
+    void emitRemovedEntry(SequenceTime time,
+                          int storage);
+
+    void emitEntryStorageChanged(SequenceTime time,
+                                 int oldStorage,
+                                 int newStorage);
+
+public slots:
+
+    /**
+     * @brief Delivers right away the changes accumulated so far.
+     **/
+    void flushEvents();
+
+private slots:
+
+    void onEventsPending();
+
+signals:
+
+    ///Emitted to the thread of the emitter when changes start accumulating
+    void eventsPending();
+
+    void entriesChanged(const Natron::CacheEventsBatch & batch);
+
+private:
+
+    ///Must be called with _pendingMutex locked
+    void scheduleDelivery();
+
+    QMutex _pendingMutex; //< protects _pending and _deliveryScheduled
+    CacheEventsBatch _pending;
+    bool _deliveryScheduled;
+    QElapsedTimer _lastDelivery; //< only used in the thread of the emitter
+};
+} // namespace Natron
+
+Q_DECLARE_METATYPE(Natron::CacheEventsBatch);
+
+#endif // NATRON_ENGINE_CACHESIGNALEMITTER_H_
@@ -0,0 +1,361 @@
+//  Natron
+//
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "CacheSlabAllocator.h"
+
+#include <cstdio>
+#include <map>
+#include <algorithm>
+#include <vector>
+#include <sstream>
+#include <iostream>
+#include <stdexcept>
+
+#include <QtCore/QMutex>
+
+#ifndef Q_MOC_RUN
+#include <boost/shared_ptr.hpp>
+#endif
+
+#include "Engine/MemoryFile.h"
+
+using namespace Natron;
+
+namespace {
+///offset -> size of the unused ranges of a slab
+typedef std::map<U64,U64> FreeRanges;
+
+struct CacheSlab
+{
+    boost::shared_ptr<MemoryFile> file;
+    FreeRanges freeRanges;
+};
+
+U64
+alignSize(U64 size)
+{
+    if (size == 0) {
+        size = 1;
+    }
+
+    return ( (size + NATRON_CACHE_SLAB_ALIGNMENT - 1) / NATRON_CACHE_SLAB_ALIGNMENT ) * NATRON_CACHE_SLAB_ALIGNMENT;
+}
+}
+
+struct Natron::CacheSlabAllocatorPrivate
+{
+    const std::string directory;
+    const U64 slabSize;
+    mutable QMutex lock; //< protects slabs
+    std::vector<CacheSlab> slabs; //< a slab whose file is NULL was not opened (yet)
+
+    CacheSlabAllocatorPrivate(const std::string & directory,
+                              U64 slabSize)
+        : directory(directory)
+          , slabSize( alignSize(slabSize) )
+          , lock()
+          , slabs()
+    {
+    }
+
+    std::string getSlabFilePath(int index) const
+    {
+        std::stringstream ss;
+        ss << directory;
+        if ( !directory.empty() && (directory[directory.size() - 1] != '/') && (directory[directory.size() - 1] != '\\') ) {
+            ss << '/';
+        }
+        ss << "slab" << index << "." NATRON_CACHE_FILE_EXT;
+
+        return ss.str();
+    }
+
+    boost::shared_ptr<MemoryFile> getFile(const CacheSlabExtent & extent) const
+    {
+        QMutexLocker k(&lock);
+
+        assert( extent.slab >= 0 && extent.slab < (int)slabs.size() );
+
+        return slabs[extent.slab].file;
+    }
+
+    ///Puts [offset,offset+size) back into the free ranges, merging it with its neighbours.
+    static void insertFreeRange(FreeRanges & ranges,
+                                U64 offset,
+                                U64 size)
+    {
+        FreeRanges::iterator next = ranges.lower_bound(offset);
+
+        if ( next != ranges.begin() ) {
+            FreeRanges::iterator prev = next;
+            --prev;
+            assert(prev->first + prev->second <= offset);
+            if (prev->first + prev->second == offset) {
+                offset = prev->first;
+                size += prev->second;
+                ranges.erase(prev);
+            }
+        }
+        if ( ( next != ranges.end() ) && (offset + size == next->first) ) {
+            size += next->second;
+            ranges.erase(next);
+        }
+        ranges.insert( std::make_pair(offset, size) );
+    }
+};
+
+CacheSlabAllocator::CacheSlabAllocator(const std::string & directory,
+                                       U64 slabSize)
+    : _imp( new CacheSlabAllocatorPrivate(directory,slabSize) )
+{
+}
+
+CacheSlabAllocator::~CacheSlabAllocator()
+{
+}
+
+const std::string &
+CacheSlabAllocator::getDirectory() const
+{
+    return _imp->directory;
+}
+
+bool
+CacheSlabAllocator::allocate(U64 size,
+                             CacheSlabExtent* extent)
+{
+    assert(extent);
+    const U64 alignedSize = alignSize(size);
+
+    QMutexLocker k(&_imp->lock);
+
+    ///First fit, in the order of the slabs so that the first slabs stay densely packed
+    for (U32 i = 0; i < _imp->slabs.size(); ++i) {
+        FreeRanges & ranges = _imp->slabs[i].freeRanges;
+        for (FreeRanges::iterator it = ranges.begin(); it != ranges.end(); ++it) {
+            if (it->second >= alignedSize) {
+                extent->slab = (int)i;
+                extent->offset = it->first;
+                extent->size = alignedSize;
+                U64 remainingOffset = it->first + alignedSize;
+                U64 remainingSize = it->second - alignedSize;
+                ranges.erase(it);
+                if (remainingSize > 0) {
+                    ranges.insert( std::make_pair(remainingOffset, remainingSize) );
+                }
+
+                return true;
+            }
+        }
+    }
+
+    ///No free range is large enough, create a new slab in the first unused slot.
+    ///A slot that was not opened holds no restored extent, hence its file can be truncated.
+    int index = 0;
+    while ( index < (int)_imp->slabs.size() && _imp->slabs[index].file ) {
+        ++index;
+    }
+    if ( index == (int)_imp->slabs.size() ) {
+        _imp->slabs.push_back( CacheSlab() );
+    }
+
+    const U64 slabSize = std::max(_imp->slabSize, alignedSize);
+    CacheSlab & slab = _imp->slabs[index];
+    try {
+        slab.file.reset( new MemoryFile(_imp->getSlabFilePath(index), slabSize, MemoryFile::eFileOpenModeEnumIfExistsTruncateElseCreate) );
+    } catch (const std::exception & e) {
+        std::cerr << e.what() << std::endl;
+        slab.file.reset();
+
+        return false;
+    }
+
+    slab.freeRanges.clear();
+    if (slabSize > alignedSize) {
+        slab.freeRanges.insert( std::make_pair(alignedSize, slabSize - alignedSize) );
+    }
+    extent->slab = index;
+    extent->offset = 0;
+    extent->size = alignedSize;
+
+    return true;
+} // allocate
+
+bool
+CacheSlabAllocator::restore(const CacheSlabExtent & extent)
+{
+    if ( extent.isNull() || (extent.size == 0) ) {
+        return false;
+    }
+
+    QMutexLocker k(&_imp->lock);
+
+    if ( extent.slab >= (int)_imp->slabs.size() ) {
+        _imp->slabs.resize(extent.slab + 1);
+    }
+    CacheSlab & slab = _imp->slabs[extent.slab];
+    if (!slab.file) {
+        try {
+            slab.file.reset( new MemoryFile(_imp->getSlabFilePath(extent.slab), MemoryFile::eFileOpenModeEnumIfExistsKeepElseFail) );
+        } catch (const std::exception &) {
+            slab.file.reset();
+
+            return false;
+        }
+        if (!slab.file->data() || slab.file->size() == 0) {
+            slab.file.reset();
+
+            return false;
+        }
+        slab.freeRanges.clear();
+        slab.freeRanges.insert( std::make_pair( (U64)0, (U64)slab.file->size() ) );
+    }
+
+    ///Find the free range containing the extent and carve the extent out of it
+    FreeRanges::iterator it = slab.freeRanges.upper_bound(extent.offset);
+    if ( it == slab.freeRanges.begin() ) {
+        return false;
+    }
+    --it;
+    U64 rangeOffset = it->first;
+    U64 rangeSize = it->second;
+    if (extent.offset + extent.size > rangeOffset + rangeSize) {
+        return false;
+    }
+    slab.freeRanges.erase(it);
+    if (extent.offset > rangeOffset) {
+        slab.freeRanges.insert( std::make_pair(rangeOffset, extent.offset - rangeOffset) );
+    }
+    U64 end = extent.offset + extent.size;
+    if (rangeOffset + rangeSize > end) {
+        slab.freeRanges.insert( std::make_pair(end, rangeOffset + rangeSize - end) );
+    }
+
+    return true;
+} // restore
+
+void
+CacheSlabAllocator::deallocate(const CacheSlabExtent & extent)
+{
+    if ( extent.isNull() ) {
+        return;
+    }
+
+    QMutexLocker k(&_imp->lock);
+
+    assert( extent.slab < (int)_imp->slabs.size() );
+    CacheSlab & slab = _imp->slabs[extent.slab];
+    assert(slab.file);
+    slab.file->discardRange(extent.offset, extent.size);
+    CacheSlabAllocatorPrivate::insertFreeRange(slab.freeRanges, extent.offset, extent.size);
+}
+
+char*
+CacheSlabAllocator::data(const CacheSlabExtent & extent) const
+{
+    boost::shared_ptr<MemoryFile> file = _imp->getFile(extent);
+
+    assert(file && file->data() && extent.offset + extent.size <= file->size());
+
+    return file->data() + extent.offset;
+}
+
+bool
+CacheSlabAllocator::flush(const CacheSlabExtent & extent) const
+{
+    boost::shared_ptr<MemoryFile> file = _imp->getFile(extent);
+
+    assert(file);
+
+    return file->flushRange(extent.offset, extent.size);
+}
+
+void
+CacheSlabAllocator::release(const CacheSlabExtent & extent) const
+{
+    boost::shared_ptr<MemoryFile> file = _imp->getFile(extent);
+
+    assert(file);
+    file->releaseRange(extent.offset, extent.size);
+}
+
+U64
+CacheSlabAllocator::removeUnusedSlabs()
+{
+    QMutexLocker k(&_imp->lock);
+    U64 ret = 0;
+
+    for (U32 i = 0; i < _imp->slabs.size(); ++i) {
+        CacheSlab & slab = _imp->slabs[i];
+        if (!slab.file) {
+            ///A slab of a previous session that no extent of the table of contents references
+            std::remove( _imp->getSlabFilePath(i).c_str() );
+            continue;
+        }
+        const U64 size = slab.file->size();
+        if ( (slab.freeRanges.size() == 1) && (slab.freeRanges.begin()->first == 0) && (slab.freeRanges.begin()->second == size) ) {
+            slab.file->remove();
+            slab.file.reset();
+            slab.freeRanges.clear();
+            ret += size;
+        }
+    }
+    ///Slabs of a previous session beyond the last one opened
+    int index = (int)_imp->slabs.size();
+    while (std::remove( _imp->getSlabFilePath(index).c_str() ) == 0) {
+        ++index;
+    }
+    while ( !_imp->slabs.empty() && !_imp->slabs.back().file ) {
+        _imp->slabs.pop_back();
+    }
+
+    return ret;
+}
+
+int
+CacheSlabAllocator::getSlabsCount() const
+{
+    QMutexLocker k(&_imp->lock);
+    int ret = 0;
+
+    for (U32 i = 0; i < _imp->slabs.size(); ++i) {
+        if (_imp->slabs[i].file) {
+            ++ret;
+        }
+    }
+
+    return ret;
+}
+
+U64
+CacheSlabAllocator::getTotalSize() const
+{
+    QMutexLocker k(&_imp->lock);
+    U64 ret = 0;
+
+    for (U32 i = 0; i < _imp->slabs.size(); ++i) {
+        if (_imp->slabs[i].file) {
+            ret += _imp->slabs[i].file->size();
+        }
+    }
+
+    return ret;
+}
+
+U64
+CacheSlabAllocator::getFreeSize() const
+{
+    QMutexLocker k(&_imp->lock);
+    U64 ret = 0;
+
+    for (U32 i = 0; i < _imp->slabs.size(); ++i) {
+        for (FreeRanges::const_iterator it = _imp->slabs[i].freeRanges.begin(); it != _imp->slabs[i].freeRanges.end(); ++it) {
+            ret += it->second;
+        }
+    }
+
+    return ret;
+}
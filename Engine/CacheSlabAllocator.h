@@ -0,0 +1,132 @@
+//  Natron
+//
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef NATRON_ENGINE_CACHESLABALLOCATOR_H_
+#define NATRON_ENGINE_CACHESLABALLOCATOR_H_
+
+#include <string>
+
+#ifndef Q_MOC_RUN
+#include <boost/scoped_ptr.hpp>
+#endif
+
+#include "Global/GlobalDefines.h"
+
+namespace Natron {
+
+/**
+ * @brief A sub-range of one of the slab files of a CacheSlabAllocator.
+ **/
+struct CacheSlabExtent
+{
+    int slab; //< index of the slab file, -1 when the extent is null
+    U64 offset; //< offset in bytes from the start of the slab file
+    U64 size; //< size in bytes, always a multiple of NATRON_CACHE_SLAB_ALIGNMENT
+
+    CacheSlabExtent()
+        : slab(-1)
+          , offset(0)
+          , size(0)
+    {
+    }
+
+    bool isNull() const
+    {
+        return slab < 0;
+    }
+};
+
+struct CacheSlabAllocatorPrivate;
+
+/**
+ * @brief Backs the disk portion of a cache with a few large memory-mapped slab files.
+ * Instead of owning a file each, disk cache entries get an extent of a slab: allocating and
+ * freeing an entry is a free-list operation and does not open, truncate or map any file.
+ *
+ * Slab files are created with their final size and mapped once for their whole lifetime,
+ * hence a pointer returned by data() remains valid until the extent is deallocated.
+ * Slab files are kept across sessions so that the cache table of contents can restore
+ * the extents it references.
+ *
+ * This class is MT-safe.
+ **/
+class CacheSlabAllocator
+{
+public:
+
+    /**
+     * @brief Slab files are created on demand in the given directory.
+     * @param slabSize The size of a slab file. An entry bigger than this gets a slab of its own.
+     **/
+    CacheSlabAllocator(const std::string & directory,
+                       U64 slabSize = NATRON_CACHE_SLAB_SIZE);
+
+    ~CacheSlabAllocator();
+
+    const std::string & getDirectory() const;
+
+    /**
+     * @brief Reserves an extent of at least size bytes, creating a new slab file if no free range
+     * is large enough. Returns false if the slab file could not be created.
+     **/
+    bool allocate(U64 size, CacheSlabExtent* extent);
+
+    /**
+     * @brief Marks an extent found in a previous session as used again, opening its slab file
+     * if needed. Returns false if the slab file is missing or if the extent overlaps a used range.
+     * All extents must be restored before the first call to allocate(), which recycles the slab
+     * files it did not open.
+     **/
+    bool restore(const CacheSlabExtent & extent);
+
+    /**
+     * @brief Gives the extent back to the free-list. Its content is discarded and, where the
+     * file-system supports it, the disk blocks backing it are released.
+     **/
+    void deallocate(const CacheSlabExtent & extent);
+
+    /**
+     * @brief Returns a pointer to the first byte of the extent in the mapped slab.
+     **/
+    char* data(const CacheSlabExtent & extent) const;
+
+    /**
+     * @brief Schedules the write-back of the extent to the slab file. This does not block.
+     **/
+    bool flush(const CacheSlabExtent & extent) const;
+
+    /**
+     * @brief Drops the pages of the extent from the memory of the process. The content is kept
+     * in the slab file and is read back the next time the extent is accessed.
+     **/
+    void release(const CacheSlabExtent & extent) const;
+
+    /**
+     * @brief Removes the slab files that no extent uses anymore, as well as the files of slabs that
+     * were not restored. Called when the cache is cleared so that the disk space is given back.
+     * Returns the number of bytes removed from the disk.
+     **/
+    U64 removeUnusedSlabs();
+
+    int getSlabsCount() const;
+
+    /**
+     * @brief The size of all slab files, in bytes.
+     **/
+    U64 getTotalSize() const;
+
+    /**
+     * @brief The number of bytes of the slab files that are not used by any extent.
+     **/
+    U64 getFreeSize() const;
+
+private:
+
+    boost::scoped_ptr<CacheSlabAllocatorPrivate> _imp;
+};
+}
+
+#endif // NATRON_ENGINE_CACHESLABALLOCATOR_H_
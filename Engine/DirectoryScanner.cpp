@@ -0,0 +1,381 @@
+//  Natron
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "DirectoryScanner.h"
+
+#include <algorithm>
+#include <cassert>
+
+#include <QtCore/QDirIterator>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtConcurrentMap>
+
+#ifdef __NATRON_UNIX__
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#if defined(_DIRENT_HAVE_D_TYPE) || defined(__APPLE__) || defined(__FreeBSD__)
+#define NATRON_DIRENT_HAS_D_TYPE
+#endif
+#endif
+
+#include <SequenceParsing.h>
+
+using namespace Natron;
+
+namespace {
+///Filters listDirectory can apply without QDir
+const QDir::Filters kScannerFilters = QDir::Dirs | QDir::AllDirs | QDir::Files | QDir::Drives | QDir::Hidden |
+                                      QDir::NoDotAndDotDot | QDir::NoDot | QDir::NoDotDot;
+
+QString
+childPath(const QString& directoryPath,
+          const QString& name)
+{
+    QString ret = directoryPath;
+
+    if ( !ret.endsWith('/') ) {
+        ret.append('/');
+    }
+    ret.append(name);
+
+    return ret;
+}
+
+bool
+isDotOrDotDotFiltered(const QString& name,
+                      const QDir::Filters& filters)
+{
+#if QT_VERSION < 0x050000
+    bool skipDot = filters & (QDir::NoDotAndDotDot | QDir::NoDot);
+    bool skipDotDot = filters & (QDir::NoDotAndDotDot | QDir::NoDotDot);
+#else
+    bool skipDot = filters & QDir::NoDot;
+    bool skipDotDot = filters & QDir::NoDotDot;
+#endif
+    if ( name == QString(".") ) {
+        return skipDot;
+    } else if ( name == QString("..") ) {
+        return skipDotDot;
+    }
+
+    return false;
+}
+
+bool
+listDirectoryWithQDir(const QString& path,
+                      const QDir::Filters& filters,
+                      bool withInfo,
+                      DirectoryEntries* entries)
+{
+    QDir dir(path);
+
+    if ( !dir.exists() ) {
+        return false;
+    }
+#ifdef __NATRON_WIN32__
+    ///The listing of a directory gives the size and date of its files on Windows
+    withInfo = true;
+#endif
+    QDirIterator it(path, filters);
+    while ( it.hasNext() ) {
+        it.next();
+        QFileInfo info = it.fileInfo();
+        DirectoryEntry e;
+        e.name = info.fileName();
+        e.isDir = info.isDir();
+        if (withInfo) {
+            e.hasInfo = true;
+            e.size = e.isDir ? 0 : info.size();
+            e.lastModified = info.lastModified();
+        }
+        entries->push_back(e);
+    }
+
+    return true;
+}
+
+#ifdef __NATRON_UNIX__
+bool
+listDirectoryWithReaddir(const QString& path,
+                         const QDir::Filters& filters,
+                         bool withInfo,
+                         DirectoryEntries* entries)
+{
+    QByteArray encodedPath = QFile::encodeName(path);
+    DIR* dir = opendir( encodedPath.constData() );
+
+    if (!dir) {
+        return false;
+    }
+
+    bool acceptDirs = filters & (QDir::Dirs | QDir::AllDirs);
+    bool acceptFiles = filters & QDir::Files;
+    bool acceptHidden = filters & QDir::Hidden;
+    QByteArray dirPrefix = QFile::encodeName( childPath( path, QString() ) );
+
+    struct dirent* d;
+    while ( ( d = readdir(dir) ) ) {
+        const char* rawName = d->d_name;
+        if ( (rawName[0] == '.') && !acceptHidden && (rawName[1] != '\0') && !( (rawName[1] == '.') && (rawName[2] == '\0') ) ) {
+            continue;
+        }
+        DirectoryEntry e;
+        e.name = QFile::decodeName(rawName);
+        if ( isDotOrDotDotFiltered(e.name, filters) ) {
+            continue;
+        }
+
+        bool needsStat = withInfo;
+        bool isOther = false;
+#ifdef NATRON_DIRENT_HAS_D_TYPE
+        switch (d->d_type) {
+        case DT_DIR:
+            e.isDir = true;
+            break;
+        case DT_REG:
+            e.isDir = false;
+            break;
+        case DT_LNK:
+        case DT_UNKNOWN:
+            ///Symbolic links are listed as their target, as QDir does
+            needsStat = true;
+            break;
+        default:
+            ///Sockets, pipes and devices are system files
+            isOther = true;
+            break;
+        }
+#else
+        needsStat = true;
+#endif
+        if (isOther) {
+            continue;
+        }
+        if (needsStat) {
+            QByteArray absolutePath = dirPrefix + QByteArray(rawName);
+            struct stat s;
+            if (stat(absolutePath.constData(), &s) != 0) {
+                ///Broken symbolic link: a system file for QDir
+                continue;
+            }
+            if ( !S_ISDIR(s.st_mode) && !S_ISREG(s.st_mode) ) {
+                continue;
+            }
+            e.isDir = S_ISDIR(s.st_mode);
+            if (withInfo) {
+                e.hasInfo = true;
+                e.size = e.isDir ? 0 : (qint64)s.st_size;
+                e.lastModified = QDateTime::fromTime_t( (uint)s.st_mtime );
+            }
+        }
+        if ( (e.isDir && !acceptDirs) || (!e.isDir && !acceptFiles) ) {
+            continue;
+        }
+        entries->push_back(e);
+    }
+    closedir(dir);
+
+    return true;
+} // listDirectoryWithReaddir
+
+#endif // __NATRON_UNIX__
+
+struct EntryLessThan
+{
+    QDir::SortFlags sort;
+
+    EntryLessThan(QDir::SortFlags sort)
+        : sort(sort)
+    {
+    }
+
+    bool operator() (const DirectoryEntry& a,
+                     const DirectoryEntry& b) const
+    {
+        bool hasInfo = a.hasInfo && b.hasInfo;
+        if ( (sort == QDir::Size) && hasInfo && (a.size != b.size) ) {
+            ///Largest first, as QDir
+            return a.size > b.size;
+        } else if ( (sort == QDir::Time) && hasInfo && (a.lastModified != b.lastModified) ) {
+            ///Most recent first, as QDir
+            return a.lastModified > b.lastModified;
+        } else if (sort == QDir::Type) {
+            int r = getSuffix(a.name).compare( getSuffix(b.name) );
+            if (r != 0) {
+                return r < 0;
+            }
+        }
+
+        return a.name.compare(b.name) < 0;
+    }
+
+    static QString getSuffix(const QString& name)
+    {
+        int lastDotPos = name.lastIndexOf( QChar('.') );
+
+        return lastDotPos == -1 ? QString() : name.mid(lastDotPos + 1);
+    }
+};
+
+struct FileNameJob
+{
+    QString name;
+    std::string absolutePath;
+    QString key;
+    boost::shared_ptr<SequenceParsing::FileNameContent> content;
+};
+
+/**
+ * @brief Files of a sequence only differ by the digits of their frame number:
+ * they all have the same name once the digits and the sign of negative frames are squashed.
+ **/
+QString
+getSequenceKey(const QString& name)
+{
+    QString ret;
+
+    ret.reserve( name.size() );
+    bool inDigits = false;
+    for (int i = 0; i < name.size(); ++i) {
+        const QChar& c = name.at(i);
+        if ( ( c == QChar('-') ) && (i + 1 < name.size()) && name.at(i + 1).isDigit() ) {
+            continue;
+        }
+        if ( c.isDigit() ) {
+            if (!inDigits) {
+                ret.append( QChar('#') );
+                inDigits = true;
+            }
+        } else {
+            ret.append(c);
+            inDigits = false;
+        }
+    }
+
+    return ret;
+}
+
+void
+parseFileName(FileNameJob& job)
+{
+    job.content.reset( new SequenceParsing::FileNameContent(job.absolutePath) );
+    job.key = getSequenceKey(job.name);
+}
+}
+
+bool
+Natron::listDirectory(const QString& path,
+                      const QDir::Filters& filters,
+                      bool withInfo,
+                      DirectoryEntries* entries)
+{
+    assert(entries);
+#ifdef __NATRON_UNIX__
+    if ( (filters & ~kScannerFilters) == 0 ) {
+        return listDirectoryWithReaddir(path, filters, withInfo, entries);
+    }
+#endif
+
+    return listDirectoryWithQDir(path, filters, withInfo, entries);
+}
+
+void
+Natron::statDirectoryEntry(const QString& absoluteFilePath,
+                           DirectoryEntry* entry)
+{
+    assert(entry);
+    QFileInfo info(absoluteFilePath);
+    entry->hasInfo = true;
+    entry->size = entry->isDir ? 0 : info.size();
+    entry->lastModified = info.lastModified();
+}
+
+void
+Natron::sortDirectoryEntries(QDir::SortFlags sort,
+                             bool reversed,
+                             DirectoryEntries* entries)
+{
+    assert(entries);
+    std::sort( entries->begin(), entries->end(), EntryLessThan(sort) );
+    if (reversed) {
+        std::reverse( entries->begin(), entries->end() );
+    }
+}
+
+FileSequenceGrouper::FileSequenceGrouper(const QString& directoryPath,
+                                         bool estimateSizes)
+    : _directoryPath(directoryPath)
+      , _estimateSizes(estimateSizes)
+      , _openSequences()
+      , _keys()
+{
+}
+
+FileSequenceGrouper::~FileSequenceGrouper()
+{
+}
+
+void
+FileSequenceGrouper::addFiles(const QStringList& fileNames,
+                              std::vector<boost::shared_ptr<SequenceParsing::SequenceFromFiles> >* sequences,
+                              std::vector<bool>* created)
+{
+    assert(sequences && created);
+    std::vector<FileNameJob> jobs( fileNames.size() );
+    for (int i = 0; i < fileNames.size(); ++i) {
+        jobs[i].name = fileNames[i];
+        jobs[i].absolutePath = childPath(_directoryPath, fileNames[i]).toStdString();
+    }
+    if (jobs.size() == 1) {
+        parseFileName( jobs.front() );
+    } else if ( !jobs.empty() ) {
+        QtConcurrent::blockingMap(jobs, parseFileName);
+    }
+
+    sequences->resize( jobs.size() );
+    created->resize( jobs.size() );
+    for (std::size_t i = 0; i < jobs.size(); ++i) {
+        SequencesList& candidates = _openSequences[jobs[i].key];
+        boost::shared_ptr<SequenceParsing::SequenceFromFiles> sequence;
+
+        ///The most recently created sequences are the most likely to match
+        for (SequencesList::reverse_iterator it = candidates.rbegin(); it != candidates.rend(); ++it) {
+            if ( (*it)->tryInsertFile(*jobs[i].content, false) ) {
+                sequence = *it;
+                break;
+            }
+        }
+        (*created)[i] = !sequence;
+        if (!sequence) {
+            sequence.reset( new SequenceParsing::SequenceFromFiles(*jobs[i].content, _estimateSizes) );
+            candidates.push_back(sequence);
+            _keys[sequence.get()] = jobs[i].key;
+        }
+        (*sequences)[i] = sequence;
+    }
+}
+
+void
+FileSequenceGrouper::closeSequence(const boost::shared_ptr<SequenceParsing::SequenceFromFiles>& sequence)
+{
+    std::map<SequenceParsing::SequenceFromFiles*,QString>::iterator found = _keys.find( sequence.get() );
+
+    if ( found == _keys.end() ) {
+        return;
+    }
+    QHash<QString,SequencesList>::iterator candidates = _openSequences.find(found->second);
+    if ( candidates != _openSequences.end() ) {
+        SequencesList::iterator it = std::find( candidates->begin(), candidates->end(), sequence );
+        if ( it != candidates->end() ) {
+            candidates->erase(it);
+        }
+        if ( candidates->empty() ) {
+            _openSequences.erase(candidates);
+        }
+    }
+    _keys.erase(found);
+}
@@ -0,0 +1,114 @@
+//  Natron
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef NATRON_ENGINE_DIRECTORYSCANNER_H_
+#define NATRON_ENGINE_DIRECTORYSCANNER_H_
+
+#include <vector>
+#include <map>
+
+#ifndef Q_MOC_RUN
+#include <boost/shared_ptr.hpp>
+#include <boost/utility.hpp>
+#endif
+
+#include <QString>
+#include <QStringList>
+#include <QDateTime>
+#include <QHash>
+#include <QtCore/QDir>
+
+#include "Global/Macros.h"
+
+namespace SequenceParsing {
+class SequenceFromFiles;
+}
+
+namespace Natron {
+
+struct DirectoryEntry
+{
+    QString name; //< without the path
+    bool isDir;
+    bool hasInfo; //< size and lastModified are valid
+    qint64 size;
+    QDateTime lastModified;
+
+    DirectoryEntry()
+        : name()
+          , isDir(false)
+          , hasInfo(false)
+          , size(0)
+          , lastModified()
+    {
+    }
+};
+
+typedef std::vector<DirectoryEntry> DirectoryEntries;
+
+/**
+ * @brief Lists the entries of the directory matching filters, unsorted, without "." and ".." unless filters ask for them.
+ * On Unix the names are read with readdir: files are only stat'ed to tell directories from files when the file system
+ * does not give the type of the entries, or if withInfo is true. Filters that require more information about the
+ * entries than their type, e.g: QDir::Readable, fall back to QDir.
+ * Returns false if the directory could not be read.
+ **/
+bool listDirectory(const QString& path,const QDir::Filters& filters,bool withInfo,DirectoryEntries* entries);
+
+/**
+ * @brief Fills the size and modification date of the entry.
+ **/
+void statDirectoryEntry(const QString& absoluteFilePath,DirectoryEntry* entry);
+
+/**
+ * @brief Sorts entries the way QDir does with the given sort flag, which must be one of QDir::Name, QDir::Size,
+ * QDir::Type or QDir::Time. Entries without info are sorted by name.
+ **/
+void sortDirectoryEntries(QDir::SortFlags sort,bool reversed,DirectoryEntries* entries);
+
+/**
+ * @brief Groups the files of a directory into sequences, a batch at a time, so that the sequences may be shown
+ * before all the files of the directory have been seen.
+ * The file names of a batch are parsed in parallel. A file is then only compared with the open sequences whose
+ * name is the same as its own once all their digits are ignored, instead of with all the sequences found so far.
+ **/
+class FileSequenceGrouper
+    : boost::noncopyable
+{
+public:
+
+    /**
+     * @param estimateSizes Passed to the sequences, estimating the size of a sequence reads the size of its files.
+     **/
+    FileSequenceGrouper(const QString& directoryPath,
+                        bool estimateSizes);
+
+    ~FileSequenceGrouper();
+
+    /**
+     * @brief Adds the files to the open sequences they belong to, in order. For each file, sequences[i] is set
+     * to its sequence, and created[i] to whether that sequence was created for it.
+     **/
+    void addFiles(const QStringList& fileNames,
+                  std::vector<boost::shared_ptr<SequenceParsing::SequenceFromFiles> >* sequences,
+                  std::vector<bool>* created);
+
+    /**
+     * @brief Files added from now on can no longer join the sequence.
+     **/
+    void closeSequence(const boost::shared_ptr<SequenceParsing::SequenceFromFiles>& sequence);
+
+private:
+
+    typedef std::vector<boost::shared_ptr<SequenceParsing::SequenceFromFiles> > SequencesList;
+
+    QString _directoryPath;
+    bool _estimateSizes;
+    QHash<QString,SequencesList> _openSequences; //< open sequences by the key of their files
+    std::map<SequenceParsing::SequenceFromFiles*,QString> _keys; //< key of each open sequence
+};
+} // namespace Natron
+
+#endif // NATRON_ENGINE_DIRECTORYSCANNER_H_
@@ -0,0 +1,80 @@
+//  Natron
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "DraftRenderState.h"
+
+#include <cassert>
+
+using namespace Natron;
+
+DraftRenderState::DraftRenderState(qint64 renderBudgetMS)
+    : _lock()
+      , _renderBudgetMS(renderBudgetMS)
+      , _draftMipMapLevelOffset(0)
+      , _lastFullRenderDurations()
+{
+}
+
+bool
+DraftRenderState::onEdit(SequenceTime time,
+                         int downscaleLevel)
+{
+    QMutexLocker k(&_lock);
+    std::map<SequenceTime, qint64>::const_iterator found = _lastFullRenderDurations.find(time);
+
+    ///A frame that was never rendered at full resolution is assumed to be fast
+    bool renderDraft = downscaleLevel > 0 && found != _lastFullRenderDurations.end() && found->second >= _renderBudgetMS;
+
+    _draftMipMapLevelOffset = renderDraft ? downscaleLevel : 0;
+
+    return renderDraft;
+}
+
+int
+DraftRenderState::getRenderMipMapLevel(int mipMapLevel,
+                                       const RectD & rod,
+                                       double par,
+                                       bool* isDraft) const
+{
+    assert(par > 0.);
+    int level;
+    {
+        QMutexLocker k(&_lock);
+        level = mipMapLevel + _draftMipMapLevelOffset;
+    }
+    ///Coarser levels than the one at which the rod is a single pixel would only blur the draft further
+    while ( level > mipMapLevel &&
+            ( ( rod.width() / par / (double)(1 << level) < 1. ) || ( rod.height() / (double)(1 << level) < 1. ) ) ) {
+        --level;
+    }
+    *isDraft = level > mipMapLevel;
+
+    return level;
+}
+
+void
+DraftRenderState::onRenderFinished(SequenceTime time,
+                                   bool isDraft,
+                                   qint64 durationMS)
+{
+    if (isDraft) {
+        return;
+    }
+    QMutexLocker k(&_lock);
+    _lastFullRenderDurations[time] = durationMS;
+}
+
+bool
+DraftRenderState::refine()
+{
+    QMutexLocker k(&_lock);
+
+    if (_draftMipMapLevelOffset == 0) {
+        return false;
+    }
+    _draftMipMapLevelOffset = 0;
+
+    return true;
+}
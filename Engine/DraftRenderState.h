@@ -0,0 +1,62 @@
+//  Natron
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef NATRON_ENGINE_DRAFTRENDERSTATE_H_
+#define NATRON_ENGINE_DRAFTRENDERSTATE_H_
+
+#include <map>
+#include <QtCore/QMutex>
+
+#include "Global/GlobalDefines.h"
+#include "Global/Macros.h"
+#include "Engine/Rect.h"
+
+namespace Natron {
+
+/**
+ * @brief Decides when the viewer renders the current frame as a coarser draft while the user edits a parameter,
+ * and when the draft must be refined to full resolution, @see ViewerInstance::renderCurrentFrameInteractively.
+ * This class is MT-safe.
+ **/
+class DraftRenderState
+{
+public:
+
+    explicit DraftRenderState(qint64 renderBudgetMS);
+
+    /**
+     * @brief Called on each edit: the next renders are drafts, downscaleLevel mipmap levels below the viewer's, if the last
+     * render at full resolution of the given frame took longer than the budget. Returns true if so.
+     **/
+    bool onEdit(SequenceTime time,
+                int downscaleLevel);
+
+    /**
+     * @brief Returns the mipmap level to render at: mipMapLevel if no draft is requested, otherwise the draft level
+     * clamped to the largest one at which the rod still covers a pixel. isDraft is set to true if it is coarser than mipMapLevel.
+     **/
+    int getRenderMipMapLevel(int mipMapLevel,
+                             const RectD & rod,
+                             double par,
+                             bool* isDraft) const WARN_UNUSED_RETURN;
+
+    ///Called when a render of the given frame went through: only the full resolution ones are measured
+    void onRenderFinished(SequenceTime time,
+                          bool isDraft,
+                          qint64 durationMS);
+
+    ///Stops rendering drafts: returns true if the last renders were drafts and must be refined
+    bool refine() WARN_UNUSED_RETURN;
+
+private:
+
+    mutable QMutex _lock;
+    qint64 _renderBudgetMS;
+    int _draftMipMapLevelOffset; //< when > 0, renders are done that many mipmap levels below the viewer's
+    std::map<SequenceTime, qint64> _lastFullRenderDurations; //< in ms, for each frame
+};
+} // namespace Natron
+
+#endif // NATRON_ENGINE_DRAFTRENDERSTATE_H_
@@ -16,8 +16,11 @@
 #include <QReadWriteLock>
 #include <QCoreApplication>
 #include <QtConcurrentRun>
+#include <QAtomicInt>
 
 #include <boost/bind.hpp>
+#include <boost/weak_ptr.hpp>
+#include <boost/scoped_ptr.hpp>
 #include <SequenceParsing.h>
 
 #include "Global/MemoryInfo.h"
@@ -33,7 +36,12 @@
 #include "Engine/OfxImageEffectInstance.h"
 #include "Engine/KnobTypes.h"
 #include "Engine/PluginMemory.h"
+#include "Engine/PreviewScheduler.h"
 #include "Engine/Project.h"
+#include "Engine/ActionsCacheVersions.h"
+#include "Engine/RenderAbortToken.h"
+#include "Engine/RenderPriorityScheduler.h"
+#include "Engine/RenderProfiler.h"
 #include "Engine/BlockingBackgroundRender.h"
 #include "Engine/AppInstance.h"
 #include "Engine/ThreadStorage.h"
@@ -52,179 +60,412 @@ class OutputFile_Knob;
 
 
 namespace  {
+    
+    ///How many versions (hashes) of the effect the actions cache remembers
+    const std::size_t kActionsCacheMaxVersions = 8;
+    
+    ///The regions of interest depend on the render window which changes with each tile rendered, so their
+    ///map is emptied when it grows larger than this.
+    const std::size_t kActionsCacheMaxRoIEntries = 512;
+    
+    ///Incremented each time an effect is destroyed: results holding pointers to effects (regions of interest
+    ///and transform concatenations) computed before that may be dangling.
+    QAtomicInt gEffectsDestroyedCount;
+    
+    int getEffectsDestroyedCount()
+    {
+        return gEffectsDestroyedCount.fetchAndAddRelaxed(0);
+    }
+    
     struct ActionKey {
         double time;
         unsigned int mipMapLevel;
-    };
-    
-    struct IdentityResults {
-        int inputIdentityNb;
-        double inputIdentityTime;
+        int view;
     };
     
     struct CompareActionsCacheKeys {
         bool operator() (const ActionKey& lhs,const ActionKey& rhs) const {
-            if (lhs.time < rhs.time) {
+            if (lhs.time != rhs.time) {
+                return lhs.time < rhs.time;
+            }
+            if (lhs.mipMapLevel != rhs.mipMapLevel) {
+                return lhs.mipMapLevel < rhs.mipMapLevel;
+            }
+            return lhs.view < rhs.view;
+        }
+    };
+    
+    struct RoIKey {
+        ActionKey action;
+        RectD outputRoD;
+        RectD renderWindow;
+    };
+    
+    bool compareRects(const RectD& lhs,const RectD& rhs,bool* equal)
+    {
+        *equal = false;
+        if (lhs.x1 != rhs.x1) {
+            return lhs.x1 < rhs.x1;
+        }
+        if (lhs.y1 != rhs.y1) {
+            return lhs.y1 < rhs.y1;
+        }
+        if (lhs.x2 != rhs.x2) {
+            return lhs.x2 < rhs.x2;
+        }
+        if (lhs.y2 != rhs.y2) {
+            return lhs.y2 < rhs.y2;
+        }
+        *equal = true;
+        return false;
+    }
+    
+    struct CompareRoIKeys {
+        bool operator() (const RoIKey& lhs,const RoIKey& rhs) const {
+            CompareActionsCacheKeys compareActions;
+            if ( compareActions(lhs.action, rhs.action) ) {
                 return true;
-            } else if (lhs.time == rhs.time) {
-                if (lhs.mipMapLevel < rhs.mipMapLevel) {
-                    return true;
-                } else {
-                    return false;
-                }
-            } else {
+            } else if ( compareActions(rhs.action, lhs.action) ) {
                 return false;
             }
-            
+            bool equal;
+            bool ret = compareRects(lhs.outputRoD, rhs.outputRoD, &equal);
+            if (!equal) {
+                return ret;
+            }
+            return compareRects(lhs.renderWindow, rhs.renderWindow, &equal);
         }
     };
     
+    struct IdentityResults {
+        int inputIdentityNb;
+        double inputIdentityTime;
+    };
+    
+    /**
+     * @brief The result of EffectInstance::tryConcatenateTransforms. The pointer to the upstream effect
+     * remains valid as long as the hash of the effect does not change since it depends on the hash of all its inputs.
+     **/
+    struct TransformConcatenationResults {
+        bool hasConcat;
+        int inputTransformNb;
+        Natron::EffectInstance* newInputEffect;
+        int newInputNbToFetchFrom;
+        Transform::Matrix3x3 cat;
+        bool isResultIdentity;
+    };
+    
     typedef std::map<ActionKey,IdentityResults,CompareActionsCacheKeys> IdentityCacheMap;
     typedef std::map<ActionKey,RectD,CompareActionsCacheKeys> RoDCacheMap;
+    typedef std::map<ActionKey,EffectInstance::FramesNeededMap,CompareActionsCacheKeys> FramesNeededCacheMap;
+    typedef std::map<RoIKey,EffectInstance::RoIMap,CompareRoIKeys> RoICacheMap;
+    typedef std::map<ActionKey,TransformConcatenationResults,CompareActionsCacheKeys> TransformConcatenationCacheMap;
+    
+    /**
+     * @brief All the results of the actions computed for one hash of the effect.
+     **/
+    struct ActionsCacheVersion {
+        U64 hash;
+        int effectsDestroyedCount; //< value of gEffectsDestroyedCount when roiCache and transformConcatenationCache were filled
+        
+        OfxRangeD timeDomain;
+        bool timeDomainSet;
+        
+        IdentityCacheMap identityCache;
+        RoDCacheMap rodCache;
+        FramesNeededCacheMap framesNeededCache;
+        RoICacheMap roiCache;
+        TransformConcatenationCacheMap transformConcatenationCache;
+        
+        ActionsCacheVersion(U64 hash)
+        : hash(hash)
+        , effectsDestroyedCount( getEffectsDestroyedCount() )
+        , timeDomain()
+        , timeDomainSet(false)
+        , identityCache()
+        , rodCache()
+        , framesNeededCache()
+        , roiCache()
+        , transformConcatenationCache()
+        {
+        }
+        
+        void dropResultsReferencingEffects()
+        {
+            roiCache.clear();
+            transformConcatenationCache.clear();
+        }
+    };
     
     /**
      * @brief This class stores all results of the following actions:
-     - getRegionOfDefinition (invalidated on hash change, mapped across time + scale)
-     - getTimeDomain (invalidated on hash change, only 1 value possible
-     - isIdentity (invalidated on hash change,mapped across time + scale)
+     - getRegionOfDefinition (mapped across time + scale + view)
+     - getTimeDomain (only 1 value possible)
+     - isIdentity (mapped across time + scale + view)
+     - getFramesNeeded (mapped across time)
+     - getRegionsOfInterest (mapped across time + scale + view + output RoD + render window)
+     - the transform concatenation chain upstream (mapped across time + scale + view)
      * The reason we store them is that the OFX Clip API can potentially call these actions recursively
      * but this is forbidden by the spec:
      * http://openfx.sourceforge.net/Documentation/1.3/ofxProgrammingReference.html#id475585
+     *
+     * The results are stored for the last kActionsCacheMaxVersions hashes of the effect, so that toggling a parameter
+     * back and forth, or switching between 2 inputs of a viewer, does not call the plug-in again.
      **/
     class ActionsCache {
         
         mutable QMutex _cacheMutex; //< protects everything in the cache
         
-        U64 _cacheHash; //< the effect hash at which the actions were computed
+        ActionsCacheVersions<ActionsCacheVersion> _versions;
+        
+        EffectInstance::ActionsCacheStatistics _stats;
         
-        OfxRangeD _timeDomain;
-        bool _timeDomainSet;
+        ActionsCacheVersion* findVersion(U64 hash)
+        {
+            return _versions.find(hash);
+        }
         
-        IdentityCacheMap _identityCache;
-        RoDCacheMap _rodCache;
+        ActionsCacheVersion* getOrCreateVersion(U64 hash)
+        {
+            return _versions.getOrCreate(hash);
+        }
+        
+        static void dropDanglingResults(ActionsCacheVersion* version)
+        {
+            ActionsCacheVersions<ActionsCacheVersion>::dropDanglingResults( version, getEffectsDestroyedCount() );
+        }
+        
+        static void countLookup(bool found,EffectInstance::ActionsCacheCounters* counters)
+        {
+            if (found) {
+                ++counters->hits;
+            } else {
+                ++counters->misses;
+            }
+        }
         
     public:
         
         ActionsCache()
         : _cacheMutex()
-        , _cacheHash(0)
-        , _timeDomain()
-        , _timeDomainSet(false)
-        , _identityCache()
-        , _rodCache()
+        , _versions(kActionsCacheMaxVersions)
+        , _stats()
         {
             
         }
         
         /**
-         * @brief Get the hash at which the actions are stored in the cache currently
+         * @brief Called when the hash of the effect changes. The results stored for other hashes are kept
+         * since the effect may come back to the same state.
          **/
-        bool getCacheHash() const {
+        void setCacheHash(U64 newHash) {
             QMutexLocker l(&_cacheMutex);
-            return _cacheHash;
+            (void)getOrCreateVersion(newHash);
         }
         
-        void invalidateAll(U64 newHash) {
+        void getStatistics(EffectInstance::ActionsCacheStatistics* stats) const {
             QMutexLocker l(&_cacheMutex);
-            _cacheHash = newHash;
-            _rodCache.clear();
-            _identityCache.clear();
-            _timeDomainSet = false;
+            *stats = _stats;
         }
         
+        bool getIdentityResult(U64 hash,double time,unsigned int mipMapLevel,int view,int* inputNbIdentity,double* identityTime) {
+            QMutexLocker l(&_cacheMutex);
+            bool ret = false;
+            ActionsCacheVersion* version = findVersion(hash);
+            if (version) {
+                ActionKey key;
+                key.time = time;
+                key.mipMapLevel = mipMapLevel;
+                key.view = view;
+                
+                IdentityCacheMap::const_iterator found = version->identityCache.find(key);
+                if ( found != version->identityCache.end() ) {
+                    *inputNbIdentity = found->second.inputIdentityNb;
+                    *identityTime = found->second.inputIdentityTime;
+                    ret = true;
+                }
+            }
+            countLookup(ret, &_stats.isIdentity);
+            return ret;
+        }
         
-        bool getIdentityResult(U64 hash,double time,unsigned int mipMapLevel,int* inputNbIdentity,double* identityTime) {
+        void setIdentityResult(U64 hash,double time,unsigned int mipMapLevel,int view,int inputNbIdentity,double identityTime)
+        {
             QMutexLocker l(&_cacheMutex);
-            if (hash != _cacheHash)
-                return false;
             
             ActionKey key;
             key.time = time;
             key.mipMapLevel = mipMapLevel;
+            key.view = view;
             
-            IdentityCacheMap::const_iterator found = _identityCache.find(key);
-            if ( found != _identityCache.end() ) {
-                *inputNbIdentity = found->second.inputIdentityNb;
-                *identityTime = found->second.inputIdentityTime;
-                return true;
+            IdentityResults& v = getOrCreateVersion(hash)->identityCache[key];
+            v.inputIdentityNb = inputNbIdentity;
+            v.inputIdentityTime = identityTime;
+        }
+        
+        bool getRoDResult(U64 hash,double time,unsigned int mipMapLevel,int view,RectD* rod) {
+            QMutexLocker l(&_cacheMutex);
+            bool ret = false;
+            ActionsCacheVersion* version = findVersion(hash);
+            if (version) {
+                ActionKey key;
+                key.time = time;
+                key.mipMapLevel = mipMapLevel;
+                key.view = view;
+                
+                RoDCacheMap::const_iterator found = version->rodCache.find(key);
+                if ( found != version->rodCache.end() ) {
+                    *rod = found->second;
+                    ret = true;
+                }
             }
-            return false;
+            countLookup(ret, &_stats.regionOfDefinition);
+            return ret;
         }
         
-        void setIdentityResult(double time,unsigned int mipMapLevel,int inputNbIdentity,double identityTime)
+        void setRoDResult(U64 hash,double time,unsigned int mipMapLevel,int view,const RectD& rod)
         {
             QMutexLocker l(&_cacheMutex);
-           
             
             ActionKey key;
             key.time = time;
             key.mipMapLevel = mipMapLevel;
+            key.view = view;
             
-            IdentityCacheMap::iterator found = _identityCache.find(key);
-            if ( found != _identityCache.end() ) {
-                found->second.inputIdentityNb = inputNbIdentity;
-                found->second.inputIdentityTime = identityTime;
-            } else {
-                IdentityResults v;
-                v.inputIdentityNb = inputNbIdentity;
-                v.inputIdentityTime = identityTime;
-                _identityCache.insert(std::make_pair(key, v));
+            ///If already set, keep the first result
+            getOrCreateVersion(hash)->rodCache.insert( std::make_pair(key, rod) );
+        }
+        
+        bool getTimeDomainResult(U64 hash,double *first,double* last) {
+            QMutexLocker l(&_cacheMutex);
+            bool ret = false;
+            ActionsCacheVersion* version = findVersion(hash);
+            if (version && version->timeDomainSet) {
+                *first = version->timeDomain.min;
+                *last = version->timeDomain.max;
+                ret = true;
             }
-            
+            countLookup(ret, &_stats.timeDomain);
+            return ret;
         }
         
-        bool getRoDResult(U64 hash,double time,unsigned int mipMapLevel,RectD* rod) {
+        void setTimeDomainResult(U64 hash,double first,double last)
+        {
+            QMutexLocker l(&_cacheMutex);
+            ActionsCacheVersion* version = getOrCreateVersion(hash);
+            version->timeDomainSet = true;
+            version->timeDomain.min = first;
+            version->timeDomain.max = last;
+        }
+        
+        bool getFramesNeededResult(U64 hash,double time,EffectInstance::FramesNeededMap* framesNeeded) {
+            QMutexLocker l(&_cacheMutex);
+            bool ret = false;
+            ActionsCacheVersion* version = findVersion(hash);
+            if (version) {
+                ActionKey key;
+                key.time = time;
+                key.mipMapLevel = 0;
+                key.view = 0;
+                
+                FramesNeededCacheMap::const_iterator found = version->framesNeededCache.find(key);
+                if ( found != version->framesNeededCache.end() ) {
+                    *framesNeeded = found->second;
+                    ret = true;
+                }
+            }
+            countLookup(ret, &_stats.framesNeeded);
+            return ret;
+        }
+        
+        void setFramesNeededResult(U64 hash,double time,const EffectInstance::FramesNeededMap& framesNeeded)
+        {
             QMutexLocker l(&_cacheMutex);
-            if (hash != _cacheHash)
-                return false;
             
             ActionKey key;
             key.time = time;
-            key.mipMapLevel = mipMapLevel;
-            
-            RoDCacheMap::const_iterator found = _rodCache.find(key);
-            if ( found != _rodCache.end() ) {
-                *rod = found->second;
-                return true;
+            key.mipMapLevel = 0;
+            key.view = 0;
+            getOrCreateVersion(hash)->framesNeededCache[key] = framesNeeded;
+        }
+        
+        bool getRoIResult(U64 hash,double time,unsigned int mipMapLevel,int view,const RectD& outputRoD,const RectD& renderWindow,
+                          EffectInstance::RoIMap* rois) {
+            QMutexLocker l(&_cacheMutex);
+            bool ret = false;
+            ActionsCacheVersion* version = findVersion(hash);
+            if (version) {
+                dropDanglingResults(version);
+                RoIKey key;
+                key.action.time = time;
+                key.action.mipMapLevel = mipMapLevel;
+                key.action.view = view;
+                key.outputRoD = outputRoD;
+                key.renderWindow = renderWindow;
+                
+                RoICacheMap::const_iterator found = version->roiCache.find(key);
+                if ( found != version->roiCache.end() ) {
+                    *rois = found->second;
+                    ret = true;
+                }
             }
-            return false;
+            countLookup(ret, &_stats.regionsOfInterest);
+            return ret;
         }
         
-        void setRoDResult(double time,unsigned int mipMapLevel,const RectD& rod)
+        void setRoIResult(U64 hash,double time,unsigned int mipMapLevel,int view,const RectD& outputRoD,const RectD& renderWindow,
+                          const EffectInstance::RoIMap& rois)
         {
             QMutexLocker l(&_cacheMutex);
             
+            RoIKey key;
+            key.action.time = time;
+            key.action.mipMapLevel = mipMapLevel;
+            key.action.view = view;
+            key.outputRoD = outputRoD;
+            key.renderWindow = renderWindow;
             
-            ActionKey key;
-            key.time = time;
-            key.mipMapLevel = mipMapLevel;
-            
-            RoDCacheMap::iterator found = _rodCache.find(key);
-            if ( found != _rodCache.end() ) {
-                ///Already set, this is a bug
-                return;
-            } else {
-                _rodCache.insert(std::make_pair(key, rod));
+            ActionsCacheVersion* version = getOrCreateVersion(hash);
+            dropDanglingResults(version);
+            RoICacheMap& roiCache = version->roiCache;
+            if (roiCache.size() >= kActionsCacheMaxRoIEntries) {
+                roiCache.clear();
             }
-            
+            roiCache[key] = rois;
         }
         
-        bool getTimeDomainResult(U64 hash,double *first,double* last) {
+        bool getTransformConcatenationResult(U64 hash,double time,unsigned int mipMapLevel,int view,TransformConcatenationResults* results) {
             QMutexLocker l(&_cacheMutex);
-            if (hash != _cacheHash || !_timeDomainSet)
-                return false;
-            
-            *first = _timeDomain.min;
-            *last = _timeDomain.max;
-            return true;
+            bool ret = false;
+            ActionsCacheVersion* version = findVersion(hash);
+            if (version) {
+                dropDanglingResults(version);
+                ActionKey key;
+                key.time = time;
+                key.mipMapLevel = mipMapLevel;
+                key.view = view;
+                
+                TransformConcatenationCacheMap::const_iterator found = version->transformConcatenationCache.find(key);
+                if ( found != version->transformConcatenationCache.end() ) {
+                    *results = found->second;
+                    ret = true;
+                }
+            }
+            countLookup(ret, &_stats.transformConcatenation);
+            return ret;
         }
         
-        void setTimeDomainResult(double first,double last)
+        void setTransformConcatenationResult(U64 hash,double time,unsigned int mipMapLevel,int view,const TransformConcatenationResults& results)
         {
             QMutexLocker l(&_cacheMutex);
-            _timeDomainSet = true;
-            _timeDomain.min = first;
-            _timeDomain.max = last;
+            
+            ActionKey key;
+            key.time = time;
+            key.mipMapLevel = mipMapLevel;
+            key.view = view;
+            ActionsCacheVersion* version = getOrCreateVersion(hash);
+            dropDanglingResults(version);
+            version->transformConcatenationCache[key] = results;
         }
         
     };
@@ -251,6 +492,8 @@ struct EffectInstance::RenderArgs
     
     int _firstFrame,_lastFrame;
     
+    EffectInstance* _renderClone; //< if not NULL, the instance on which the render action is called, @see acquireRenderClone
+    
     RenderArgs()
         : _rod()
           , _regionOfInterestResults()
@@ -265,6 +508,7 @@ struct EffectInstance::RenderArgs
           , _outputImage()
           , _firstFrame(0)
           , _lastFrame(0)
+          , _renderClone(0)
     {
     }
     
@@ -282,6 +526,7 @@ struct EffectInstance::RenderArgs
     , _outputImage(o._outputImage)
     , _firstFrame(o._firstFrame)
     , _lastFrame(o._lastFrame)
+    , _renderClone(o._renderClone)
     {
         assert(_outputImage);
     }
@@ -336,7 +581,10 @@ struct EffectInstance::Implementation
 
     QMutex lastRenderArgsMutex; //< protects lastImage & lastRenderHash
     U64 lastRenderHash;  //< the last hash given to render
-    boost::shared_ptr<Natron::Image> lastImage; //< the last image rendered
+    
+    ///The last image rendered. We do not keep it alive: if it was not cached it is freed as soon as
+    ///its consumer is done with it, and if it was evicted from the cache there is nothing to remove anyway.
+    boost::weak_ptr<Natron::Image> lastImage;
     
     mutable QReadWriteLock duringInteractActionMutex; //< protects duringInteractAction
     bool duringInteractAction; //< true when we're running inside an interact action
@@ -615,6 +863,40 @@ struct EffectInstance::Implementation
 
     };
     
+    /**
+     * @brief Sets on the render args of the thread the render clone acquired for the render action, and gives it
+     * back to the effect when destroyed.
+     **/
+    class ScopedRenderClone
+    {
+        ThreadStorage<RenderArgs>* _dst;
+        EffectInstance* _effect;
+        EffectInstance* _clone;
+        
+    public:
+        
+        ScopedRenderClone(ThreadStorage<RenderArgs>* dst,
+                          EffectInstance* effect,
+                          EffectInstance* clone)
+        : _dst(dst)
+        , _effect(effect)
+        , _clone(clone)
+        {
+            if (_clone) {
+                assert( _dst->hasLocalData() );
+                _dst->localData()._renderClone = _clone;
+            }
+        }
+        
+        ~ScopedRenderClone()
+        {
+            if (_clone) {
+                _dst->localData()._renderClone = 0;
+                _effect->releaseRenderClone(_clone);
+            }
+        }
+    };
+    
     void addInputImageTempPointer(const boost::shared_ptr<Natron::Image> & img)
     {
         inputImages.localData().push_back(img);
@@ -655,6 +937,158 @@ public:
     }
 };
 
+/**
+ * @brief Accounts for the input images of a renderRoI call in the memory budget of the frame
+ * for as long as they are pinned by the render.
+ **/
+class FrameMemoryBudgetHolder_RAII
+{
+    boost::shared_ptr<FrameMemoryBudget> budget;
+    U64 bytes;
+    
+public:
+    
+    FrameMemoryBudgetHolder_RAII(const boost::shared_ptr<FrameMemoryBudget>& budget,const std::list<boost::shared_ptr<Natron::Image> >& imgs)
+    : budget(budget)
+    , bytes(0)
+    {
+        if (budget) {
+            for (std::list<boost::shared_ptr<Natron::Image> >::const_iterator it = imgs.begin(); it != imgs.end(); ++it) {
+                bytes += (*it)->size();
+            }
+            budget->retainBytes(bytes);
+        }
+    }
+    
+    void release()
+    {
+        if (budget) {
+            budget->releaseBytes(bytes);
+            budget.reset();
+        }
+    }
+    
+    ~FrameMemoryBudgetHolder_RAII()
+    {
+        release();
+    }
+};
+
+namespace {
+    
+///Number of frames currently rendering, each of them owns a FrameMemoryBudget
+QAtomicInt framesRenderingCount;
+    
+}
+
+FramePeakAverage::FramePeakAverage()
+    : _lock()
+    , _average(0)
+{
+}
+
+void
+FramePeakAverage::addFramePeak(U64 peakBytes)
+{
+    QMutexLocker k(&_lock);
+    if (_average == 0) {
+        _average = peakBytes;
+    } else {
+        _average = (_average * 3 + peakBytes) / 4;
+    }
+}
+
+U64
+FramePeakAverage::getAverage() const
+{
+    QMutexLocker k(&_lock);
+    return _average;
+}
+
+void
+FramePeakAverage::reset()
+{
+    QMutexLocker k(&_lock);
+    _average = 0;
+}
+
+FrameMemoryBudget::FrameMemoryBudget(U64 budget,
+                                     const boost::shared_ptr<FramePeakAverage>& peakAverage)
+    : _lock()
+    , _budget(budget)
+    , _peakAverage(peakAverage)
+    , _heldBytes(0)
+    , _peakBytes(0)
+{
+    framesRenderingCount.ref();
+}
+
+FrameMemoryBudget::~FrameMemoryBudget()
+{
+    framesRenderingCount.deref();
+    ///The frame is done, fold its peak in the running average of its render
+    if (_peakAverage && _peakBytes > 0) {
+        _peakAverage->addFramePeak(_peakBytes);
+    }
+}
+
+void
+FrameMemoryBudget::retainBytes(U64 bytes)
+{
+    QMutexLocker k(&_lock);
+    _heldBytes += bytes;
+    if (_heldBytes > _peakBytes) {
+        _peakBytes = _heldBytes;
+    }
+}
+
+void
+FrameMemoryBudget::releaseBytes(U64 bytes)
+{
+    QMutexLocker k(&_lock);
+    assert(bytes <= _heldBytes);
+    _heldBytes -= std::min(bytes, _heldBytes);
+}
+
+bool
+FrameMemoryBudget::isExceeded() const
+{
+    U64 share = getBudget();
+    QMutexLocker k(&_lock);
+    return share > 0 && _heldBytes > share;
+}
+
+U64
+FrameMemoryBudget::getBudget() const
+{
+#if QT_VERSION < 0x050000
+    int nFrames = (int)framesRenderingCount;
+#else
+    int nFrames = framesRenderingCount.load();
+#endif
+    ///_budget is never modified after construction
+    return _budget / (U64)std::max(1, nFrames);
+}
+
+U64
+FrameMemoryBudget::getPeakBytes() const
+{
+    QMutexLocker k(&_lock);
+    return _peakBytes;
+}
+
+U64
+FrameMemoryBudget::getRenderMemoryBudget()
+{
+    boost::shared_ptr<Settings> settings = appPTR->getCurrentSettings();
+    double renderPercent = 1. - settings->getRamMaximumPercent() - settings->getUnreachableRamPercent();
+    
+    ///Never go below 10% of the RAM, otherwise a misconfigured cache would prevent any render
+    renderPercent = std::max(0.1, renderPercent);
+    ///Called for each frame: the cgroup limit is only read on the interval of the memory pressure monitor
+    return (U64)( renderPercent * appPTR->getTotalRAM() );
+}
+
 void
 EffectInstance::addThreadLocalInputImageTempPointer(const boost::shared_ptr<Natron::Image> & img)
 {
@@ -671,6 +1105,7 @@ EffectInstance::EffectInstance(boost::shared_ptr<Node> node)
 EffectInstance::~EffectInstance()
 {
     clearPluginMemoryChunks();
+    gEffectsDestroyedCount.fetchAndAddRelaxed(1);
 }
 
 
@@ -722,9 +1157,19 @@ EffectInstance::setParallelRenderArgs(int time,
                                       U64 nodeHash,
                                       U64 rotoAge,
                                       bool canSetValue,
-                                      const TimeLine* timeline)
+                                      const TimeLine* timeline,
+                                      const boost::shared_ptr<FrameMemoryBudget>& memoryBudget,
+                                      const boost::shared_ptr<Natron::RenderAbortToken>& abortToken)
 {
     ParallelRenderArgs& args = _imp->frameRenderArgs.localData();
+    
+    ///Nested calls on the same thread are part of the same frame: keep the budget and the token of the outermost call
+    if (args.validArgs <= 0 || !args.memoryBudget) {
+        args.memoryBudget = memoryBudget;
+    }
+    if (args.validArgs <= 0 || !args.abortToken) {
+        args.abortToken = abortToken;
+    }
     args.canSetValue = canSetValue;
     args.time = time;
     args.timeline = timeline;
@@ -747,6 +1192,11 @@ EffectInstance::invalidateParallelRenderArgs()
     if (_imp->frameRenderArgs.hasLocalData()) {
         ParallelRenderArgs& args = _imp->frameRenderArgs.localData();
         --args.validArgs;
+        if (args.validArgs <= 0) {
+            ///The frame is done, do not hold its budget any longer
+            args.memoryBudget.reset();
+            args.abortToken.reset();
+        }
         return args.canSetValue;
     } else {
         qDebug() << "Frame render args thread storage not set, this is probably because the graph changed while rendering.";
@@ -803,25 +1253,37 @@ EffectInstance::aborted() const
             ///No valid args, probably not rendering
             return false;
         } else {
+            ///Another node or thread of the frame already found out
+            if (args.abortToken && args.abortToken->isAborted()) {
+                return true;
+            }
+            
+            bool ret;
             if (args.isRenderResponseToUserInteraction) {
                 
                 if (args.canAbort) {
                     ///Rendering issued by RenderEngine::renderCurrentFrame, if time or hash changed, abort
-                    bool ret = args.nodeHash != getHash() ||
+                    ret = args.nodeHash != getHash() ||
                     args.time != args.timeline->currentFrame() ||
                     !_node->isActivated();
-                    return ret;
                 } else {
-                    bool ret = !_node->isActivated();
-                    return ret;
+                    ///Previews are rendered this way: when a viewer starts rendering the PreviewScheduler
+                    ///aborts their token, which is checked above on every thread of the preview
+                    ret = !_node->isActivated();
                 }
                 
             } else {
                 ///Rendering is playback or render on disk, we rely on the _imp->renderAborted flag for this.
 
-                return isAbortedFromPlayback();
+                ret = isAbortedFromPlayback();
           
             }
+            
+            ///Let the rest of the frame know without evaluating all of the above
+            if (ret && args.abortToken) {
+                args.abortToken->abort();
+            }
+            return ret;
         }
 
     }
@@ -1021,7 +1483,8 @@ EffectInstance::getImage(int inputNb,
                          const bool dontUpscale,
                          RectI* roiPixel)
 {
-   
+    RenderProfilerScope profilerScope(eProfiledActionGetImage, this, time);
+    
     ///The input we want the image from
     EffectInstance* n = getInput(inputNb);
     
@@ -1636,14 +2099,92 @@ EffectInstance::getImageFromCacheAndConvertIfNeeded(bool useCache,
 
 }
 
+/**
+ * @brief Returns true if the given effect is an identity on one of its inputs at the same time, meaning
+ * it can be skipped when concatenating transforms. The input is returned in inputNb.
+ **/
+static bool
+isIdentityAtTime(Natron::EffectInstance* effect,
+                 const EffectInstance::RenderRoIArgs& args,
+                 int* inputNb)
+{
+    RenderScale scale = args.scale;
+    if (effect->supportsRenderScaleMaybe() == EffectInstance::eSupportsNo) {
+        scale.x = scale.y = 1.;
+    }
+    
+    U64 hash = effect->getHash();
+    RectD rod;
+    bool isProjectFormat;
+    Natron::StatusEnum stat = effect->getRegionOfDefinition_public(hash, args.time, scale, args.view, &rod, &isProjectFormat);
+    if (stat == eStatusFailed || rod.isNull()) {
+        return false;
+    }
+    
+    SequenceTime inputTime;
+    bool identity;
+    try {
+        identity = effect->isIdentity_public(hash, args.time, scale, rod, effect->getPreferredAspectRatio(), args.view, &inputTime, inputNb);
+    } catch (...) {
+        return false;
+    }
+    
+    ///An identity at another time cannot be concatenated
+    return identity && *inputNb >= 0 && inputTime == args.time;
+}
+
 bool
 EffectInstance::tryConcatenateTransforms(const RenderRoIArgs& args,
+                                         U64 nodeHash,
                                          int* inputTransformNb,
                                          Natron::EffectInstance** newInputEffect,
                                          int *newInputNbToFetchFrom,
                                          boost::shared_ptr<Transform::Matrix3x3>* cat,
                                          bool* isResultIdentity)
 {
+    ///The chain only depends on the hash of this node (which contains the hash of all nodes upstream), the time, the scale and the view.
+    ///Walking it calls getTransform and isIdentity on each node of the chain, so reuse the result of a previous walk if possible.
+    TransformConcatenationResults results;
+    if (_imp->actionsCache.getTransformConcatenationResult(nodeHash, args.time, args.mipMapLevel, args.view, &results)) {
+        if (!results.hasConcat) {
+            *newInputEffect = 0;
+            *newInputNbToFetchFrom = -1;
+            *inputTransformNb = -1;
+            return false;
+        }
+        *inputTransformNb = results.inputTransformNb;
+        *newInputEffect = results.newInputEffect;
+        *newInputNbToFetchFrom = results.newInputNbToFetchFrom;
+        cat->reset(new Transform::Matrix3x3(results.cat));
+        *isResultIdentity = results.isResultIdentity;
+        return true;
+    }
+    
+    results.hasConcat = tryConcatenateTransformsInternal(args, inputTransformNb, newInputEffect, newInputNbToFetchFrom, cat, isResultIdentity);
+    if (results.hasConcat) {
+        results.inputTransformNb = *inputTransformNb;
+        results.newInputEffect = *newInputEffect;
+        results.newInputNbToFetchFrom = *newInputNbToFetchFrom;
+        results.cat = **cat;
+        results.isResultIdentity = *isResultIdentity;
+    } else {
+        results.inputTransformNb = -1;
+        results.newInputEffect = 0;
+        results.newInputNbToFetchFrom = -1;
+        results.isResultIdentity = false;
+    }
+    _imp->actionsCache.setTransformConcatenationResult(nodeHash, args.time, args.mipMapLevel, args.view, results);
+    return results.hasConcat;
+}
+
+bool
+EffectInstance::tryConcatenateTransformsInternal(const RenderRoIArgs& args,
+                                                 int* inputTransformNb,
+                                                 Natron::EffectInstance** newInputEffect,
+                                                 int *newInputNbToFetchFrom,
+                                                 boost::shared_ptr<Transform::Matrix3x3>* cat,
+                                                 bool* isResultIdentity)
+{
     
     bool canTransform = getCanTransform();
     Natron::EffectInstance* inputTransformEffect = 0;
@@ -1656,7 +2197,12 @@ EffectInstance::tryConcatenateTransforms(const RenderRoIArgs& args,
         Transform::Matrix3x3 thisNodeTransform;
         
         *inputTransformNb = getInputNumber(inputTransformEffect);
-        assert(*inputTransformNb != -1);
+        if (*inputTransformNb == -1) {
+            ///The clip that can receive a transform is not connected
+            *newInputEffect = 0;
+            *newInputNbToFetchFrom = -1;
+            return false;
+        }
         
         assert(inputTransformEffect);
         
@@ -1679,13 +2225,17 @@ EffectInstance::tryConcatenateTransforms(const RenderRoIArgs& args,
         
         bool inputCanTransform = false;
         bool inputIsDisabled  =  inputTransformEffect->getNode()->isNodeDisabled();
+        int inputIdentityNb = -1;
         
         if (!inputIsDisabled) {
             inputCanTransform = inputTransformEffect->getCanTransform();
+            if (!inputCanTransform && !isIdentityAtTime(inputTransformEffect, args, &inputIdentityNb)) {
+                inputIdentityNb = -1;
+            }
         }
         
         
-        while (inputTransformEffect && (inputCanTransform || inputIsDisabled)) {
+        while (inputTransformEffect && (inputCanTransform || inputIsDisabled || inputIdentityNb != -1)) {
             //input is either disabled, or identity or can concatenate a transform too
             
             if (inputIsDisabled) {
@@ -1713,17 +2263,27 @@ EffectInstance::tryConcatenateTransforms(const RenderRoIArgs& args,
                     *newInputEffect = inputTransformEffect;
                     inputTransformEffect = inputToTransform;
                 } else {
+                    ///e.g: a masked transform whose mask is connected, it must render by itself
+                    inputCanTransform = false;
                     break;
                 }
-            } else  {
-                assert(false);
+            } else {
+                ///The input is an identity at this time (e.g: a Grade with a mix of 0), fetch directly from its input
+                assert(inputIdentityNb != -1);
+                *newInputEffect = inputTransformEffect;
+                *newInputNbToFetchFrom = inputIdentityNb;
+                inputTransformEffect = inputTransformEffect->getInput(inputIdentityNb);
             }
             
-            
+            inputCanTransform = false;
+            inputIdentityNb = -1;
             if (inputTransformEffect) {
                 inputIsDisabled = inputTransformEffect->getNode()->isNodeDisabled();
                 if (!inputIsDisabled) {
                     inputCanTransform = inputTransformEffect->getCanTransform();
+                    if (!inputCanTransform && !isIdentityAtTime(inputTransformEffect, args, &inputIdentityNb)) {
+                        inputIdentityNb = -1;
+                    }
                 }
             }
         }
@@ -1731,7 +2291,7 @@ EffectInstance::tryConcatenateTransforms(const RenderRoIArgs& args,
         
         if (inputTransformEffect && !matricesByOrder.empty()) {
             
-            assert(!inputCanTransform && !inputIsDisabled);
+            assert(!inputIsDisabled);
             assert(*newInputEffect);
             
             ///Now actually concatenate matrices together
@@ -1788,7 +2348,8 @@ public:
 boost::shared_ptr<Natron::Image>
 EffectInstance::renderRoI(const RenderRoIArgs & args)
 {
-   
+    RenderProfilerScope profilerScope(eProfiledActionRenderRoI, this, args.time);
+    
     ParallelRenderArgs& frameRenderArgs = _imp->frameRenderArgs.localData();
     if (!frameRenderArgs.validArgs) {
         qDebug() << "Thread-storage for the render of the frame was not set, this is a bug.";
@@ -1965,7 +2526,7 @@ EffectInstance::renderRoI(const RenderRoIArgs & args)
     bool hasConcat;
     
     if (appPTR->getCurrentSettings()->isTransformConcatenationEnabled()) {
-        hasConcat = tryConcatenateTransforms(args, &transformInputNb, &newInputAfterConcat, &newInputNb, &transformMatrix, &isResultingTransformIdentity);
+        hasConcat = tryConcatenateTransforms(args, nodeHash, &transformInputNb, &newInputAfterConcat, &newInputNb, &transformMatrix, &isResultingTransformIdentity);
     } else {
         hasConcat = false;
     }
@@ -1993,7 +2554,9 @@ EffectInstance::renderRoI(const RenderRoIArgs & args)
     bool createInCache = shouldCacheOutput();
 
     bool isFrameVaryingOrAnimated = isFrameVaryingOrAnimated_Recursive();
-    Natron::ImageKey key = Natron::Image::makeKey(nodeHash, isFrameVaryingOrAnimated, args.time, args.view);
+    ///Effects whose image is the same for all views share their cache entries: the views after the first
+    ///one find the image in the cache instead of rendering the upstream tree again
+    Natron::ImageKey key = Natron::Image::makeKey(nodeHash, isFrameVaryingOrAnimated, args.time, getViewForCache(args.view));
     
     bool useDiskCacheNode = dynamic_cast<DiskCacheNode*>(this) != NULL;
 
@@ -2007,7 +2570,7 @@ EffectInstance::renderRoI(const RenderRoIArgs & args)
         U64 lastRenderHash;
         {
             QMutexLocker l(&_imp->lastRenderArgsMutex);
-            lastRenderedImage = _imp->lastImage;
+            lastRenderedImage = _imp->lastImage.lock();
             lastRenderHash = _imp->lastRenderHash;
         }
         if ( lastRenderedImage && lastRenderHash != nodeHash ) {
@@ -2068,7 +2631,7 @@ EffectInstance::renderRoI(const RenderRoIArgs & args)
     if (image) {
         framesNeeded = cachedImgParams->getFramesNeeded();
     } else {
-        framesNeeded = getFramesNeeded_public(args.time);
+        framesNeeded = getFramesNeeded_public(nodeHash, args.time);
     }
     
     
@@ -2167,7 +2730,10 @@ EffectInstance::renderRoI(const RenderRoIArgs & args)
         image->getRestToRender(roi, rectsToRender);
 #endif
         
-        if (!rectsToRender.empty() && appPTR->isNodeCacheAlmostFull()) {
+        ///The same goes if the images pinned by the tree for this frame already exceed the memory budget of the frame
+        bool frameOverBudget = frameRenderArgs.memoryBudget && frameRenderArgs.memoryBudget->isExceeded();
+        
+        if (!rectsToRender.empty() && (appPTR->isNodeCacheAlmostFull() || frameOverBudget)) {
             ///The node cache is almost full and we need to render  something in the image, if we hold a pointer to this image here
             ///we might recursively end-up in this same situation at each level of the render tree, ending with all images of each level
             ///being held in memory.
@@ -2251,8 +2817,10 @@ EffectInstance::renderRoI(const RenderRoIArgs & args)
     
     ///We hold our input images in thread-storage, so that the getImage function can find them afterwards, even if the node doesn't cache its output.
     boost::shared_ptr<InputImagesHolder_RAII> inputImagesHolder;
+    boost::shared_ptr<FrameMemoryBudgetHolder_RAII> inputImagesBudgetHolder;
     if (!rectsToRender.empty() && !inputImages.empty()) {
         inputImagesHolder.reset(new InputImagesHolder_RAII(inputImages,&_imp->inputImages));
+        inputImagesBudgetHolder.reset(new FrameMemoryBudgetHolder_RAII(frameRenderArgs.memoryBudget,inputImages));
     }
     
     ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -2439,6 +3007,12 @@ EffectInstance::renderRoI(const RenderRoIArgs & args)
                                               );
         }
         
+        ///The render action is the last consumer of the input images: release them now rather than when returning,
+        ///so that they are not pinned while we downscale/convert the output nor while the trimap waits on other threads.
+        inputImagesHolder.reset();
+        inputImagesBudgetHolder.reset();
+        inputImages.clear();
+        
 #if NATRON_ENABLE_TRIMAP
         if (!frameRenderArgs.canAbort && frameRenderArgs.isRenderResponseToUserInteraction) {
             ///Only use trimap system if the render cannot be aborted.
@@ -2487,7 +3061,9 @@ EffectInstance::renderRoI(const RenderRoIArgs & args)
     bool imageConversionNeeded = args.components != downscaledImage->getComponents() || args.bitdepth != downscaledImage->getBitDepth();
     assert( isSupportedBitDepth(outputDepth) && isSupportedComponent(-1, outputComponents) );
     
-    if (imageConversionNeeded && renderRetCode != eRenderRoIStatusRenderFailed) {
+    ///Don't bother converting an image that is going to be thrown away
+    bool skipConversion = renderAborted && !args.calledFromGetImage && renderRetCode != eRenderRoIStatusImageAlreadyRendered;
+    if (imageConversionNeeded && renderRetCode != eRenderRoIStatusRenderFailed && !skipConversion) {
         boost::shared_ptr<Image> tmp( new Image(args.components, rod, downscaledImage->getBounds(), mipMapLevel,downscaledImage->getPixelAspectRatio(), args.bitdepth, false) );
         
         bool unPremultIfNeeded = getOutputPremultiplication() == eImagePremultiplicationPremultiplied;
@@ -2544,7 +3120,7 @@ EffectInstance::renderInputImagesForRoI(bool createImageInCache,
                                         std::list< boost::shared_ptr<Natron::Image> > *inputImages,
                                         RoIMap* inputsRoi)
 {
-    getRegionsOfInterest_public(time, renderMappedScale, rod, canonicalRenderWindow, view,inputsRoi);
+    getRegionsOfInterest_public(nodeHash, time, renderMappedScale, rod, canonicalRenderWindow, view,inputsRoi);
 #ifdef DEBUG
     if (!inputsRoi->empty() && framesNeeded.empty() && !isReader()) {
         qDebug() << getNode()->getName_mt_safe().c_str() << ": getRegionsOfInterestAction returned 1 or multiple input RoI(s) but returned "
@@ -2763,6 +3339,11 @@ EffectInstance::renderRoIInternal(SequenceTime time,
     
     for (std::list<RectI>::const_iterator it = rectsToRender.begin(); it != rectsToRender.end(); ++it) {
         
+        ///The rectangles left are not marked as rendered, renderRoI finds out the render was aborted
+        if ( RenderAbortToken::isCurrentThreadRenderAborted() ) {
+            break;
+        }
+        
         RectI downscaledRectToRender = *it; // please leave it as const, copy it if necessary
 
         ///Upscale the RoI to a region in the full scale image so it is in canonical coordinates
@@ -2884,25 +3465,6 @@ EffectInstance::renderRoIInternal(SequenceTime time,
 
        
 
-        ///We only need to call begin if we've not already called it.
-        bool callBegin = false;
-
-        ///neer call beginsequenceRender here if the render is sequential
-        
-        Natron::SequentialPreferenceEnum pref = getSequentialPreference();
-        if (!isWriter() || pref == eSequentialPreferenceNotSequential) {
-            callBegin = true;
-        }
-
-        if (callBegin) {
-            assert( !( (supportsRenderScaleMaybe() == eSupportsNo) && !(renderMappedScale.x == 1. && renderMappedScale.y == 1.) ) );
-            if (beginSequenceRender_public(time, time, 1, !appPTR->isBackground(), renderMappedScale, isSequentialRender,
-                                           isRenderMadeInResponseToUserInteraction, view) == eStatusFailed) {
-                renderStatus = eStatusFailed;
-                break;
-            }
-        }
-
         /*depending on the thread-safety of the plug-in we render with a different
            amount of threads*/
         EffectInstance::RenderSafetyEnum safety = renderThreadSafety();
@@ -2911,13 +3473,15 @@ EffectInstance::renderRoIInternal(SequenceTime time,
         ///as it would lead to a deadlock when the project is loading.
         ///Just fall back to Fully_safe
         int nbThreads = appPTR->getCurrentSettings()->getNumberOfThreads();
+        const RenderPriorityEnum priority = RenderPriorityScheduler::getCurrentThreadPriority();
         if (safety == eRenderSafetyFullySafeFrame) {
             ///If the plug-in is eRenderSafetyFullySafeFrame that means it wants the host to perform SMP aka slice up the RoI into chunks
             ///but if the effect doesn't support tiles it won't work.
             ///Also check that the number of threads indicating by the settings are appropriate for this render mode.
+            ///Renders of a higher priority in progress get the threads of the pool, @see RenderPriorityScheduler
             if ( !tilesSupported || (nbThreads == -1) || (nbThreads == 1) ||
                 ( (nbThreads == 0) && (appPTR->getHardwareIdealThreadCount() == 1) ) ||
-                 ( QThreadPool::globalInstance()->activeThreadCount() >= QThreadPool::globalInstance()->maxThreadCount() ) ) {
+                 ( RenderPriorityScheduler::getAvailablePoolThreads(priority) == 0 ) ) {
                 safety = eRenderSafetyFullySafe;
             } else {
                 if ( !getApp()->getProject()->tryLock() ) {
@@ -2928,6 +3492,54 @@ EffectInstance::renderRoIInternal(SequenceTime time,
             }
         }
         
+        // eRenderSafetyInstanceSafe means that there is at most one render per instance
+        // NOTE: the per-instance lock should probably be shared between
+        // all clones of the same instance, because an InstanceSafe plugin may assume it is the sole owner of the output image,
+        // and read-write on it.
+        // It is probably safer to assume that several clones may write to the same output image only in the eRenderSafetyFullySafe case.
+
+        // eRenderSafetyFullySafe means that there is only one render per FRAME : the lock is by image and handled in Node.cpp
+        ///locks belongs to an instance)
+        boost::scoped_ptr<QMutexLocker> locker;
+        EffectInstance* renderClone = 0;
+        if (safety == eRenderSafetyInstanceSafe) {
+            ///Render with a free clone of the instance if there is one so that other frames can render concurrently,
+            ///otherwise wait for the instance
+            renderClone = acquireRenderClone();
+            if (!renderClone) {
+                locker.reset( new QMutexLocker( &getNode()->getRenderInstancesSharedMutex() ) );
+            }
+        } else if (safety == eRenderSafetyUnsafe) {
+            const Natron::Plugin* p = _node->getPlugin();
+            assert(p);
+
+            locker.reset( new QMutexLocker( appPTR->getMutexForPlugin(p->getPluginID(), p->getMajorVersion(), p->getMinorVersion()) ) );
+        }
+        ///For eRenderSafetyFullySafe, don't take any lock, the image already has a lock on itself so we're sure it can't be written to by 2 different threads.
+
+        ///The begin and end sequence render actions wrap the render action on the same instance
+        Implementation::ScopedRenderClone scopedClone(&_imp->renderArgs, this, renderClone);
+        EffectInstance* renderInstance = renderClone ? renderClone : this;
+
+        ///We only need to call begin if we've not already called it.
+        bool callBegin = false;
+
+        ///neer call beginsequenceRender here if the render is sequential
+        
+        Natron::SequentialPreferenceEnum pref = getSequentialPreference();
+        if (!isWriter() || pref == eSequentialPreferenceNotSequential) {
+            callBegin = true;
+        }
+
+        if (callBegin) {
+            assert( !( (supportsRenderScaleMaybe() == eSupportsNo) && !(renderMappedScale.x == 1. && renderMappedScale.y == 1.) ) );
+            if (renderInstance->beginSequenceRender_public(time, time, 1, !appPTR->isBackground(), renderMappedScale, isSequentialRender,
+                                                           isRenderMadeInResponseToUserInteraction, view) == eStatusFailed) {
+                renderStatus = eStatusFailed;
+                break;
+            }
+        }
+
         assert(_imp->frameRenderArgs.hasLocalData());
         const ParallelRenderArgs& frameArgs = _imp->frameRenderArgs.localData();
 
@@ -2945,6 +3557,7 @@ EffectInstance::renderRoIInternal(SequenceTime time,
             tiledArgs.inputImages = inputImages;
             tiledArgs.renderUseScaleOneInputs = useScaleOneInputImages;
             tiledArgs.isRenderResponseToUserInteraction = isRenderMadeInResponseToUserInteraction;
+            tiledArgs.priority = priority;
             tiledArgs.downscaledImage = downscaledImage;
             tiledArgs.fullScaleImage = image;
             tiledArgs.renderMappedImage = renderMappedImage;
@@ -2965,10 +3578,10 @@ EffectInstance::renderRoIInternal(SequenceTime time,
 
             if (callBegin) {
                 assert( !( (supportsRenderScaleMaybe() == eSupportsNo) && !(renderMappedScale.x == 1. && renderMappedScale.y == 1.) ) );
-                if (endSequenceRender_public(time, time, time, false, renderMappedScale,
-                                             isSequentialRender,
-                                             isRenderMadeInResponseToUserInteraction,
-                                             view) == eStatusFailed) {
+                if (renderInstance->endSequenceRender_public(time, time, time, false, renderMappedScale,
+                                                             isSequentialRender,
+                                                             isRenderMadeInResponseToUserInteraction,
+                                                             view) == eStatusFailed) {
                     renderStatus = eStatusFailed;
                     break;
                 }
@@ -2991,43 +3604,30 @@ EffectInstance::renderRoIInternal(SequenceTime time,
         case eRenderSafetyInstanceSafe:     // indicating that any instance can have a single 'render' call at any one time,
         case eRenderSafetyFullySafe:        // indicating that any instance of a plugin can have multiple renders running simultaneously
         case eRenderSafetyUnsafe: {     // indicating that only a single 'render' call can be made at any time amoung all instances
-            // eRenderSafetyInstanceSafe means that there is at most one render per instance
-            // NOTE: the per-instance lock should probably be shared between
-            // all clones of the same instance, because an InstanceSafe plugin may assume it is the sole owner of the output image,
-            // and read-write on it.
-            // It is probably safer to assume that several clones may write to the same output image only in the eRenderSafetyFullySafe case.
-
-            // eRenderSafetyFullySafe means that there is only one render per FRAME : the lock is by image and handled in Node.cpp
-            ///locks belongs to an instance)
-
-            QMutexLocker *locker = 0;
-
-            if (safety == eRenderSafetyInstanceSafe) {
-                locker = new QMutexLocker( &getNode()->getRenderInstancesSharedMutex() );
-            } else if (safety == eRenderSafetyUnsafe) {
-                const Natron::Plugin* p = _node->getPlugin();
-                assert(p);
-                
-                locker = new QMutexLocker( appPTR->getMutexForPlugin(p->getPluginID(), p->getMajorVersion(), p->getMinorVersion()) );
-            }
-            ///For eRenderSafetyFullySafe, don't take any lock, the image already has a lock on itself so we're sure it can't be written to by 2 different threads.
-            
-            
             RenderingFunctorRetEnum functorRet = tiledRenderingFunctor(args,
-                                                                   frameArgs,
-                                                                   inputImages,
-                                                                   false,
-                                                                   renderFullScaleThenDownscale,
-                                                                   useScaleOneInputImages,
-                                                                   isSequentialRender,
-                                                                   isRenderMadeInResponseToUserInteraction,
-                                                                   downscaledRectToRender,
-                                                                   par,
-                                                                   downscaledImage,
-                                                                   image,
-                                                                   renderMappedImage);
-
-            delete locker;
+                                                                       frameArgs,
+                                                                       inputImages,
+                                                                       false,
+                                                                       renderFullScaleThenDownscale,
+                                                                       useScaleOneInputImages,
+                                                                       isSequentialRender,
+                                                                       isRenderMadeInResponseToUserInteraction,
+                                                                       downscaledRectToRender,
+                                                                       par,
+                                                                       downscaledImage,
+                                                                       image,
+                                                                       renderMappedImage);
+
+            if (callBegin) {
+                assert( !( (supportsRenderScaleMaybe() == eSupportsNo) && !(renderMappedScale.x == 1. && renderMappedScale.y == 1.) ) );
+                if (renderInstance->endSequenceRender_public(time, time, time, false, renderMappedScale,
+                                                             isSequentialRender,
+                                                             isRenderMadeInResponseToUserInteraction,
+                                                             view) == eStatusFailed) {
+                    renderStatus = eStatusFailed;
+                    break;
+                }
+            }
             
             if (functorRet == eRenderingFunctorRetFailed) {
                 renderStatus = eStatusFailed;
@@ -3065,6 +3665,9 @@ EffectInstance::tiledRenderingFunctor(const TiledRenderingFunctorArgs& args,
                                      bool setThreadLocalStorage,
                                      const RectI & downscaledRectToRender )
 {
+    ///The tile is rendered by a thread of the pool on behalf of the render that split the frame
+    RenderPriorityScope priorityScope(args.priority, true);
+    
     return tiledRenderingFunctor(*args.args,
                                  frameArgs,
                                  args.inputImages,
@@ -3104,6 +3707,12 @@ EffectInstance::tiledRenderingFunctor(const RenderArgs & args,
     }
 #endif
     
+    ///A tile that starts after the frame was aborted has nothing to do: this is what keeps the wait on
+    ///the other tiles in renderRoIInternal short
+    if ( setThreadLocalStorage && frameArgs.abortToken && frameArgs.abortToken->isAborted() ) {
+        return eRenderingFunctorRetOK;
+    }
+    
     const SequenceTime time = args._time;
     int mipMapLevel = downscaledImage->getMipMapLevel();
     const int view = args._view;
@@ -3198,7 +3807,9 @@ EffectInstance::tiledRenderingFunctor(const RenderArgs & args,
                                                                   frameArgs.canAbort,
                                                                   frameArgs.nodeHash,
                                                                   frameArgs.canSetValue,
-                                                                  frameArgs.timeline) );
+                                                                  frameArgs.timeline,
+                                                                  frameArgs.memoryBudget,
+                                                                  frameArgs.abortToken) );
         
         scopedInputImages.reset(new InputImagesHolder_RAII(inputImages,&_imp->inputImages));
     }
@@ -3318,7 +3929,7 @@ EffectInstance::createKnobDynamically()
 void
 EffectInstance::evaluate(KnobI* knob,
                          bool isSignificant,
-                         Natron::ValueChangedReasonEnum /*reason*/)
+                         Natron::ValueChangedReasonEnum reason)
 {
     assert(_node);
 
@@ -3382,10 +3993,12 @@ EffectInstance::evaluate(KnobI* knob,
     for (std::list<ViewerInstance* >::iterator it = viewers.begin();
          it != viewers.end();
          ++it) {
-        if (isSignificant) {
-            (*it)->renderCurrentFrame(true);
-        } else {
+        if (!isSignificant) {
             (*it)->redrawViewer();
+        } else if (reason == Natron::eValueChangedReasonUserEdited) {
+            (*it)->renderCurrentFrameInteractively();
+        } else {
+            (*it)->renderCurrentFrame(true);
         }
     }
 
@@ -3746,6 +4359,20 @@ EffectInstance::render_public(SequenceTime time,
                               boost::shared_ptr<Natron::Image> output)
 {
     NON_RECURSIVE_ACTION();
+    RenderProfilerScope profilerScope(eProfiledActionRender, this, time);
+    
+    EffectInstance* renderClone = 0;
+    if ( _imp->renderArgs.hasLocalData() ) {
+        const RenderArgs & args = _imp->renderArgs.localData();
+        if (args._validArgs) {
+            renderClone = args._renderClone;
+        }
+    }
+    if (renderClone) {
+        ///The knobs of the clone fetch the render time from its own render args
+        Implementation::ScopedRenderArgs cloneArgs(&renderClone->_imp->renderArgs, _imp->renderArgs.localData());
+        return renderClone->render(time, originalScale, mappedScale, roi, view, isSequentialRender, isRenderResponseToUserInteraction, output);
+    }
     return render(time, originalScale, mappedScale, roi, view, isSequentialRender, isRenderResponseToUserInteraction, output);
 
 }
@@ -3777,7 +4404,7 @@ EffectInstance::isIdentity_public(U64 hash,
     unsigned int mipMapLevel = Image::getLevelFromScale(scale.x);
     
     double timeF;
-    bool foundInCache = _imp->actionsCache.getIdentityResult(hash, time, mipMapLevel, inputNb, &timeF);
+    bool foundInCache = _imp->actionsCache.getIdentityResult(hash, time, mipMapLevel, view, inputNb, &timeF);
     if (foundInCache) {
         *inputTime = timeF;
         return *inputNb >= 0 || *inputNb == -2;
@@ -3835,7 +4462,7 @@ EffectInstance::isIdentity_public(U64 hash,
             *inputNb = -1;
             *inputTime = time;
         }
-        _imp->actionsCache.setIdentityResult(time, mipMapLevel, *inputNb, *inputTime);
+        _imp->actionsCache.setIdentityResult(hash, time, mipMapLevel, view, *inputNb, *inputTime);
         return ret;
     }
 }
@@ -3853,7 +4480,7 @@ EffectInstance::getRegionOfDefinition_public(U64 hash,
     }
     
     unsigned int mipMapLevel = Image::getLevelFromScale(scale.x);
-    bool foundInCache = _imp->actionsCache.getRoDResult(hash, time, mipMapLevel, rod);
+    bool foundInCache = _imp->actionsCache.getRoDResult(hash, time, mipMapLevel, view, rod);
     if (foundInCache) {
         *isProjectFormat = false;
         if (rod->isNull()) {
@@ -3882,14 +4509,12 @@ EffectInstance::getRegionOfDefinition_public(U64 hash,
             
             if ( (ret != eStatusOK) && (ret != eStatusReplyDefault) ) {
                 // rod is not valid
-                _imp->actionsCache.invalidateAll(hash);
-                _imp->actionsCache.setRoDResult(time, mipMapLevel, RectD());
+                _imp->actionsCache.setRoDResult(hash, time, mipMapLevel, view, RectD());
                 return ret;
             }
             
             if (rod->isNull()) {
-                _imp->actionsCache.invalidateAll(hash);
-                _imp->actionsCache.setRoDResult(time, mipMapLevel, RectD());
+                _imp->actionsCache.setRoDResult(hash, time, mipMapLevel, view, RectD());
                 return eStatusFailed;
             }
             
@@ -3899,32 +4524,51 @@ EffectInstance::getRegionOfDefinition_public(U64 hash,
         *isProjectFormat = ifInfiniteApplyHeuristic(hash,time, scale, view, rod);
         assert(rod->x1 <= rod->x2 && rod->y1 <= rod->y2);
 
-        _imp->actionsCache.setRoDResult( time, mipMapLevel, *rod);
+        _imp->actionsCache.setRoDResult(hash, time, mipMapLevel, view, *rod);
         return ret;
     }
 }
 
 void
-EffectInstance::getRegionsOfInterest_public(SequenceTime time,
+EffectInstance::getRegionsOfInterest_public(U64 hash,
+                                            SequenceTime time,
                                             const RenderScale & scale,
                                             const RectD & outputRoD, //!< effect RoD in canonical coordinates
                                             const RectD & renderWindow, //!< the region to be rendered in the output image, in Canonical Coordinates
                                             int view,
                                             EffectInstance::RoIMap* ret)
 {
-    NON_RECURSIVE_ACTION();
     assert(outputRoD.x2 >= outputRoD.x1 && outputRoD.y2 >= outputRoD.y1);
     assert(renderWindow.x2 >= renderWindow.x1 && renderWindow.y2 >= renderWindow.y1);
-    getRegionsOfInterest(time, scale, outputRoD, renderWindow, view,ret);
     
+    unsigned int mipMapLevel = Image::getLevelFromScale(scale.x);
+    RoIMap rois;
+    if ( !_imp->actionsCache.getRoIResult(hash, time, mipMapLevel, view, outputRoD, renderWindow, &rois) ) {
+        NON_RECURSIVE_ACTION();
+        getRegionsOfInterest(time, scale, outputRoD, renderWindow, view, &rois);
+        _imp->actionsCache.setRoIResult(hash, time, mipMapLevel, view, outputRoD, renderWindow, rois);
+    }
+    ret->insert( rois.begin(), rois.end() );
 }
 
 EffectInstance::FramesNeededMap
-EffectInstance::getFramesNeeded_public(SequenceTime time)
+EffectInstance::getFramesNeeded_public(U64 hash,
+                                       SequenceTime time)
 {
-    NON_RECURSIVE_ACTION();
+    FramesNeededMap framesNeeded;
+    if ( !_imp->actionsCache.getFramesNeededResult(hash, time, &framesNeeded) ) {
+        NON_RECURSIVE_ACTION();
+        framesNeeded = getFramesNeeded(time);
+        _imp->actionsCache.setFramesNeededResult(hash, time, framesNeeded);
+    }
+
+    return framesNeeded;
+}
 
-    return getFramesNeeded(time);
+void
+EffectInstance::getActionsCacheStatistics(ActionsCacheStatistics* stats) const
+{
+    _imp->actionsCache.getStatistics(stats);
 }
 
 void
@@ -3956,7 +4600,7 @@ EffectInstance::getFrameRange_public(U64 hash,
         
         NON_RECURSIVE_ACTION();
         getFrameRange(first, last);
-        _imp->actionsCache.setTimeDomainResult(*first, *last);
+        _imp->actionsCache.setTimeDomainResult(hash, *first, *last);
     }
 }
 
@@ -4317,8 +4961,8 @@ EffectInstance::onNodeHashChanged(U64 hash)
     ///Always running in the MAIN THREAD
     assert(QThread::currentThread() == qApp->thread());
     
-    ///Invalidate actions cache
-    _imp->actionsCache.invalidateAll(hash);
+    ///Results stored for the previous hashes are kept, the node may come back to one of these states
+    _imp->actionsCache.setCacheHash(hash);
 }
 
 bool
@@ -4370,6 +5014,40 @@ EffectInstance::isFrameVaryingOrAnimated_Recursive() const
     return ret;
 }
 
+static
+void isViewInvariant_impl(const Natron::EffectInstance* node,bool *ret)
+{
+    ///Writers write one file per view
+    if ( node->isViewAware() || node->isWriter() ) {
+        *ret = false;
+    } else {
+        int maxInputs = node->getMaxInputCount();
+        for (int i = 0; i < maxInputs; ++i) {
+            Natron::EffectInstance* input = node->getInput(i);
+            if (input) {
+                isViewInvariant_impl(input,ret);
+                if (!*ret) {
+                    return;
+                }
+            }
+        }
+    }
+}
+
+bool
+EffectInstance::isViewInvariant_Recursive() const
+{
+    bool ret = true;
+    isViewInvariant_impl(this,&ret);
+    return ret;
+}
+
+int
+EffectInstance::getViewForCache(int view) const
+{
+    return isViewInvariant_Recursive() ? NATRON_IMAGE_KEY_ALL_VIEWS : view;
+}
+
 OutputEffectInstance::OutputEffectInstance(boost::shared_ptr<Node> node)
     : Natron::EffectInstance(node)
       , _writerCurrentFrame(0)
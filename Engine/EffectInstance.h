@@ -12,6 +12,7 @@
 #ifndef NATRON_ENGINE_EFFECTINSTANCE_H_
 #define NATRON_ENGINE_EFFECTINSTANCE_H_
 #include <list>
+#include <QMutex>
 #ifndef Q_MOC_RUN
 #include <boost/shared_ptr.hpp>
 #include <boost/scoped_ptr.hpp>
@@ -51,6 +52,82 @@ class BufferableObject;
 namespace Transform {
 struct Matrix3x3;
 }
+namespace Natron {
+class RenderAbortToken;
+}
+
+/**
+ * @brief Running average of the peak memory held by the frames of a render.
+ * Each scheduler owns one so that the number of frames it renders in parallel only depends on its own frames.
+ **/
+class FramePeakAverage
+{
+public:
+
+    FramePeakAverage();
+
+    ///Folds the peak memory held by a frame that is done rendering in the average
+    void addFramePeak(U64 peakBytes);
+
+    ///Returns the average, or 0 if no frame was rendered yet
+    U64 getAverage() const;
+
+    void reset();
+
+private:
+
+    mutable QMutex _lock;
+    U64 _average;
+};
+
+/**
+ * @brief Book-keeping of the images pinned in memory by the tree while rendering a single frame.
+ * An instance is shared by all the nodes and all the threads taking part in the rendering of a frame.
+ * The images held by a node while its render action is running (i.e: its input images) are
+ * accounted for, so that renderRoI can release them early and degrade its caching strategy
+ * when the frame goes over its budget.
+ * The memory given to rendering is shared by all the frames rendering at once, so a frame is over
+ * its budget when it holds more than its share of it.
+ **/
+class FrameMemoryBudget
+{
+public:
+
+    /**
+     * @param peakAverage If not NULL, the peak memory held by the frame is folded in it once the frame is done.
+     **/
+    explicit FrameMemoryBudget(U64 budget,
+                               const boost::shared_ptr<FramePeakAverage>& peakAverage = boost::shared_ptr<FramePeakAverage>());
+
+    ~FrameMemoryBudget();
+
+    void retainBytes(U64 bytes);
+
+    void releaseBytes(U64 bytes);
+
+    ///True if the images currently held by the frame exceed its share of the budget
+    bool isExceeded() const;
+
+    ///The share of the budget of this frame, that is the budget divided by the number of frames rendering at once
+    U64 getBudget() const;
+
+    ///The maximum amount of memory held at once so far by the frame
+    U64 getPeakBytes() const;
+
+    /**
+     * @brief Returns the amount of memory that rendering may use, that is the RAM
+     * that is neither dedicated to the caches nor kept free for other applications.
+     **/
+    static U64 getRenderMemoryBudget();
+
+private:
+
+    mutable QMutex _lock;
+    U64 _budget;
+    boost::shared_ptr<FramePeakAverage> _peakAverage;
+    U64 _heldBytes;
+    U64 _peakBytes;
+};
 
 /**
  * @brief Thread-local arguments given to render a frame by the tree.
@@ -96,6 +173,12 @@ struct ParallelRenderArgs
     ///Can the plug-in call setValue while the action is active
     bool canSetValue;
     
+    ///The memory budget of the frame, shared by all nodes of the tree
+    boost::shared_ptr<FrameMemoryBudget> memoryBudget;
+    
+    ///Flagged once the frame is aborted, shared by all nodes of the tree
+    boost::shared_ptr<Natron::RenderAbortToken> abortToken;
+    
     ParallelRenderArgs()
     : time(0)
     , timeline(0)
@@ -107,6 +190,8 @@ struct ParallelRenderArgs
     , isSequentialRender(false)
     , canAbort(false)
     , canSetValue(false)
+    , memoryBudget()
+    , abortToken()
     {
         
     }
@@ -132,6 +217,30 @@ public:
     typedef std::map<EffectInstance*,RectD> RoIMap; // RoIs are in canonical coordinates
     typedef std::map<int, std::vector<RangeD> > FramesNeededMap;
 
+    ///How many times the results of an action were found in the actions cache (hits) and how many times
+    ///the action had to be called (misses)
+    struct ActionsCacheCounters
+    {
+        U64 hits;
+        U64 misses;
+
+        ActionsCacheCounters()
+            : hits(0)
+              , misses(0)
+        {
+        }
+    };
+
+    struct ActionsCacheStatistics
+    {
+        ActionsCacheCounters regionOfDefinition;
+        ActionsCacheCounters isIdentity;
+        ActionsCacheCounters framesNeeded;
+        ActionsCacheCounters regionsOfInterest;
+        ActionsCacheCounters timeDomain;
+        ActionsCacheCounters transformConcatenation;
+    };
+
     struct RenderRoIArgs
     {
         SequenceTime time; //< the time at which to render
@@ -519,7 +628,9 @@ public:
                                U64 nodeHash,
                                U64 rotoAge,
                                bool canSetValue,
-                               const TimeLine* timeline);
+                               const TimeLine* timeline,
+                               const boost::shared_ptr<FrameMemoryBudget>& memoryBudget,
+                               const boost::shared_ptr<Natron::RenderAbortToken>& abortToken);
 
     /**
      *@returns whether the effect was flagged with canSetValue = true or false
@@ -616,6 +727,26 @@ public:
      **/
     bool isFrameVaryingOrAnimated_Recursive() const;
 
+    /**
+     * @brief Returns whether the output of the effect may differ from one view to another for the same input images,
+     * e.g: an effect that selects or combines the views of its inputs, or that reads a file per view.
+     * Effects are view aware unless they are known to make their image for a view only out of the images of their
+     * inputs for that view: only those are rendered and cached once for all the views of a multi-view project.
+     **/
+    virtual bool isViewAware() const { return true; }
+
+    /**
+     * @brief Returns whether the image of the current node is the same for all views:
+     * neither the node nor the tree upstream is view aware, and the node is not a writer.
+     **/
+    bool isViewInvariant_Recursive() const;
+
+    /**
+     * @brief The view under which the images of the effect rendered for the given view are cached:
+     * NATRON_IMAGE_KEY_ALL_VIEWS if isViewInvariant_Recursive() so that all views share the same images.
+     **/
+    int getViewForCache(int view) const;
+
 protected:
     /**
      * @brief Must fill the image 'output' for the region of interest 'roi' at the given time and
@@ -714,6 +845,22 @@ public:
      **/
     virtual RenderSafetyEnum renderThreadSafety() const WARN_UNUSED_RETURN = 0;
 
+    /**
+     * @brief For eRenderSafetyInstanceSafe effects only: returns another instance of the effect, with the same parameters
+     * values, that no other thread is rendering with. The render action is then called on it instead of this instance
+     * so that several frames can be rendered concurrently without taking the per-instance lock.
+     * Returns NULL if there is no such instance, in which case the caller renders with this instance under the lock.
+     * The instance must be given back with releaseRenderClone once the render action returned.
+     **/
+    virtual Natron::EffectInstance* acquireRenderClone() WARN_UNUSED_RETURN
+    {
+        return NULL;
+    }
+
+    virtual void releaseRenderClone(Natron::EffectInstance* /*clone*/)
+    {
+    }
+
     /*@brief The derived class should query this to abort any long process
        in the engine function.*/
     bool aborted() const WARN_UNUSED_RETURN;
@@ -816,17 +963,24 @@ public:
                                                 RectD* rod,
                                                 bool* isProjectFormat) WARN_UNUSED_RETURN;
 
-    void getRegionsOfInterest_public(SequenceTime time,
+    void getRegionsOfInterest_public(U64 hash,
+                                     SequenceTime time,
                                        const RenderScale & scale,
                                        const RectD & outputRoD,
                                        const RectD & renderWindow, //!< the region to be rendered in the output image, in Canonical Coordinates
                                        int view,
                                       RoIMap* ret);
 
-    FramesNeededMap getFramesNeeded_public(SequenceTime time) WARN_UNUSED_RETURN;
+    FramesNeededMap getFramesNeeded_public(U64 hash,SequenceTime time) WARN_UNUSED_RETURN;
 
     void getFrameRange_public(U64 hash,SequenceTime *first,SequenceTime *last, bool bypasscache = false);
 
+    /**
+     * @brief Returns the hit/miss counters of the cache storing the results of the actions above
+     * since the effect was created.
+     **/
+    void getActionsCacheStatistics(ActionsCacheStatistics* stats) const;
+
     /**
      * @brief Override to initialize the overlay interact. It is called only on the
      * live instance.
@@ -1327,15 +1481,28 @@ private:
      * @param inputTransformNb[out] if this node can concatenate, then it will be set to the input number concatenated
      * @param newInputEffect[out] will be set to the new input upstream replacing the original main input.
      * @param cat[out] the concatenation matrix of all transforms
+     * The result is cached in the actions cache for the given node hash, time, scale and view.
      * @param isResultIdentity[out] if true then the result of all the transforms upstream plus the one of this node is an identity matrix
      * @return True if the nodes has concatenated nodes, false otherwise.
      **/
     bool tryConcatenateTransforms(const RenderRoIArgs& args,
+                                  U64 nodeHash,
                                   int* inputTransformNb,
                                   Natron::EffectInstance** newInputEffect,
                                   int *newInputNbToFetchFrom,
                                   boost::shared_ptr<Transform::Matrix3x3>* cat,
                                   bool* isResultIdentity);
+    
+    /**
+     * @brief Walks the tree upstream to concatenate the transforms, skipping nodes that are disabled or
+     * an identity at the given time. This is called by tryConcatenateTransforms when the result is not cached yet.
+     **/
+    bool tryConcatenateTransformsInternal(const RenderRoIArgs& args,
+                                          int* inputTransformNb,
+                                          Natron::EffectInstance** newInputEffect,
+                                          int *newInputNbToFetchFrom,
+                                          boost::shared_ptr<Transform::Matrix3x3>* cat,
+                                          bool* isResultIdentity);
 
     /**
      * @brief Called by getImage when the thread-storage was not set by the caller thread (mostly because this is a thread that is not
@@ -1375,6 +1542,7 @@ private:
         bool renderUseScaleOneInputs;
         bool isSequentialRender;
         bool isRenderResponseToUserInteraction;
+        Natron::RenderPriorityEnum priority; //< the priority of the render that split the frame in tiles
         double par;
         boost::shared_ptr<Natron::Image>  downscaledImage;
         boost::shared_ptr<Natron::Image>  fullScaleImage;
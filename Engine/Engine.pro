@@ -54,15 +54,21 @@ SOURCES += \
     AppInstance.cpp \
     AppManager.cpp \
     BlockingBackgroundRender.cpp \
+    CacheCodec.cpp \
+    CacheSignalEmitter.cpp \
+    CacheSlabAllocator.cpp \
     Curve.cpp \
     CurveSerialization.cpp \
+    DirectoryScanner.cpp \
     DiskCacheNode.cpp \
+    DraftRenderState.cpp \
     EffectInstance.cpp \
     FileDownloader.cpp \
     FileSystemModel.cpp \
     FrameEntry.cpp \
     FrameKey.cpp \
     FrameParamsSerialization.cpp \
+    FramePrefetcher.cpp \
     Hash64.cpp \
     HistogramCPU.cpp \
     Image.cpp \
@@ -74,10 +80,12 @@ SOURCES += \
     KnobFactory.cpp \
     KnobFile.cpp \
     KnobTypes.cpp \
+    LazyMemory.cpp \
     LibraryBinary.cpp \
     Log.cpp \
     Lut.cpp \
     MemoryFile.cpp \
+    MemoryPressureMonitor.cpp \
     Node.cpp \
     NonKeyParams.cpp \
     NonKeyParamsSerialization.cpp \
@@ -93,10 +101,14 @@ SOURCES += \
     OutputSchedulerThread.cpp \
     Plugin.cpp \
     PluginMemory.cpp \
+    PreviewScheduler.cpp \
     ProcessHandler.cpp \
     Project.cpp \
     ProjectPrivate.cpp \
     ProjectSerialization.cpp \
+    RenderAbortToken.cpp \
+    RenderPriorityScheduler.cpp \
+    RenderProfiler.cpp \
     RotoContext.cpp \
     RotoSerialization.cpp  \
     Settings.cpp \
@@ -109,15 +121,21 @@ SOURCES += \
     ../libs/SequenceParsing/SequenceParsing.cpp
 
 HEADERS += \
+    ActionsCacheVersions.h \
     AppInstance.h \
     AppManager.h \
     BlockingBackgroundRender.h \
     Cache.h \
+    CacheCodec.h \
+    CacheSignalEmitter.h \
+    CacheSlabAllocator.h \
     CacheEntry.h \
     Curve.h \
     CurveSerialization.h \
     CurvePrivate.h \
+    DirectoryScanner.h \
     DiskCacheNode.h \
+    DraftRenderState.h \
     EffectInstance.h \
     FileDownloader.h \
     FileSystemModel.h \
@@ -127,6 +145,7 @@ HEADERS += \
     FrameEntrySerialization.h \
     FrameParams.h \
     FrameParamsSerialization.h \
+    FramePrefetcher.h \
     Hash64.h \
     HistogramCPU.h \
     ImageInfo.h \
@@ -145,11 +164,13 @@ HEADERS += \
     KnobFactory.h \
     KnobFile.h \
     KnobTypes.h \
+    LazyMemory.h \
     LibraryBinary.h \
     Log.h \
     LRUHashTable.h \
     Lut.h \
     MemoryFile.h \
+    MemoryPressureMonitor.h \
     Node.h \
     NodeGuiI.h \
     NonKeyParams.h \
@@ -168,10 +189,14 @@ HEADERS += \
     OverlaySupport.h \
     Plugin.h \
     PluginMemory.h \
+    PreviewScheduler.h \
     ProcessHandler.h \
     Project.h \
     ProjectPrivate.h \
     ProjectSerialization.h \
+    RenderAbortToken.h \
+    RenderPriorityScheduler.h \
+    RenderProfiler.h \
     Rect.h \
     RotoContext.h \
     RotoContextPrivate.h \
@@ -11,6 +11,9 @@
 #include "FileSystemModel.h"
 
 #include <vector>
+#include <list>
+#include <map>
+#include <algorithm>
 
 #include <QtCore/QMutex>
 #include <QtCore/QWaitCondition>
@@ -21,9 +24,12 @@
 #include <QtCore/QDebug>
 #include <QtCore/QUrl>
 #include <QtCore/QMimeData>
+#include <QtCore/QSet>
 
 #include <SequenceParsing.h>
 
+#include "Engine/DirectoryScanner.h"
+
 
 
 static QStringList getSplitPath(const QString& path)
@@ -88,13 +94,17 @@ struct FileSystemItemPrivate
     ///This will be set when the file system model is in sequence mode and this is a file
     boost::shared_ptr<SequenceParsing::SequenceFromFiles> sequence;
     
+    ///Read lazily if they were not known when the item was gathered
     QDateTime dateModified;
     quint64 size;
+    bool hasInfo;
+    QMutex infoMutex; //< protects dateModified, size and hasInfo
+    
     QString fileExtension;
     QString absoluteFilePath;
     
     FileSystemItemPrivate(bool isDir,const QString& filename,const boost::shared_ptr<SequenceParsing::SequenceFromFiles>& sequence,
-                          const QDateTime& dateModified,quint64 size,FileSystemItem* parent)
+                          const QDateTime& dateModified,quint64 size,FileSystemItem* parent,bool hasInfo)
     : parent(parent)
     , children()
     , childrenMutex()
@@ -103,6 +113,8 @@ struct FileSystemItemPrivate
     , sequence(sequence)
     , dateModified(dateModified)
     , size(size)
+    , hasInfo(hasInfo)
+    , infoMutex()
     , fileExtension()
     , absoluteFilePath()
     {
@@ -126,6 +138,34 @@ struct FileSystemItemPrivate
             
         }
     }
+    
+    void fetchInfo()
+    {
+        QMutexLocker l(&infoMutex);
+        if (hasInfo) {
+            return;
+        }
+        hasInfo = true;
+        if (sequence) {
+            ///Estimate the size of the sequence from its first file
+            const std::map<int,SequenceParsing::FileNameContent>& indexes = sequence->getFrameIndexes();
+            QString firstFile;
+            quint64 filesCount = 1;
+            if ( sequence->isSingleFile() || indexes.empty() ) {
+                firstFile = sequence->generateValidSequencePattern().c_str();
+            } else {
+                firstFile = indexes.begin()->second.absoluteFileName().c_str();
+                filesCount = indexes.size();
+            }
+            QFileInfo info(firstFile);
+            dateModified = info.lastModified();
+            size = info.size() * filesCount;
+        } else {
+            QFileInfo info(absoluteFilePath);
+            dateModified = info.lastModified();
+            size = isDir ? 0 : info.size();
+        }
+    }
    
 };
 
@@ -134,8 +174,9 @@ FileSystemItem::FileSystemItem(bool isDir,
                                const boost::shared_ptr<SequenceParsing::SequenceFromFiles>& sequence,
                                const QDateTime& dateModified,
                                quint64 size,
-                               FileSystemItem* parent)
-: _imp(new FileSystemItemPrivate(isDir,filename,sequence,dateModified,size,parent))
+                               FileSystemItem* parent,
+                               bool hasInfo)
+: _imp(new FileSystemItemPrivate(isDir,filename,sequence,dateModified,size,parent,hasInfo))
 {
     
 }
@@ -211,12 +252,14 @@ FileSystemItem::fileExtension() const
 const QDateTime&
 FileSystemItem::getLastModified() const
 {
+    _imp->fetchInfo();
     return _imp->dateModified;
 }
 
 quint64
 FileSystemItem::getSize() const
 {
+    _imp->fetchInfo();
     return _imp->size;
 }
 
@@ -327,6 +370,7 @@ FileSystemModel::FileSystemModel(SortableViewI* view)
 : QAbstractItemModel()
 , _imp(new FileSystemModelPrivate(this,view))
 {
+    QObject::connect(&_imp->gatherer, SIGNAL(childrenGathered(QString)), this, SLOT(onChildrenGatheredByGatherer(QString)));
     QObject::connect(&_imp->gatherer, SIGNAL(directoryLoaded(QString)), this, SLOT(onDirectoryLoadedByGatherer(QString)));
     
     
@@ -902,6 +946,33 @@ FileSystemModelPrivate::populateItem(const boost::shared_ptr<FileSystemItem> &it
     gatherer.fetchDirectory(item);
 }
 
+void
+FileSystemModel::onChildrenGatheredByGatherer(const QString& directory)
+{
+    boost::shared_ptr<FileSystemItem> item = _imp->getItemFromPath(directory);
+    if (!item) {
+        return;
+    }
+    
+    std::vector<boost::shared_ptr<FileSystemItem> > children;
+    _imp->gatherer.takeGatheredChildren(item, &children);
+    if ( children.empty() ) {
+        return;
+    }
+    
+    QModelIndex idx = item == _imp->rootItem ? QModelIndex() : index(item.get(),0);
+    int count = item->childCount();
+    beginInsertRows(idx, count, count + (int)children.size() - 1);
+    for (std::size_t i = 0; i < children.size(); ++i) {
+        item->addChild(children[i]);
+    }
+    endInsertRows();
+    
+    if (directory == _imp->currentRootPath) {
+        emit directoryPartiallyLoaded(directory);
+    }
+}
+
 void
 FileSystemModel::onDirectoryLoadedByGatherer(const QString& directory)
 {
@@ -921,6 +992,7 @@ FileSystemModel::onDirectoryLoadedByGatherer(const QString& directory)
         assert(_imp->watcher);
         
         ///Watch all files in the directory and track changes
+        QStringList paths;
         for (int i = 0; i < item->childCount(); ++i) {
             boost::shared_ptr<FileSystemItem> child = item->childAt(i);
             boost::shared_ptr<SequenceParsing::SequenceFromFiles> sequence = child->getSequence();
@@ -928,21 +1000,24 @@ FileSystemModel::onDirectoryLoadedByGatherer(const QString& directory)
             if (sequence) {
                 ///Add all items in the sequence
                 if (sequence->isSingleFile()) {
-                    _imp->watcher->addPath(sequence->generateValidSequencePattern().c_str());
+                    paths.push_back(sequence->generateValidSequencePattern().c_str());
                 } else {
                     const std::map<int,SequenceParsing::FileNameContent>& indexes = sequence->getFrameIndexes();
                     for (std::map<int,SequenceParsing::FileNameContent>::const_iterator it = indexes.begin();
                          it != indexes.end(); ++it) {
-                        _imp->watcher->addPath(it->second.absoluteFileName().c_str());
+                        paths.push_back(it->second.absoluteFileName().c_str());
                     }
                 }
     
             } else {
-                const QString& absolutePath = child->absoluteFilePath();
-                _imp->watcher->addPath(absolutePath);
+                paths.push_back( child->absoluteFilePath() );
             }
             
         }
+        if ( !paths.isEmpty() ) {
+            ///Adding them at once is much faster than one by one
+            _imp->watcher->addPaths(paths);
+        }
         
         ///Set it to true to prevent it from being re-watched
         _imp->rootPathWatched = true;
@@ -1029,6 +1104,8 @@ FileSystemModelPrivate::getItem(const QModelIndex &index) const
 
 ///////////////////////// FileGathererThread
 
+typedef std::list< std::pair< boost::shared_ptr<FileSystemItem>,boost::shared_ptr<FileSystemItem> > > GatheredChildren;
+
 struct FileGathererThreadPrivate
 {
     FileSystemModel* model;
@@ -1051,6 +1128,10 @@ struct FileGathererThreadPrivate
     boost::shared_ptr<FileSystemItem> requestedItem,itemBeingFetched;
     QMutex requestedDirMutex;
     
+    ///Children gathered that the model did not take yet, with their parent
+    GatheredChildren gatheredChildren;
+    QMutex gatheredChildrenMutex;
+    
     FileGathererThreadPrivate(FileSystemModel* model)
     : model(model)
     , mustQuit(false)
@@ -1067,6 +1148,8 @@ struct FileGathererThreadPrivate
     , requestedItem()
     , itemBeingFetched()
     , requestedDirMutex()
+    , gatheredChildren()
+    , gatheredChildrenMutex()
     {
         
     }
@@ -1208,173 +1291,222 @@ FileGathererThread::run()
     }
 }
 
-static void addChildToItem(FileSystemItem* parent,const boost::shared_ptr<SequenceParsing::SequenceFromFiles>& sequence,
-                           const QFileInfo& info)
+///Number of entries of a directory gathered before they are shown
+#define NATRON_FILE_GATHERER_BATCH_SIZE 2048
+
+namespace {
+///An entry of the directory, or the first file of a sequence, not yet published to the model
+struct GatheredEntry
 {
-    ///Does the child exist already ?
-    QString filename = sequence ? sequence->generateUserFriendlySequencePattern().c_str() : info.fileName();
+    const Natron::DirectoryEntry* entry;
+    boost::shared_ptr<SequenceParsing::SequenceFromFiles> sequence;
+    std::size_t lastBatch; //< last batch in which a file was added to the sequence
+};
+
+typedef std::list<GatheredEntry> GatheredEntries;
+}
+
+static boost::shared_ptr<FileSystemItem> createGatheredChild(FileSystemItem* parent,
+                                                             const GatheredEntry& gathered,
+                                                             QSet<QString>* existingNames)
+{
+    QString filename = gathered.sequence ? gathered.sequence->generateUserFriendlySequencePattern().c_str() : gathered.entry->name;
     
-    bool found = false;
-    for (int j = 0; j < parent->childCount(); ++j) {
-        if (parent->childAt(j)->fileName() == filename) {
-            found = true;
-            break;
-        }
+    ///Does the child exist already ?
+    if ( existingNames->contains(filename) ) {
+        return boost::shared_ptr<FileSystemItem>();
     }
+    existingNames->insert(filename);
     
-    if (!found) {
-        
-        bool isDir = sequence ? false : info.isDir();
-        qint64 size;
-        if (sequence) {
-            size = sequence->getEstimatedTotalSize();
-        } else {
-            size = isDir ? 0 : info.size();
-        }
-
-        
-        ///Create the child
-        boost::shared_ptr<FileSystemItem> child( new FileSystemItem(isDir,
-                                                                    filename,
-                                                                    sequence,
-                                                                    info.lastModified(),
-                                                                    size,
-                                                                    parent) );
-        parent->addChild(child);
-        
+    bool isDir = gathered.sequence ? false : gathered.entry->isDir;
+    quint64 size = 0;
+    if (gathered.entry->hasInfo) {
+        size = gathered.sequence ? gathered.sequence->getEstimatedTotalSize() : gathered.entry->size;
     }
-
+    
+    return boost::shared_ptr<FileSystemItem>( new FileSystemItem(isDir,
+                                                                 filename,
+                                                                 gathered.sequence,
+                                                                 gathered.entry->lastModified,
+                                                                 size,
+                                                                 parent,
+                                                                 gathered.entry->hasInfo) );
 }
 
-typedef std::list< std::pair< boost::shared_ptr<SequenceParsing::SequenceFromFiles> ,QFileInfo > > FileSequences;
-
-#define KERNEL_INCR() \
-    switch (viewOrder) \
-    { \
-        case Qt::AscendingOrder: \
-            ++i; \
-            break; \
-        case Qt::DescendingOrder: \
-            --i; \
-            break; \
-    }
-
 void
 FileGathererThread::gatheringKernel(const boost::shared_ptr<FileSystemItem>& item)
 {
-
-    QDir dir( item->absoluteFilePath() );
+    const QString& directoryPath = item->absoluteFilePath();
     
     Qt::SortOrder viewOrder = _imp->model->sortIndicatorOrder();
     FileSystemModel::Sections sortSection = (FileSystemModel::Sections)_imp->model->sortIndicatorSection();
+    
+    ///Reading the size and date of each file is what makes listing a large directory slow: only do it upfront
+    ///if the view is sorted by them, otherwise the items read them when the view displays them
+    QDir::SortFlags sorting = QDir::Name;
+    bool needsInfo = false;
     switch (sortSection) {
-        case FileSystemModel::Name:
-            dir.setSorting(QDir::Name);
-            break;
         case FileSystemModel::Size:
-            dir.setSorting(QDir::Size);
+            sorting = QDir::Size;
+            needsInfo = true;
             break;
         case FileSystemModel::Type:
-            dir.setSorting(QDir::Type);
+            sorting = QDir::Type;
             break;
         case FileSystemModel::DateModified:
-            dir.setSorting(QDir::Time);
+            sorting = QDir::Time;
+            needsInfo = true;
             break;
         default:
             break;
     }
     
     ///All entries in the directory
-    QFileInfoList all = dir.entryInfoList(_imp->model->filter());
+    Natron::DirectoryEntries all;
+    Natron::listDirectory(directoryPath, _imp->model->filter(), needsInfo, &all);
+    Natron::sortDirectoryEntries(sorting, viewOrder == Qt::DescendingOrder, &all);
     
-    ///List of all possible file sequences in the directory or directories
-    FileSequences sequences;
+    bool sequenceMode = _imp->model->isSequenceModeEnabled();
     
-    int start;
-    int end;
-    switch (viewOrder) {
-        case Qt::AscendingOrder:
-            start = 0;
-            end = all.size();
-            break;
-        case Qt::DescendingOrder:
-            start = all.size() - 1;
-            end = -1;
-            break;
+    ///Children may be published before the whole directory is read, unless a sequence could still grow:
+    ///the files of a sequence are next to each other only when sorted by name
+    bool publishEarly = !sequenceMode || sorting == QDir::Name;
+    
+    QSet<QString> existingNames;
+    for (int i = 0; i < item->childCount(); ++i) {
+        existingNames.insert( item->childAt(i)->fileName() );
     }
     
-    int i = start;
-    while (i != end) {
+    Natron::FileSequenceGrouper grouper(directoryPath, needsInfo);
+    GatheredEntries pending;
+    std::map<SequenceParsing::SequenceFromFiles*,GatheredEntries::iterator> pendingSequences;
+    
+    std::size_t batch = 0;
+    for (std::size_t batchStart = 0; batchStart < all.size(); batchStart += NATRON_FILE_GATHERER_BATCH_SIZE, ++batch) {
         
         ///If we must abort we do it now
         if ( _imp->checkForAbort() ) {
             return;
         }
         
-        if ( all[i].isDir() ) {
-            ///This is a directory
-            sequences.push_back(std::make_pair(boost::shared_ptr<SequenceParsing::SequenceFromFiles>(), all[i]));
-        } else {
-            
-
-            QString filename = all[i].fileName();
-
-            /// If the item does not match the filter regexp set by the user, discard it
-            if ( !_imp->model->isAcceptedByRegexps(filename) ) {
-                KERNEL_INCR();
-                continue;
-            }
-            
-            /// If file sequence fetching is disabled, accept it
-            if ( !_imp->model->isSequenceModeEnabled() ) {
-                sequences.push_back(std::make_pair(boost::shared_ptr<SequenceParsing::SequenceFromFiles>(), all[i]));
-                KERNEL_INCR();
-                continue;
+        std::size_t batchEnd = std::min(all.size(), batchStart + NATRON_FILE_GATHERER_BATCH_SIZE);
+        
+        std::vector<std::size_t> accepted;
+        QStringList fileNames;
+        for (std::size_t i = batchStart; i < batchEnd; ++i) {
+            if ( !all[i].isDir ) {
+                /// If the item does not match the filter regexp set by the user, discard it
+                if ( !_imp->model->isAcceptedByRegexps(all[i].name) ) {
+                    continue;
+                }
+                if (sequenceMode) {
+                    fileNames.push_back(all[i].name);
+                }
             }
-
-            std::string absoluteFilePath = generateChildAbsoluteName(item.get(), filename).toStdString();
-            
-            
-            bool foundMatchingSequence = false;
-            
-            /// If we reach here, this is a valid file and we need to determine if it belongs to another sequence or we need
-            /// to create a new one
-            SequenceParsing::FileNameContent fileContent(absoluteFilePath);
-            
-            ///Note that we use a reverse iterator because we have more chance to find a match in the last recently added entries
-            for (FileSequences::reverse_iterator it = sequences.rbegin(); it != sequences.rend(); ++it) {
-                
-                if ( it->first && it->first->tryInsertFile(fileContent,false) ) {
-                    
-                    foundMatchingSequence = true;
-                    break;
+            accepted.push_back(i);
+        }
+        
+        /// Determine for each file if it belongs to another sequence or we need to create a new one
+        std::vector<boost::shared_ptr<SequenceParsing::SequenceFromFiles> > sequences;
+        std::vector<bool> created;
+        if ( !fileNames.isEmpty() ) {
+            grouper.addFiles(fileNames, &sequences, &created);
+        }
+        
+        std::size_t fileIndex = 0;
+        for (std::size_t i = 0; i < accepted.size(); ++i) {
+            GatheredEntry gathered;
+            gathered.entry = &all[accepted[i]];
+            gathered.lastBatch = batch;
+            if (sequenceMode && !gathered.entry->isDir) {
+                const boost::shared_ptr<SequenceParsing::SequenceFromFiles>& sequence = sequences[fileIndex];
+                bool isNewSequence = created[fileIndex];
+                ++fileIndex;
+                if (!isNewSequence) {
+                    std::map<SequenceParsing::SequenceFromFiles*,GatheredEntries::iterator>::iterator found = pendingSequences.find( sequence.get() );
+                    assert( found != pendingSequences.end() );
+                    found->second->lastBatch = batch;
+                    continue;
                 }
-                
+                gathered.sequence = sequence;
+                pending.push_back(gathered);
+                pendingSequences[sequence.get()] = --pending.end();
+            } else {
+                pending.push_back(gathered);
             }
-            
-            if (!foundMatchingSequence) {
-                
-                boost::shared_ptr<SequenceParsing::SequenceFromFiles> newSequence( new SequenceParsing::SequenceFromFiles(fileContent,true) );
-                sequences.push_back(std::make_pair(newSequence, all[i]));
-
+        }
+        
+        ///Now create the children that can no longer change, in order
+        bool isLastBatch = batchEnd == all.size();
+        std::vector<boost::shared_ptr<FileSystemItem> > children;
+        while ( !pending.empty() ) {
+            const GatheredEntry& gathered = pending.front();
+            if ( !isLastBatch && ( !publishEarly || ( gathered.sequence && (gathered.lastBatch == batch) ) ) ) {
+                break;
             }
-            
+            if (gathered.sequence) {
+                grouper.closeSequence(gathered.sequence);
+                pendingSequences.erase( gathered.sequence.get() );
+            }
+            boost::shared_ptr<FileSystemItem> child = createGatheredChild(item.get(), gathered, &existingNames);
+            if (child) {
+                children.push_back(child);
+            }
+            pending.pop_front();
         }
-        KERNEL_INCR();
+        publishChildren(item, children);
     }
     
-    ///Now iterate through the sequences and create the children as necessary
-    for (FileSequences::iterator it = sequences.begin(); it != sequences.end(); ++it) {
-        addChildToItem(item.get(), it->first, it->second);
+    emit directoryLoaded(directoryPath);
+}
+
+void
+FileGathererThread::publishChildren(const boost::shared_ptr<FileSystemItem>& item,
+                                    const std::vector<boost::shared_ptr<FileSystemItem> >& children)
+{
+    if ( children.empty() ) {
+        return;
+    }
+    {
+        QMutexLocker k(&_imp->gatheredChildrenMutex);
+        for (std::size_t i = 0; i < children.size(); ++i) {
+            _imp->gatheredChildren.push_back( std::make_pair(item, children[i]) );
+        }
+    }
+    emit childrenGathered( item->absoluteFilePath() );
+}
+
+void
+FileGathererThread::takeGatheredChildren(const boost::shared_ptr<FileSystemItem>& item,
+                                         std::vector<boost::shared_ptr<FileSystemItem> >* children)
+{
+    assert(children);
+    QMutexLocker k(&_imp->gatheredChildrenMutex);
+    for (GatheredChildren::iterator it = _imp->gatheredChildren.begin(); it != _imp->gatheredChildren.end();) {
+        if (it->first == item) {
+            children->push_back(it->second);
+            it = _imp->gatheredChildren.erase(it);
+        } else {
+            ++it;
+        }
     }
-    
-    emit directoryLoaded( item->absoluteFilePath() );
 }
 
 void
 FileGathererThread::fetchDirectory(const boost::shared_ptr<FileSystemItem>& item)
 {
     abortGathering();
+    {
+        ///The children of the item the model did not take yet will be gathered again
+        QMutexLocker k(&_imp->gatheredChildrenMutex);
+        for (GatheredChildren::iterator it = _imp->gatheredChildren.begin(); it != _imp->gatheredChildren.end();) {
+            if (it->first == item) {
+                it = _imp->gatheredChildren.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
     {
         QMutexLocker l(&_imp->requestedDirMutex);
         _imp->requestedItem = item;
@@ -10,6 +10,7 @@
 
 #ifndef FILESYSTEMMODEL_H
 #define FILESYSTEMMODEL_H
+#include <vector>
 #ifndef Q_MOC_RUN
 #include <boost/shared_ptr.hpp>
 #include <boost/scoped_ptr.hpp>
@@ -34,12 +35,17 @@ class FileSystemItem
 public:
 
     
+    /**
+     * @param hasInfo If false, dateModified and size are ignored: they are read from the file system
+     * the first time they are requested.
+     **/
     FileSystemItem(bool isDir,
                    const QString& filename,
                    const boost::shared_ptr<SequenceParsing::SequenceFromFiles>& sequence,
                    const QDateTime& dateModified,
                    quint64 size,
-                   FileSystemItem* parent = 0);
+                   FileSystemItem* parent = 0,
+                   bool hasInfo = true);
     
     ~FileSystemItem();
     
@@ -117,8 +123,18 @@ public:
     void fetchDirectory(const boost::shared_ptr<FileSystemItem>& item);
     
     bool isWorking() const;
+    
+    /**
+     * @brief Moves the children gathered for item since the last call to children.
+     * They are not added to item by the gatherer so that the model can notify the views.
+     **/
+    void takeGatheredChildren(const boost::shared_ptr<FileSystemItem>& item,
+                              std::vector<boost::shared_ptr<FileSystemItem> >* children);
 signals:
     
+    ///Emitted when children were gathered for the directory, @see takeGatheredChildren
+    void childrenGathered(QString);
+    
     void directoryLoaded(QString);
     
 
@@ -128,6 +144,9 @@ private:
     
     void gatheringKernel(const boost::shared_ptr<FileSystemItem>& item);
     
+    void publishChildren(const boost::shared_ptr<FileSystemItem>& item,
+                         const std::vector<boost::shared_ptr<FileSystemItem> >& children);
+    
     boost::scoped_ptr<FileGathererThreadPrivate> _imp;
     
 };
@@ -277,6 +296,8 @@ public:
     
 public slots:
     
+    void onChildrenGatheredByGatherer(const QString& directory);
+    
     void onDirectoryLoadedByGatherer(const QString& directory);
     
     void onWatchedDirectoryChanged(const QString& directory);
@@ -287,6 +308,10 @@ signals:
     
     void rootPathChanged(QString);
     
+    ///Emitted each time children of the root path are added while it is being loaded,
+    ///before directoryLoaded is emitted
+    void directoryPartiallyLoaded(QString);
+    
     void directoryLoaded(QString);
     
 private:
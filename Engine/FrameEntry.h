@@ -39,9 +39,8 @@ public:
     FrameEntry(const FrameKey & key,
                const boost::shared_ptr<FrameParams> &  params,
                const Natron::CacheAPI* cache,
-               Natron::StorageModeEnum storage,
-               const std::string & path)
-        : CacheEntryHelper<U8,FrameKey,FrameParams>(key,params,cache,storage,path)
+               Natron::StorageModeEnum storage)
+        : CacheEntryHelper<U8,FrameKey,FrameParams>(key,params,cache,storage)
         , _aborted(false)
         , _abortedMutex()
     {
@@ -75,6 +74,13 @@ public:
         return _data.writable();
     }
 
+    virtual void getCompressionLayout(int* elementSize,
+                                      bool* isFloat) const OVERRIDE FINAL
+    {
+        *elementSize = FrameParams::getBytesPerPixel( _key.getBitDepth() );
+        *isFloat = _key.getBitDepth() == 2; // OpenGLViewerI::eBitDepthFloat
+    }
+
     void setAborted(bool aborted) {
         QMutexLocker k(&_abortedMutex);
         _aborted = aborted;
@@ -27,7 +27,7 @@ public:
                 int bitDepth,
                 int texW,
                 int texH)
-        : NonKeyParams(1,bitDepth != 0 ? texW * texH * 16 : texW * texH * 4)
+        : NonKeyParams(1,texW * texH * getBytesPerPixel(bitDepth))
         , _rod(rod)
     {
     }
@@ -35,6 +35,22 @@ public:
     virtual ~FrameParams()
     {
     }
+    
+    /**
+     * @brief Returns the size of a RGBA pixel of a viewer texture for the given OpenGLViewerI::BitDepthEnum:
+     * 4 bytes for byte textures, 8 bytes for half float textures and 16 bytes for float textures.
+     **/
+    static int getBytesPerPixel(int bitDepth)
+    {
+        switch (bitDepth) {
+            case 0:
+                return 4;
+            case 1:
+                return 8;
+            default:
+                return 16;
+        }
+    }
 
     template<class Archive>
     void serialize(Archive & ar, const unsigned int version);
@@ -0,0 +1,323 @@
+//  Natron
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "FramePrefetcher.h"
+
+#include <algorithm>
+#include <map>
+#include <set>
+#include <vector>
+#include <QMutex>
+#include <QWaitCondition>
+#ifndef Q_MOC_RUN
+#include <boost/shared_ptr.hpp>
+#endif
+
+#include "Engine/AppInstance.h"
+#include "Engine/AppManager.h"
+#include "Engine/EffectInstance.h"
+#include "Engine/Image.h"
+#include "Engine/Node.h"
+#include "Engine/RenderPriorityScheduler.h"
+#include "Engine/Settings.h"
+#include "Engine/TimeLine.h"
+
+using namespace Natron;
+
+namespace {
+///Images read ahead for a frame, and how much memory they use
+struct PrefetchedFrame
+{
+    std::list<boost::shared_ptr<Natron::Image> > images;
+    U64 bytes;
+
+    PrefetchedFrame()
+        : images()
+          , bytes(0)
+    {
+    }
+};
+
+typedef std::map<int,PrefetchedFrame> PrefetchedFrames;
+
+void
+getUpstreamReaders(EffectInstance* effect,
+                   std::set<EffectInstance*>* visited,
+                   std::list<EffectInstance*>* readers)
+{
+    if ( !visited->insert(effect).second ) {
+        return;
+    }
+    if ( effect->isReader() ) {
+        readers->push_back(effect);
+
+        return;
+    }
+    int maxInputs = effect->getMaxInputCount();
+    for (int i = 0; i < maxInputs; ++i) {
+        EffectInstance* input = effect->getInput(i);
+        if (input) {
+            getUpstreamReaders(input, visited, readers);
+        }
+    }
+}
+}
+
+struct FramePrefetcherPrivate
+{
+    Natron::OutputEffectInstance* output;
+
+    mutable QMutex queueMutex; //< protects all fields below
+    QWaitCondition queueCond;
+    std::list<EffectInstance*> readers;
+    std::list<int> queue; //< frames waiting to be read ahead
+    std::set<int> started; //< frames the render threads started rendering, they must not be read ahead anymore
+    PrefetchedFrames prefetched;
+    U64 prefetchedBytes;
+    U64 budget;
+    int view;
+
+    ///Incremented whenever the prefetching is cancelled, so that the prefetcher can tell whether the frame it
+    ///just read is still wanted
+    U64 generation;
+    bool mustQuit;
+
+    FramePrefetcherPrivate(Natron::OutputEffectInstance* output)
+        : output(output)
+          , queueMutex()
+          , queueCond()
+          , readers()
+          , queue()
+          , started()
+          , prefetched()
+          , prefetchedBytes(0)
+          , budget(0)
+          , view(0)
+          , generation(0)
+          , mustQuit(false)
+    {
+    }
+
+    bool isQueuedOrPrefetched(int time) const
+    {
+        ///Private, shouldn't lock
+        assert( !queueMutex.tryLock() );
+
+        return prefetched.find(time) != prefetched.end() || std::find(queue.begin(), queue.end(), time) != queue.end();
+    }
+
+    /**
+     * @brief Waits for a frame to read ahead while there is room in the budget.
+     * Returns false if the thread must quit.
+     **/
+    bool waitForFrame(int* time,
+                      std::list<EffectInstance*>* readersToRender,
+                      int* viewToRender,
+                      U64* currentGeneration)
+    {
+        QMutexLocker k(&queueMutex);
+
+        while ( !mustQuit && ( queue.empty() || readers.empty() || (prefetchedBytes >= budget) ) ) {
+            queueCond.wait(&queueMutex);
+        }
+        if (mustQuit) {
+            return false;
+        }
+        *time = queue.front();
+        queue.pop_front();
+        *readersToRender = readers;
+        *viewToRender = view;
+        *currentGeneration = generation;
+
+        return true;
+    }
+
+    /**
+     * @brief Renders the readers at the given time at full resolution, they end up in the node cache.
+     **/
+    void prefetchFrame(int time,
+                       const std::list<EffectInstance*>& readersToRender,
+                       int viewToRender,
+                       PrefetchedFrame* frame)
+    {
+        RenderScale scale;
+
+        scale.x = scale.y = 1.;
+
+        for (std::list<EffectInstance*>::const_iterator it = readersToRender.begin(); it != readersToRender.end(); ++it) {
+            EffectInstance* reader = *it;
+            U64 hash = reader->getHash();
+            RectD rod;
+            bool isProjectFormat;
+            StatusEnum stat = reader->getRegionOfDefinition_public(hash, time, scale, viewToRender, &rod, &isProjectFormat);
+            if ( (stat == eStatusFailed) || rod.isNull() ) {
+                continue;
+            }
+            ImageComponentsEnum components;
+            ImageBitDepthEnum depth;
+            reader->getPreferredDepthAndComponents(-1, &components, &depth);
+            RectI renderWindow;
+            rod.toPixelEnclosing(0, reader->getPreferredAspectRatio(), &renderWindow);
+
+            Node::ParallelRenderArgsSetter frameRenderArgs(reader->getNode().get(),
+                                                           time,
+                                                           viewToRender,
+                                                           false,
+                                                           false,
+                                                           true,
+                                                           hash,
+                                                           false,
+                                                           output->getApp()->getTimeLine().get());
+            boost::shared_ptr<Image> img;
+            try {
+                img = reader->renderRoI( EffectInstance::RenderRoIArgs(time,
+                                                                       scale,
+                                                                       0,
+                                                                       viewToRender,
+                                                                       false,
+                                                                       renderWindow,
+                                                                       rod,
+                                                                       components,
+                                                                       depth) );
+            } catch (const std::exception &) {
+                ///The render thread will hit the same error and report it
+                continue;
+            }
+            if (img) {
+                frame->images.push_back(img);
+                frame->bytes += img->size();
+            }
+        }
+    }
+};
+
+FramePrefetcher::FramePrefetcher(Natron::OutputEffectInstance* output)
+    : QThread()
+      , _imp( new FramePrefetcherPrivate(output) )
+{
+    setObjectName("FramePrefetcher");
+}
+
+FramePrefetcher::~FramePrefetcher()
+{
+}
+
+void
+FramePrefetcher::beginPrefetching()
+{
+    std::list<EffectInstance*> readers;
+    U64 budget = appPTR->getCurrentSettings()->getReadAheadMemoryBudget();
+
+    if (budget > 0) {
+        std::set<EffectInstance*> visited;
+        getUpstreamReaders(_imp->output, &visited, &readers);
+    }
+
+    {
+        QMutexLocker k(&_imp->queueMutex);
+        ++_imp->generation;
+        _imp->readers = readers;
+        _imp->budget = budget;
+        _imp->view = _imp->output->getApp()->getMainView();
+        _imp->queue.clear();
+        _imp->started.clear();
+        _imp->prefetched.clear();
+        _imp->prefetchedBytes = 0;
+    }
+    if ( !readers.empty() && !isRunning() ) {
+        start();
+    }
+}
+
+void
+FramePrefetcher::setFramesToPrefetch(const std::list<int>& frames)
+{
+    QMutexLocker k(&_imp->queueMutex);
+
+    if ( _imp->readers.empty() ) {
+        return;
+    }
+    _imp->queue.clear();
+    for (std::list<int>::const_iterator it = frames.begin(); it != frames.end(); ++it) {
+        ///When looping, a frame already rendered is rendered again later
+        _imp->started.erase(*it);
+        if ( !_imp->isQueuedOrPrefetched(*it) ) {
+            _imp->queue.push_back(*it);
+        }
+    }
+    _imp->queueCond.wakeOne();
+}
+
+void
+FramePrefetcher::notifyFrameRenderStarted(int time)
+{
+    QMutexLocker k(&_imp->queueMutex);
+
+    if ( _imp->readers.empty() ) {
+        return;
+    }
+    _imp->started.insert(time);
+    _imp->queue.remove(time);
+    PrefetchedFrames::iterator found = _imp->prefetched.find(time);
+    if ( found != _imp->prefetched.end() ) {
+        ///The images stay in the node cache, we just stop accounting for them
+        _imp->prefetchedBytes -= found->second.bytes;
+        _imp->prefetched.erase(found);
+        _imp->queueCond.wakeOne();
+    }
+}
+
+void
+FramePrefetcher::cancelPrefetching()
+{
+    QMutexLocker k(&_imp->queueMutex);
+
+    ++_imp->generation;
+    _imp->readers.clear();
+    _imp->queue.clear();
+    _imp->started.clear();
+    _imp->prefetched.clear();
+    _imp->prefetchedBytes = 0;
+}
+
+void
+FramePrefetcher::quitThread()
+{
+    if ( !isRunning() ) {
+        return;
+    }
+    {
+        QMutexLocker k(&_imp->queueMutex);
+        _imp->mustQuit = true;
+        _imp->queue.clear();
+        _imp->queueCond.wakeOne();
+    }
+    wait();
+}
+
+void
+FramePrefetcher::run()
+{
+    int time;
+    std::list<EffectInstance*> readers;
+    int view;
+    U64 generation;
+
+    while ( _imp->waitForFrame(&time, &readers, &view, &generation) ) {
+        PrefetchedFrame frame;
+        {
+            ///Reading ahead must not slow down the frames being rendered
+            RenderPriorityScope priorityScope(eRenderPriorityBackground);
+            _imp->prefetchFrame(time, readers, view, &frame);
+        }
+
+        QMutexLocker k(&_imp->queueMutex);
+        ///Forget the frame if the render was cancelled or if a render thread already started it in the meantime
+        if ( (generation == _imp->generation) && ( _imp->started.find(time) == _imp->started.end() ) && !frame.images.empty() ) {
+            _imp->prefetchedBytes += frame.bytes;
+            _imp->prefetched[time] = frame;
+        }
+    }
+}
@@ -0,0 +1,74 @@
+//  Natron
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef NATRON_ENGINE_FRAMEPREFETCHER_H_
+#define NATRON_ENGINE_FRAMEPREFETCHER_H_
+
+#include <list>
+#include <QThread>
+#ifndef Q_MOC_RUN
+#include <boost/scoped_ptr.hpp>
+#endif
+#include "Global/Macros.h"
+
+namespace Natron {
+class OutputEffectInstance;
+}
+
+struct FramePrefetcherPrivate;
+
+/**
+ * @brief The thread reading ahead the frames of the readers upstream of an output while it plays back or renders a sequence.
+ * The scheduler of the output tells it which frames it is about to render; the prefetcher then renders the readers at
+ * these frames, at full resolution, into the node cache so that the render threads find them there instead of
+ * waiting for the files to be read.
+ * The images read ahead and not yet picked by a render thread are accounted against a memory budget
+ * (@see Settings::getReadAheadMemoryBudget): once it is reached, the prefetcher waits for the render threads to catch up.
+ **/
+class FramePrefetcher
+    : public QThread
+{
+public:
+
+    FramePrefetcher(Natron::OutputEffectInstance* output);
+
+    virtual ~FramePrefetcher();
+
+    /**
+     * @brief Called when a render starts: finds the readers upstream of the output.
+     * Nothing is read ahead if there is none or if reading ahead is disabled.
+     **/
+    void beginPrefetching();
+
+    /**
+     * @brief The frames the output is going to render next, in the order they will be rendered.
+     * They replace the frames that were waiting to be read ahead.
+     **/
+    void setFramesToPrefetch(const std::list<int>& frames);
+
+    /**
+     * @brief Called when a render thread starts rendering the given frame: it is no longer read ahead and the memory
+     * used by its images is given back to the budget.
+     **/
+    void notifyFrameRenderStarted(int time);
+
+    /**
+     * @brief Drops the frames waiting to be read ahead and those read ahead. This is called when the render is aborted
+     * or stopped: the readers being rendered by the prefetcher are aborted along with the rest of the tree.
+     **/
+    void cancelPrefetching();
+
+    /**
+     * @brief Stops the thread and waits for it to return.
+     **/
+    void quitThread();
+
+private:
+
+    virtual void run() OVERRIDE FINAL;
+    boost::scoped_ptr<FramePrefetcherPrivate> _imp;
+};
+
+#endif // NATRON_ENGINE_FRAMEPREFETCHER_H_
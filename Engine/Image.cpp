@@ -17,6 +17,8 @@
 #endif
 #include "Engine/AppManager.h"
 #include "Engine/Lut.h"
+#include "Engine/RenderAbortToken.h"
+#include "Engine/RenderProfiler.h"
 
 using namespace Natron;
 
@@ -24,8 +26,11 @@ using namespace Natron;
 
 #define PIXEL_UNAVAILABLE 2
 
+///Conversions of large images check every that many rows whether the frame they are part of was aborted
+#define NATRON_IMAGE_ABORT_CHECK_ROWS 16
+
 template <int trimap>
-RectI minimalNonMarkedBbox_internal(const RectI& roi, const RectI& _bounds,const std::vector<char>& _map,
+RectI minimalNonMarkedBbox_internal(const RectI& roi, const RectI& _bounds,const LazyMemory<char>& _map,
                                     bool* isBeingRenderedElsewhere)
 {
     RectI bbox;
@@ -162,7 +167,7 @@ RectI minimalNonMarkedBbox_internal(const RectI& roi, const RectI& _bounds,const
 
 template <int trimap>
 void
-minimalNonMarkedRects_internal(const RectI & roi,const RectI& _bounds, const std::vector<char>& _map,
+minimalNonMarkedRects_internal(const RectI & roi,const RectI& _bounds, const LazyMemory<char>& _map,
                                std::list<RectI>& ret,bool* isBeingRenderedElsewhere)
 {
     RectI bboxM = minimalNonMarkedBbox_internal<trimap>(roi, _bounds, _map, isBeingRenderedElsewhere);
@@ -461,9 +466,8 @@ Natron::Bitmap::getBitmapAt(int x,
 Image::Image(const ImageKey & key,
              const boost::shared_ptr<Natron::ImageParams>& params,
              const Natron::CacheAPI* cache,
-             Natron::StorageModeEnum storage,
-             const std::string & path)
-    : CacheEntryHelper<unsigned char, ImageKey,ImageParams>(key, params, cache,storage,path)
+             Natron::StorageModeEnum storage)
+    : CacheEntryHelper<unsigned char, ImageKey,ImageParams>(key, params, cache,storage)
     , _useBitmap(true)
 {
     _components = params->getComponents();
@@ -475,7 +479,7 @@ Image::Image(const ImageKey & key,
 
 Image::Image(const ImageKey & key,
              const boost::shared_ptr<Natron::ImageParams>& params)
-: CacheEntryHelper<unsigned char, ImageKey,ImageParams>(key, params, NULL,Natron::eStorageModeRAM,std::string())
+: CacheEntryHelper<unsigned char, ImageKey,ImageParams>(key, params, NULL,Natron::eStorageModeRAM)
 , _useBitmap(false)
 {
     _components = params->getComponents();
@@ -511,8 +515,7 @@ Image::Image(ImageComponentsEnum components,
                                                                    components,
                                                                    std::map<int,std::vector<RangeD> >() ) ),
                   NULL,
-                  Natron::eStorageModeRAM,
-                  std::string()
+                  Natron::eStorageModeRAM
                   );
 
     _components = components;
@@ -543,6 +546,14 @@ Image::onMemoryAllocated(bool diskRestoration)
     
 }
 
+void
+Image::getCompressionLayout(int* elementSize,
+                            bool* isFloat) const
+{
+    *elementSize = getComponentsCount() * getSizeOfForBitDepth(_bitDepth);
+    *isFloat = _bitDepth == Natron::eImageBitDepthFloat;
+}
+
 
 ImageKey  
 Image::makeKey(U64 nodeHashKey,
@@ -1811,6 +1822,9 @@ convertToFormatInternal_sameComps(const RectI & renderWindow,
         return;
     }
     for (int y = 0; y < intersection.height(); ++y) {
+        if ( ( (y % NATRON_IMAGE_ABORT_CHECK_ROWS) == 0 ) && RenderAbortToken::isCurrentThreadRenderAborted() ) {
+            return;
+        }
         int start = rand() % intersection.width();
         const SRCPIX* srcPixels = (const SRCPIX*)srcImg.pixelAt(intersection.x1 + start, intersection.y1 + y);
         DSTPIX* dstPixels = (DSTPIX*)dstImg.pixelAt(intersection.x1 + start, intersection.y1 + y);
@@ -1942,6 +1956,10 @@ convertToFormatInternal(const RectI & renderWindow,
     
     for (int y = 0; y < intersection.height(); ++y) {
         
+        if ( ( (y % NATRON_IMAGE_ABORT_CHECK_ROWS) == 0 ) && RenderAbortToken::isCurrentThreadRenderAborted() ) {
+            return;
+        }
+        
         ///Start of the line for error diffusion
         int start = rand() % intersection.width();
         
@@ -2193,6 +2211,8 @@ Image::convertToFormat(const RectI & renderWindow,
                        bool requiresUnpremult,
                        Natron::Image* dstImg) const
 {
+    RenderProfilerScope profilerScope(eProfiledActionConvertImage);
+
     assert( getBounds() == dstImg->getBounds() );
 
     if ( dstImg->getComponents() == getComponents() ) {
@@ -25,6 +25,7 @@ CLANG_DIAG_ON(deprecated)
 #include "Engine/ImageKey.h"
 #include "Engine/ImageParams.h"
 #include "Engine/CacheEntry.h"
+#include "Engine/LazyMemory.h"
 #include "Engine/Rect.h"
 #include "Engine/OutputSchedulerThread.h"
 
@@ -43,7 +44,6 @@ namespace Natron {
             // "identities" images (i.e: images that are just a link to another image). See EffectInstance :
             // "!!!Note that if isIdentity is true it will allocate an empty image object with 0 bytes of data."
             //assert(!rod.isNull());
-            std::fill(_map.begin(), _map.end(), 0);
         }
 
         Bitmap()
@@ -56,9 +56,8 @@ namespace Natron {
         {
             assert(_map.size() == 0);
             _bounds = bounds;
+            ///Starts at 0: only the pages of the bitmap covering the areas rendered are allocated
             _map.resize( _bounds.area() );
-
-            std::fill(_map.begin(), _map.end(), 0);
         }
 
         ~Bitmap()
@@ -97,12 +96,12 @@ namespace Natron {
 
         const char* getBitmap() const
         {
-            return &_map.front();
+            return _map.data();
         }
 
         char* getBitmap()
         {
-            return &_map.front();
+            return _map.data();
         }
 
         const char* getBitmapAt(int x,int y) const;
@@ -114,7 +113,7 @@ namespace Natron {
         
     private:
         RectI _bounds;
-        std::vector<char> _map;
+        LazyMemory<char> _map;
     };
 
     class Image
@@ -125,8 +124,7 @@ namespace Natron {
         Image(const ImageKey & key,
               const boost::shared_ptr<ImageParams> &  params,
               const Natron::CacheAPI* cache,
-              Natron::StorageModeEnum storage,
-              const std::string & path);
+              Natron::StorageModeEnum storage);
         
         
 
@@ -155,6 +153,8 @@ namespace Natron {
 
         virtual void onMemoryAllocated(bool diskRestoration) OVERRIDE FINAL;
 
+        virtual void getCompressionLayout(int* elementSize,bool* isFloat) const OVERRIDE FINAL;
+
         static ImageKey makeKey(U64 nodeHashKey,
                                 bool frameVaryingOrAnimated,
                                 SequenceTime time,
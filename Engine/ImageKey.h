@@ -15,6 +15,10 @@
 
 #include "Engine/KeyHelper.h"
 
+///The view of the keys of images that are the same for all the views of the project,
+///@see EffectInstance::getViewForCache
+#define NATRON_IMAGE_KEY_ALL_VIEWS -1
+
 namespace Natron {
 class ImageKey
         :  public KeyHelper<U64>
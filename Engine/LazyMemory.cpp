@@ -0,0 +1,73 @@
+//  Natron
+//
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "LazyMemory.h"
+
+#include <cstdlib>
+
+#include "Global/Macros.h"
+
+#ifdef __NATRON_WIN32__
+# include <windows.h>
+#else
+# include <sys/mman.h>
+#endif
+
+///Allocations smaller than this come from the heap: the saving would be at most a few pages
+///and mapping memory is a system call
+#define NATRON_LAZY_MEMORY_MAPPING_THRESHOLD (256 * 1024)
+
+namespace Natron {
+
+void*
+allocateLazyMemory(std::size_t bytes,
+                   bool* mapped)
+{
+    assert(mapped);
+    *mapped = false;
+    if (bytes == 0) {
+        return NULL;
+    }
+    if (bytes >= NATRON_LAZY_MEMORY_MAPPING_THRESHOLD) {
+#ifdef __NATRON_WIN32__
+        ///Committed pages are only backed by physical memory when first accessed
+        void* data = VirtualAlloc(NULL, bytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+#else
+        void* data = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1, 0);
+        if (data == MAP_FAILED) {
+            data = NULL;
+        }
+#endif
+        if (data) {
+            *mapped = true;
+
+            return data;
+        }
+    }
+
+    return std::calloc(bytes, 1);
+}
+
+void
+deallocateLazyMemory(void* data,
+                     std::size_t bytes,
+                     bool mapped)
+{
+    if (!data) {
+        return;
+    }
+    if (mapped) {
+#ifdef __NATRON_WIN32__
+        (void)bytes;
+        VirtualFree(data, 0, MEM_RELEASE);
+#else
+        munmap(data, bytes);
+#endif
+    } else {
+        std::free(data);
+    }
+}
+} // namespace Natron
@@ -0,0 +1,174 @@
+//  Natron
+//
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef NATRON_ENGINE_LAZYMEMORY_H_
+#define NATRON_ENGINE_LAZYMEMORY_H_
+
+#include <cstddef>
+#include <cstring>
+#include <cassert>
+#include <algorithm>
+#include <new>
+
+#ifndef Q_MOC_RUN
+#include <boost/utility.hpp>
+#endif
+
+namespace Natron {
+
+/**
+ * @brief Allocates bytes of memory initialized to 0. Large allocations are mapped from the operating system,
+ * which only backs a page with physical memory the first time it is written: until then it reads as 0 and
+ * costs nothing. mapped is set to what must be passed to deallocateLazyMemory.
+ * Returns NULL if the memory could not be allocated.
+ **/
+void* allocateLazyMemory(std::size_t bytes,bool* mapped);
+
+void deallocateLazyMemory(void* data,std::size_t bytes,bool mapped);
+
+/**
+ * @brief A contiguous array of count elements whose pages are only allocated when written.
+ * Pixels of an image that are never rendered, e.g: the parts of the RoD outside of all the RoIs requested
+ * so far, thus never occupy memory even though the image spans its whole RoD. Growing the rendered area of
+ * the image only allocates the pages of the new pixels, without moving or copying those already rendered.
+ * Unlike std::vector the elements are not constructed: DataType must be a POD type for which all bits 0 is 0.
+ **/
+template <typename DataType>
+class LazyMemory
+    : boost::noncopyable
+{
+public:
+
+    LazyMemory()
+        : _data(NULL)
+          , _count(0)
+          , _mapped(false)
+    {
+    }
+
+    explicit LazyMemory(std::size_t count)
+        : _data(NULL)
+          , _count(0)
+          , _mapped(false)
+    {
+        resize(count);
+    }
+
+    ~LazyMemory()
+    {
+        clear();
+    }
+
+    /**
+     * @brief The first min(count,size()) elements are kept, the others are 0.
+     * Throws std::bad_alloc if the memory could not be allocated.
+     **/
+    void resize(std::size_t count)
+    {
+        if (count == _count) {
+            return;
+        }
+        if (count == 0) {
+            clear();
+
+            return;
+        }
+        bool mapped;
+        DataType* data = (DataType*)allocateLazyMemory(count * sizeof(DataType), &mapped);
+        if (!data) {
+            throw std::bad_alloc();
+        }
+        if (_data) {
+            std::memcpy( data, _data, std::min(count, _count) * sizeof(DataType) );
+            deallocateLazyMemory(_data, _count * sizeof(DataType), _mapped);
+        }
+        _data = data;
+        _count = count;
+        _mapped = mapped;
+    }
+
+    ///Frees the memory
+    void clear()
+    {
+        if (_data) {
+            deallocateLazyMemory(_data, _count * sizeof(DataType), _mapped);
+        }
+        _data = NULL;
+        _count = 0;
+        _mapped = false;
+    }
+
+    void swap(LazyMemory & other)
+    {
+        std::swap(_data, other._data);
+        std::swap(_count, other._count);
+        std::swap(_mapped, other._mapped);
+    }
+
+    std::size_t size() const
+    {
+        return _count;
+    }
+
+    bool empty() const
+    {
+        return _count == 0;
+    }
+
+    DataType* data()
+    {
+        return _data;
+    }
+
+    const DataType* data() const
+    {
+        return _data;
+    }
+
+    DataType & front()
+    {
+        assert(_data);
+
+        return *_data;
+    }
+
+    const DataType & front() const
+    {
+        assert(_data);
+
+        return *_data;
+    }
+
+    DataType* begin()
+    {
+        return _data;
+    }
+
+    DataType* end()
+    {
+        return _data + _count;
+    }
+
+    ///Unchecked, like std::vector
+    DataType & operator[](std::size_t i)
+    {
+        return _data[i];
+    }
+
+    const DataType & operator[](std::size_t i) const
+    {
+        return _data[i];
+    }
+
+private:
+
+    DataType* _data;
+    std::size_t _count;
+    bool _mapped; //< the memory was mapped from the operating system
+};
+} // namespace Natron
+
+#endif // NATRON_ENGINE_LAZYMEMORY_H_
@@ -12,6 +12,7 @@
 #include "Lut.h"
 
 #include <cstring> // for memcpy
+#include <vector>
 
 #include "Engine/Rect.h"
 
@@ -37,28 +38,100 @@ o32_host_order = {
     { 0, 1, 2, 3 }
 };
 #define O32_HOST_ORDER (o32_host_order.value)
-static unsigned short
+
+/// Returns the 16 most significant bits of the IEEE-754 representation of f, i.e. the sign, the exponent
+/// and the 7 first bits of the mantissa. This is the index of f in toFunc_hipart_to_uint8xx.
+/// Working on the integer representation instead of a union of shorts makes it independent of the
+/// host endianness, and lets the compiler vectorize the loops in hipart_row.
+static inline unsigned short
 hipart(const float f)
 {
-    union
-    {
-        float f;
-        unsigned short us[2];
-    }
+    U32 bits;
 
-    tmp;
+    std::memcpy( &bits, &f, sizeof(float) );
 
-    tmp.us[0] = tmp.us[1] = 0;
-    tmp.f = f;
+    return (unsigned short)(bits >> 16);
+}
 
-    if (O32_HOST_ORDER == O32_BIG_ENDIAN) {
-        return tmp.us[0];
-    } else if (O32_HOST_ORDER == O32_LITTLE_ENDIAN) {
-        return tmp.us[1];
+/// Computes the table index of W values of the buffer from (distant of inDelta elements), optionally
+/// multiplied by the alpha buffer. This loop does not touch the table at all so it can be vectorized,
+/// the look-ups are then done in a separate pass by lookup_row.
+static void
+hipart_row(const float* from,
+           const float* alpha,
+           int W,
+           int inDelta,
+           unsigned short* indexes)
+{
+    if (!alpha) {
+        for (int i = 0; i < W; ++i) {
+            indexes[i] = hipart(from[i * inDelta]);
+        }
     } else {
-        assert( (O32_HOST_ORDER == O32_LITTLE_ENDIAN) || (O32_HOST_ORDER == O32_BIG_ENDIAN) );
+        for (int i = 0; i < W; ++i) {
+            indexes[i] = hipart(from[i * inDelta] * alpha[i * inDelta]);
+        }
+    }
+}
 
-        return 0;
+/// Encodes W values of the buffer from (distant of inDelta elements), optionally multiplied by the alpha buffer,
+/// to 16 bits. The table entry is picked by the 16 most significant bits of the float and the 16 others interpolate
+/// linearly up to the next entry: there is no data-dependent branch, only 2 gathers.
+static void
+uint16_row(const float* base,
+           const float* slope,
+           const float* from,
+           const float* alpha,
+           int W,
+           int inDelta,
+           unsigned short* to,
+           int outDelta)
+{
+    for (int i = 0; i < W; ++i) {
+        float v = alpha ? from[i * inDelta] * alpha[i * inDelta] : from[i * inDelta];
+        U32 bits;
+        std::memcpy( &bits, &v, sizeof(float) );
+        U32 index = bits >> 16;
+        ///the entries are in [0 - 65535], so is the interpolation between 2 of them
+        to[i * outDelta] = (unsigned short)( base[index] + slope[index] * (float)(bits & 0xffff) + 0.5f );
+    }
+}
+
+/// Gathers W entries of table. Indexes and out may be the same buffer.
+template <typename T>
+static void
+lookup_row(const T* table,
+           const unsigned short* indexes,
+           int W,
+           T* out)
+{
+    for (int i = 0; i < W; ++i) {
+        out[i] = table[indexes[i]];
+    }
+}
+
+/// Applies the error diffusion of the 8-bit conversions on a row of 0-0xff00 values.
+/// The row is processed forward from start then backward from start-1, exactly like the per-pixel
+/// loops did, so the result is bit-exact with the previous implementation.
+static void
+diffuse_row(const unsigned short* values,
+            int W,
+            int start,
+            unsigned char* to,
+            int outDelta)
+{
+    unsigned error = 0x80;
+
+    for (int x = start; x < W; ++x) {
+        error = (error & 0xff) + values[x];
+        assert(error < 0x10000);
+        to[x * outDelta] = (unsigned char)(error >> 8);
+    }
+    error = 0x80;
+    for (int x = start - 1; x >= 0; --x) {
+        error = (error & 0xff) + values[x];
+        assert(error < 0x10000);
+        to[x * outDelta] = (unsigned char)(error >> 8);
     }
 }
 
@@ -97,10 +170,34 @@ index_to_float(const unsigned short i)
     return tmp.f;
 }
 
+/// The 16 bits encoding, as a float in [0 - 65535], of the float whose 16 most significant bits are i and the others 0.
+/// NaN's and infinities are encoded as the largest legal floats of the same sign.
+static float
+hipart_start_to_uint16(toColorSpaceFunctionV1 toFunc,
+                       int i)
+{
+    U32 bits = (U32)i << 16;
+    float f;
+
+    std::memcpy( &f, &bits, sizeof(float) );
+    if ( (i & 0x7f80) == 0x7f80 ) {
+        f = (i & 0x8000) ? -std::numeric_limits<float>::max() : std::numeric_limits<float>::max();
+    }
+    float v = toFunc(f) * 65535.f;
+    if ( !(v > 0.f) ) {
+        return 0.f;
+    } else if (v > 65535.f) {
+        return 65535.f;
+    }
+
+    return v;
+}
+
 ///initialize the singleton
 LutManager LutManager::m_instance = LutManager();
 LutManager::LutManager()
     : luts()
+      , lutsMutex()
 {
 }
 
@@ -109,6 +206,7 @@ LutManager::getLut(const std::string & name,
                    fromColorSpaceFunctionV1 fromFunc,
                    toColorSpaceFunctionV1 toFunc)
 {
+    QMutexLocker l(&LutManager::m_instance.lutsMutex);
     LutsMap::iterator found = LutManager::m_instance.luts.find(name);
 
     if ( found != LutManager::m_instance.luts.end() ) {
@@ -193,7 +291,7 @@ getOffsetsForPacking(PixelPackingEnum format,
 float
 Lut::fromColorSpaceUint8ToLinearFloatFast(unsigned char v) const
 {
-    assert(init_);
+    assert( isInitialized() );
 
     return fromFunc_uint8_to_float[v];
 }
@@ -204,7 +302,7 @@ Lut::fromColorSpaceUint8ToLinearFloatFast(unsigned char v) const
 float
 Lut::toColorSpaceFloatFromLinearFloatFast(float v) const
 {
-    assert(init_);
+    assert( isInitialized() );
 
     return Color::intToFloat<0xff01>(toFunc_hipart_to_uint8xx[hipart(v)]);
 }
@@ -214,7 +312,7 @@ Lut::toColorSpaceFloatFromLinearFloatFast(float v) const
 unsigned char
 Lut::toColorSpaceUint8FromLinearFloatFast(float v) const
 {
-    assert(init_);
+    assert( isInitialized() );
 
     return Color::uint8xxToChar(toFunc_hipart_to_uint8xx[hipart(v)]);
 }
@@ -222,73 +320,82 @@ Lut::toColorSpaceUint8FromLinearFloatFast(float v) const
 unsigned short
 Lut::toColorSpaceUint8xxFromLinearFloatFast(float v) const
 {
-    assert(init_);
+    assert( isInitialized() );
 
     return toFunc_hipart_to_uint8xx[hipart(v)];
 }
 
-// the following only works for increasing LUTs
 unsigned short
 Lut::toColorSpaceUint16FromLinearFloatFast(float v) const
 {
-    assert(init_);
-    // algorithm:
-    // - convert to 8 bits -> val8u
-    // - convert val8u-1, val8u and val8u+1 to float
-    // - interpolate linearly in the right interval
-    unsigned char v8u = toColorSpaceUint8FromLinearFloatFast(v);
-    unsigned char v8u_next, v8u_prev;
-    float v32f_next, v32f_prev;
-    if (v8u == 0) {
-        v8u_prev = 0;
-        v8u_next = 1;
-        v32f_prev = fromColorSpaceUint8ToLinearFloatFast(0);
-        v32f_next = fromColorSpaceUint8ToLinearFloatFast(1);
-    } else if (v8u == 255) {
-        v8u_prev = 254;
-        v8u_next = 255;
-        v32f_prev = fromColorSpaceUint8ToLinearFloatFast(254);
-        v32f_next = fromColorSpaceUint8ToLinearFloatFast(255);
-    } else {
-        float v32f = fromColorSpaceUint8ToLinearFloatFast(v8u);
-        // we suppose the LUT is an increasing func
-        if (v < v32f) {
-            v8u_prev = v8u - 1;
-            v32f_prev = fromColorSpaceUint8ToLinearFloatFast(v8u_prev);
-            v8u_next = v8u;
-            v32f_next = v32f;
-        } else {
-            v8u_prev = v8u;
-            v32f_prev = v32f;
-            v8u_next = v8u + 1;
-            v32f_next = fromColorSpaceUint8ToLinearFloatFast(v8u_next);
-        }
-    }
+    assert( isInitialized() );
+    unsigned short ret;
+
+    uint16_row(toFunc_hipart_to_uint16, toFunc_hipart_to_uint16_slope, &v, NULL, 1, 1, &ret, 1);
 
-    // interpolate linearly
-    return (v8u_prev << 8) + v8u_prev + (v - v32f_prev) * ( ( (v8u_next - v8u_prev) << 8 ) + (v8u_next + v8u_prev) ) / (v32f_next - v32f_prev) + 0.5;
+    return ret;
 }
 
 float
 Lut::fromColorSpaceUint16ToLinearFloatFast(unsigned short v) const
 {
-    assert(init_);
-    // the following is from ImageMagick's quantum.h
-    unsigned char v8u_prev = ( v - (v >> 8) ) >> 8;
-    unsigned char v8u_next = v8u_prev + 1;
-    unsigned short v16u_prev = (v8u_prev << 8) + v8u_prev;
-    unsigned short v16u_next = (v8u_next << 8) + v8u_next;
-    float v32f_prev = fromColorSpaceUint8ToLinearFloatFast(v8u_prev);
-    float v32f_next = fromColorSpaceUint8ToLinearFloatFast(v8u_next);
+    assert( isInitialized() );
 
-    // interpolate linearly
-    return v32f_prev + (v - v16u_prev) * (v32f_next - v32f_prev) / (v16u_next - v16u_prev);
+    return fromFunc_uint16_to_float[v];
+}
+
+void
+Lut::toColorSpaceUint8xxFromLinearFloatFast(const float* from,
+                                            int W,
+                                            int inDelta,
+                                            unsigned short* to) const
+{
+    assert( isInitialized() );
+    hipart_row(from, NULL, W, inDelta, to);
+    lookup_row(toFunc_hipart_to_uint8xx, to, W, to);
+}
+
+void
+Lut::toColorSpaceUint16FromLinearFloatFast(const float* from,
+                                           int W,
+                                           int inDelta,
+                                           unsigned short* to,
+                                           int outDelta) const
+{
+    assert( isInitialized() );
+    uint16_row(toFunc_hipart_to_uint16, toFunc_hipart_to_uint16_slope, from, NULL, W, inDelta, to, outDelta);
+}
+
+void
+Lut::fromColorSpaceUint8ToLinearFloatFast(const unsigned char* from,
+                                          int W,
+                                          int inDelta,
+                                          float* to,
+                                          int outDelta) const
+{
+    assert( isInitialized() );
+    for (int i = 0; i < W; ++i) {
+        to[i * outDelta] = fromFunc_uint8_to_float[from[i * inDelta]];
+    }
+}
+
+void
+Lut::fromColorSpaceUint16ToLinearFloatFast(const unsigned short* from,
+                                           int W,
+                                           int inDelta,
+                                           float* to,
+                                           int outDelta) const
+{
+    assert( isInitialized() );
+    for (int i = 0; i < W; ++i) {
+        to[i * outDelta] = fromColorSpaceUint16ToLinearFloatFast(from[i * inDelta]);
+    }
 }
 
 void
 Lut::fillTables() const
 {
-    if (init_) {
+    if ( isInitialized() ) {
         return;
     }
     // fill all
@@ -308,6 +415,25 @@ Lut::fillTables() const
         int i = hipart(f);
         toFunc_hipart_to_uint8xx[i] = Color::charToUint8xx(b);
     }
+    // fill fromFunc_uint16_to_float. Every 257th entry corresponds to a byte value
+    // and is taken from fromFunc_uint8_to_float, so that 8 and 16 bits
+    // conversions of the same value are consistent.
+    for (int i = 0; i < 0x10000; ++i) {
+        fromFunc_uint16_to_float[i] = (i % 0x101 == 0) ? fromFunc_uint8_to_float[i / 0x101] : _fromFunc( Color::intToFloat<0x10000>(i) );
+    }
+    // fill the 16 bits encoding tables: the encoding of the floats starting each range of 2^16 floats
+    // sharing the same 16 most significant bits, and the slope up to the start of the next range
+    for (int i = 0; i < 0x10000; ++i) {
+        toFunc_hipart_to_uint16[i] = hipart_start_to_uint16(_toFunc, i);
+    }
+    for (int i = 0; i < 0x10000; ++i) {
+        ///the largest positive and negative ranges have no next range
+        if ( (i == 0x7fff) || (i == 0xffff) ) {
+            toFunc_hipart_to_uint16_slope[i] = 0.f;
+        } else {
+            toFunc_hipart_to_uint16_slope[i] = (toFunc_hipart_to_uint16[i + 1] - toFunc_hipart_to_uint16[i]) / 65536.f;
+        }
+    }
 }
 
 void
@@ -318,57 +444,27 @@ Lut::to_byte_planar(unsigned char* to,
                     int inDelta,
                     int outDelta) const
 {
+    if (W <= 0) {
+        return;
+    }
     validate();
-    unsigned char *end = to + W * outDelta;
     int start = rand() % W;
-    const float *q;
-    unsigned char *p;
-    unsigned error;
-    if (!alpha) {
-        /* go fowards from starting point to end of line: */
-        error = 0x80;
-        for (p = to + start * outDelta, q = from + start * inDelta; p < end; p += outDelta, q += inDelta) {
-            error = (error & 0xff) + toFunc_hipart_to_uint8xx[hipart(*q)];
-            *p = (unsigned char)(error >> 8);
-        }
-        /* go backwards from starting point to start of line: */
-        error = 0x80;
-        for (p = to + (start - 1) * outDelta, q = from + start * inDelta; p >= to; p -= outDelta) {
-            q -= inDelta;
-            error = (error & 0xff) + toFunc_hipart_to_uint8xx[hipart(*q)];
-            *p = (unsigned char)(error >> 8);
-        }
-    } else {
-        const float *a = alpha;
-        /* go fowards from starting point to end of line: */
-        error = 0x80;
-        for (p = to + start * outDelta, q = from + start * inDelta, a += start * inDelta; p < end; p += outDelta, q += inDelta, a += inDelta) {
-            const float v = *q * *a;
-            error = (error & 0xff) + toFunc_hipart_to_uint8xx[hipart(v)];
-            ++a;
-            *p = (unsigned char)(error >> 8);
-        }
-        /* go backwards from starting point to start of line: */
-        error = 0x80;
-        for (p = to + (start - 1) * outDelta, q = from + start * inDelta, a = alpha + start * inDelta; p >= to; p -= outDelta) {
-            const float v = *q * *a;
-            q -= inDelta;
-            q -= inDelta;
-            error = (error & 0xff) + toFunc_hipart_to_uint8xx[hipart(v)];
-            *p = (unsigned char)(error >> 8);
-        }
-    }
+    std::vector<unsigned short> values(W);
+    hipart_row(from, alpha, W, inDelta, &values.front());
+    lookup_row(toFunc_hipart_to_uint8xx, &values.front(), W, &values.front());
+    diffuse_row(&values.front(), W, start, to, outDelta);
 }
 
 void
-Lut::to_short_planar(unsigned short* /*to*/,
-                     const float* /*from*/,
-                     int /*W*/,
-                     const float* /*alpha*/,
-                     int /*inDelta*/,
-                     int /*outDelta*/) const
+Lut::to_short_planar(unsigned short* to,
+                     const float* from,
+                     int W,
+                     const float* alpha,
+                     int inDelta,
+                     int outDelta) const
 {
-    throw std::runtime_error("Lut::to_short_planar not implemented yet.");
+    validate();
+    uint16_row(toFunc_hipart_to_uint16, toFunc_hipart_to_uint16_slope, from, alpha, W, inDelta, to, outDelta);
 }
 
 void
@@ -423,10 +519,14 @@ Lut::to_byte_packed(unsigned char* to,
 
     validate();
 
+    ///Each row is converted in 3 passes: compute the table indexes of a whole channel, gather the table
+    ///entries, then run the (inherently sequential) error diffusion on the gathered values.
+    const int width = rect.x2 - rect.x1;
+    const float* premultAlpha = NULL;
+    std::vector<unsigned short> values(width);
+
     for (int y = rect.y1; y < rect.y2; ++y) {
-        int start = rand() % (rect.x2 - rect.x1) + rect.x1;
-        unsigned error_r, error_g, error_b;
-        error_r = error_g = error_b = 0x80;
+        int start = rand() % width;
         int srcY = y;
         if (!invertY) {
             srcY = srcBounds.y2 - y - 1;
@@ -434,57 +534,90 @@ Lut::to_byte_packed(unsigned char* to,
 
 
         int dstY = dstBounds.y2 - y - 1;
-        const float *src_pixels = from + (srcY * (srcBounds.x2 - srcBounds.x1) * inPackingSize);
-        unsigned char *dst_pixels = to + (dstY * (dstBounds.x2 - dstBounds.x1) * outPackingSize);
-        /* go fowards from starting point to end of line: */
-        for (int x = start; x < rect.x2; ++x) {
-            int inCol = x * inPackingSize;
-            int outCol = x * outPackingSize;
-            float a = (inputHasAlpha && premult) ? src_pixels[inCol + inAOffset] : 1.f;
-            error_r = (error_r & 0xff) + toFunc_hipart_to_uint8xx[hipart(src_pixels[inCol + inROffset] * a)];
-            error_g = (error_g & 0xff) + toFunc_hipart_to_uint8xx[hipart(src_pixels[inCol + inGOffset] * a)];
-            error_b = (error_b & 0xff) + toFunc_hipart_to_uint8xx[hipart(src_pixels[inCol + inBOffset] * a)];
-            assert(error_r < 0x10000 && error_g < 0x10000 && error_b < 0x10000);
-            dst_pixels[outCol + outROffset] = (unsigned char)(error_r >> 8);
-            dst_pixels[outCol + outGOffset] = (unsigned char)(error_g >> 8);
-            dst_pixels[outCol + outBOffset] = (unsigned char)(error_b >> 8);
-            if (outputHasAlpha) {
-                dst_pixels[outCol + outAOffset] = floatToInt<256>(a);
-            }
+        const float *src_pixels = from + (srcY * (srcBounds.x2 - srcBounds.x1) * inPackingSize) + rect.x1 * inPackingSize;
+        unsigned char *dst_pixels = to + (dstY * (dstBounds.x2 - dstBounds.x1) * outPackingSize) + rect.x1 * outPackingSize;
+        if (inputHasAlpha && premult) {
+            premultAlpha = src_pixels + inAOffset;
         }
-        /* go backwards from starting point to start of line: */
-        error_r = error_g = error_b = 0x80;
-        for (int x = start - 1; x >= rect.x1; --x) {
-            int inCol = x * inPackingSize;
-            int outCol = x * outPackingSize;
-            float a = (inputHasAlpha && premult) ? src_pixels[inCol + inAOffset] : 1.f;
-            error_r = (error_r & 0xff) + toFunc_hipart_to_uint8xx[hipart(src_pixels[inCol + inROffset] * a)];
-            error_g = (error_g & 0xff) + toFunc_hipart_to_uint8xx[hipart(src_pixels[inCol + inGOffset] * a)];
-            error_b = (error_b & 0xff) + toFunc_hipart_to_uint8xx[hipart(src_pixels[inCol + inBOffset] * a)];
-            assert(error_r < 0x10000 && error_g < 0x10000 && error_b < 0x10000);
-            dst_pixels[outCol + outROffset] = (unsigned char)(error_r >> 8);
-            dst_pixels[outCol + outGOffset] = (unsigned char)(error_g >> 8);
-            dst_pixels[outCol + outBOffset] = (unsigned char)(error_b >> 8);
-            if (outputHasAlpha) {
-                dst_pixels[outCol + outAOffset] = floatToInt<256>(a);
+
+        const int inOffsets[3] = { inROffset, inGOffset, inBOffset };
+        const int outOffsets[3] = { outROffset, outGOffset, outBOffset };
+        for (int c = 0; c < 3; ++c) {
+            hipart_row(src_pixels + inOffsets[c], premultAlpha, width, inPackingSize, &values.front());
+            lookup_row(toFunc_hipart_to_uint8xx, &values.front(), width, &values.front());
+            diffuse_row(&values.front(), width, start, dst_pixels + outOffsets[c], outPackingSize);
+        }
+        if (outputHasAlpha) {
+            for (int x = 0; x < width; ++x) {
+                float a = premultAlpha ? premultAlpha[x * inPackingSize] : 1.f;
+                dst_pixels[x * outPackingSize + outAOffset] = floatToInt<256>(a);
             }
         }
     }
 } // to_byte_packed
 
 void
-Lut::to_short_packed(unsigned short* /*to*/,
-                     const float* /*from*/,
-                     const RectI & /*conversionRect*/,
-                     const RectI & /*srcBounds*/,
-                     const RectI & /*dstBounds*/,
-                     PixelPackingEnum /*inputPacking*/,
-                     PixelPackingEnum /*outputPacking*/,
-                     bool /*invertY*/,
-                     bool /*premult*/) const
+Lut::to_short_packed(unsigned short* to,
+                     const float* from,
+                     const RectI & conversionRect,
+                     const RectI & srcBounds,
+                     const RectI & dstBounds,
+                     PixelPackingEnum inputPacking,
+                     PixelPackingEnum outputPacking,
+                     bool invertY,
+                     bool premult) const
 {
-    throw std::runtime_error("Lut::to_short_packed not implemented yet.");
-}
+    ///clip the conversion rect to srcBounds and dstBounds
+    RectI rect = conversionRect;
+
+    if ( !clip(&rect,srcBounds) || !clip(&rect,dstBounds) ) {
+        return;
+    }
+
+    bool inputHasAlpha = inputPacking == ePixelPackingBGRA || inputPacking == ePixelPackingRGBA;
+    bool outputHasAlpha = outputPacking == ePixelPackingBGRA || outputPacking == ePixelPackingRGBA;
+    int inROffset, inGOffset, inBOffset, inAOffset;
+    int outROffset, outGOffset, outBOffset, outAOffset;
+    getOffsetsForPacking(inputPacking, &inROffset, &inGOffset, &inBOffset, &inAOffset);
+    getOffsetsForPacking(outputPacking, &outROffset, &outGOffset, &outBOffset, &outAOffset);
+
+    int inPackingSize,outPackingSize;
+    inPackingSize = inputHasAlpha ? 4 : 3;
+    outPackingSize = outputHasAlpha ? 4 : 3;
+
+    validate();
+
+    ///Each channel of a row is encoded in one branch-free pass, @see uint16_row
+    const int width = rect.x2 - rect.x1;
+    const float* premultAlpha = NULL;
+
+    for (int y = rect.y1; y < rect.y2; ++y) {
+        int srcY = y;
+        if (invertY) {
+            srcY = srcBounds.y2 - y - 1;
+        }
+
+        int dstY = dstBounds.y2 - y - 1;
+        const float *src_pixels = from + (srcY * (srcBounds.x2 - srcBounds.x1) * inPackingSize) + rect.x1 * inPackingSize;
+        unsigned short *dst_pixels = to + (dstY * (dstBounds.x2 - dstBounds.x1) * outPackingSize) + rect.x1 * outPackingSize;
+        if (inputHasAlpha && premult) {
+            premultAlpha = src_pixels + inAOffset;
+        }
+
+        const int inOffsets[3] = { inROffset, inGOffset, inBOffset };
+        const int outOffsets[3] = { outROffset, outGOffset, outBOffset };
+        for (int c = 0; c < 3; ++c) {
+            uint16_row(toFunc_hipart_to_uint16, toFunc_hipart_to_uint16_slope, src_pixels + inOffsets[c], premultAlpha,
+                       width, inPackingSize, dst_pixels + outOffsets[c], outPackingSize);
+        }
+        if (outputHasAlpha) {
+            for (int x = 0; x < width; ++x) {
+                float a = premultAlpha ? premultAlpha[x * inPackingSize] : 1.f;
+                dst_pixels[x * outPackingSize + outAOffset] = floatToInt<65536>(a);
+            }
+        }
+    }
+} // to_short_packed
 
 void
 Lut::to_float_packed(float* to,
@@ -552,7 +685,7 @@ Lut::from_byte_planar(float* to,
     validate();
     if (!alpha) {
         for (int f = 0,t = 0; f < W; f += inDelta, t += outDelta) {
-            to[f] = fromFunc_uint8_to_float[(int)from[f]];
+            to[t] = fromFunc_uint8_to_float[(int)from[f]];
         }
     } else {
         for (int f = 0,t = 0; f < W; f += inDelta, t += outDelta) {
@@ -562,14 +695,22 @@ Lut::from_byte_planar(float* to,
 }
 
 void
-Lut::from_short_planar(float* /*to*/,
-                       const unsigned short* /*from*/,
-                       int /*W*/,
-                       const unsigned short*/* alpha*/,
-                       int /*inDelta*/,
-                       int /* outDelta*/) const
+Lut::from_short_planar(float* to,
+                       const unsigned short* from,
+                       int W,
+                       const unsigned short* alpha,
+                       int inDelta,
+                       int outDelta) const
 {
-    throw std::runtime_error("Lut::from_short_planar not implemented yet.");
+    validate();
+    if (!alpha) {
+        fromColorSpaceUint16ToLinearFloatFast(from, W, inDelta, to, outDelta);
+    } else {
+        for (int i = 0; i < W; ++i) {
+            float a = Color::intToFloat<65536>(alpha[i * inDelta]);
+            to[i * outDelta] = a <= 0. ? 0. : fromColorSpaceFloatToLinearFloat(Color::intToFloat<65536>(from[i * inDelta]) / a) * a;
+        }
+    }
 }
 
 void
@@ -672,18 +813,81 @@ Lut::from_byte_packed(float* to,
 } // from_byte_packed
 
 void
-Lut::from_short_packed(float* /*to*/,
-                       const unsigned short* /*from*/,
-                       const RectI & /*conversionRect*/,
-                       const RectI & /*srcBounds*/,
-                       const RectI & /*dstBounds*/,
-                       PixelPackingEnum /*inputPacking*/,
-                       PixelPackingEnum /*outputPacking*/,
-                       bool /*invertY*/,
-                       bool /*premult*/) const
+Lut::from_short_packed(float* to,
+                       const unsigned short* from,
+                       const RectI & conversionRect,
+                       const RectI & srcBounds,
+                       const RectI & dstBounds,
+                       PixelPackingEnum inputPacking,
+                       PixelPackingEnum outputPacking,
+                       bool invertY,
+                       bool premult) const
 {
-    throw std::runtime_error("Lut::from_short_packed not implemented yet.");
-}
+    if ( ( inputPacking == ePixelPackingPLANAR) || ( outputPacking == ePixelPackingPLANAR) ) {
+        throw std::runtime_error("Invalid pixel format.");
+    }
+
+    ///clip the conversion rect to srcBounds and dstBounds
+    RectI rect = conversionRect;
+    if ( !clip(&rect,srcBounds) || !clip(&rect,dstBounds) ) {
+        return;
+    }
+
+
+    bool inputHasAlpha = inputPacking == ePixelPackingBGRA || inputPacking == ePixelPackingRGBA;
+    bool outputHasAlpha = outputPacking == ePixelPackingBGRA || outputPacking == ePixelPackingRGBA;
+    int inROffset, inGOffset, inBOffset, inAOffset;
+    int outROffset, outGOffset, outBOffset, outAOffset;
+    getOffsetsForPacking(inputPacking, &inROffset, &inGOffset, &inBOffset, &inAOffset);
+    getOffsetsForPacking(outputPacking, &outROffset, &outGOffset, &outBOffset, &outAOffset);
+
+    int inPackingSize,outPackingSize;
+    inPackingSize = inputHasAlpha ? 4 : 3;
+    outPackingSize = outputHasAlpha ? 4 : 3;
+
+    validate();
+    for (int y = rect.y1; y < rect.y2; ++y) {
+        int srcY = y;
+        if (invertY) {
+            srcY = srcBounds.y2 - y - 1;
+        }
+
+        const unsigned short *src_pixels = from + (srcY * (srcBounds.x2 - srcBounds.x1) * inPackingSize);
+        float *dst_pixels = to + (y * (dstBounds.x2 - dstBounds.x1) * outPackingSize);
+        if (!inputHasAlpha || !premult) {
+            const int inOffsets[3] = { inROffset, inGOffset, inBOffset };
+            const int outOffsets[3] = { outROffset, outGOffset, outBOffset };
+            for (int c = 0; c < 3; ++c) {
+                fromColorSpaceUint16ToLinearFloatFast(src_pixels + rect.x1 * inPackingSize + inOffsets[c], rect.x2 - rect.x1, inPackingSize,
+                                                      dst_pixels + rect.x1 * outPackingSize + outOffsets[c], outPackingSize);
+            }
+            if (outputHasAlpha) {
+                for (int x = rect.x1; x < rect.x2; ++x) {
+                    dst_pixels[x * outPackingSize + outAOffset] = inputHasAlpha ?
+                                                                  Color::intToFloat<65536>(src_pixels[x * inPackingSize + inAOffset]) : 1.f;
+                }
+            }
+        } else {
+            for (int x = rect.x1; x < rect.x2; ++x) {
+                int inCol = x * inPackingSize;
+                int outCol = x * outPackingSize;
+                float rf = 0., gf = 0., bf = 0.;
+                float a = Color::intToFloat<65536>(src_pixels[inCol + inAOffset]);
+                if (a > 0) {
+                    rf = Color::intToFloat<65536>(src_pixels[inCol + inROffset]) / a;
+                    gf = Color::intToFloat<65536>(src_pixels[inCol + inGOffset]) / a;
+                    bf = Color::intToFloat<65536>(src_pixels[inCol + inBOffset]) / a;
+                }
+                dst_pixels[outCol + outROffset] = fromColorSpaceUint16ToLinearFloatFast( Color::floatToInt<65536>(rf) ) * a;
+                dst_pixels[outCol + outGOffset] = fromColorSpaceUint16ToLinearFloatFast( Color::floatToInt<65536>(gf) ) * a;
+                dst_pixels[outCol + outBOffset] = fromColorSpaceUint16ToLinearFloatFast( Color::floatToInt<65536>(bf) ) * a;
+                if (outputHasAlpha) {
+                    dst_pixels[outCol + outAOffset] = a;
+                }
+            }
+        }
+    }
+} // from_short_packed
 
 void
 Lut::from_float_packed(float* to,
@@ -852,16 +1056,58 @@ from_byte_packed(float *to,
 }
 
 void
-from_short_packed(float */*to*/,
-                  const unsigned short */*from*/,
-                  const RectI & /*rect*/,
-                  const RectI & /*srcRod*/,
-                  const RectI & /*rod*/,
-                  PixelPackingEnum /*inputFormat*/,
-                  PixelPackingEnum /*format*/,
-                  bool /*invertY*/)
+from_short_packed(float *to,
+                  const unsigned short *from,
+                  const RectI &conversionRect,
+                  const RectI &srcBounds,
+                  const RectI &dstBounds,
+                  PixelPackingEnum inputPacking,
+                  PixelPackingEnum outputPacking,
+                  bool invertY)
 {
-    throw std::runtime_error("Linear::from_short_packed not yet implemented.");
+    if ( ( inputPacking == ePixelPackingPLANAR) || ( outputPacking == ePixelPackingPLANAR) ) {
+        throw std::runtime_error("Invalid pixel format.");
+    }
+
+    ///clip the conversion rect to srcBounds and dstBounds
+    RectI rect = conversionRect;
+    if ( !clip(&rect,srcBounds) || !clip(&rect,dstBounds) ) {
+        return;
+    }
+
+
+    bool inputHasAlpha = inputPacking == ePixelPackingBGRA || inputPacking == ePixelPackingRGBA;
+    bool outputHasAlpha = outputPacking == ePixelPackingBGRA || outputPacking == ePixelPackingRGBA;
+    int inROffset, inGOffset, inBOffset, inAOffset;
+    int outROffset, outGOffset, outBOffset, outAOffset;
+    getOffsetsForPacking(inputPacking, &inROffset, &inGOffset, &inBOffset, &inAOffset);
+    getOffsetsForPacking(outputPacking, &outROffset, &outGOffset, &outBOffset, &outAOffset);
+
+
+    int inPackingSize,outPackingSize;
+    inPackingSize = inputHasAlpha ? 4 : 3;
+    outPackingSize = outputHasAlpha ? 4 : 3;
+
+
+    for (int y = rect.y1; y < rect.y2; ++y) {
+        int srcY = y;
+        if (invertY) {
+            srcY = srcBounds.y2 - y - 1;
+        }
+        const unsigned short *src_pixels = from + (srcY * (srcBounds.x2 - srcBounds.x1) * inPackingSize);
+        float *dst_pixels = to + (y * (dstBounds.x2 - dstBounds.x1) * outPackingSize);
+        for (int x = rect.x1; x < rect.x2; ++x) {
+            int inCol = x * inPackingSize;
+            int outCol = x * outPackingSize;
+            unsigned short a = inputHasAlpha ? src_pixels[inCol + inAOffset] : 65535;
+            dst_pixels[outCol + outROffset] = Color::intToFloat<65536>(src_pixels[inCol + inROffset]);
+            dst_pixels[outCol + outGOffset] = Color::intToFloat<65536>(src_pixels[inCol + inGOffset]);
+            dst_pixels[outCol + outBOffset] = Color::intToFloat<65536>(src_pixels[inCol + inBOffset]);
+            if (outputHasAlpha) {
+                dst_pixels[outCol + outAOffset] = Color::intToFloat<65536>(a);
+            }
+        }
+    }
 }
 
 void
@@ -1018,13 +1264,15 @@ to_short_planar(unsigned short *to,
                 int inDelta,
                 int outDelta)
 {
-    (void)to;
-    (void)from;
-    (void)W;
-    (void)alpha;
-    (void)inDelta;
-    (void)outDelta;
-    throw std::runtime_error("Linear::to_short_planar not yet implemented.");
+    if (!alpha) {
+        for (int i = 0; i < W; ++i) {
+            to[i * outDelta] = floatToInt<65536>(from[i * inDelta]);
+        }
+    } else {
+        for (int i = 0; i < W; ++i) {
+            to[i * outDelta] = floatToInt<65536>(from[i * inDelta] * alpha[i * inDelta]);
+        }
+    }
 }
 
 void
@@ -1141,17 +1389,50 @@ to_short_packed(unsigned short* to,
                 bool invertY,
                 bool premult)
 {
-    (void)to;
-    (void)from;
-    (void)conversionRect;
-    (void)srcBounds;
-    (void)dstBounds;
-    (void)invertY;
-    (void)premult;
-    (void)inputPacking;
-    (void)outputPacking;
-    throw std::runtime_error("Linear::to_short_packed not yet implemented.");
-}
+    if ( ( inputPacking == ePixelPackingPLANAR) || ( outputPacking == ePixelPackingPLANAR) ) {
+        throw std::runtime_error("This function is not meant for planar buffers.");
+    }
+
+    ///clip the conversion rect to srcBounds and dstBounds
+    RectI rect = conversionRect;
+    if ( !clip(&rect,srcBounds) || !clip(&rect,dstBounds) ) {
+        return;
+    }
+
+
+    bool inputHasAlpha = inputPacking == ePixelPackingBGRA || inputPacking == ePixelPackingRGBA;
+    bool outputHasAlpha = outputPacking == ePixelPackingBGRA || outputPacking == ePixelPackingRGBA;
+    int inROffset, inGOffset, inBOffset, inAOffset;
+    int outROffset, outGOffset, outBOffset, outAOffset;
+    getOffsetsForPacking(inputPacking, &inROffset, &inGOffset, &inBOffset, &inAOffset);
+    getOffsetsForPacking(outputPacking, &outROffset, &outGOffset, &outBOffset, &outAOffset);
+
+    int inPackingSize,outPackingSize;
+    inPackingSize = inputHasAlpha ? 4 : 3;
+    outPackingSize = outputHasAlpha ? 4 : 3;
+
+    for (int y = rect.y1; y < rect.y2; ++y) {
+        int srcY = y;
+        if (invertY) {
+            srcY = srcBounds.y2 - y - 1;
+        }
+
+        const float *src_pixels = from + (srcY * (srcBounds.x2 - srcBounds.x1) * inPackingSize);
+        unsigned short *dst_pixels = to + (y * (dstBounds.x2 - dstBounds.x1) * outPackingSize);
+        for (int x = rect.x1; x < rect.x2; ++x) {
+            int inCol = x * inPackingSize;
+            int outCol = x * outPackingSize;
+            float a = (inputHasAlpha && premult) ? src_pixels[inCol + inAOffset] : 1.f;
+
+            dst_pixels[outCol + outROffset] = floatToInt<65536>(src_pixels[inCol + inROffset] * a);
+            dst_pixels[outCol + outGOffset] = floatToInt<65536>(src_pixels[inCol + inGOffset] * a);
+            dst_pixels[outCol + outBOffset] = floatToInt<65536>(src_pixels[inCol + inBOffset] * a);
+            if (outputHasAlpha) {
+                dst_pixels[outCol + outAOffset] = floatToInt<65536>(a);
+            }
+        }
+    }
+} // to_short_packed
 
 void
 to_float_packed(float* to,
@@ -1430,6 +1711,91 @@ rgb_to_hsv( float r,
         *h += 360;
     }
 }
+
+/// Branch-free float to half conversion with round to nearest even,
+/// see "Half to float done quick" by F. Giesen.
+static inline unsigned short
+float_to_half_rtne(float value)
+{
+    const U32 f32infty = 255U << 23;
+    const U32 f16max = (127U + 16U) << 23;
+    const U32 denormMagicBits = ( (127U - 15U) + (23U - 10U) + 1U ) << 23;
+    float denormMagic;
+    std::memcpy( &denormMagic, &denormMagicBits, sizeof(float) );
+
+    U32 f;
+    std::memcpy( &f, &value, sizeof(float) );
+    const U32 sign = f & 0x80000000U;
+    f ^= sign;
+
+    // too large for a half: infinity, or a quiet NaN if the input is a NaN
+    const U32 overflow = 0x7c00U | ( (U32)(f > f32infty) << 9 );
+
+    // the result is a denormal (or zero): let the FPU do the rounding by adding a magic number
+    float fabs;
+    std::memcpy( &fabs, &f, sizeof(float) );
+    float denormF = fabs + denormMagic;
+    U32 denorm;
+    std::memcpy( &denorm, &denormF, sizeof(float) );
+    denorm -= denormMagicBits;
+
+    // normalized result: rebias the exponent and round the mantissa to nearest even
+    const U32 mantOdd = (f >> 13) & 1U;
+    const U32 normalized = ( f + ( (U32)(15 - 127) << 23 ) + 0xfffU + mantOdd ) >> 13;
+
+    // select with masks rather than branches
+    const U32 isOverflow = 0U - (U32)(f >= f16max);
+    const U32 isDenorm = 0U - (U32)(f < (113U << 23));
+    U32 ret = (isOverflow & overflow) | (~isOverflow & ( (isDenorm & denorm) | (~isDenorm & normalized) ) );
+
+    return (unsigned short)( ret | (sign >> 16) );
+}
+
+void
+to_half_row(const float* from,
+            int W,
+            unsigned short* to)
+{
+    for (int i = 0; i < W; ++i) {
+        to[i] = float_to_half_rtne(from[i]);
+    }
+}
+
+unsigned short
+floatToHalf(float value)
+{
+    return float_to_half_rtne(value);
+}
+
+float
+halfToFloat(unsigned short value)
+{
+    const U32 shiftedExp = 0x7c00U << 13; // exponent mask after shift
+    const U32 magicBits = 113U << 23;
+
+    U32 o = (U32)(value & 0x7fff) << 13; // exponent/mantissa bits
+    const U32 exp = shiftedExp & o; // just the exponent
+    o += (127U - 15U) << 23; // exponent adjust
+
+    float ret;
+    if (exp == shiftedExp) {
+        // Inf/NaN: extra exponent adjust
+        o += (128U - 16U) << 23;
+        std::memcpy( &ret, &o, sizeof(float) );
+    } else if (exp == 0) {
+        // Zero/Denormal: renormalize
+        o += 1U << 23;
+        float magic;
+        std::memcpy( &magic, &magicBits, sizeof(float) );
+        std::memcpy( &ret, &o, sizeof(float) );
+        ret -= magic;
+    } else {
+        std::memcpy( &ret, &o, sizeof(float) );
+    }
+
+    return (value & 0x8000) ? -ret : ret;
+}
+
 }     // namespace Color {
 } // namespace Natron {
 
@@ -49,8 +49,27 @@
 #include "Global/Macros.h"
 CLANG_DIAG_OFF(deprecated)
 #include <QMutex>
+#include <QAtomicInt>
 CLANG_DIAG_ON(deprecated)
 
+#if QT_VERSION < 0x050000
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+///Qt 4 has no acquire load: read the value with a plain load and order the reads that follow it with this fence.
+#if defined(__GNUC__) && ( (__GNUC__ > 4) || (__GNUC__ == 4 && __GNUC_MINOR__ >= 7) || defined(__clang__) )
+#define NATRON_LUT_ACQUIRE_FENCE() __atomic_thread_fence(__ATOMIC_ACQUIRE)
+#elif defined(__GNUC__)
+#define NATRON_LUT_ACQUIRE_FENCE() __sync_synchronize()
+#elif defined(_MSC_VER) && ( defined(_M_IX86) || defined(_M_X64) )
+#define NATRON_LUT_ACQUIRE_FENCE() _ReadWriteBarrier()
+#elif defined(_MSC_VER) && defined(_M_ARM)
+#define NATRON_LUT_ACQUIRE_FENCE() __dmb(_ARM_BARRIER_ISH)
+#else
+#error "No acquire fence available for this compiler"
+#endif
+#endif
+
 
 class RectI;
 
@@ -76,8 +95,8 @@ typedef float (*toColorSpaceFunctionV1)(float v);
 
 // a Singleton that holds precomputed LUTs for the whole application.
 // The m_instance member is static and is thus built before the first call to Instance().
-// WARNING : This class is not thread-safe and calling getLut must not be done in a function called
-// by multiple thread at once!
+// getLut is thread-safe: the map of luts is protected by a mutex, and the tables of each lut
+// are filled only once, by the first thread that needs them.
 class Lut;
 class LutManager
 {
@@ -90,7 +109,7 @@ public:
     /**
      * @brief Returns a pointer to a lut with the given name and the given from and to functions.
      * If a lut with the same name didn't already exist, then it will create one.
-     * WARNING : NOT THREAD-SAFE
+     * MT-safe
      **/
     static const Lut * getLut(const std::string & name,fromColorSpaceFunctionV1 fromFunc,toColorSpaceFunctionV1 toFunc);
 
@@ -127,6 +146,7 @@ private:
     //each lut with a ref count mapped against their name
     typedef std::map<std::string,const Lut * > LutsMap;
     LutsMap luts;
+    QMutex lutsMutex; //< protects luts
 };
 
 
@@ -144,8 +164,14 @@ class Lut
     /// and never change afterwards
     mutable unsigned short toFunc_hipart_to_uint8xx[0x10000];         /// contains  2^16 = 65536 values between 0-255
     mutable float fromFunc_uint8_to_float[256];         /// values between 0-1.f
-    mutable bool init_;         ///< false if the tables are not yet initialized
-    mutable QMutex _lock;         ///< protects init_
+    mutable float fromFunc_uint16_to_float[0x10000];         /// values between 0-1.f
+    /// 16 bits encoding of the float whose 16 most significant bits are the index and the 16 others are 0, in [0 - 65535]
+    mutable float toFunc_hipart_to_uint16[0x10000];
+    /// increase of the 16 bits encoding per unit of the 16 least significant bits of the float: the encoding is
+    /// interpolated linearly between the entries of toFunc_hipart_to_uint16
+    mutable float toFunc_hipart_to_uint16_slope[0x10000];
+    mutable QAtomicInt init_;         ///< 0 if the tables are not yet initialized, set to 1 once they are filled
+    mutable QMutex _lock;         ///< serializes the filling of the tables
 
     friend class LutManager;
     ///private constructor, used by LutManager
@@ -155,7 +181,7 @@ class Lut
         : _name(name)
           , _fromFunc(fromFunc)
           , _toFunc(toFunc)
-          , init_(false)
+          , init_(0)
           , _lock()
     {
     }
@@ -185,16 +211,38 @@ public:
         return _toFunc(v);
     }
 
+    /**
+     * @brief Returns true if the tables are filled. The tables are never modified afterwards,
+     * so a thread seeing true can read them without any lock.
+     * This is a plain load followed by an acquire barrier, it never locks the bus.
+     **/
+    bool isInitialized() const
+    {
+#if QT_VERSION < 0x050000
+        int init = (int)init_;
+        NATRON_LUT_ACQUIRE_FENCE();
+
+        return init == 1;
+#else
+        return init_.loadAcquire() == 1;
+#endif
+    }
+
     //Called by all public members
+    //Only the first call (or concurrent first calls) take the lock, afterwards this is a single acquire load.
     void validate() const
     {
+        if ( isInitialized() ) {
+            return;
+        }
+
         QMutexLocker g(&_lock);
 
-        if (init_) {
+        if ( isInitialized() ) {
             return;
         }
         fillTables();
-        init_ = true;
+        init_.fetchAndStoreRelease(1);
     }
 
     const std::string & getName() const
@@ -221,7 +269,8 @@ public:
 
     /* @brief Converts a float ranging in [0 - 1.f] in linear color-space using the look-up tables.
      * @return An unsigned short in [0 - 65535] in the destination color-space.
-     * This function uses localluy linear approximations of the transfer function.
+     * This function uses locally linear approximations of the transfer function: the 16 most significant
+     * bits of the float index the tables and the 16 others interpolate, without any branch.
      */
     unsigned short toColorSpaceUint16FromLinearFloatFast(float v) const;
 
@@ -232,9 +281,22 @@ public:
 
     /* @brief Converts a short ranging in [0 - 65535] in the destination color-space using the look-up tables.
      * @return A float in [0 - 1.f] in linear color-space.
+     * This is a direct look-up in a 65536 entries table.
      */
     float fromColorSpaceUint16ToLinearFloatFast(unsigned short v) const;
 
+    /**
+     * @brief Bulk versions of the functions above: they convert W values of the buffer from, distant of inDelta
+     * elements, into the buffer to (whose elements are distant of outDelta, if applicable).
+     * They give exactly the same results as calling the single value versions in a loop, but the table indexes are
+     * computed in a separate pass from the look-ups so that the compiler can vectorize them.
+     * validate() must have been called before.
+     **/
+    void toColorSpaceUint8xxFromLinearFloatFast(const float* from, int W, int inDelta, unsigned short* to) const;
+    void toColorSpaceUint16FromLinearFloatFast(const float* from, int W, int inDelta, unsigned short* to, int outDelta) const;
+    void fromColorSpaceUint8ToLinearFloatFast(const unsigned char* from, int W, int inDelta, float* to, int outDelta) const;
+    void fromColorSpaceUint16ToLinearFloatFast(const unsigned short* from, int W, int inDelta, float* to, int outDelta) const;
+
 
     /////@TODO the following functions expects a float input buffer, one could extend it to cover all bitdepths.
 
@@ -506,6 +568,20 @@ to_func_srgb(float v)
 ///		if s == 0, then h = -1 (undefined)
 void rgb_to_hsv( float r, float g, float b, float *h, float *s, float *v );
 
+/**
+ * @brief Convert an array of 32-bit floats to IEEE 754 half floats (binary16), as used by GL_HALF_FLOAT textures.
+ * Values are rounded to the nearest even, values too large for a half become infinity and NaNs are preserved.
+ * The loop is branch-free so that the compiler can vectorize it.
+ * \a W is the number of elements to convert. The input and output buffers must not overlap in memory.
+ **/
+void to_half_row(const float* from, int W, unsigned short* to);
+
+/// Convert a single 32-bit float to an IEEE 754 half float, @see to_half_row
+unsigned short floatToHalf(float value);
+
+/// Convert an IEEE 754 half float to a 32-bit float. This is exact.
+float halfToFloat(unsigned short value);
+
 /// numvals should be 256 for byte, 65536 for 16-bits, etc.
 
 /// maps 0-(numvals-1) to 0.-1.
@@ -27,6 +27,7 @@
 #endif
 #include <iostream>
 #include <stdexcept>
+#include <cassert>
 
 #include "Global/Macros.h"
 
@@ -73,7 +74,12 @@ MemoryFile::MemoryFile(const std::string & filepath,
                        FileOpenModeEnum open_mode)
     : _imp( new MemoryFilePrivate(filepath) )
 {
-    _imp->openInternal(open_mode);
+    try {
+        _imp->openInternal(open_mode);
+    } catch (...) {
+        delete _imp;
+        throw;
+    }
 }
 
 MemoryFile::MemoryFile(const std::string & filepath,
@@ -81,8 +87,13 @@ MemoryFile::MemoryFile(const std::string & filepath,
                        FileOpenModeEnum open_mode)
     : _imp( new MemoryFilePrivate(filepath) )
 {
-    _imp->openInternal(open_mode);
-    resize(size);
+    try {
+        _imp->openInternal(open_mode);
+        resize(size);
+    } catch (...) {
+        delete _imp;
+        throw;
+    }
 }
 
 void
@@ -338,6 +349,52 @@ MemoryFile::flush()
 #endif
 }
 
+bool
+MemoryFile::flushRange(size_t offset,
+                       size_t length)
+{
+    assert(_imp->data && offset + length <= _imp->size);
+#if defined(__NATRON_UNIX__)
+
+    return ::msync(_imp->data + offset, length, MS_ASYNC) == 0;
+#elif defined(__NATRON_WIN32__)
+
+    return ::FlushViewOfFile(_imp->data + offset, length) != 0;
+#endif
+}
+
+void
+MemoryFile::releaseRange(size_t offset,
+                         size_t length)
+{
+    assert(_imp->data && offset + length <= _imp->size);
+#if defined(__NATRON_UNIX__)
+    ///The mapping is shared: dirty pages stay in the page cache and are written back to the file
+    ::madvise(_imp->data + offset, length, MADV_DONTNEED);
+#elif defined(__NATRON_WIN32__)
+    ///Removes the pages from the working set of the process, they are paged back in from the file
+    ::VirtualUnlock(_imp->data + offset, length);
+#endif
+}
+
+void
+MemoryFile::discardRange(size_t offset,
+                         size_t length)
+{
+    assert(_imp->data && offset + length <= _imp->size);
+#if defined(__NATRON_UNIX__)
+#if defined(__linux__) && defined(FALLOC_FL_PUNCH_HOLE)
+    if (::fallocate(_imp->file_handle, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, offset, length) == 0) {
+        return;
+    }
+#endif
+    ::madvise(_imp->data + offset, length, MADV_DONTNEED);
+#else
+    (void)offset;
+    (void)length;
+#endif
+}
+
 MemoryFile::~MemoryFile()
 {
     if (_imp->data) {
@@ -120,6 +120,26 @@ public:
      **/
     bool flush();
 
+    /**
+     * @brief Schedules the write-back of the given range of the mapping without waiting for it.
+     * The offset must be a multiple of the page size.
+     **/
+    bool flushRange(size_t offset, size_t length);
+
+    /**
+     * @brief Drops the pages of the given range from the memory of the process. The data
+     * is kept in the file and mapped back on the next access.
+     * The offset must be a multiple of the page size.
+     **/
+    void releaseRange(size_t offset, size_t length);
+
+    /**
+     * @brief Throws away the content of the given range. Where the file-system supports it,
+     * the disk blocks backing the range are deallocated, otherwise the data is left as is.
+     * The offset must be a multiple of the page size.
+     **/
+    void discardRange(size_t offset, size_t length);
+
     /**
      * @brief Returns the filepath of the backing file.
      **/
@@ -0,0 +1,181 @@
+//  Natron
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "MemoryPressureMonitor.h"
+
+#include <stdexcept>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QAtomicInt>
+#include <QDebug>
+
+#include "Global/MemoryInfo.h"
+#include "Engine/AppManager.h"
+#include "Engine/Settings.h"
+
+using namespace Natron;
+
+namespace {
+///Sampling intervals, in milliseconds, depending on the pressure level
+const unsigned long kSampleIntervalNone = 500;
+const unsigned long kSampleIntervalModerate = 100;
+const unsigned long kSampleIntervalHigh = 20;
+
+///Width of the band above the RAM to keep free in which the pressure is moderate, in fraction of the total RAM
+const double kModeratePressureBand = 0.05;
+
+///When trimming, the caches release enough to get this far above the RAM to keep free, in fraction of the total RAM,
+///so that the next allocations do not immediately trigger another trim
+const double kTrimMargin = 0.025;
+}
+
+struct Natron::MemoryPressureMonitorPrivate
+{
+    QAtomicInt pressure; //< a MemoryPressureEnum
+    mutable QMutex totalRAMMutex; //< protects totalRAM
+    std::size_t totalRAM; //< getSystemTotalRAM_conditionnally() at the last sample, it reads the cgroup files
+    QMutex mustQuitMutex; //< protects mustQuit and sampleRequested
+    QWaitCondition sampleCond;
+    bool mustQuit;
+    bool sampleRequested;
+
+    MemoryPressureMonitorPrivate()
+        : pressure(eMemoryPressureNone)
+          , totalRAMMutex()
+          , totalRAM( getSystemTotalRAM_conditionnally() )
+          , mustQuitMutex()
+          , sampleCond()
+          , mustQuit(false)
+          , sampleRequested(false)
+    {
+    }
+
+    /**
+     * @brief Measures the RAM available, updates the pressure level and returns how many bytes the caches
+     * should release (0 if the pressure is not high).
+     **/
+    std::size_t sample()
+    {
+        std::size_t totalRAM = getSystemTotalRAM_conditionnally();
+        {
+            QMutexLocker k(&totalRAMMutex);
+            this->totalRAM = totalRAM;
+        }
+        std::size_t toKeepFree = totalRAM * appPTR->getCurrentSettings()->getUnreachableRamPercent();
+        std::size_t available;
+
+        try {
+            available = getAmountAvailableRAM();
+        } catch (const std::exception & e) {
+            qDebug() << e.what();
+            pressure.fetchAndStoreRelaxed(eMemoryPressureNone);
+
+            return 0;
+        }
+
+        if (available <= toKeepFree) {
+            pressure.fetchAndStoreRelaxed(eMemoryPressureHigh);
+
+            return toKeepFree + (std::size_t)(totalRAM * kTrimMargin) - available;
+        } else if ( available <= toKeepFree + (std::size_t)(totalRAM * kModeratePressureBand) ) {
+            pressure.fetchAndStoreRelaxed(eMemoryPressureModerate);
+        } else {
+            pressure.fetchAndStoreRelaxed(eMemoryPressureNone);
+        }
+
+        return 0;
+    }
+};
+
+MemoryPressureMonitor::MemoryPressureMonitor()
+    : QThread()
+      , _imp( new MemoryPressureMonitorPrivate() )
+{
+    setObjectName("MemoryPressureMonitor");
+}
+
+MemoryPressureMonitor::~MemoryPressureMonitor()
+{
+}
+
+MemoryPressureEnum
+MemoryPressureMonitor::getPressure() const
+{
+#if QT_VERSION < 0x050000
+    return (MemoryPressureEnum)(int)_imp->pressure;
+#else
+    return (MemoryPressureEnum)_imp->pressure.load();
+#endif
+}
+
+std::size_t
+MemoryPressureMonitor::getTotalRAM() const
+{
+    QMutexLocker k(&_imp->totalRAMMutex);
+
+    return _imp->totalRAM;
+}
+
+void
+MemoryPressureMonitor::requestSample()
+{
+    QMutexLocker k(&_imp->mustQuitMutex);
+
+    _imp->sampleRequested = true;
+    _imp->sampleCond.wakeOne();
+}
+
+void
+MemoryPressureMonitor::quitThread()
+{
+    if ( !isRunning() ) {
+        return;
+    }
+    {
+        QMutexLocker k(&_imp->mustQuitMutex);
+        _imp->mustQuit = true;
+        _imp->sampleCond.wakeOne();
+    }
+    wait();
+}
+
+void
+MemoryPressureMonitor::run()
+{
+    for (;;) {
+        std::size_t bytesToFree = _imp->sample();
+        if (bytesToFree > 0) {
+#ifdef NATRON_DEBUG_CACHE
+            qDebug() << "Total available RAM is below the threshold, trimming the caches by" << printAsRAM(bytesToFree);
+#endif
+            appPTR->trimCachesUnderMemoryPressure(bytesToFree);
+        }
+
+        unsigned long interval;
+        switch ( getPressure() ) {
+        case eMemoryPressureHigh:
+            interval = kSampleIntervalHigh;
+            break;
+        case eMemoryPressureModerate:
+            interval = kSampleIntervalModerate;
+            break;
+        case eMemoryPressureNone:
+        default:
+            interval = kSampleIntervalNone;
+            break;
+        }
+
+        QMutexLocker k(&_imp->mustQuitMutex);
+        if (!_imp->mustQuit && !_imp->sampleRequested) {
+            _imp->sampleCond.wait(&_imp->mustQuitMutex, interval);
+        }
+        if (_imp->mustQuit) {
+            _imp->mustQuit = false;
+
+            return;
+        }
+        _imp->sampleRequested = false;
+    }
+}
@@ -0,0 +1,69 @@
+//  Natron
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef NATRON_ENGINE_MEMORYPRESSUREMONITOR_H_
+#define NATRON_ENGINE_MEMORYPRESSUREMONITOR_H_
+
+#include <cstddef>
+#include <QThread>
+#ifndef Q_MOC_RUN
+#include <boost/scoped_ptr.hpp>
+#endif
+#include "Global/Macros.h"
+
+namespace Natron {
+enum MemoryPressureEnum
+{
+    eMemoryPressureNone = 0, //< there is enough free RAM
+    eMemoryPressureModerate, //< the free RAM is getting close to the RAM that must be kept free for the system
+    eMemoryPressureHigh //< the free RAM is below the RAM that must be kept free for the system, the caches are being trimmed
+};
+
+struct MemoryPressureMonitorPrivate;
+
+/**
+ * @brief A thread sampling the RAM available to the application and trimming the caches when it goes below the
+ * RAM that must be kept free for the system (see Settings::getUnreachableRamPercent()).
+ * The last measured pressure level can be read cheaply from any thread with getPressure(), so that allocating
+ * an entry in a cache does not have to query the system.
+ **/
+class MemoryPressureMonitor
+    : public QThread
+{
+public:
+
+    MemoryPressureMonitor();
+
+    virtual ~MemoryPressureMonitor();
+
+    /**
+     * @brief Returns the pressure level measured by the last sample. This does not lock anything.
+     **/
+    MemoryPressureEnum getPressure() const WARN_UNUSED_RETURN;
+
+    /**
+     * @brief Returns the RAM the application may use as measured by the last sample: the total RAM of the system,
+     * or the memory limit of the control group of the process if lower. This does not query the system.
+     **/
+    std::size_t getTotalRAM() const WARN_UNUSED_RETURN;
+
+    /**
+     * @brief Wakes up the thread so that it takes a sample now rather than at its next interval.
+     **/
+    void requestSample();
+
+    /**
+     * @brief Stops the thread and waits for it to return.
+     **/
+    void quitThread();
+
+private:
+
+    virtual void run() OVERRIDE FINAL;
+    boost::scoped_ptr<MemoryPressureMonitorPrivate> _imp;
+};
+}
+
+#endif // NATRON_ENGINE_MEMORYPRESSUREMONITOR_H_
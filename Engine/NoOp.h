@@ -40,6 +40,9 @@ public:
     
     virtual bool getCanTransform() const OVERRIDE FINAL WARN_UNUSED_RETURN { return true; }
 
+    ///The image of a NoOp is the image of its input for the same view
+    virtual bool isViewAware() const OVERRIDE FINAL WARN_UNUSED_RETURN { return false; }
+
     virtual std::string getPluginID() const WARN_UNUSED_RETURN = 0;
     virtual std::string getPluginLabel() const WARN_UNUSED_RETURN = 0;
     virtual std::string getDescription() const WARN_UNUSED_RETURN = 0;
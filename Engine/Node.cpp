@@ -42,6 +42,7 @@
 #include "Engine/KnobTypes.h"
 #include "Engine/ImageParams.h"
 #include "Engine/ThreadStorage.h"
+#include "Engine/RenderAbortToken.h"
 #include "Engine/RotoContext.h"
 #include "Engine/Timer.h"
 #include "Engine/Settings.h"
@@ -115,6 +116,10 @@ struct Node::Implementation
     , mustQuitPreview(false)
     , mustQuitPreviewMutex()
     , mustQuitPreviewCond()
+    , previewImageMutex()
+    , previewImage()
+    , previewWidth(0)
+    , previewHeight(0)
     , knobsAge(0)
     , knobsAgeMutex()
     , masterNodeMutex()
@@ -213,6 +218,9 @@ struct Node::Implementation
     bool mustQuitPreview;
     QMutex mustQuitPreviewMutex;
     QWaitCondition mustQuitPreviewCond;
+    mutable QMutex previewImageMutex; //< protects previewImage, previewWidth and previewHeight
+    std::vector<unsigned int> previewImage; //< the last preview rendered by the PreviewScheduler
+    int previewWidth,previewHeight;
     QMutex renderInstancesSharedMutex; //< see eRenderSafetyInstanceSafe in EffectInstance::renderRoI
     //only 1 clone can render at any time
     
@@ -2216,7 +2224,7 @@ namespace {
                     // bilinear interpolation is pointless when downscaling a lot, and this is a preview anyway.
                     // just use nearest neighbor
                     double x = (j - *dstWidth / 2.) / zoomFactor + (srcBounds.x1 + srcBounds.x2) / 2.;
-                    int xi = std::floor(x + 0.5); // round to nearest
+                    int xi = std::floor(x + 0.5) - srcBounds.x1; // round to nearest, relative to src_pixels
                     if ( (xi < 0) || ( xi >= (srcBounds.x2 - srcBounds.x1) ) ) {
 #ifndef __NATRON_WIN32__
                         dst_pixels[j] = toBGRA(0, 0, 0, 0);
@@ -2236,6 +2244,48 @@ namespace {
             }
         }
     } // renderPreview
+    
+    /**
+     * @brief Returns an image of the node that is already in the cache (typically rendered for the viewer) and from which
+     * the preview can be sampled: it must be at a resolution at least as high as the preview needs and be fully
+     * rendered over the whole RoD. Among those, the one with the lowest resolution is returned.
+     **/
+    boost::shared_ptr<Natron::Image>
+    getCachedImageForPreview(const Natron::EffectInstance* effect,
+                             U64 nodeHash,
+                             SequenceTime time,
+                             unsigned int mipMapLevel,
+                             const RectD& rod,
+                             double par)
+    {
+        boost::shared_ptr<Natron::Image> ret;
+        Natron::ImageKey key = Natron::Image::makeKey(nodeHash, effect->isFrameVaryingOrAnimated_Recursive(), time, effect->getViewForCache(0));
+        std::list<boost::shared_ptr<Natron::Image> > cachedImages;
+        if ( !Natron::getImageFromCache(key, &cachedImages) ) {
+            return ret;
+        }
+        for (std::list<boost::shared_ptr<Natron::Image> >::iterator it = cachedImages.begin(); it != cachedImages.end(); ++it) {
+            Natron::ImageComponentsEnum comps = (*it)->getComponents();
+            if ( (comps != Natron::eImageComponentRGB) && (comps != Natron::eImageComponentRGBA) ) {
+                continue;
+            }
+            unsigned int level = (*it)->getMipMapLevel();
+            if ( (level > mipMapLevel) || ( ret && (ret->getMipMapLevel() >= level) ) ) {
+                continue;
+            }
+            RectI rodPixel;
+            rod.toPixelEnclosing(level, par, &rodPixel);
+            if ( !(*it)->getBounds().contains(rodPixel) ) {
+                continue;
+            }
+            std::list<RectI> rest;
+            (*it)->getRestToRender(rodPixel, rest);
+            if ( rest.empty() ) {
+                ret = *it;
+            }
+        }
+        return ret;
+    }
 }
 
 class ComputingPreviewSetter_RAII
@@ -2263,7 +2313,8 @@ bool
 Node::makePreviewImage(SequenceTime time,
                        int *width,
                        int *height,
-                       unsigned int* buf)
+                       unsigned int* buf,
+                       const boost::shared_ptr<Natron::RenderAbortToken>& abortToken)
 {
     assert(_imp->knobsInitialized);
     if (!_imp->liveInstance) {
@@ -2299,35 +2350,41 @@ Node::makePreviewImage(SequenceTime time,
     
     const double par = _imp->liveInstance->getPreferredAspectRatio();
     
-    boost::shared_ptr<Image> img;
     RectI renderWindow;
     rod.toPixelEnclosing(mipMapLevel, par, &renderWindow);
     
-    ParallelRenderArgsSetter frameRenderArgs(this,
-                                             time,
-                                             0, //< preview only renders view 0 (left)
-                                             true,
-                                             false,
-                                             false,
-                                             nodeHash,
-                                             false,
-                                             getApp()->getTimeLine().get());
-    
-    // Exceptions are caught because the program can run without a preview,
-    // but any exception in renderROI is probably fatal.
-    try {
-        img = _imp->liveInstance->renderRoI( EffectInstance::RenderRoIArgs( time,
-                                                                           scale,
-                                                                           mipMapLevel,
-                                                                           0, //< preview only renders view 0 (left)
-                                                                           false,
-                                                                           renderWindow,
-                                                                           rod,
-                                                                           Natron::eImageComponentRGB, //< preview is always rgb...
-                                                                           getBitDepth() ) );
-    } catch (...) {
-        qDebug() << "Error: Cannot render preview";
-        return false;
+    ///If the viewer already rendered this node, sample the preview from the cached image instead of rendering again
+    boost::shared_ptr<Image> img = getCachedImageForPreview(_imp->liveInstance, nodeHash, time, mipMapLevel, rod, par);
+    
+    if (!img) {
+        ParallelRenderArgsSetter frameRenderArgs(this,
+                                                 time,
+                                                 0, //< preview only renders view 0 (left)
+                                                 true,
+                                                 false,
+                                                 false,
+                                                 nodeHash,
+                                                 false,
+                                                 getApp()->getTimeLine().get(),
+                                                 boost::shared_ptr<FrameMemoryBudget>(),
+                                                 abortToken);
+        
+        // Exceptions are caught because the program can run without a preview,
+        // but any exception in renderROI is probably fatal.
+        try {
+            img = _imp->liveInstance->renderRoI( EffectInstance::RenderRoIArgs( time,
+                                                                               scale,
+                                                                               mipMapLevel,
+                                                                               0, //< preview only renders view 0 (left)
+                                                                               false,
+                                                                               renderWindow,
+                                                                               rod,
+                                                                               Natron::eImageComponentRGB, //< preview is always rgb...
+                                                                               getBitDepth() ) );
+        } catch (...) {
+            qDebug() << "Error: Cannot render preview";
+            return false;
+        }
     }
     
     if (!img) {
@@ -2361,6 +2418,38 @@ Node::makePreviewImage(SequenceTime time,
     
 } // makePreviewImage
 
+void
+Node::setPreviewImage(int time,
+                      int width,
+                      int height,
+                      const unsigned int* buf)
+{
+    {
+        QMutexLocker k(&_imp->previewImageMutex);
+        _imp->previewImage.assign(buf, buf + width * height);
+        _imp->previewWidth = width;
+        _imp->previewHeight = height;
+    }
+    emit previewRendered(time);
+}
+
+bool
+Node::getPreviewImage(int* width,
+                      int* height,
+                      std::vector<unsigned int>* buf) const
+{
+    QMutexLocker k(&_imp->previewImageMutex);
+
+    if ( _imp->previewImage.empty() ) {
+        return false;
+    }
+    *width = _imp->previewWidth;
+    *height = _imp->previewHeight;
+    *buf = _imp->previewImage;
+
+    return true;
+}
+
 bool
 Node::isInputNode() const
 {
@@ -3438,15 +3527,32 @@ Node::setParallelRenderArgs(int time,
                             bool canAbort,
                             U64 nodeHash,
                             bool canSetValue,
-                            const TimeLine* timeline)
+                            const TimeLine* timeline,
+                            const boost::shared_ptr<FrameMemoryBudget>& memoryBudget,
+                            const boost::shared_ptr<Natron::RenderAbortToken>& abortToken)
 {
+    ///All the nodes of the tree share the same budget for this frame
+    boost::shared_ptr<FrameMemoryBudget> budget = memoryBudget;
+    if (!budget) {
+        budget.reset(new FrameMemoryBudget(FrameMemoryBudget::getRenderMemoryBudget()));
+    }
+    ///And the same token. Nested calls on the same thread are part of the frame it is already rendering.
+    boost::shared_ptr<RenderAbortToken> token = abortToken;
+    if (!token) {
+        token = RenderAbortToken::getThreadToken();
+    }
+    if (!token) {
+        token.reset( new RenderAbortToken(getApp(), isRenderUserInteraction) );
+    }
     std::list<Natron::Node*> marked;
-    setParallelRenderArgsInternal(time, view, isRenderUserInteraction, isSequential, nodeHash,canAbort, canSetValue, timeline, marked);
+    setParallelRenderArgsInternal(time, view, isRenderUserInteraction, isSequential, nodeHash,canAbort, canSetValue, timeline, budget, token, marked);
+    RenderAbortToken::pushThreadToken(token, _imp->liveInstance);
 }
 
 void
 Node::invalidateParallelRenderArgs()
 {
+    RenderAbortToken::popThreadToken();
     std::list<Natron::Node*> marked;
     invalidateParallelRenderArgsInternal(marked);
 }
@@ -3517,6 +3623,8 @@ Node::setParallelRenderArgsInternal(int time,
                                     bool canAbort,
                                     bool canSetValue,
                                     const TimeLine* timeline,
+                                    const boost::shared_ptr<FrameMemoryBudget>& memoryBudget,
+                                    const boost::shared_ptr<Natron::RenderAbortToken>& abortToken,
                                     std::list<Natron::Node*>& markedNodes)
 {
     ///If marked, we alredy set render args
@@ -3532,7 +3640,7 @@ Node::setParallelRenderArgsInternal(int time,
         rotoAge = 0;
     }
     
-    _imp->liveInstance->setParallelRenderArgs(time, view, isRenderUserInteraction, isSequential, canAbort, nodeHash, rotoAge,canSetValue, timeline);
+    _imp->liveInstance->setParallelRenderArgs(time, view, isRenderUserInteraction, isSequential, canAbort, nodeHash, rotoAge,canSetValue, timeline, memoryBudget, abortToken);
     
     
     ///Wait for the main-thread to be done dequeuing the connect actions queue
@@ -3567,7 +3675,7 @@ Node::setParallelRenderArgsInternal(int time,
     for (int i = 0; i < maxInpu; ++i) {
         boost::shared_ptr<Node> input = getInput(i);
         if (input) {
-            input->setParallelRenderArgsInternal(time, view, isRenderUserInteraction, isSequential, input->getHashValue(),canAbort, canSetValue,  timeline, markedNodes);
+            input->setParallelRenderArgsInternal(time, view, isRenderUserInteraction, isSequential, input->getHashValue(),canAbort, canSetValue,  timeline, memoryBudget, abortToken, markedNodes);
             
         }
     }
@@ -50,12 +50,14 @@ class KnobHolder;
 class Double_Knob;
 class NodeGuiI;
 class RotoContext;
+class FrameMemoryBudget;
 namespace Natron {
 class Plugin;
 class OutputEffectInstance;
 class Image;
 class EffectInstance;
 class LibraryBinary;
+class RenderAbortToken;
 
 class Node
     : public QObject
@@ -494,8 +496,22 @@ public:
      *
      * The width and height might be modified by the function, so their value can
      * be queried at the end of the function
+     * The render stops early once abortToken, if any, is aborted.
      **/
-    bool makePreviewImage(SequenceTime time,int *width,int *height,unsigned int* buf);
+    bool makePreviewImage(SequenceTime time,int *width,int *height,unsigned int* buf,
+                          const boost::shared_ptr<Natron::RenderAbortToken>& abortToken = boost::shared_ptr<Natron::RenderAbortToken>());
+
+    /**
+     * @brief Called by the PreviewScheduler once the preview has been rendered by makePreviewImage.
+     * The preview is stored in the node and previewRendered is emitted so the GUI can fetch it on the main-thread
+     * with getPreviewImage.
+     **/
+    void setPreviewImage(int time,int width,int height,const unsigned int* buf);
+
+    /**
+     * @brief Returns the last preview set with setPreviewImage, or false if there is none.
+     **/
+    bool getPreviewImage(int* width,int* height,std::vector<unsigned int>* buf) const;
 
     /**
      * @brief Returns true if the node is currently rendering a preview image.
@@ -705,6 +721,9 @@ public:
     /**
      * @brief Recursively sets render preferences for the rendering of a frame for the current thread.
      * This is thread local storage
+     * If memoryBudget is NULL, a new budget is created for the frame, otherwise the given one is shared
+     * (e.g: by the threads rendering tiles of the same frame). The same goes for abortToken, except that
+     * a thread already rendering a frame keeps its token.
      **/
     void setParallelRenderArgs(int time,
                                int view,
@@ -713,7 +732,9 @@ public:
                                bool canAbort,
                                U64 nodeHash,
                                bool canSetValue,
-                               const TimeLine* timeline);
+                               const TimeLine* timeline,
+                               const boost::shared_ptr<FrameMemoryBudget>& memoryBudget = boost::shared_ptr<FrameMemoryBudget>(),
+                               const boost::shared_ptr<Natron::RenderAbortToken>& abortToken = boost::shared_ptr<Natron::RenderAbortToken>());
     
     void invalidateParallelRenderArgs();
     
@@ -730,10 +751,12 @@ public:
                                  bool canAbort,
                                  U64 nodeHash,
                                  bool canSetValue,
-                                 const TimeLine* timeline)
+                                 const TimeLine* timeline,
+                                 const boost::shared_ptr<FrameMemoryBudget>& memoryBudget = boost::shared_ptr<FrameMemoryBudget>(),
+                                 const boost::shared_ptr<Natron::RenderAbortToken>& abortToken = boost::shared_ptr<Natron::RenderAbortToken>())
         : node(n)
         {
-            node->setParallelRenderArgs(time,view,isRenderUserInteraction,isSequential,canAbort,nodeHash,canSetValue,timeline);
+            node->setParallelRenderArgs(time,view,isRenderUserInteraction,isSequential,canAbort,nodeHash,canSetValue,timeline,memoryBudget,abortToken);
         }
         
         ~ParallelRenderArgsSetter()
@@ -827,6 +850,8 @@ signals:
 
     void previewRefreshRequested(int);
 
+    void previewRendered(int);
+
     void inputNIsRendering(int inputNb);
 
     void inputNIsFinishedRendering(int inputNb);
@@ -885,6 +910,8 @@ private:
                                        bool canAbort,
                                        bool canSetValue,
                                        const TimeLine* timeline,
+                                       const boost::shared_ptr<FrameMemoryBudget>& memoryBudget,
+                                       const boost::shared_ptr<Natron::RenderAbortToken>& abortToken,
                                        std::list<Natron::Node*>& markedNodes);
     
 
@@ -46,11 +46,28 @@ OfxClipInstance::OfxClipInstance(OfxEffectInstance* nodeInstance
       , _effect(effect)
       , _aspectRatio(1.)
       , _lastActionData()
+      , _imagesPool()
+      , _imagesPoolsMutex()
+      , _imagesPools()
+      , _cachedPrefs()
 {
     assert(_nodeInstance);
     assert(_effect);
 }
 
+OfxClipInstance::~OfxClipInstance()
+{
+    ///The pools of the other threads are only destroyed when their thread exits: release their images now
+    QMutexLocker l(&_imagesPoolsMutex);
+
+    for (std::list<boost::weak_ptr<ImagesPool> >::iterator it = _imagesPools.begin(); it != _imagesPools.end(); ++it) {
+        boost::shared_ptr<ImagesPool> pool = it->lock();
+        if (pool) {
+            pool->releaseImages();
+        }
+    }
+}
+
 const std::string &
 OfxClipInstance::getUnmappedBitDepth() const
 {
@@ -240,6 +257,27 @@ OfxClipInstance::setAspectRatio(double par)
     _aspectRatio = par;
 }
 
+void
+OfxClipInstance::getNatronPreferences(Natron::ImageComponentsEnum* components,
+                                      Natron::ImageBitDepthEnum* bitDepth)
+{
+    ///The host and the plug-in may set the properties directly, compare with their current values
+    const std::string & ofxComponents = getComponents();
+    const std::string & ofxBitDepth = getPixelDepth();
+    CachedPreferences & cache = _cachedPrefs.localData();
+
+    if ( !cache.valid || (cache.ofxComponents != ofxComponents) || (cache.ofxBitDepth != ofxBitDepth) ) {
+        cache.valid = false;
+        cache.components = ofxComponentsToNatronComponents(ofxComponents);
+        cache.bitDepth = ofxDepthToNatronDepth(ofxBitDepth);
+        cache.ofxComponents = ofxComponents;
+        cache.ofxBitDepth = ofxBitDepth;
+        cache.valid = true;
+    }
+    *components = cache.components;
+    *bitDepth = cache.bitDepth;
+}
+
 // Frame Rate -
 double
 OfxClipInstance::getFrameRate() const
@@ -480,7 +518,7 @@ OfxClipInstance::getStereoscopicImage(OfxTime time,
             return NULL;
         }
         //The output clip doesn't have any transform matrix
-        return new OfxImage(outputImage,renderWindow,boost::shared_ptr<Transform::Matrix3x3>(),*this);
+        return getPooledImage( outputImage, renderWindow, boost::shared_ptr<Transform::Matrix3x3>() );
     }
     
     
@@ -503,6 +541,9 @@ OfxClipInstance::getStereoscopicImage(OfxTime time,
         } else {
             if (view == -1) {
                 view = args.view;
+            } else {
+                ///The plug-in picks the view it reads: its output may differ between views
+                _nodeInstance->setViewAware();
             }
         }
         
@@ -560,8 +601,9 @@ OfxClipInstance::getImageInternal(OfxTime time,
 
     
 
-    Natron::ImageComponentsEnum comps =  ofxComponentsToNatronComponents( getComponents() );
-    Natron::ImageBitDepthEnum bitDepth = ofxDepthToNatronDepth( getPixelDepth() );
+    Natron::ImageComponentsEnum comps;
+    Natron::ImageBitDepthEnum bitDepth;
+    getNatronPreferences(&comps, &bitDepth);
     double par = getAspectRatio();
     RectI renderWindow;
     boost::shared_ptr<Natron::Image> image;
@@ -586,7 +628,7 @@ OfxClipInstance::getImageInternal(OfxTime time,
                 StatusEnum stat = node->getRegionOfDefinition_public(node->getHash(), time, renderScale, view, &rod, &isProjectFormat);
                 assert(stat == Natron::eStatusOK);
             }
-            node->getRegionsOfInterest_public(time, renderScale, rod, rod, 0,&regionsOfInterests);
+            node->getRegionsOfInterest_public(node->getHash(), time, renderScale, rod, rod, 0,&regionsOfInterests);
         }
         
         EffectInstance* inputNode = node->getInput(rerouteInputNb);
@@ -632,9 +674,73 @@ OfxClipInstance::getImageInternal(OfxTime time,
         if (renderWindow.isNull()) {
             return NULL;
         } else {
-            return new OfxImage(image,renderWindow,transform,*this);
+            return getPooledImage(image, renderWindow, transform);
+        }
+    }
+}
+
+OfxImage*
+OfxClipInstance::getPooledImage(const boost::shared_ptr<Natron::Image>& image,
+                                const RectI& renderWindow,
+                                const boost::shared_ptr<Transform::Matrix3x3>& transform)
+{
+    boost::shared_ptr<ImagesPool> & pool = _imagesPool.localData();
+    
+    if (!pool) {
+        pool.reset(new ImagesPool);
+        QMutexLocker l(&_imagesPoolsMutex);
+        ///Forget the pools of the threads that exited
+        std::list<boost::weak_ptr<ImagesPool> >::iterator it = _imagesPools.begin();
+        while ( it != _imagesPools.end() ) {
+            if ( it->expired() ) {
+                it = _imagesPools.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        _imagesPools.push_back(pool);
+    }
+    for (std::list<OfxImage*>::iterator it = pool->images.begin(); it != pool->images.end(); ++it) {
+        if ( (*it)->isReferencedOnlyByPool() ) {
+            (*it)->setInternalImage(image, renderWindow, transform, *this);
+            (*it)->addReference();
+            
+            return *it;
         }
     }
+    
+    OfxImage* ret = new OfxImage(image,renderWindow,transform,*this);
+    ///The plug-in owns the reference the image was created with, this one is for the pool
+    ret->addReference();
+    pool->images.push_back(ret);
+    
+    return ret;
+}
+
+void
+OfxClipInstance::recycleImages()
+{
+    if ( !_imagesPool.hasLocalData() ) {
+        return;
+    }
+    const boost::shared_ptr<ImagesPool> & pool = _imagesPool.localData();
+    if (!pool) {
+        return;
+    }
+    for (std::list<OfxImage*>::iterator it = pool->images.begin(); it != pool->images.end(); ++it) {
+        if ( (*it)->isReferencedOnlyByPool() ) {
+            (*it)->resetInternalImage();
+        }
+    }
+}
+
+void
+OfxClipInstance::ImagesPool::releaseImages()
+{
+    for (std::list<OfxImage*>::iterator it = images.begin(); it != images.end(); ++it) {
+        (*it)->releasePoolReference();
+    }
+    images.clear();
 }
 
 std::string
@@ -725,8 +831,26 @@ OfxImage::OfxImage(boost::shared_ptr<Natron::Image> internalImage,
                    OfxClipInstance &clip)
     : OFX::Host::ImageEffect::Image(clip)
       , _bitDepth(OfxImage::eBitDepthFloat)
-      , _floatImage(internalImage)
+      , _floatImage()
 {
+    setInternalImage(internalImage, renderWindow, mat, clip);
+}
+
+void
+OfxImage::resetInternalImage()
+{
+    _floatImage.reset();
+    setPointerProperty(kOfxImagePropData, NULL);
+}
+
+void
+OfxImage::setInternalImage(const boost::shared_ptr<Natron::Image>& internalImage,
+                           const RectI& renderWindow,
+                           const boost::shared_ptr<Transform::Matrix3x3>& mat,
+                           OfxClipInstance &clip)
+{
+    _floatImage = internalImage;
+    
     unsigned int mipMapLevel = internalImage->getMipMapLevel();
     RenderScale scale;
 
@@ -900,6 +1024,21 @@ OfxClipInstance::clearTransform()
     _lastActionData.localData().isTransformDataValid = false;
 }
 
+void
+OfxClipInstance::copyTransformFrom(const OfxClipInstance& other)
+{
+    ActionLocalData & args = _lastActionData.localData();
+    if ( other._lastActionData.hasLocalData() ) {
+        const ActionLocalData otherArgs = other._lastActionData.localData();
+        args.matrix = otherArgs.matrix;
+        args.rerouteInputNb = otherArgs.rerouteInputNb;
+        args.rerouteNode = otherArgs.rerouteNode;
+        args.isTransformDataValid = otherArgs.isTransformDataValid;
+    } else {
+        args.isTransformDataValid = false;
+    }
+}
+
 const std::string &
 OfxClipInstance::findSupportedComp(const std::string &s) const
 {
@@ -14,6 +14,7 @@
 
 
 #include <cassert>
+#include <list>
 
 #include "Global/Macros.h"
 CLANG_DIAG_OFF(deprecated)
@@ -21,6 +22,7 @@ CLANG_DIAG_OFF(deprecated)
 CLANG_DIAG_ON(deprecated)
 #ifndef Q_MOC_RUN
 #include <boost/shared_ptr.hpp>
+#include <boost/weak_ptr.hpp>
 #endif
 //ofx
 #include <ofxhImageEffect.h>
@@ -56,9 +58,7 @@ public:
                     ,
                     OFX::Host::ImageEffect::ClipDescriptor* desc);
 
-    virtual ~OfxClipInstance()
-    {
-    }
+    virtual ~OfxClipInstance();
 
     /// Get the Raw Unmapped Pixel Depth from the host
     ///
@@ -90,6 +90,14 @@ public:
     virtual double getAspectRatio() const OVERRIDE FINAL WARN_UNUSED_RETURN;
 
     void setAspectRatio(double par);
+
+    /**
+     * @brief Returns the components and bit depth preferences of the clip as Natron enums. The conversions are cached
+     * for the calling thread and redone only when the properties changed, whichever way they were set.
+     * Throws a std::runtime_error if a preference has no Natron counterpart.
+     **/
+    void getNatronPreferences(Natron::ImageComponentsEnum* components,
+                              Natron::ImageBitDepthEnum* bitDepth);
     
     // Frame Rate -
     //
@@ -186,9 +194,29 @@ public:
 
     void setTransformAndReRouteInput(const Transform::Matrix3x3& m,Natron::EffectInstance* rerouteInput,int newInputNb);
     void clearTransform();
+
+    /**
+     * @brief Copies the transform and re-routed input set for the calling thread on the given clip. This is used by
+     * render clones, whose clips do not see the transforms concatenated by the tree on the clips of the main instance.
+     **/
+    void copyTransformFrom(const OfxClipInstance& other);
+
+    /**
+     * @brief Called at the end of an action: the images of the pool of the calling thread that the plug-in
+     * released no longer hold the Natron images they wrapped.
+     **/
+    void recycleImages();
     
 private:
 
+    /**
+     * @brief Returns an OfxImage wrapping the given image: it is picked in the pool of the calling thread if the plug-in
+     * released one, otherwise a new one is made and added to the pool.
+     **/
+    OfxImage* getPooledImage(const boost::shared_ptr<Natron::Image>& image,
+                             const RectI& renderWindow,
+                             const boost::shared_ptr<Transform::Matrix3x3>& transform);
+
     OFX::Host::ImageEffect::Image* getImageInternal(OfxTime time,const OfxPointD & renderScale, int view, const OfxRectD *optionalBounds,
                                                     bool usingReroute,
                                                     int rerouteInputNb,
@@ -231,7 +259,61 @@ private:
     };
 
     Natron::ThreadStorage<ActionLocalData> _lastActionData; //< foreach  thread, the args
-    
+
+    /**
+     * @brief The OfxImage handed to the plug-in by this clip on a thread. The pool holds a reference on each of them:
+     * when the plug-in releases an image it is not deleted and its property set is reused for the next image fetched.
+     * Not copyable: it owns its images.
+     **/
+    struct ImagesPool
+    {
+        std::list<OfxImage*> images;
+
+        ImagesPool()
+            : images()
+        {
+        }
+
+        ~ImagesPool()
+        {
+            releaseImages();
+        }
+
+        ///Images still held by the plug-in are deleted when it releases them
+        void releaseImages();
+
+    private:
+
+        ImagesPool(const ImagesPool&);
+        ImagesPool& operator=(const ImagesPool&);
+    };
+
+    Natron::ThreadStorage<boost::shared_ptr<ImagesPool> > _imagesPool;
+
+    ///The pools of all threads, so that their images are released with the clip rather than when their thread exits
+    QMutex _imagesPoolsMutex;
+    std::list<boost::weak_ptr<ImagesPool> > _imagesPools;
+
+    ///The last preferences converted to Natron enums on a thread, @see getNatronPreferences
+    struct CachedPreferences
+    {
+        bool valid;
+        std::string ofxComponents;
+        std::string ofxBitDepth;
+        Natron::ImageComponentsEnum components;
+        Natron::ImageBitDepthEnum bitDepth;
+
+        CachedPreferences()
+            : valid(false)
+              , ofxComponents()
+              , ofxBitDepth()
+              , components(Natron::eImageComponentNone)
+              , bitDepth(Natron::eImageBitDepthNone)
+        {
+        }
+    };
+
+    Natron::ThreadStorage<CachedPreferences> _cachedPrefs;
 };
 
 class OfxImage
@@ -268,6 +350,31 @@ public:
     {
     }
 
+    /**
+     * @brief Makes this image wrap another Natron image: only the values of the properties are changed.
+     **/
+    void setInternalImage(const boost::shared_ptr<Natron::Image>& internalImage,
+                          const RectI& renderWindow,
+                          const boost::shared_ptr<Transform::Matrix3x3>& mat,
+                          OfxClipInstance &clip);
+
+    ///Stops wrapping the Natron image so that it can be freed
+    void resetInternalImage();
+
+    ///True if the only reference left on the image is the one of the pool it belongs to
+    bool isReferencedOnlyByPool() const
+    {
+        return _referenceCount == 1;
+    }
+
+    ///Releases the reference of the pool, deleting the image if the plug-in doesn't hold it anymore
+    void releasePoolReference()
+    {
+        if ( releaseReference() ) {
+            delete this;
+        }
+    }
+
     BitDepthEnum bitDepth() const
     {
         return _bitDepth;
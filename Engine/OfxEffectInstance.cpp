@@ -45,6 +45,7 @@
 #include "Engine/AppInstance.h"
 #include "Engine/NodeSerialization.h"
 #include "Engine/Node.h"
+#include "Engine/Settings.h"
 #include "Engine/Transform.h"
 
 using namespace Natron;
@@ -95,7 +96,8 @@ public:
             if (mipMapLevelSet) {
                 effect->discardClipsMipMapLevel();
             }
-            
+            effect->recycleClipsImages();
+
         }
     }
 
@@ -123,11 +125,18 @@ OfxEffectInstance::OfxEffectInstance(boost::shared_ptr<Natron::Node> node)
       , _renderSafetyLock(new QReadWriteLock)
       , _context(eContextNone)
       , _preferencesLock(new QReadWriteLock(QReadWriteLock::Recursive))
+      , _renderCloneOf(0)
+      , _viewAware(1)
+      , _renderClonesMutex(new QMutex)
+      , _renderClones()
+      , _nRenderClonesRequested(0)
+      , _renderClonesFailed(false)
 #ifdef DEBUG
       , _canSetValue()
 #endif
 {
     QObject::connect( this, SIGNAL( syncPrivateDataRequested() ), this, SLOT( onSyncPrivateDataRequested() ) );
+    QObject::connect( this, SIGNAL( renderCloneRequested() ), this, SLOT( onRenderCloneRequested() ), Qt::QueuedConnection );
 }
 
 void
@@ -184,6 +193,7 @@ OfxEffectInstance::createOfxImageEffectInstance(OFX::Host::ImageEffect::ImageEff
         _effect->setOfxEffectInstance( dynamic_cast<OfxEffectInstance*>(this) );
 
         _natronPluginID = plugin->getIdentifier();
+
 //        _natronPluginID = generateImageEffectClassName( _effect->getPlugin()->getIdentifier(),
 //                                                        _effect->getPlugin()->getVersionMajor(),
 //                                                        _effect->getPlugin()->getVersionMinor(),
@@ -208,6 +218,17 @@ OfxEffectInstance::createOfxImageEffectInstance(OFX::Host::ImageEffect::ImageEff
             if (stat != kOfxStatOK) {
                 throw std::runtime_error("Error while populating the Ofx image effect");
             }
+
+            ///Plug-ins of the multi-view group select or combine the views of their inputs, readers and generators
+            ///make their image out of something else than their inputs (e.g: the file of the view) and writers write
+            ///a file per view. The other plug-ins only depend on the view through the images they fetch, until they
+            ///fetch an explicit view, @see setViewAware
+            std::list<std::string> grouping;
+            getPluginGrouping(&grouping);
+            bool isMultiView = !grouping.empty() && (grouping.front() == PLUGIN_GROUP_MULTIVIEW);
+            if ( !isMultiView && !isReader() && !isWriter() && !isGenerator() && (getMaxInputCount() > 0) ) {
+                _viewAware.fetchAndStoreOrdered(0);
+            }
             assert( _effect->getPlugin() );
             assert( _effect->getPlugin()->getPluginHandle() );
             assert( _effect->getPlugin()->getPluginHandle()->getOfxPlugin() );
@@ -347,9 +368,234 @@ OfxEffectInstance::~OfxEffectInstance()
         delete _overlayInteract;
     }
 
+    destroyRenderClones();
     delete _effect;
     delete _renderSafetyLock;
     delete _preferencesLock;
+    delete _renderClonesMutex;
+}
+
+void
+OfxEffectInstance::initializeAsRenderClone(OfxEffectInstance* mainInstance)
+{
+    ///Only called from the main thread.
+    assert( QThread::currentThread() == qApp->thread() );
+    assert(mainInstance && !mainInstance->_renderCloneOf);
+
+    _renderCloneOf = mainInstance;
+    _natronPluginID = mainInstance->_natronPluginID;
+    _isOutput = mainInstance->_isOutput;
+    _context = mainInstance->_context;
+    _viewAware.fetchAndStoreOrdered( mainInstance->isViewAware() ? 1 : 0 );
+    setSupportsRenderScaleMaybe( mainInstance->supportsRenderScaleMaybe() );
+
+    OFX::Host::ImageEffect::ImageEffectPlugin* plugin = mainInstance->effectInstance()->getPlugin();
+    const std::string & context = mainInstance->effectInstance()->getContext();
+    OFX::Host::ImageEffect::Descriptor* desc = plugin->getContext(context);
+    if (!desc) {
+        throw std::runtime_error(std::string("Failed to get description for OFX plugin in context ") + context);
+    }
+
+    ///A render clone is never evaluated: its knobs only mirror the values of the main instance
+    blockEvaluation();
+
+    _effect = new Natron::OfxImageEffectInstance(plugin,*desc,context,false);
+    _effect->setOfxEffectInstance(this);
+
+    OfxStatus stat;
+    {
+        SET_CAN_SET_VALUE(true);
+
+        stat = _effect->populate();
+        if (stat != kOfxStatOK) {
+            throw std::runtime_error("Error while populating the Ofx image effect");
+        }
+
+        ///Knobs that are not params of the plug-in (e.g: those added by the node) have no counterpart here
+        const std::vector<boost::shared_ptr<KnobI> > & knobs = getKnobs();
+        for (U32 i = 0; i < knobs.size(); ++i) {
+            boost::shared_ptr<KnobI> mainKnob = mainInstance->getKnobByName( knobs[i]->getName() );
+            if (mainKnob) {
+                knobs[i]->clone( mainKnob.get() );
+            }
+        }
+
+        {
+            ///Take the preferences lock so that it cannot be modified throughout the action.
+            QReadLocker preferencesLocker(_preferencesLock);
+            stat = _effect->createInstanceAction();
+        }
+    }
+    if ( (stat != kOfxStatOK) && (stat != kOfxStatReplyDefault) ) {
+        throw std::runtime_error("Could not create effect instance for plugin");
+    }
+
+    {
+        QReadLocker mainPreferencesLocker(mainInstance->_preferencesLock);
+        QWriteLocker preferencesLocker(_preferencesLock);
+        _effect->copyPreferencesFrom( *mainInstance->effectInstance() );
+    }
+
+    ///From now on the plug-in talks to the host through the main instance (abort, progress, messages, memory...)
+    ///which holds the thread-local storage of the render
+    _effect->setOfxEffectInstance(mainInstance);
+    _created = true;
+    _initialized = true;
+}
+
+Natron::EffectInstance*
+OfxEffectInstance::acquireRenderClone()
+{
+    assert(!_renderCloneOf);
+
+    QMutexLocker l(_renderClonesMutex);
+    for (std::list<RenderClone>::iterator it = _renderClones.begin(); it != _renderClones.end(); ++it) {
+        if (!it->isRendering) {
+            it->isRendering = true;
+
+            return it->instance;
+        }
+    }
+
+    if (!_renderClonesFailed) {
+        ///This instance renders too, hence one clone less than the number of parallel renders
+        int maxClones = appPTR->getCurrentSettings()->getNumberOfParallelRenders();
+        if (maxClones == 0) {
+            maxClones = appPTR->getHardwareIdealThreadCount();
+        }
+        maxClones -= 1;
+        if ( ( (int)_renderClones.size() + _nRenderClonesRequested ) < maxClones ) {
+            ///Plug-in instances can only be created on the main thread
+            ++_nRenderClonesRequested;
+            emit renderCloneRequested();
+        }
+    }
+
+    return NULL;
+}
+
+void
+OfxEffectInstance::releaseRenderClone(Natron::EffectInstance* clone)
+{
+    QMutexLocker l(_renderClonesMutex);
+
+    for (std::list<RenderClone>::iterator it = _renderClones.begin(); it != _renderClones.end(); ++it) {
+        if (it->instance == clone) {
+            assert(it->isRendering);
+            for (std::list<KnobChange>::iterator change = it->pendingChanges.begin(); change != it->pendingChanges.end(); ++change) {
+                it->instance->syncKnobFromMainInstance(change->knob, change->ofxReason, change->time);
+            }
+            it->pendingChanges.clear();
+            it->isRendering = false;
+
+            return;
+        }
+    }
+    assert(false);
+}
+
+void
+OfxEffectInstance::onRenderCloneRequested()
+{
+    ///Can only be called in the main thread
+    assert( QThread::currentThread() == qApp->thread() );
+
+    OfxEffectInstance* clone = 0;
+    if (_initialized) {
+        try {
+            clone = new OfxEffectInstance( getNode() );
+            clone->initializeAsRenderClone(this);
+        } catch (const std::exception & e) {
+            qDebug() << getNode()->getName_mt_safe().c_str() << ": failed to create a render clone:" << e.what();
+            delete clone;
+            clone = 0;
+        }
+    }
+
+    QMutexLocker l(_renderClonesMutex);
+    --_nRenderClonesRequested;
+    if (clone) {
+        RenderClone c;
+        c.instance = clone;
+        c.isRendering = false;
+        _renderClones.push_back(c);
+    } else {
+        _renderClonesFailed = true;
+    }
+}
+
+void
+OfxEffectInstance::syncRenderClones(KnobI* k,
+                                    const std::string & ofxReason,
+                                    OfxTime time)
+{
+    QMutexLocker l(_renderClonesMutex);
+
+    for (std::list<RenderClone>::iterator it = _renderClones.begin(); it != _renderClones.end(); ++it) {
+        if (it->isRendering) {
+            ///Don't change the parameters of the clone under the feet of its render
+            KnobChange change;
+            change.knob = k;
+            change.ofxReason = ofxReason;
+            change.time = time;
+            it->pendingChanges.push_back(change);
+        } else {
+            it->instance->syncKnobFromMainInstance(k, ofxReason, time);
+        }
+    }
+}
+
+void
+OfxEffectInstance::syncKnobFromMainInstance(KnobI* mainKnob,
+                                            const std::string & ofxReason,
+                                            OfxTime time)
+{
+    assert(_renderCloneOf);
+
+    boost::shared_ptr<KnobI> cloneKnob = getKnobByName( mainKnob->getName() );
+    if (!cloneKnob) {
+        ///The knob was added by the node and is not a param of the plug-in
+        return;
+    }
+    cloneKnob->clone(mainKnob);
+
+    ///Let the plug-in update the data it derives from the param, as the main instance did
+    OfxPointD renderScale;
+    renderScale.x = renderScale.y = 1;
+    SET_CAN_SET_VALUE(true);
+    ignore_result( _effect->beginInstanceChangedAction(ofxReason) );
+    OfxStatus stat = _effect->paramInstanceChangedAction(mainKnob->getName(), ofxReason, time, renderScale);
+    ignore_result( _effect->endInstanceChangedAction(ofxReason) );
+    if ( (stat != kOfxStatOK) && (stat != kOfxStatReplyDefault) ) {
+        QString err( QString( getNode()->getName_mt_safe().c_str() ) + ": An error occured while changing parameter " +
+                     mainKnob->getDescription().c_str() + " of a render clone" );
+        appPTR->writeToOfxLog_mt_safe(err);
+    }
+}
+
+void
+OfxEffectInstance::syncRenderClonesPreferences()
+{
+    QMutexLocker l(_renderClonesMutex);
+
+    for (std::list<RenderClone>::iterator it = _renderClones.begin(); it != _renderClones.end(); ++it) {
+        QWriteLocker preferencesLocker(it->instance->_preferencesLock);
+        it->instance->_effect->copyPreferencesFrom(*_effect);
+    }
+}
+
+void
+OfxEffectInstance::destroyRenderClones()
+{
+    std::list<RenderClone> clones;
+    {
+        QMutexLocker l(_renderClonesMutex);
+        clones.swap(_renderClones);
+    }
+    for (std::list<RenderClone>::iterator it = clones.begin(); it != clones.end(); ++it) {
+        assert(!it->isRendering);
+        delete it->instance;
+    }
 }
 
 bool
@@ -1137,6 +1383,7 @@ OfxEffectInstance::checkOFXClipPreferences(double time,
         
         effectInstance()->updatePreferences_safe(effectPrefs.frameRate, effectPrefs.fielding, effectPrefs.premult,
                                                  effectPrefs.continuous, effectPrefs.frameVarying);
+        syncRenderClonesPreferences();
     }
     
     
@@ -1886,6 +2133,10 @@ OfxEffectInstance::render(SequenceTime time,
                                             true,//< set mipmaplevel ?
                                             Natron::Image::getLevelFromScale(originalScale.x));
 
+        if (_renderCloneOf) {
+            ///The transforms concatenated by the tree were set on the clips of the main instance
+            _effect->copyClipsTransformFrom( *_renderCloneOf->effectInstance() );
+        }
         
         ///Take the preferences lock so that it cannot be modified throughout the action.
         QReadLocker preferencesLocker(_preferencesLock);
@@ -2384,6 +2635,10 @@ OfxEffectInstance::knobChanged(KnobI* k,
         return;
     }
 
+    std::string ofxReason = natronValueChangedReasonToOfxValueChangedReason(reason);
+    assert( !ofxReason.empty() ); // crashes when resetting to defaults
+    syncRenderClones(k, ofxReason, (OfxTime)time);
+
     ///If the param changed is a button and the node is disabled don't do anything which might
     ///trigger an analysis
     if ( (reason == eValueChangedReasonUserEdited) && dynamic_cast<Button_Knob*>(k) && _node->isNodeDisabled() ) {
@@ -2399,8 +2654,6 @@ OfxEffectInstance::knobChanged(KnobI* k,
     // OFX::Host::Param::paramSetValue() does it for us when it's edited by the plugin
     bool canCallInstanceChangedAction = reason != Natron::eValueChangedReasonPluginEdited;
     
-    std::string ofxReason = natronValueChangedReasonToOfxValueChangedReason(reason);
-    assert( !ofxReason.empty() ); // crashes when resetting to defaults
     OfxPointD renderScale;
     renderScale.x = renderScale.y = 1;
     OfxStatus stat = kOfxStatOK;
@@ -2850,6 +3103,33 @@ OfxEffectInstance::isFrameVarying() const
     return effectInstance()->isFrameVarying();
 }
 
+bool
+OfxEffectInstance::isViewAware() const
+{
+    const QAtomicInt & viewAware = _renderCloneOf ? _renderCloneOf->_viewAware : _viewAware;
+
+#if QT_VERSION < 0x050000
+    return (int)viewAware != 0;
+#else
+    return viewAware.load() != 0;
+#endif
+}
+
+void
+OfxEffectInstance::setViewAware()
+{
+    OfxEffectInstance* mainInstance = getMainInstance();
+    if (mainInstance != this) {
+        _viewAware.fetchAndStoreOrdered(1);
+    }
+    if ( mainInstance->_viewAware.fetchAndStoreOrdered(1) == 0 ) {
+        ///The images cached so far are shared by all views but may differ from one view to another: drop them.
+        ///The nodes downstream no longer look their images up under the shared key either. Renders already
+        ///started may still complete with a shared image.
+        appPTR->removeAllImagesFromCacheWithMatchingKey( mainInstance->getHash() );
+    }
+}
+
 bool
 OfxEffectInstance::doesTemporalClipAccess() const
 {
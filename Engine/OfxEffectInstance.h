@@ -20,6 +20,7 @@
 #endif
 CLANG_DIAG_OFF(deprecated)
 #include <QtCore/QMutex>
+#include <QtCore/QAtomicInt>
 #include <QtCore/QString>
 #include <QtCore/QObject>
 CLANG_DIAG_ON(deprecated)
@@ -131,6 +132,14 @@ public:
         emit syncPrivateDataRequested();
     }
 
+    /**
+     * @brief If this is a render clone, returns the instance it was cloned from, otherwise returns this.
+     **/
+    OfxEffectInstance* getMainInstance() WARN_UNUSED_RETURN
+    {
+        return _renderCloneOf ? _renderCloneOf : this;
+    }
+
 public:
     /********OVERRIDEN FROM EFFECT INSTANCE*************/
     virtual int getMajorVersion() const OVERRIDE FINAL WARN_UNUSED_RETURN;
@@ -202,6 +211,14 @@ public:
                             SequenceTime* inputTime,
                             int* inputNb) OVERRIDE;
     virtual Natron::EffectInstance::RenderSafetyEnum renderThreadSafety() const OVERRIDE FINAL WARN_UNUSED_RETURN;
+
+    /**
+     * @brief Render clones are full instances of the plug-in, with their own parameters mirroring ours, created lazily
+     * on the main thread up to the number of parallel renders. If all of them are rendering, another one is requested
+     * and NULL is returned: the caller then renders with this instance under the per-instance lock.
+     **/
+    virtual Natron::EffectInstance* acquireRenderClone() OVERRIDE FINAL WARN_UNUSED_RETURN;
+    virtual void releaseRenderClone(Natron::EffectInstance* clone) OVERRIDE FINAL;
     virtual void purgeCaches() OVERRIDE;
 
     /**
@@ -268,8 +285,16 @@ public:
     virtual void clearTransform(int inputNb) OVERRIDE FINAL;
 
     virtual bool isFrameVarying() const OVERRIDE FINAL WARN_UNUSED_RETURN;
+    virtual bool isViewAware() const OVERRIDE FINAL WARN_UNUSED_RETURN;
     /********OVERRIDEN FROM EFFECT INSTANCE: END*************/
 
+    /**
+     * @brief Called when the plug-in fetches the image of an explicit view instead of the view being rendered:
+     * from now on its images are cached per view, as well as those of the nodes downstream.
+     * MT-safe, may be called on a render clone.
+     **/
+    void setViewAware();
+
     OfxClipInstance* getClipCorrespondingToInput(int inputNo) const;
 
 
@@ -278,11 +303,15 @@ public slots:
 
     void onSyncPrivateDataRequested();
 
+    void onRenderCloneRequested();
+
 
 signals:
 
     void syncPrivateDataRequested();
 
+    void renderCloneRequested();
+
 private:
     /** @brief Enumerates the contexts a plugin can be used in */
     enum ContextEnum
@@ -305,6 +334,28 @@ private:
 
     void initializeContextDependentParams();
 
+    /**
+     * @brief Makes this instance a render clone of the given instance: instantiates the plug-in in the same context
+     * and copies the parameters values and clip preferences of mainInstance.
+     **/
+    void initializeAsRenderClone(OfxEffectInstance* mainInstance);
+
+    ///Copies the values of the given knob of the main instance to the render clones and forwards the
+    ///instance changed action to them. Clones that are rendering are synced when they are released.
+    void syncRenderClones(KnobI* k,
+                          const std::string & ofxReason,
+                          OfxTime time);
+
+    ///Called on a render clone: copies the values of the knob of the main instance and calls the instance changed action
+    void syncKnobFromMainInstance(KnobI* mainKnob,
+                                  const std::string & ofxReason,
+                                  OfxTime time);
+
+    ///Copies the clip preferences of the main instance to the render clones
+    void syncRenderClonesPreferences();
+
+    void destroyRenderClones();
+
 #ifdef DEBUG
 /*
     Debug helper to track plug-in that do setValue calls that are forbidden
@@ -387,6 +438,27 @@ private:
     mutable QReadWriteLock* _renderSafetyLock;
     ContextEnum _context;
     mutable QReadWriteLock* _preferencesLock;
+
+    struct KnobChange
+    {
+        KnobI* knob; //< knob of the main instance
+        std::string ofxReason;
+        OfxTime time;
+    };
+
+    struct RenderClone
+    {
+        OfxEffectInstance* instance;
+        bool isRendering;
+        std::list<KnobChange> pendingChanges; //< knobs changed while the clone was rendering
+    };
+
+    OfxEffectInstance* _renderCloneOf; //< if this is a render clone, the instance it was cloned from
+    QAtomicInt _viewAware; //< 0 only if the plug-in is known to depend on the view through its inputs only, @see isViewAware
+    mutable QMutex* _renderClonesMutex; //< protects the fields below
+    std::list<RenderClone> _renderClones;
+    int _nRenderClonesRequested; //< clones requested to the main thread but not created yet
+    bool _renderClonesFailed; //< true if the plug-in failed to create a clone, in which case we stop requesting them
 #ifdef DEBUG
     Natron::ThreadStorage<bool> _canSetValue;
 #endif
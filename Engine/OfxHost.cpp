@@ -60,6 +60,7 @@ CLANG_DIAG_ON(deprecated-register)
 #include "Engine/StandardPaths.h"
 #include "Engine/Settings.h"
 #include "Engine/Node.h"
+#include "Engine/RenderPriorityScheduler.h"
 
 using namespace Natron;
 
@@ -685,9 +686,13 @@ static OfxStatus
 threadFunctionWrapper(OfxThreadFunctionV1 func,
                       unsigned int threadIndex,
                       unsigned int threadMax,
-                      void *customArg)
+                      void *customArg,
+                      Natron::RenderPriorityEnum priority)
 {
     assert(threadIndex < threadMax);
+    ///The thread of the pool works on behalf of the render that called multiThread
+    Natron::RenderPriorityScope priorityScope(priority, true);
+    
     std::list<int>& localData = gThreadIndex.localData();
     localData.push_back((int)threadIndex);
 
@@ -806,7 +811,8 @@ Natron::OfxHost::multiThread(OfxThreadFunctionV1 func,
         
         /// DON'T set the maximum thread count, this is a global application setting, and see the documentation excerpt above
         //QThreadPool::globalInstance()->setMaxThreadCount(nThreads);
-        QFuture<OfxStatus> future = QtConcurrent::mapped( threadIndexes, boost::bind(::threadFunctionWrapper,func, _1, nThreads, customArg) );
+        QFuture<OfxStatus> future = QtConcurrent::mapped( threadIndexes, boost::bind(::threadFunctionWrapper,func, _1, nThreads, customArg,
+                                                                                                   Natron::RenderPriorityScheduler::getCurrentThreadPriority()) );
         future.waitForFinished();
         ///DON'T reset back to the original value the maximum thread count
         //QThreadPool::globalInstance()->setMaxThreadCount(QThread::idealThreadCount());
@@ -915,6 +921,10 @@ Natron::OfxHost::multiThreadNumCPUS(unsigned int *nCPUs) const
         ///+1 because the current thread is going to wait during the multiThread call so we're better off
         ///not counting it.
         *nCPUs = std::max(1,std::min(maxThreadsCount - activeThreadsCount + 1, nThreadsPerEffect));
+        
+        ///Leave the pool to the renders of a higher priority, @see RenderPriorityScheduler
+        Natron::RenderPriorityEnum priority = Natron::RenderPriorityScheduler::getCurrentThreadPriority();
+        *nCPUs = std::min( *nCPUs, (unsigned int)Natron::RenderPriorityScheduler::getAvailablePoolThreads(priority) + 1 );
     }
 
     return kOfxStatOK;
@@ -97,7 +97,8 @@ OfxImageEffectInstance::newClipInstance(OFX::Host::ImageEffect::Instance* plugin
 {
     (void)plugin;
 
-    return new OfxClipInstance(getOfxEffectInstance(), this, index, descriptor);
+    ///The clips of a render clone fetch their images through the main instance, which holds the render thread-local storage
+    return new OfxClipInstance(getOfxEffectInstance()->getMainInstance(), this, index, descriptor);
 }
 
 OfxStatus
@@ -795,6 +796,34 @@ OfxImageEffectInstance::discardClipsMipMapLevel()
     }
 }
 
+void
+OfxImageEffectInstance::recycleClipsImages()
+{
+    for (std::map<std::string, OFX::Host::ImageEffect::ClipInstance*>::iterator it = _clips.begin(); it != _clips.end(); ++it) {
+        OfxClipInstance* clip = dynamic_cast<OfxClipInstance*>(it->second);
+        assert(clip);
+        if (clip) {
+            clip->recycleImages();
+        }
+    }
+}
+
+void
+OfxImageEffectInstance::copyClipsTransformFrom(const OfxImageEffectInstance& other)
+{
+    for (std::map<std::string, OFX::Host::ImageEffect::ClipInstance*>::iterator it = _clips.begin(); it != _clips.end(); ++it) {
+        if ( it->second->isOutput() ) {
+            continue;
+        }
+        OfxClipInstance* clip = dynamic_cast<OfxClipInstance*>(it->second);
+        OfxClipInstance* otherClip = dynamic_cast<OfxClipInstance*>( other.getClip(it->first) );
+        assert(clip && otherClip);
+        if (clip && otherClip) {
+            clip->copyTransformFrom(*otherClip);
+        }
+    }
+}
+
 bool
 OfxImageEffectInstance::areAllNonOptionalClipsConnected() const
 {
@@ -966,6 +995,23 @@ OfxImageEffectInstance::getClips() const
     return _clips;
 }
 
+void
+OfxImageEffectInstance::copyPreferencesFrom(const OfxImageEffectInstance& other)
+{
+    for (std::map<std::string, OFX::Host::ImageEffect::ClipInstance*>::iterator it = _clips.begin(); it != _clips.end(); ++it) {
+        OfxClipInstance* clip = dynamic_cast<OfxClipInstance*>(it->second);
+        OfxClipInstance* otherClip = dynamic_cast<OfxClipInstance*>( other.getClip(it->first) );
+        assert(clip && otherClip);
+        if (clip && otherClip) {
+            clip->setComponents( otherClip->getComponents() );
+            clip->setPixelDepth( otherClip->getPixelDepth() );
+            clip->setAspectRatio( otherClip->getAspectRatio() );
+        }
+    }
+    updatePreferences_safe(other._outputFrameRate, other._outputFielding, other._outputPreMultiplication,
+                           other._continuousSamples, other._frameVarying);
+}
+
 bool
 OfxImageEffectInstance::getCanApplyTransform(OfxClipInstance** clip) const
 {
@@ -257,6 +257,12 @@ public:
     void discardClipsView();
     void setClipsMipMapLevel(unsigned int mipMapLevel);
     void discardClipsMipMapLevel();
+    
+    ///Copies on the clips the transforms the tree set on the clips of the given instance for the calling thread
+    void copyClipsTransformFrom(const OfxImageEffectInstance& other);
+    
+    ///Lets the clips reuse the images released by the plug-in during the action, @see OfxClipInstance::recycleImages
+    void recycleClipsImages();
     ////////////////////////////////////////
     ////////////////////////////////////////////////////////////////////////////////////////////////////
 
@@ -264,6 +270,13 @@ public:
     
     const std::map<std::string,OFX::Host::ImageEffect::ClipInstance*>& getClips() const;
     
+    /**
+     * @brief Copies the clip and effect preferences resulting from the getClipPreferences action of the given instance.
+     * Used to keep the render clones of an effect in sync with it without running the action on each of them.
+     * Caller maintains a lock around this call to prevent race conditions.
+     **/
+    void copyPreferencesFrom(const OfxImageEffectInstance& other);
+    
 private:
     OfxEffectInstance* _ofxEffectInstance; /* FIXME: OfxImageEffectInstance should be able to work without the node_ //
                                               Not easy since every Knob need a valid pointer to a node when
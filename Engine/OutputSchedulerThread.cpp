@@ -21,20 +21,25 @@
 #include <QString>
 #include <QThreadPool>
 #include <QDebug>
-#include <QtConcurrentRun>
 #include <QFuture>
 #include <QFutureWatcher>
 #include <QRunnable>
+#include <QElapsedTimer>
 
 #include "Global/MemoryInfo.h"
 
 #include "Engine/AppManager.h"
 #include "Engine/AppInstance.h"
 #include "Engine/EffectInstance.h"
+#include "Engine/FramePrefetcher.h"
 #include "Engine/Image.h"
 #include "Engine/Node.h"
 #include "Engine/OpenGLViewerI.h"
+#include "Engine/PreviewScheduler.h"
 #include "Engine/Project.h"
+#include "Engine/RenderAbortToken.h"
+#include "Engine/RenderPriorityScheduler.h"
+#include "Engine/RenderProfiler.h"
 #include "Engine/Settings.h"
 #include "Engine/Timer.h"
 #include "Engine/TimeLine.h"
@@ -43,6 +48,9 @@
 
 #define NATRON_FPS_REFRESH_RATE_SECONDS 1.5
 
+///How often a render thread held back by renders of a higher priority checks whether it was aborted
+#define NATRON_RENDER_PREEMPTION_POLL_MS 50
+
 
 using namespace Natron;
 
@@ -148,6 +156,7 @@ struct OutputSchedulerThreadPrivate
     bool isAbortRequestBlocking;
     QWaitCondition abortedRequestedCondition;
     QMutex abortedRequestedMutex; // protects abortRequested
+    QElapsedTimer abortLatencyTimer; // protected by abortedRequestedMutex, started by the first abort request of a render
 
     
     QMutex abortBeingProcessedMutex; //protects abortBeingProcessed
@@ -201,6 +210,12 @@ struct OutputSchedulerThreadPrivate
     Natron::OutputEffectInstance* outputEffect; //< The effect used as output device
     RenderEngine* engine;
 
+    ///Reads ahead the frames of the readers while the render threads process the previous frames
+    boost::scoped_ptr<FramePrefetcher> prefetcher;
+    
+    ///Peak memory held by the frames of the current render, reset when a render starts
+    boost::shared_ptr<FramePeakAverage> framePeak;
+
     
     OutputSchedulerThreadPrivate(RenderEngine* engine,Natron::OutputEffectInstance* effect,OutputSchedulerThread::ProcessFrameModeEnum mode)
     : buf()
@@ -219,6 +234,7 @@ struct OutputSchedulerThreadPrivate
     , isAbortRequestBlocking(false)
     , abortedRequestedCondition()
     , abortedRequestedMutex()
+    , abortLatencyTimer()
     , abortBeingProcessedMutex()
     , abortBeingProcessed(false)
     , processRunning(false)
@@ -241,6 +257,8 @@ struct OutputSchedulerThreadPrivate
     , framesToRenderNotEmptyCond()
     , outputEffect(effect)
     , engine(engine)
+    , prefetcher(new FramePrefetcher(effect))
+    , framePeak(new FramePeakAverage)
     {
        
     }
@@ -327,6 +345,26 @@ struct OutputSchedulerThreadPrivate
                                      int firstFrame,
                                      int lastFrame,
                                      int* nextFrame);
+
+    /**
+     * @brief Asks the prefetcher to read ahead count frames of the sequence, starting at frame
+     **/
+    void prefetchFramesInSequence(PlaybackModeEnum pMode,
+                                  OutputSchedulerThread::RenderDirectionEnum direction,
+                                  int frame,
+                                  int firstFrame,
+                                  int lastFrame,
+                                  int count)
+    {
+        std::list<int> frames;
+        for (int i = 0; i < count; ++i) {
+            frames.push_back(frame);
+            if ( !getNextFrameInSequence(pMode, direction, frame, firstFrame, lastFrame, &frame, &direction) ) {
+                break;
+            }
+        }
+        prefetcher->setFramesToPrefetch(frames);
+    }
     
     /**
      * @brief Checks if mustQuit has been set to true, if so then it will return true and the scheduler thread should stop
@@ -431,6 +469,8 @@ OutputSchedulerThread::OutputSchedulerThread(RenderEngine* engine,Natron::Output
 
 OutputSchedulerThread::~OutputSchedulerThread()
 {
+    _imp->prefetcher->quitThread();
+
     ///Wake-up all threads and tell them that they must quit
     stopRenderThreads(0);
     
@@ -581,6 +621,7 @@ OutputSchedulerThread::pushFramesToRenderInternal(int startingFrame,int nThreads
         _imp->lastFramePushedIndex = startingFrame;
     } else {
         ///Push 2x the count of threads to be sure no one will be waiting
+        bool hasNextFrame = true;
         while ((int)_imp->framesToRender.size() < nThreads * 2) {
             _imp->framesToRender.push_back(startingFrame);
             
@@ -588,9 +629,15 @@ OutputSchedulerThread::pushFramesToRenderInternal(int startingFrame,int nThreads
             
             if (!OutputSchedulerThreadPrivate::getNextFrameInSequence(pMode, direction, startingFrame,
                                                                       firstFrame, lastFrame, &startingFrame, &direction)) {
+                hasNextFrame = false;
                 break;
             }
         }
+        
+        ///Read ahead the frames that will be pushed next
+        if (hasNextFrame) {
+            _imp->prefetchFramesInSequence(pMode, direction, startingFrame, firstFrame, lastFrame, nThreads * 2);
+        }
     }
   
     ///Wake up render threads to notify them theres work to do
@@ -620,6 +667,8 @@ OutputSchedulerThread::pushAllFrameRange()
             _imp->framesToRender.push_back(i);
         }
     }
+    ///The render threads pick the frames in order, the budget of the prefetcher limits how far ahead it reads
+    _imp->prefetcher->setFramesToPrefetch(_imp->framesToRender);
     ///Wake up render threads to notify them theres work to do
     _imp->framesToRenderNotEmptyCond.wakeAll();
 }
@@ -708,6 +757,8 @@ OutputSchedulerThread::pickFrameToRender(RenderThreadTask* thread)
         int ret = _imp->framesToRender.front();
         _imp->framesToRender.pop_front();
         
+        _imp->prefetcher->notifyFrameRenderStarted(ret);
+        
         ///Flag the thread as active
         {
             QMutexLocker l(&_imp->renderThreadsMutex);
@@ -744,8 +795,13 @@ OutputSchedulerThread::startRender()
     
     if ( isFPSRegulationNeeded() ) {
         _imp->timer->playState = ePlayStateRunning;
+        ///The first frame of this render is due immediately, not one period after the last frame of the previous one
+        _imp->timer->resetPlayback();
     }
     
+    ///The tree may have changed since the previous render, do not bound the parallel renders with its frames
+    _imp->framePeak->reset();
+    
     ///We will push frame to renders starting at startingFrame.
     ///They will be in the range determined by firstFrame-lastFrame
     int startingFrame;
@@ -762,6 +818,10 @@ OutputSchedulerThread::startRender()
     
     aboutToStartRender();
     
+    if (firstFrame != lastFrame) {
+        _imp->prefetcher->beginPrefetching();
+    }
+    
     ///Flag that we're now doing work
     {
         QMutexLocker l(&_imp->workingMutex);
@@ -822,6 +882,7 @@ void
 OutputSchedulerThread::stopRender()
 {
     _imp->timer->playState = ePlayStatePause;
+    _imp->prefetcher->cancelPrefetching();
     
     ///Wait for all render threads to be done
     {
@@ -831,6 +892,14 @@ OutputSchedulerThread::stopRender()
         _imp->waitForRenderThreadsToBeDone();
     }
     
+    ///All render threads are idle: this is how long the abort took to be effective
+    {
+        QMutexLocker l(&_imp->abortedRequestedMutex);
+        if (_imp->abortRequested > 0) {
+            RenderProfiler::recordAbortLatency(_imp->abortLatencyTimer.nsecsElapsed() * 1e-9);
+        }
+    }
+    
     
     ///If the output effect is sequential (only WriteFFMPEG for now)
     Natron::SequentialPreferenceEnum pref = _imp->outputEffect->getSequentialPreference();
@@ -1117,6 +1186,12 @@ OutputSchedulerThread::run()
     
 }
 
+boost::shared_ptr<FrameMemoryBudget>
+OutputSchedulerThread::createFrameMemoryBudget() const
+{
+    return boost::shared_ptr<FrameMemoryBudget>( new FrameMemoryBudget(FrameMemoryBudget::getRenderMemoryBudget(), _imp->framePeak) );
+}
+
 void
 OutputSchedulerThread::adjustNumberOfThreads(int* newNThreads)
 {
@@ -1138,6 +1213,16 @@ OutputSchedulerThread::adjustNumberOfThreads(int* newNThreads)
     } else {
         optimalNThreads = userSettingParallelThreads;
     }
+    
+    ///Do not render more frames in parallel than what the memory left to rendering can hold, based on
+    ///the peak memory held by the tree for the frames of this render.
+    U64 framePeak = _imp->framePeak->getAverage();
+    if (framePeak > 0) {
+        U64 framesFittingInMemory = FrameMemoryBudget::getRenderMemoryBudget() / framePeak;
+        if (framesFittingInMemory < (U64)optimalNThreads) {
+            optimalNThreads = (int)framesFittingInMemory;
+        }
+    }
     optimalNThreads = std::max(1,optimalNThreads);
 
 
@@ -1314,6 +1399,12 @@ OutputSchedulerThread::abortRendering(bool blocking)
                 ///Flag the whole tree recursively that we aborted
                 _imp->outputEffect->getApp()->getProject()->setAllNodesAborted(true);
                 
+                ///And the frames being rendered, so that they stop without waiting for their nodes to check
+                RenderAbortToken::abortRendersFromPlayback( _imp->outputEffect->getApp() );
+                
+                if (_imp->abortRequested == 0) {
+                    _imp->abortLatencyTimer.start();
+                }
                 ++_imp->abortRequested;
             }
             
@@ -1322,6 +1413,7 @@ OutputSchedulerThread::abortRendering(bool blocking)
                 QMutexLocker framesLocker (&_imp->framesToRenderMutex);
                 _imp->framesToRender.clear();
             }
+            _imp->prefetcher->cancelPrefetching();
             
             
             if (isMainThread) {
@@ -1379,6 +1471,8 @@ OutputSchedulerThread::quitThread()
         }
     }
     
+    _imp->prefetcher->quitThread();
+    
     ///Wake-up all threads and tell them that they must quit
     stopRenderThreads(0);
 
@@ -1410,6 +1504,12 @@ OutputSchedulerThread::getDesiredFPS() const
     return _imp->timer->getDesiredFrameRate();
 }
 
+void
+OutputSchedulerThread::getPlaybackStats(PlaybackStats* stats) const
+{
+    _imp->timer->getPlaybackStats(stats);
+}
+
 void
 OutputSchedulerThread::renderFrameRange(int firstFrame,int lastFrame,RenderDirectionEnum direction)
 {
@@ -1507,6 +1607,13 @@ OutputSchedulerThread::isWorking() const
     return _imp->working;
 }
 
+bool
+OutputSchedulerThread::isBeingAborted() const
+{
+    QMutexLocker l(&_imp->abortedRequestedMutex);
+    return _imp->abortRequested > 0;
+}
+
 
 void
 OutputSchedulerThread::getFrameRangeRequestedToRender(int &first,int& last) const
@@ -1602,7 +1709,9 @@ struct RenderThreadTaskPrivate
     QMutex runningMutex;
     bool running;
     
-    RenderThreadTaskPrivate(Natron::OutputEffectInstance* output,OutputSchedulerThread* scheduler)
+    Natron::RenderPriorityEnum priority;
+    
+    RenderThreadTaskPrivate(Natron::OutputEffectInstance* output,OutputSchedulerThread* scheduler,Natron::RenderPriorityEnum priority)
     : scheduler(scheduler)
     , output(output)
     , mustQuitMutex()
@@ -1610,15 +1719,16 @@ struct RenderThreadTaskPrivate
     , hasQuit(false)
     , runningMutex()
     , running(false)
+    , priority(priority)
     {
         
     }
 };
 
 
-RenderThreadTask::RenderThreadTask(Natron::OutputEffectInstance* output,OutputSchedulerThread* scheduler)
+RenderThreadTask::RenderThreadTask(Natron::OutputEffectInstance* output,OutputSchedulerThread* scheduler,Natron::RenderPriorityEnum priority)
 : QThread()
-, _imp(new RenderThreadTaskPrivate(output,scheduler))
+, _imp(new RenderThreadTaskPrivate(output,scheduler,priority))
 {
     setObjectName("Parallel render thread");
 }
@@ -1634,6 +1744,11 @@ RenderThreadTask::run()
     
     notifyIsRunning(true);
     
+    ///Let the operating system favor the threads rendering what the user is looking at
+    if ( (_imp->priority == eRenderPriorityBackground) && !appPTR->isBackground() ) {
+        setPriority(QThread::LowPriority);
+    }
+    
     for (;;) {
         
         int time = _imp->scheduler->pickFrameToRender(this);
@@ -1642,7 +1757,21 @@ RenderThreadTask::run()
             break;
         }
         
-        renderFrame(time);
+        ///Do not start the frame while renders of a higher priority are using the CPU, @see RenderPriorityScheduler
+        while ( !RenderPriorityScheduler::waitForHigherPriorityRenders(_imp->priority, NATRON_RENDER_PREEMPTION_POLL_MS) ) {
+            if ( mustQuit() || _imp->scheduler->isBeingAborted() ) {
+                break;
+            }
+        }
+        
+        if ( mustQuit() ) {
+            break;
+        }
+        
+        {
+            RenderPriorityScope priorityScope(_imp->priority);
+            renderFrame(time);
+        }
         
         if ( mustQuit() ) {
             break;
@@ -1718,7 +1847,7 @@ class DefaultRenderFrameRunnable : public RenderThreadTask
 public:
     
     DefaultRenderFrameRunnable(Natron::OutputEffectInstance* writer,OutputSchedulerThread* scheduler)
-    : RenderThreadTask(writer,scheduler)
+    : RenderThreadTask(writer,scheduler,eRenderPriorityBackground)
     {
         
     }
@@ -1808,7 +1937,8 @@ private:
                                                                    true,
                                                                    activeInputToRenderHash,
                                                                    false,
-                                                                   _imp->output->getApp()->getTimeLine().get());
+                                                                   _imp->output->getApp()->getTimeLine().get(),
+                                                                   _imp->scheduler->createFrameMemoryBudget());
                     
                     boost::shared_ptr<Natron::Image> img =
                     activeInputToRender->renderRoI( EffectInstance::RenderRoIArgs(time, //< the time at which to render
@@ -1892,7 +2022,8 @@ DefaultScheduler::processFrame(const BufferedFrames& frames)
                                                        true,
                                                        hash,
                                                        false,
-                                                       _effect->getApp()->getTimeLine().get());
+                                                       _effect->getApp()->getTimeLine().get(),
+                                                       createFrameMemoryBudget());
         
         ImagePtr inputImage = boost::dynamic_pointer_cast<Natron::Image>(it->frame);
         assert(inputImage);
@@ -2082,7 +2213,7 @@ class ViewerRenderFrameRunnable : public RenderThreadTask
 public:
     
     ViewerRenderFrameRunnable(ViewerInstance* viewer,OutputSchedulerThread* scheduler)
-    : RenderThreadTask(viewer,scheduler)
+    : RenderThreadTask(viewer,scheduler,eRenderPriorityPlayback)
     , _viewer(viewer)
     {
         
@@ -2113,7 +2244,12 @@ private:
         
         for (int i = 0; i < 2; ++i) {
             args[i].reset(new ViewerInstance::ViewerArgs);
-            status[i] = _viewer->getRenderViewerArgsAndCheckCache(time, view, i, viewerHash, args[i].get());
+            status[i] = _viewer->getRenderViewerArgsAndCheckCache(time, view, i, viewerHash, true, args[i].get());
+        }
+        ///Both textures are part of the same frame
+        boost::shared_ptr<FrameMemoryBudget> memoryBudget = _imp->scheduler->createFrameMemoryBudget();
+        for (int i = 0; i < 2; ++i) {
+            args[i]->memoryBudget = memoryBudget;
         }
        
         if (status[0] == eStatusFailed && status[1] == eStatusFailed) {
@@ -2232,9 +2368,22 @@ RenderEngine::createScheduler(Natron::OutputEffectInstance* effect)
     return new DefaultScheduler(this,effect);
 }
 
+/**
+ * @brief Previews must not compete with a viewer for the cores: abort the one being rendered, it will be
+ * rendered again once the viewers are idle.
+ **/
+static void
+abortRunningPreviewForViewer(Natron::OutputEffectInstance* output)
+{
+    if ( dynamic_cast<ViewerInstance*>(output) ) {
+        output->getApp()->getPreviewScheduler()->abortRunningPreview();
+    }
+}
+
 void
 RenderEngine::renderFrameRange(int firstFrame,int lastFrame,OutputSchedulerThread::RenderDirectionEnum forward)
 {
+    abortRunningPreviewForViewer(_imp->output);
     {
         QMutexLocker k(&_imp->schedulerCreationLock);
         if (!_imp->scheduler) {
@@ -2248,7 +2397,7 @@ RenderEngine::renderFrameRange(int firstFrame,int lastFrame,OutputSchedulerThrea
 void
 RenderEngine::renderFromCurrentFrame(OutputSchedulerThread::RenderDirectionEnum forward)
 {
-    
+    abortRunningPreviewForViewer(_imp->output);
     {
         QMutexLocker k(&_imp->schedulerCreationLock);
         if (!_imp->scheduler) {
@@ -2270,6 +2419,7 @@ RenderEngine::renderCurrentFrame(bool canAbort)
         return;
     }
     
+    abortRunningPreviewForViewer(_imp->output);
     
     ///If the scheduler is already doing playback, continue it
     if ( _imp->scheduler && _imp->scheduler->isWorking() ) {
@@ -2382,6 +2532,17 @@ RenderEngine::getDesiredFPS() const
     return _imp->scheduler ? _imp->scheduler->getDesiredFPS() : 24;
 }
 
+bool
+RenderEngine::getPlaybackStats(PlaybackStats* stats) const
+{
+    if (!_imp->scheduler) {
+        return false;
+    }
+    _imp->scheduler->getPlaybackStats(stats);
+
+    return true;
+}
+
 
 OutputSchedulerThread*
 ViewerRenderEngine::createScheduler(Natron::OutputEffectInstance* effect) 
@@ -2493,10 +2654,13 @@ static void renderCurrentFrameFunctor(CurrentFrameFunctorArgs& args)
     StatusEnum stat;
     
     BufferableObjectList ret;
-    try {
-        stat = args.viewer->renderViewer(args.view,QThread::currentThread() == qApp->thread(),false,args.viewerHash,args.canAbort,args.args);
-    } catch (...) {
-        stat = eStatusFailed;
+    {
+        RenderPriorityScope priorityScope(eRenderPriorityInteractive);
+        try {
+            stat = args.viewer->renderViewer(args.view,QThread::currentThread() == qApp->thread(),false,args.viewerHash,args.canAbort,args.args);
+        } catch (...) {
+            stat = eStatusFailed;
+        }
     }
     
     if (stat == eStatusFailed) {
@@ -2523,6 +2687,34 @@ static void renderCurrentFrameFunctor(CurrentFrameFunctorArgs& args)
     
 }
 
+/**
+ * @brief Runs renderCurrentFrameFunctor in the global thread pool, ahead of the tiles queued there by the renders
+ * of a lower priority, @see RenderPriorityScheduler::getPoolTaskPriority
+ **/
+class CurrentFrameFunctorRunnable : public QRunnable
+{
+    CurrentFrameFunctorArgs _args;
+    
+public:
+    
+    CurrentFrameFunctorRunnable(const CurrentFrameFunctorArgs& args)
+    : QRunnable()
+    , _args(args)
+    {
+        
+    }
+    
+    virtual ~CurrentFrameFunctorRunnable()
+    {
+        
+    }
+    
+    virtual void run() OVERRIDE FINAL
+    {
+        renderCurrentFrameFunctor(_args);
+    }
+};
+
 ViewerCurrentFrameRequestScheduler::ViewerCurrentFrameRequestScheduler(ViewerInstance* viewer)
 : QThread()
 , _imp(new ViewerCurrentFrameRequestSchedulerPrivate(viewer))
@@ -2728,7 +2920,7 @@ ViewerCurrentFrameRequestScheduler::renderCurrentFrame(bool canAbort)
     boost::shared_ptr<ViewerInstance::ViewerArgs> args[2];
     for (int i = 0; i < 2; ++i) {
         args[i].reset(new ViewerInstance::ViewerArgs);
-        status[i] = _imp->viewer->getRenderViewerArgsAndCheckCache(frame, view, i, viewerHash, args[i].get());
+        status[i] = _imp->viewer->getRenderViewerArgsAndCheckCache(frame, view, i, viewerHash, false, args[i].get());
     }
     
     if (status[0] == eStatusFailed && status[1] == eStatusFailed) {
@@ -2776,7 +2968,8 @@ ViewerCurrentFrameRequestScheduler::renderCurrentFrame(bool canAbort)
                 }
             }
             functorArgs.request = request;
-            QtConcurrent::run(renderCurrentFrameFunctor,functorArgs);
+            QThreadPool::globalInstance()->start( new CurrentFrameFunctorRunnable(functorArgs),
+                                                  RenderPriorityScheduler::getPoolTaskPriority(eRenderPriorityInteractive) );
         }
     }
 }
@@ -29,6 +29,8 @@ namespace Natron {
 }
 
 class RenderEngine;
+class FrameMemoryBudget;
+struct PlaybackStats;
 
 /**
  * @brief Stub class used by internal implementation of OutputSchedulerThread to pass objects through signal/slots
@@ -84,7 +86,10 @@ class RenderThreadTask :  public QThread
     
 public:
     
-    RenderThreadTask(Natron::OutputEffectInstance* output,OutputSchedulerThread* scheduler);
+    /**
+     * @param priority The priority of the frames rendered by the thread, @see RenderPriorityScheduler
+     **/
+    RenderThreadTask(Natron::OutputEffectInstance* output,OutputSchedulerThread* scheduler,Natron::RenderPriorityEnum priority);
     
     virtual ~RenderThreadTask();
     
@@ -198,6 +203,11 @@ public:
      * @brief Returns true if the scheduler is active and some render threads are doing work.
      **/
     bool isWorking() const;
+    
+    /**
+     * @brief Returns true if abortRendering() was called and the render threads did not stop yet.
+     **/
+    bool isBeingAborted() const;
 
     
     void doAbortRenderingOnMainThread (bool blocking)
@@ -244,11 +254,22 @@ public:
      **/
     double getDesiredFPS() const;
     
+    /**
+     * @brief Returns how regularly the frames of the current (or last) playback were presented
+     **/
+    void getPlaybackStats(PlaybackStats* stats) const;
+    
     /**
      * @brief Returns the frame range of the output node, as given by the getFrameRange action
      **/
     void getPluginFrameRange(int& first,int &last) const;
     
+    /**
+     * @brief Returns a new memory budget for a frame of this render. The peak memory held by the frame
+     * is used to bound the number of frames this scheduler renders in parallel.
+     **/
+    boost::shared_ptr<FrameMemoryBudget> createFrameMemoryBudget() const;
+    
     
     
 public slots:
@@ -573,6 +594,12 @@ public:
      **/
     double getDesiredFPS() const;
     
+    /**
+     * @brief Returns how regularly the frames of the current (or last) playback were presented.
+     * Returns false if the engine has no scheduler yet.
+     **/
+    bool getPlaybackStats(PlaybackStats* stats) const;
+    
     /**
      * @brief Quit all processing, making sure all threads are finished.
      **/
@@ -0,0 +1,222 @@
+//  Natron
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "PreviewScheduler.h"
+
+#include <list>
+#include <vector>
+#include <QMutex>
+#include <QWaitCondition>
+#ifndef Q_MOC_RUN
+#include <boost/weak_ptr.hpp>
+#endif
+
+#include "Engine/AppInstance.h"
+#include "Engine/Node.h"
+#include "Engine/Project.h"
+#include "Engine/RenderAbortToken.h"
+#include "Engine/RenderPriorityScheduler.h"
+#include "Engine/ViewerInstance.h"
+#include "Engine/OutputSchedulerThread.h"
+
+///How often the scheduler checks whether the viewers are done rendering, in milliseconds
+#define NATRON_PREVIEW_VIEWER_IDLE_POLL_INTERVAL 50
+
+namespace {
+struct PreviewRequest
+{
+    boost::weak_ptr<Natron::Node> node;
+    Natron::Node* nodePtr; //< only used to compare requests, never dereferenced
+    int time;
+};
+}
+
+struct PreviewSchedulerPrivate
+{
+    AppInstance* app;
+
+    mutable QMutex queueMutex; //< protects queue, running, runningToken, mustQuit
+    QWaitCondition queueCond;
+    std::list<PreviewRequest> queue;
+    Natron::Node* running; //< the node whose preview is being rendered
+    ///Shared by all the threads rendering the running preview, aborted when it must stop
+    boost::shared_ptr<Natron::RenderAbortToken> runningToken;
+    bool mustQuit;
+
+    PreviewSchedulerPrivate(AppInstance* app)
+        : app(app)
+          , queueMutex()
+          , queueCond()
+          , queue()
+          , running(0)
+          , runningToken()
+          , mustQuit(false)
+    {
+    }
+
+    bool isAnyViewerRendering() const
+    {
+        std::vector<boost::shared_ptr<Natron::Node> > nodes = app->getProject()->getCurrentNodes();
+
+        for (std::vector<boost::shared_ptr<Natron::Node> >::iterator it = nodes.begin(); it != nodes.end(); ++it) {
+            ViewerInstance* isViewer = dynamic_cast<ViewerInstance*>( (*it)->getLiveInstance() );
+            if ( isViewer && isViewer->getRenderEngine()->hasThreadsWorking() ) {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    /**
+     * @brief Waits for a request and for the viewers to be idle, then pops the request and sets the
+     * token of its render. Returns false if the thread must quit.
+     **/
+    bool waitForRequest(PreviewRequest* request,
+                        boost::shared_ptr<Natron::RenderAbortToken>* token)
+    {
+        QMutexLocker k(&queueMutex);
+
+        for (;;) {
+            while ( queue.empty() && !mustQuit ) {
+                queueCond.wait(&queueMutex);
+            }
+            if (mustQuit) {
+                return false;
+            }
+            k.unlock();
+            bool viewerRendering = isAnyViewerRendering();
+            k.relock();
+            if (!viewerRendering) {
+                break;
+            }
+            queueCond.wait(&queueMutex, NATRON_PREVIEW_VIEWER_IDLE_POLL_INTERVAL);
+        }
+        *request = queue.front();
+        queue.pop_front();
+        running = request->nodePtr;
+        runningToken.reset( new Natron::RenderAbortToken(app, true) );
+        *token = runningToken;
+
+        return true;
+    }
+
+    /**
+     * @brief Queues the request again unless a newer request for the same node was made in the meantime.
+     **/
+    void requeue(const PreviewRequest& request)
+    {
+        QMutexLocker k(&queueMutex);
+
+        for (std::list<PreviewRequest>::iterator it = queue.begin(); it != queue.end(); ++it) {
+            if (it->nodePtr == request.nodePtr) {
+                return;
+            }
+        }
+        queue.push_back(request);
+    }
+};
+
+PreviewScheduler::PreviewScheduler(AppInstance* app)
+    : QThread()
+      , _imp( new PreviewSchedulerPrivate(app) )
+{
+    setObjectName("PreviewScheduler");
+}
+
+PreviewScheduler::~PreviewScheduler()
+{
+}
+
+void
+PreviewScheduler::requestPreview(const boost::shared_ptr<Natron::Node>& node,
+                                 int time)
+{
+    {
+        QMutexLocker k(&_imp->queueMutex);
+        bool found = false;
+        for (std::list<PreviewRequest>::iterator it = _imp->queue.begin(); it != _imp->queue.end(); ++it) {
+            if (it->nodePtr == node.get()) {
+                it->time = time;
+                found = true;
+                break;
+            }
+        }
+        if (!found) {
+            PreviewRequest r;
+            r.node = node;
+            r.nodePtr = node.get();
+            r.time = time;
+            _imp->queue.push_back(r);
+        }
+        _imp->queueCond.wakeOne();
+    }
+    if ( !isRunning() ) {
+        start(QThread::LowestPriority);
+    }
+}
+
+void
+PreviewScheduler::abortRunningPreview()
+{
+    QMutexLocker k(&_imp->queueMutex);
+
+    if (_imp->runningToken) {
+        _imp->runningToken->abort();
+    }
+}
+
+void
+PreviewScheduler::quitThread()
+{
+    if ( !isRunning() ) {
+        return;
+    }
+    {
+        QMutexLocker k(&_imp->queueMutex);
+        _imp->mustQuit = true;
+        _imp->queue.clear();
+        if (_imp->runningToken) {
+            _imp->runningToken->abort();
+        }
+        _imp->queueCond.wakeOne();
+    }
+    wait();
+}
+
+void
+PreviewScheduler::run()
+{
+    PreviewRequest request;
+    boost::shared_ptr<Natron::RenderAbortToken> token;
+
+    while ( _imp->waitForRequest(&request, &token) ) {
+        boost::shared_ptr<Natron::Node> node = request.node.lock();
+        if ( node && node->isActivated() ) {
+            int w = NATRON_PREVIEW_WIDTH;
+            int h = NATRON_PREVIEW_HEIGHT;
+#ifndef __NATRON_WIN32__
+            std::vector<unsigned int> buf(w * h, 0);
+#else
+            std::vector<unsigned int> buf(w * h, 0xFF000000); // opaque black
+#endif
+            bool success;
+            {
+                Natron::RenderPriorityScope priorityScope(Natron::eRenderPriorityBackground);
+                success = node->makePreviewImage(request.time, &w, &h, &buf.front(), token);
+            }
+            if ( token->isAborted() ) {
+                ///A viewer started rendering, the preview may be incomplete
+                _imp->requeue(request);
+            } else if (success) {
+                node->setPreviewImage(request.time, w, h, &buf.front());
+            }
+        }
+        QMutexLocker k(&_imp->queueMutex);
+        _imp->running = 0;
+        _imp->runningToken.reset();
+        token.reset();
+    }
+}
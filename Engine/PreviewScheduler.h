@@ -0,0 +1,62 @@
+//  Natron
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef NATRON_ENGINE_PREVIEWSCHEDULER_H_
+#define NATRON_ENGINE_PREVIEWSCHEDULER_H_
+
+#include <QThread>
+#ifndef Q_MOC_RUN
+#include <boost/shared_ptr.hpp>
+#include <boost/scoped_ptr.hpp>
+#endif
+#include "Global/Macros.h"
+
+class AppInstance;
+namespace Natron {
+class Node;
+}
+
+struct PreviewSchedulerPrivate;
+
+/**
+ * @brief The thread rendering the previews of the nodes of an app instance, one at a time and at the lowest priority.
+ * Requests for a node that is already waiting in the queue are coalesced: only the most recent time is rendered.
+ * Previews are never rendered while a viewer is rendering, and a preview being rendered when a viewer render
+ * starts is aborted and rendered again later, so that previews do not steal cores from the viewer during interaction.
+ * Once rendered, the preview is handed to the node with Node::setPreviewImage().
+ **/
+class PreviewScheduler
+    : public QThread
+{
+public:
+
+    PreviewScheduler(AppInstance* app);
+
+    virtual ~PreviewScheduler();
+
+    /**
+     * @brief Queues the rendering of the preview of the given node at the given time.
+     * If the node is already in the queue, only the time of its request is updated.
+     **/
+    void requestPreview(const boost::shared_ptr<Natron::Node>& node,int time);
+
+    /**
+     * @brief Aborts the preview being rendered, if any. It is queued again and will be rendered
+     * once the viewers are idle. This does not wait for the render to return.
+     **/
+    void abortRunningPreview();
+
+    /**
+     * @brief Stops the thread and waits for it to return. Pending requests are discarded.
+     **/
+    void quitThread();
+
+private:
+
+    virtual void run() OVERRIDE FINAL;
+    boost::scoped_ptr<PreviewSchedulerPrivate> _imp;
+};
+
+#endif // NATRON_ENGINE_PREVIEWSCHEDULER_H_
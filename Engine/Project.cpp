@@ -46,6 +46,7 @@
 #include "Engine/KnobFile.h"
 #include "Engine/StandardPaths.h"
 #include "Engine/OutputSchedulerThread.h"
+#include "Engine/Timer.h"
 
 using std::cout; using std::endl;
 using std::make_pair;
@@ -233,14 +234,27 @@ Project::loadProjectInternal(const QString & path,
             QMutexLocker k(&_imp->isLoadingProjectMutex);
             _imp->isLoadingProjectInternal = true;
         }
+        TimeLapse parseTimer;
         boost::archive::xml_iarchive iArchive(ifile);
         bool bgProject;
         iArchive >> boost::serialization::make_nvp("Background_project", bgProject);
         ProjectSerialization projectSerializationObj( getApp() );
         iArchive >> boost::serialization::make_nvp("Project", projectSerializationObj);
+        _imp->loadTimings = ProjectLoadTimings();
+        _imp->loadTimings.parse = parseTimer.getTimeElapsedReset();
         
         ret = load(projectSerializationObj,name,path,isAutoSave,realFilePath);
         
+        if ( appPTR->isBackground() ) {
+            const ProjectLoadTimings & t = _imp->loadTimings;
+            std::cout << tr("Project loaded in ").toStdString() << parseTimer.getTimeSinceCreation() << "s ("
+                      << tr("parse: ").toStdString() << t.parse << "s, "
+                      << tr("project settings: ").toStdString() << t.knobs << "s, "
+                      << tr("nodes creation: ").toStdString() << t.instantiate << "s, "
+                      << tr("links: ").toStdString() << t.link << "s, "
+                      << tr("clip preferences: ").toStdString() << t.clipPreferences << "s)" << std::endl;
+        }
+        
         {
             QMutexLocker k(&_imp->isLoadingProjectMutex);
             _imp->isLoadingProjectInternal = false;
@@ -10,6 +10,9 @@
 
 #include "ProjectPrivate.h"
 
+#include <set>
+#include <vector>
+
 #include <QDebug>
 #include <QTimer>
 #include <QDateTime>
@@ -27,6 +30,55 @@
 #include "Engine/AppManager.h"
 #include "Engine/ViewerInstance.h"
 #include "Engine/Settings.h"
+#include "Engine/Timer.h"
+
+namespace {
+typedef std::map<std::string, std::list<NodeSerialization>::const_iterator> SerializationsByName;
+
+/**
+ * @brief Depth-first visit of the serialized inputs of a node so that every node is appended to the
+ * ordered list after all of its inputs. Cycles (which a valid project cannot have) are simply broken.
+ * The visit uses an explicit stack: the dependency chains of large projects may be too long to recurse.
+ **/
+void
+orderSerializationByDependencies(std::list<NodeSerialization>::const_iterator it,
+                                 const SerializationsByName & byName,
+                                 std::set<std::string> & visited,
+                                 std::list<std::list<NodeSerialization>::const_iterator> & ordered)
+{
+    if ( !visited.insert( it->getPluginLabel() ).second ) {
+        return;
+    }
+
+    ///Each entry is a node being visited and the index of the next of its inputs to visit
+    std::vector<std::pair<std::list<NodeSerialization>::const_iterator, U32> > stack;
+    stack.push_back( std::make_pair(it, (U32)0) );
+    while ( !stack.empty() ) {
+        std::pair<std::list<NodeSerialization>::const_iterator, U32> & top = stack.back();
+        const std::vector<std::string> & inputs = top.first->getInputs();
+        bool pushedInput = false;
+        while ( top.second < inputs.size() ) {
+            const std::string & inputName = inputs[top.second];
+            ++top.second;
+            if ( inputName.empty() ) {
+                continue;
+            }
+            SerializationsByName::const_iterator found = byName.find(inputName);
+            if ( ( found != byName.end() ) && visited.insert( found->second->getPluginLabel() ).second ) {
+                ///top is invalidated by the push_back
+                stack.push_back( std::make_pair(found->second, (U32)0) );
+                pushedInput = true;
+                break;
+            }
+        }
+        if (!pushedInput) {
+            ordered.push_back(top.first);
+            stack.pop_back();
+        }
+    }
+}
+}
+
 namespace Natron {
 ProjectPrivate::ProjectPrivate(Natron::Project* project)
     : _publicInterface(project)
@@ -62,6 +114,7 @@ ProjectPrivate::ProjectPrivate(Natron::Project* project)
       , isSavingProjectMutex()
       , isSavingProject(false)
       , autoSaveTimer( new QTimer() )
+      , loadTimings()
 
 {
     autoSaveTimer->setSingleShot(true);
@@ -76,6 +129,7 @@ ProjectPrivate::restoreFromSerialization(const ProjectSerialization & obj,
 {
     
     bool mustShowErrorsLog = false;
+    TimeLapse phaseTimer;
     
     /*1st OFF RESTORE THE PROJECT KNOBS*/
 
@@ -147,6 +201,8 @@ ProjectPrivate::restoreFromSerialization(const ProjectSerialization & obj,
 
     }
 
+    loadTimings.knobs = phaseTimer.getTimeElapsedReset();
+
     /// 2) restore the timeline
     timeline->seekFrame(obj.getCurrentTime(), false, 0, Natron::eTimelineChangeReasonPlaybackSeek);
 
@@ -162,6 +218,13 @@ ProjectPrivate::restoreFromSerialization(const ProjectSerialization & obj,
     ///This map contains all the parents that must be reconnected and an iterator to the child serialization
     std::map<boost::shared_ptr<Natron::Node>, std::list<NodeSerialization>::const_iterator > parentsToReconnect;
 
+    ///Index the serialized nodes by name once: looking them up linearly for every multi-instance child
+    ///and every input made loading quadratic in the number of nodes.
+    SerializationsByName serializationsByName;
+    for (std::list< NodeSerialization >::const_iterator it = serializedNodes.begin(); it != serializedNodes.end(); ++it) {
+        serializationsByName.insert( std::make_pair(it->getPluginLabel(), it) );
+    }
+
     /*first create all nodes*/
     int nodesRestored = 0;
     for (std::list< NodeSerialization >::const_iterator it = serializedNodes.begin(); it != serializedNodes.end(); ++it) {
@@ -178,13 +241,7 @@ ProjectPrivate::restoreFromSerialization(const ProjectSerialization & obj,
         ///If not, create it
 
         if ( !it->getMultiInstanceParentName().empty() ) {
-            bool foundParent = false;
-            for (std::list< NodeSerialization >::const_iterator it2 = serializedNodes.begin(); it2 != serializedNodes.end(); ++it2) {
-                if ( it2->getPluginLabel() == it->getMultiInstanceParentName() ) {
-                    foundParent = true;
-                    break;
-                }
-            }
+            bool foundParent = serializationsByName.find( it->getMultiInstanceParentName() ) != serializationsByName.end();
             if (!foundParent) {
                 ///Maybe it was created so far by another child who created it so look into the nodes
                 for (std::vector<boost::shared_ptr<Natron::Node> >::iterator it2 = currentNodes.begin(); it2 != currentNodes.end(); ++it2) {
@@ -242,24 +299,37 @@ ProjectPrivate::restoreFromSerialization(const ProjectSerialization & obj,
     }
 
 
+    loadTimings.instantiate = phaseTimer.getTimeElapsedReset();
+
+    std::map<std::string, boost::shared_ptr<Natron::Node> > nodesByName;
+    for (U32 j = 0; j < currentNodes.size(); ++j) {
+        nodesByName.insert( std::make_pair(currentNodes[j]->getName(), currentNodes[j]) );
+    }
+
+    ///Link the nodes upstream first: a node is connected only once all of its inputs are, so hashes
+    ///and clip preferences are not propagated again through half-built branches.
+    std::list<std::list<NodeSerialization>::const_iterator> orderedSerializations;
+    {
+        std::set<std::string> visited;
+        for (std::list< NodeSerialization >::const_iterator it = serializedNodes.begin(); it != serializedNodes.end(); ++it) {
+            orderSerializationByDependencies(it, serializationsByName, visited, orderedSerializations);
+        }
+    }
+
     /// 4) connect the nodes together, and restore the slave/master links for all knobs.
-    for (std::list< NodeSerialization >::const_iterator it = serializedNodes.begin(); it != serializedNodes.end(); ++it) {
+    for (std::list<std::list<NodeSerialization>::const_iterator>::const_iterator orderedIt = orderedSerializations.begin();
+         orderedIt != orderedSerializations.end(); ++orderedIt) {
+        std::list<NodeSerialization>::const_iterator it = *orderedIt;
         if ( appPTR->isBackground() && (it->getPluginID() == PLUGINID_NATRON_VIEWER) ) {
             //ignore viewers on background mode
             continue;
         }
 
-
-        boost::shared_ptr<Natron::Node> thisNode;
-        for (U32 j = 0; j < currentNodes.size(); ++j) {
-            if ( currentNodes[j]->getName() == it->getPluginLabel() ) {
-                thisNode = currentNodes[j];
-                break;
-            }
-        }
-        if (!thisNode) {
+        std::map<std::string, boost::shared_ptr<Natron::Node> >::const_iterator foundNode = nodesByName.find( it->getPluginLabel() );
+        if ( foundNode == nodesByName.end() ) {
             continue;
         }
+        boost::shared_ptr<Natron::Node> thisNode = foundNode->second;
 
         ///for all nodes that are part of a multi-instance, fetch the main instance node pointer
         const std::string & parentName = it->getMultiInstanceParentName();
@@ -271,12 +341,10 @@ ProjectPrivate::restoreFromSerialization(const ProjectSerialization & obj,
         const std::string & masterNodeName = it->getMasterNodeName();
         if ( !masterNodeName.empty() ) {
             ///find such a node
+            std::map<std::string, boost::shared_ptr<Natron::Node> >::const_iterator foundMaster = nodesByName.find(masterNodeName);
             boost::shared_ptr<Natron::Node> masterNode;
-            for (U32 j = 0; j < currentNodes.size(); ++j) {
-                if (currentNodes[j]->getName() == masterNodeName) {
-                    masterNode = currentNodes[j];
-                    break;
-                }
+            if ( foundMaster != nodesByName.end() ) {
+                masterNode = foundMaster->second;
             }
             if (!masterNode) {
                 appPTR->writeToOfxLog_mt_safe(QString("Cannot restore the link between " + QString(it->getPluginLabel().c_str()) + " and " + masterNodeName.c_str()));
@@ -289,7 +357,11 @@ ProjectPrivate::restoreFromSerialization(const ProjectSerialization & obj,
 
         const std::vector<std::string> & inputs = it->getInputs();
         for (U32 j = 0; j < inputs.size(); ++j) {
-            if ( !inputs[j].empty() && !project->getApp()->getProject()->connectNodes(j, inputs[j],thisNode.get()) ) {
+            if ( inputs[j].empty() ) {
+                continue;
+            }
+            std::map<std::string, boost::shared_ptr<Natron::Node> >::const_iterator foundInput = nodesByName.find(inputs[j]);
+            if ( ( foundInput == nodesByName.end() ) || !project->connectNodes(j, foundInput->second, thisNode.get()) ) {
                 std::string message = std::string("Failed to connect node ") + it->getPluginLabel() + " to " + inputs[j];
                 appPTR->writeToOfxLog_mt_safe(message.c_str());
                 mustShowErrorsLog =true;
@@ -312,6 +384,7 @@ ProjectPrivate::restoreFromSerialization(const ProjectSerialization & obj,
     }
     
     _publicInterface->getApp()->progressUpdate(_publicInterface, 0.25);
+    loadTimings.link = phaseTimer.getTimeElapsedReset();
     
     ///The next for loop is about 50% of loading time of a project
     
@@ -334,6 +407,8 @@ ProjectPrivate::restoreFromSerialization(const ProjectSerialization & obj,
         }
     }
     
+    loadTimings.clipPreferences = phaseTimer.getTimeElapsedReset();
+
     ///We should be now at 75% progress...
     
     QDateTime time = QDateTime::currentDateTime();
@@ -56,6 +56,28 @@ generateStringFromFormat(const Format & f)
     return formatStr;
 }
 
+/**
+ * @brief Wall-clock time (in seconds) spent in each phase of the last project load.
+ * Printed in background mode so that slow loads can be diagnosed without a profiler.
+ **/
+struct ProjectLoadTimings
+{
+    double parse; //< reading the file through the boost archive
+    double knobs; //< restoring the project's own knobs
+    double instantiate; //< creating the nodes and restoring their knobs
+    double link; //< connecting inputs and restoring knob links/expressions
+    double clipPreferences; //< restoring clip preferences from the output nodes
+
+    ProjectLoadTimings()
+        : parse(0)
+          , knobs(0)
+          , instantiate(0)
+          , link(0)
+          , clipPreferences(0)
+    {
+    }
+};
+
 struct ProjectPrivate
 {
     Natron::Project* _publicInterface;
@@ -104,6 +126,7 @@ struct ProjectPrivate
     bool isSavingProject; //< true when the project is saving
     boost::shared_ptr<QTimer> autoSaveTimer;
     std::list<boost::shared_ptr<QFutureWatcher<void> > > autoSaveFutures;
+    ProjectLoadTimings loadTimings; //< only accessed by the main thread
 
     
     ProjectPrivate(Natron::Project* project);
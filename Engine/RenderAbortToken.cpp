@@ -0,0 +1,144 @@
+//  Natron
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "RenderAbortToken.h"
+
+#include <cassert>
+#include <list>
+#include <vector>
+#include <algorithm>
+#include <QMutex>
+
+#include "Engine/EffectInstance.h"
+#include "Engine/RenderProfiler.h"
+#include "Engine/ThreadStorage.h"
+
+using namespace Natron;
+
+namespace {
+struct ThreadTokenEntry
+{
+    boost::shared_ptr<RenderAbortToken> token;
+    const EffectInstance* effect;
+};
+
+///The frames rendered by a thread, innermost last
+typedef std::vector<ThreadTokenEntry> ThreadTokenStack;
+
+Natron::ThreadStorage<ThreadTokenStack> gThreadTokens;
+
+QMutex gPlaybackTokensMutex; //< protects gPlaybackTokens
+std::list<RenderAbortToken*> gPlaybackTokens; //< tokens of the frames rendered for playback or on disk
+}
+
+RenderAbortToken::RenderAbortToken(const AppInstance* app,
+                                   bool isRenderResponseToUserInteraction)
+    : _aborted()
+      , _app(app)
+      , _isRenderResponseToUserInteraction(isRenderResponseToUserInteraction)
+      , _abortTimer()
+{
+    ///Renders made in response to a user interaction find out by themselves they were aborted, @see EffectInstance::aborted()
+    if (!_isRenderResponseToUserInteraction) {
+        QMutexLocker k(&gPlaybackTokensMutex);
+        gPlaybackTokens.push_back(this);
+    }
+}
+
+RenderAbortToken::~RenderAbortToken()
+{
+    if (!_isRenderResponseToUserInteraction) {
+        QMutexLocker k(&gPlaybackTokensMutex);
+        std::list<RenderAbortToken*>::iterator found = std::find(gPlaybackTokens.begin(), gPlaybackTokens.end(), this);
+        assert( found != gPlaybackTokens.end() );
+        gPlaybackTokens.erase(found);
+    } else if ( isAborted() ) {
+        ///The last thread working on the frame just released it. Playback latencies are measured by the scheduler,
+        ///which waits for all its frames.
+        RenderProfiler::recordAbortLatency(_abortTimer.nsecsElapsed() * 1e-9);
+    }
+}
+
+void
+RenderAbortToken::abort()
+{
+    if ( _aborted.testAndSetOrdered(0, 1) ) {
+        _abortTimer.start();
+    }
+}
+
+bool
+RenderAbortToken::isAborted() const
+{
+#if QT_VERSION < 0x050000
+    return (int)_aborted != 0;
+#else
+    return _aborted.load() != 0;
+#endif
+}
+
+void
+RenderAbortToken::abortRendersFromPlayback(const AppInstance* app)
+{
+    QMutexLocker k(&gPlaybackTokensMutex);
+
+    for (std::list<RenderAbortToken*>::iterator it = gPlaybackTokens.begin(); it != gPlaybackTokens.end(); ++it) {
+        if ( (*it)->_app == app ) {
+            (*it)->abort();
+        }
+    }
+}
+
+bool
+RenderAbortToken::isCurrentThreadRenderAborted()
+{
+    if ( !gThreadTokens.hasLocalData() ) {
+        return false;
+    }
+    const ThreadTokenStack& stack = gThreadTokens.localData();
+    if ( stack.empty() ) {
+        return false;
+    }
+    const ThreadTokenEntry& e = stack.back();
+    if ( e.token->isAborted() ) {
+        return true;
+    }
+
+    ///Flags the token if it finds out the frame was aborted
+    return e.effect && e.effect->aborted();
+}
+
+void
+RenderAbortToken::pushThreadToken(const boost::shared_ptr<RenderAbortToken>& token,
+                                  const EffectInstance* effect)
+{
+    assert(token);
+    ThreadTokenEntry e;
+    e.token = token;
+    e.effect = effect;
+    gThreadTokens.localData().push_back(e);
+}
+
+void
+RenderAbortToken::popThreadToken()
+{
+    ThreadTokenStack& stack = gThreadTokens.localData();
+
+    assert( !stack.empty() );
+    if ( !stack.empty() ) {
+        stack.pop_back();
+    }
+}
+
+boost::shared_ptr<RenderAbortToken>
+RenderAbortToken::getThreadToken()
+{
+    if ( !gThreadTokens.hasLocalData() ) {
+        return boost::shared_ptr<RenderAbortToken>();
+    }
+    const ThreadTokenStack& stack = gThreadTokens.localData();
+
+    return stack.empty() ? boost::shared_ptr<RenderAbortToken>() : stack.back().token;
+}
@@ -0,0 +1,72 @@
+//  Natron
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef NATRON_ENGINE_RENDERABORTTOKEN_H_
+#define NATRON_ENGINE_RENDERABORTTOKEN_H_
+
+#include <boost/shared_ptr.hpp>
+#include <QAtomicInt>
+#include <QElapsedTimer>
+#include "Global/Macros.h"
+
+class AppInstance;
+
+namespace Natron {
+class EffectInstance;
+
+/**
+ * @brief Shared by all the nodes and all the threads rendering a frame, like the FrameMemoryBudget.
+ * Once the frame is known to be aborted the token is flagged: the long running loops of the engine
+ * (image conversions, roto masks, tiles that did not start yet...) then stop at their next check
+ * for the price of an atomic read, instead of every node finding out by itself why it was aborted.
+ **/
+class RenderAbortToken
+{
+public:
+
+    RenderAbortToken(const AppInstance* app,
+                     bool isRenderResponseToUserInteraction);
+
+    ~RenderAbortToken();
+
+    void abort();
+
+    bool isAborted() const WARN_UNUSED_RETURN;
+
+    /**
+     * @brief Aborts the frames of the given app being rendered for playback or on disk.
+     * @see OutputSchedulerThread::abortRendering
+     **/
+    static void abortRendersFromPlayback(const AppInstance* app);
+
+    /**
+     * @brief Returns true if the frame rendered by the calling thread was aborted. This is meant for the
+     * loops of the engine that do not know which node they work for, e.g: Image::convertToFormat.
+     * Always false for threads that are not rendering.
+     **/
+    static bool isCurrentThreadRenderAborted() WARN_UNUSED_RETURN;
+
+    /**
+     * @brief The token of the frame rendered by the calling thread becomes token until popThreadToken() is
+     * called. effect is the node whose EffectInstance::aborted() tells whether the frame was aborted.
+     * @see Node::setParallelRenderArgs
+     **/
+    static void pushThreadToken(const boost::shared_ptr<RenderAbortToken>& token,const EffectInstance* effect);
+
+    static void popThreadToken();
+
+    ///The token of the frame rendered by the calling thread, if any
+    static boost::shared_ptr<RenderAbortToken> getThreadToken();
+
+private:
+
+    QAtomicInt _aborted;
+    const AppInstance* _app;
+    bool _isRenderResponseToUserInteraction;
+    QElapsedTimer _abortTimer; //< started by the first call to abort()
+};
+} // namespace Natron
+
+#endif // NATRON_ENGINE_RENDERABORTTOKEN_H_
@@ -0,0 +1,211 @@
+//  Natron
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "RenderPriorityScheduler.h"
+
+#include <cassert>
+#include <vector>
+#include <algorithm>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QThreadPool>
+
+#include "Engine/ThreadStorage.h"
+
+///How long after the last render of a priority ended the renders of a lower priority are still held back
+#define NATRON_RENDER_PREEMPTION_GRACE_MS 100
+
+using namespace Natron;
+
+namespace {
+struct PriorityState
+{
+    RenderPoolStats stats;
+    QElapsedTimer lastRenderEnd; //< invalid until a render of this priority ended
+};
+
+///The priorities of the renders a thread works for, innermost last
+typedef std::vector<RenderPriorityEnum> PriorityStack;
+
+QMutex gStatesMutex; //< protects gStates
+QWaitCondition gRenderEndedCond; //< woken up by every render that ends
+PriorityState gStates[eRenderPriorityCount];
+Natron::ThreadStorage<PriorityStack> gThreadPriorities;
+
+///Must be called with gStatesMutex locked
+bool
+hasHigherPriorityRendersInternal(RenderPriorityEnum priority)
+{
+    assert( !gStatesMutex.tryLock() );
+    for (int i = 0; i < (int)priority; ++i) {
+        const PriorityState& s = gStates[i];
+        if (s.stats.activeRenders > 0) {
+            return true;
+        }
+        if ( s.lastRenderEnd.isValid() && (s.lastRenderEnd.elapsed() < NATRON_RENDER_PREEMPTION_GRACE_MS) ) {
+            return true;
+        }
+    }
+
+    return false;
+}
+}
+
+RenderPriorityEnum
+RenderPriorityScheduler::getCurrentThreadPriority()
+{
+    if ( !gThreadPriorities.hasLocalData() ) {
+        return eRenderPriorityInteractive;
+    }
+    const PriorityStack& stack = gThreadPriorities.localData();
+
+    return stack.empty() ? eRenderPriorityInteractive : stack.back();
+}
+
+bool
+RenderPriorityScheduler::hasHigherPriorityRenders(RenderPriorityEnum priority)
+{
+    QMutexLocker k(&gStatesMutex);
+
+    return hasHigherPriorityRendersInternal(priority);
+}
+
+int
+RenderPriorityScheduler::getAvailablePoolThreads(RenderPriorityEnum priority)
+{
+    if ( hasHigherPriorityRenders(priority) ) {
+        return 0;
+    }
+    QThreadPool* pool = QThreadPool::globalInstance();
+
+    // activeThreadCount may be negative (for example if releaseThread() is called)
+    return std::max( 0, pool->maxThreadCount() - std::max(0, pool->activeThreadCount()) );
+}
+
+int
+RenderPriorityScheduler::getPoolTaskPriority(RenderPriorityEnum priority)
+{
+    return (int)eRenderPriorityCount - 1 - (int)priority;
+}
+
+bool
+RenderPriorityScheduler::waitForHigherPriorityRenders(RenderPriorityEnum priority,
+                                                      int timeoutMS)
+{
+    QMutexLocker k(&gStatesMutex);
+
+    if ( !hasHigherPriorityRendersInternal(priority) ) {
+        return true;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    bool mayStart = false;
+    for (;;) {
+        int remaining = timeoutMS - (int)timer.elapsed();
+        if (remaining <= 0) {
+            break;
+        }
+        ///The grace period elapses without anyone waking us up
+        gRenderEndedCond.wait( &gStatesMutex, std::min(remaining, NATRON_RENDER_PREEMPTION_GRACE_MS) );
+        if ( !hasHigherPriorityRendersInternal(priority) ) {
+            mayStart = true;
+            break;
+        }
+    }
+
+    RenderPoolStats& stats = gStates[priority].stats;
+    ++stats.preemptions;
+    stats.preemptedTime += timer.nsecsElapsed() * 1e-9;
+
+    return mayStart;
+}
+
+void
+RenderPriorityScheduler::getStatistics(RenderPoolStats* stats)
+{
+    assert(stats);
+    QMutexLocker k(&gStatesMutex);
+    for (int i = 0; i < (int)eRenderPriorityCount; ++i) {
+        stats[i] = gStates[i].stats;
+    }
+}
+
+void
+RenderPriorityScheduler::clearStatistics()
+{
+    QMutexLocker k(&gStatesMutex);
+
+    for (int i = 0; i < (int)eRenderPriorityCount; ++i) {
+        RenderPoolStats& stats = gStates[i].stats;
+        RenderPoolStats cleared;
+        cleared.activeRenders = stats.activeRenders;
+        cleared.peakActiveRenders = stats.activeRenders;
+        cleared.activePoolTasks = stats.activePoolTasks;
+        cleared.peakActivePoolTasks = stats.activePoolTasks;
+        stats = cleared;
+    }
+}
+
+void
+RenderPriorityScheduler::beginRender(RenderPriorityEnum priority,
+                                     bool isPoolTask)
+{
+    QMutexLocker k(&gStatesMutex);
+    RenderPoolStats& stats = gStates[priority].stats;
+
+    if (isPoolTask) {
+        ++stats.poolTasks;
+        ++stats.activePoolTasks;
+        stats.peakActivePoolTasks = std::max(stats.peakActivePoolTasks, stats.activePoolTasks);
+    } else {
+        ++stats.renders;
+        ++stats.activeRenders;
+        stats.peakActiveRenders = std::max(stats.peakActiveRenders, stats.activeRenders);
+    }
+}
+
+void
+RenderPriorityScheduler::endRender(RenderPriorityEnum priority,
+                                   bool isPoolTask,
+                                   double elapsed)
+{
+    QMutexLocker k(&gStatesMutex);
+    PriorityState& state = gStates[priority];
+
+    if (isPoolTask) {
+        assert(state.stats.activePoolTasks > 0);
+        --state.stats.activePoolTasks;
+        state.stats.poolBusyTime += elapsed;
+    } else {
+        assert(state.stats.activeRenders > 0);
+        --state.stats.activeRenders;
+        state.lastRenderEnd.start();
+        gRenderEndedCond.wakeAll();
+    }
+}
+
+RenderPriorityScope::RenderPriorityScope(RenderPriorityEnum priority,
+                                         bool isPoolTask)
+    : _priority(priority)
+      , _isPoolTask(isPoolTask)
+      , _timer()
+{
+    assert(priority >= 0 && priority < eRenderPriorityCount);
+    gThreadPriorities.localData().push_back(priority);
+    RenderPriorityScheduler::beginRender(priority, isPoolTask);
+    _timer.start();
+}
+
+RenderPriorityScope::~RenderPriorityScope()
+{
+    RenderPriorityScheduler::endRender(_priority, _isPoolTask, _timer.nsecsElapsed() * 1e-9);
+
+    PriorityStack& stack = gThreadPriorities.localData();
+    assert( !stack.empty() && stack.back() == _priority );
+    if ( !stack.empty() ) {
+        stack.pop_back();
+    }
+}
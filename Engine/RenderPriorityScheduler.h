@@ -0,0 +1,137 @@
+//  Natron
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef NATRON_ENGINE_RENDERPRIORITYSCHEDULER_H_
+#define NATRON_ENGINE_RENDERPRIORITYSCHEDULER_H_
+
+#include <QElapsedTimer>
+#include "Global/GlobalDefines.h"
+#include "Global/Macros.h"
+
+namespace Natron {
+
+/**
+ * @brief How busy the renders of one priority kept the engine.
+ * Renders are the frames started by the render threads, the viewer and the previews.
+ * Pool tasks are the tiles and the OpenFX multi-thread suite threads they ran in the global thread pool.
+ **/
+struct RenderPoolStats
+{
+    int activeRenders;
+    int peakActiveRenders;
+    U64 renders;
+    int activePoolTasks;
+    int peakActivePoolTasks;
+    U64 poolTasks;
+    double poolBusyTime; //< time spent by the threads of the pool in the tasks, in seconds
+    U64 preemptions; //< number of waits of a render thread for renders of a higher priority, @see waitForHigherPriorityRenders
+    double preemptedTime; //< time spent waiting, in seconds
+
+    RenderPoolStats()
+        : activeRenders(0)
+          , peakActiveRenders(0)
+          , renders(0)
+          , activePoolTasks(0)
+          , peakActivePoolTasks(0)
+          , poolTasks(0)
+          , poolBusyTime(0.)
+          , preemptions(0)
+          , preemptedTime(0.)
+    {
+    }
+};
+
+/**
+ * @brief Arbitrates the global thread pool between the renders of different priorities.
+ * Qt 4 cannot run QtConcurrent::mapped in another pool than the global one, so rather than owning one pool
+ * per priority the renders share the global pool and:
+ * - a render only splits its work into tasks of the pool (tiles, OpenFX multi-thread suite, viewer texture conversion)
+ * while no render of a higher priority is in progress, @see getAvailablePoolThreads;
+ * - the render threads of the playback and of the writers wait before starting a frame until the renders of a higher
+ * priority are done, @see waitForHigherPriorityRenders;
+ * - the viewer's current frame is queued ahead of the tasks of lower priority, @see getPoolTaskPriority.
+ * Interactive renders thus preempt playback, which preempts background renders.
+ **/
+class RenderPriorityScheduler
+{
+public:
+
+    /**
+     * @brief The priority of the render in progress on the calling thread. Threads that did not declare any
+     * with a RenderPriorityScope are considered interactive, i.e: they are never held back.
+     **/
+    static RenderPriorityEnum getCurrentThreadPriority() WARN_UNUSED_RETURN;
+
+    /**
+     * @brief Returns true if renders of a higher priority than the given one are in progress or ended less than
+     * NATRON_RENDER_PREEMPTION_GRACE_MS ago: the gaps between the frames of a scrub are not an opportunity to start
+     * a frame of lower priority.
+     **/
+    static bool hasHigherPriorityRenders(RenderPriorityEnum priority) WARN_UNUSED_RETURN;
+
+    /**
+     * @brief The number of threads of the global pool a render of the given priority may use right now,
+     * 0 meaning it should do its work in the calling thread.
+     **/
+    static int getAvailablePoolThreads(RenderPriorityEnum priority) WARN_UNUSED_RETURN;
+
+    /**
+     * @brief The priority to pass to QThreadPool::start for a runnable of the given priority.
+     * QtConcurrent queues its tasks with priority 0, that of background renders.
+     **/
+    static int getPoolTaskPriority(RenderPriorityEnum priority) WARN_UNUSED_RETURN;
+
+    /**
+     * @brief Blocks the calling thread for at most timeoutMS milliseconds until hasHigherPriorityRenders(priority)
+     * returns false. Returns true if the render may start, false if the caller should check whether it was
+     * aborted and call it again.
+     **/
+    static bool waitForHigherPriorityRenders(RenderPriorityEnum priority,int timeoutMS) WARN_UNUSED_RETURN;
+
+    /**
+     * @brief Statistics per priority, stats must point to eRenderPriorityCount elements.
+     **/
+    static void getStatistics(RenderPoolStats* stats);
+
+    /**
+     * @brief Resets the peaks and the totals, the renders and tasks in progress are still counted.
+     **/
+    static void clearStatistics();
+
+private:
+
+    friend class RenderPriorityScope;
+
+    static void beginRender(RenderPriorityEnum priority,bool isPoolTask);
+
+    static void endRender(RenderPriorityEnum priority,bool isPoolTask,double elapsed);
+};
+
+/**
+ * @brief The calling thread works for a render of the given priority until this object is destroyed.
+ * Scopes can be nested, e.g: a background render thread rendering a preview.
+ **/
+class RenderPriorityScope
+{
+public:
+
+    /**
+     * @param isPoolTask True if the thread is a thread of the pool running a task on behalf of a render
+     * of the given priority, e.g: a tile.
+     **/
+    RenderPriorityScope(RenderPriorityEnum priority,
+                        bool isPoolTask = false);
+
+    ~RenderPriorityScope();
+
+private:
+
+    RenderPriorityEnum _priority;
+    bool _isPoolTask;
+    QElapsedTimer _timer;
+};
+} // namespace Natron
+
+#endif // NATRON_ENGINE_RENDERPRIORITYSCHEDULER_H_
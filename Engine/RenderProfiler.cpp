@@ -0,0 +1,404 @@
+//  Natron
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "RenderProfiler.h"
+
+#include <cassert>
+#include <vector>
+#include <algorithm>
+#include <fstream>
+#include <QMutex>
+#include <QAtomicInt>
+
+#if defined(__NATRON_WIN32__)
+#include <windows.h>
+#elif defined(__NATRON_OSX__)
+#include <mach/mach.h>
+#else
+#include <time.h>
+#endif
+
+#include "Engine/EffectInstance.h"
+#include "Engine/ThreadStorage.h"
+
+using namespace Natron;
+
+namespace {
+struct ProfileStackEntry
+{
+    ProfiledActionEnum action;
+    std::string node;
+    int time;
+    double nestedWallTime; //< time spent in getImage by a render action
+    double nestedThreadTime;
+};
+
+///The actions being measured on a thread, innermost last
+typedef std::vector<ProfileStackEntry> ProfileStack;
+
+QAtomicInt gProfilerEnabled;
+QMutex gProfileMutex; //< protects gProfile
+RenderProfile gProfile;
+AbortLatencies gAbortLatencies; //< protected by gProfileMutex
+Natron::ThreadStorage<ProfileStack> gProfileStack;
+
+/**
+ * @brief Returns the CPU time consumed so far by the calling thread, in seconds.
+ **/
+double
+getCurrentThreadCPUTime()
+{
+#if defined(__NATRON_WIN32__)
+    FILETIME creation,exit,kernel,user;
+    if ( !GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user) ) {
+        return 0.;
+    }
+    ULARGE_INTEGER k,u;
+    k.LowPart = kernel.dwLowDateTime;
+    k.HighPart = kernel.dwHighDateTime;
+    u.LowPart = user.dwLowDateTime;
+    u.HighPart = user.dwHighDateTime;
+
+    ///FILETIMEs are in units of 100 nanoseconds
+    return (k.QuadPart + u.QuadPart) * 1e-7;
+#elif defined(__NATRON_OSX__)
+    mach_port_t thread = mach_thread_self();
+    thread_basic_info_data_t info;
+    mach_msg_type_number_t count = THREAD_BASIC_INFO_COUNT;
+    kern_return_t kr = thread_info(thread, THREAD_BASIC_INFO, (thread_info_t)&info, &count);
+    mach_port_deallocate(mach_task_self(), thread);
+    if (kr != KERN_SUCCESS) {
+        return 0.;
+    }
+
+    return info.user_time.seconds + info.user_time.microseconds * 1e-6 +
+           info.system_time.seconds + info.system_time.microseconds * 1e-6;
+#else
+    struct timespec ts;
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0) {
+        return 0.;
+    }
+
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+#endif
+}
+
+void
+mergeIntoProfile(const std::string& node,
+                 int time,
+                 const NodeFrameProfile& profile)
+{
+    QMutexLocker k(&gProfileMutex);
+
+    gProfile[node][time].merge(profile);
+}
+
+const char*
+getActionName(int action)
+{
+    switch (action) {
+    case eProfiledActionRenderRoI:
+
+        return "renderRoI";
+    case eProfiledActionRender:
+
+        return "render";
+    case eProfiledActionGetImage:
+
+        return "getImage";
+    case eProfiledActionConvertImage:
+
+        return "convertImage";
+    default:
+
+        return "unknown";
+    }
+}
+
+void
+writeJSONString(std::ostream& stream,
+                const std::string& str)
+{
+    stream << '"';
+    for (std::size_t i = 0; i < str.size(); ++i) {
+        unsigned char c = str[i];
+        if ( (c == '"') || (c == '\\') ) {
+            stream << '\\' << c;
+        } else if (c < 0x20) {
+            static const char* hex = "0123456789abcdef";
+            stream << "\\u00" << hex[c >> 4] << hex[c & 0xf];
+        } else {
+            stream << c;
+        }
+    }
+    stream << '"';
+}
+
+void
+writeFrameProfile(std::ostream& stream,
+                  const NodeFrameProfile& profile,
+                  const std::string& indent)
+{
+    for (int i = 0; i < eProfiledActionCount; ++i) {
+        const ProfiledActionTimes& a = profile.actions[i];
+        stream << indent << '"' << getActionName(i) << "\": { \"calls\": " << a.calls
+               << ", \"wallTime\": " << a.wallTime << ", \"threadTime\": " << a.threadTime << " },\n";
+    }
+    stream << indent << "\"renderSelfWallTime\": " << profile.renderSelfWallTime << ",\n";
+    stream << indent << "\"renderSelfThreadTime\": " << profile.renderSelfThreadTime << ",\n";
+    stream << indent << "\"cacheHits\": " << profile.cacheHits << ",\n";
+    stream << indent << "\"cacheMisses\": " << profile.cacheMisses << ",\n";
+    stream << indent << "\"bytesAllocated\": " << profile.bytesAllocated << '\n';
+}
+
+struct NodeTotal
+{
+    std::string name;
+    NodeFrameProfile total;
+    const NodeProfile* frames;
+};
+
+bool
+nodeTotalCostlier(const NodeTotal& a,
+                  const NodeTotal& b)
+{
+    return a.total.renderSelfWallTime > b.total.renderSelfWallTime;
+}
+}
+
+void
+NodeFrameProfile::merge(const NodeFrameProfile& other)
+{
+    for (int i = 0; i < eProfiledActionCount; ++i) {
+        actions[i].calls += other.actions[i].calls;
+        actions[i].wallTime += other.actions[i].wallTime;
+        actions[i].threadTime += other.actions[i].threadTime;
+    }
+    renderSelfWallTime += other.renderSelfWallTime;
+    renderSelfThreadTime += other.renderSelfThreadTime;
+    cacheHits += other.cacheHits;
+    cacheMisses += other.cacheMisses;
+    bytesAllocated += other.bytesAllocated;
+}
+
+bool
+RenderProfiler::isEnabled()
+{
+#if QT_VERSION < 0x050000
+    return (int)gProfilerEnabled != 0;
+#else
+    return gProfilerEnabled.load() != 0;
+#endif
+}
+
+void
+RenderProfiler::setEnabled(bool enabled)
+{
+    gProfilerEnabled.fetchAndStoreRelaxed(enabled ? 1 : 0);
+}
+
+void
+RenderProfiler::clear()
+{
+    QMutexLocker k(&gProfileMutex);
+
+    gProfile.clear();
+    gAbortLatencies = AbortLatencies();
+}
+
+void
+RenderProfiler::getProfile(RenderProfile* profile)
+{
+    QMutexLocker k(&gProfileMutex);
+
+    *profile = gProfile;
+}
+
+void
+RenderProfiler::recordCacheAccess(bool hit,
+                                  U64 bytesAllocated)
+{
+    if ( !isEnabled() ) {
+        return;
+    }
+    ProfileStack& stack = gProfileStack.localData();
+    if ( stack.empty() ) {
+        return;
+    }
+    NodeFrameProfile p;
+    if (hit) {
+        p.cacheHits = 1;
+    } else {
+        p.cacheMisses = 1;
+    }
+    p.bytesAllocated = bytesAllocated;
+    mergeIntoProfile(stack.back().node, stack.back().time, p);
+}
+
+void
+RenderProfiler::recordAbortLatency(double seconds)
+{
+    if ( !isEnabled() ) {
+        return;
+    }
+    QMutexLocker k(&gProfileMutex);
+    ++gAbortLatencies.count;
+    gAbortLatencies.totalTime += seconds;
+    gAbortLatencies.maxTime = std::max(gAbortLatencies.maxTime, seconds);
+}
+
+void
+RenderProfiler::getAbortLatencies(AbortLatencies* latencies)
+{
+    QMutexLocker k(&gProfileMutex);
+
+    *latencies = gAbortLatencies;
+}
+
+void
+RenderProfiler::writeReport(std::ostream& stream)
+{
+    RenderProfile profile;
+
+    getProfile(&profile);
+
+    std::vector<NodeTotal> nodes;
+    for (RenderProfile::const_iterator it = profile.begin(); it != profile.end(); ++it) {
+        NodeTotal n;
+        n.name = it->first;
+        n.frames = &it->second;
+        for (NodeProfile::const_iterator it2 = it->second.begin(); it2 != it->second.end(); ++it2) {
+            n.total.merge(it2->second);
+        }
+        nodes.push_back(n);
+    }
+    ///Costliest nodes first
+    std::stable_sort(nodes.begin(), nodes.end(), nodeTotalCostlier);
+
+    std::streamsize oldPrecision = stream.precision(9);
+    stream << "{\n  \"nodes\": [\n";
+    for (std::size_t i = 0; i < nodes.size(); ++i) {
+        stream << "    {\n      \"name\": ";
+        writeJSONString(stream, nodes[i].name);
+        stream << ",\n      \"total\": {\n";
+        writeFrameProfile(stream, nodes[i].total, "        ");
+        stream << "      },\n      \"frames\": [\n";
+        for (NodeProfile::const_iterator it = nodes[i].frames->begin(); it != nodes[i].frames->end(); ++it) {
+            stream << "        {\n          \"frame\": " << it->first << ",\n";
+            writeFrameProfile(stream, it->second, "          ");
+            NodeProfile::const_iterator next = it;
+            ++next;
+            stream << ( next == nodes[i].frames->end() ? "        }\n" : "        },\n" );
+        }
+        stream << "      ]\n";
+        stream << ( i + 1 == nodes.size() ? "    }\n" : "    },\n" );
+    }
+    AbortLatencies latencies;
+    getAbortLatencies(&latencies);
+    stream << "  ],\n  \"abortLatency\": { \"count\": " << latencies.count
+           << ", \"meanTime\": " << (latencies.count ? latencies.totalTime / latencies.count : 0.)
+           << ", \"maxTime\": " << latencies.maxTime << " }\n}\n";
+    stream.precision(oldPrecision);
+}
+
+bool
+RenderProfiler::writeReport(const std::string& filename,
+                            std::string* error)
+{
+    std::ofstream ofile(filename.c_str(), std::ofstream::out);
+
+    if ( !ofile.good() ) {
+        *error = "Failed to open " + filename;
+
+        return false;
+    }
+    writeReport(ofile);
+    ofile.close();
+    if ( ofile.fail() ) {
+        *error = "Failed to write " + filename;
+
+        return false;
+    }
+
+    return true;
+}
+
+RenderProfilerScope::RenderProfilerScope(ProfiledActionEnum action,
+                                         const EffectInstance* effect,
+                                         int time)
+    : _active(false)
+      , _action(action)
+      , _timer()
+      , _threadTimeStart(0.)
+{
+    if ( RenderProfiler::isEnabled() ) {
+        begin(action, effect, time);
+    }
+}
+
+RenderProfilerScope::RenderProfilerScope(ProfiledActionEnum action)
+    : _active(false)
+      , _action(action)
+      , _timer()
+      , _threadTimeStart(0.)
+{
+    if ( RenderProfiler::isEnabled() ) {
+        begin(action, NULL, 0);
+    }
+}
+
+void
+RenderProfilerScope::begin(ProfiledActionEnum action,
+                           const EffectInstance* effect,
+                           int time)
+{
+    ProfileStack& stack = gProfileStack.localData();
+    ProfileStackEntry e;
+
+    e.action = action;
+    e.nestedWallTime = 0.;
+    e.nestedThreadTime = 0.;
+    if (effect) {
+        e.node = effect->getName_mt_safe();
+        e.time = time;
+    } else if ( !stack.empty() ) {
+        e.node = stack.back().node;
+        e.time = stack.back().time;
+    } else {
+        ///Nothing is being rendered by this thread, there is nothing to attribute this action to
+        return;
+    }
+    stack.push_back(e);
+    _active = true;
+    _threadTimeStart = getCurrentThreadCPUTime();
+    _timer.start();
+}
+
+RenderProfilerScope::~RenderProfilerScope()
+{
+    if (!_active) {
+        return;
+    }
+    double wallTime = _timer.nsecsElapsed() * 1e-9;
+    double threadTime = getCurrentThreadCPUTime() - _threadTimeStart;
+    ProfileStack& stack = gProfileStack.localData();
+    assert( !stack.empty() && stack.back().action == _action );
+    ProfileStackEntry e = stack.back();
+    stack.pop_back();
+
+    NodeFrameProfile p;
+    p.actions[_action].calls = 1;
+    p.actions[_action].wallTime = wallTime;
+    p.actions[_action].threadTime = threadTime;
+    if (_action == eProfiledActionRender) {
+        p.renderSelfWallTime = std::max(0., wallTime - e.nestedWallTime);
+        p.renderSelfThreadTime = std::max(0., threadTime - e.nestedThreadTime);
+    } else if ( (_action == eProfiledActionGetImage) && !stack.empty() && (stack.back().action == eProfiledActionRender) ) {
+        ///The plug-in is waiting for its input, this is not part of its own cost
+        stack.back().nestedWallTime += wallTime;
+        stack.back().nestedThreadTime += threadTime;
+    }
+    mergeIntoProfile(e.node, e.time, p);
+}
@@ -0,0 +1,163 @@
+//  Natron
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef NATRON_ENGINE_RENDERPROFILER_H_
+#define NATRON_ENGINE_RENDERPROFILER_H_
+
+#include <map>
+#include <string>
+#include <ostream>
+#include <QElapsedTimer>
+#include "Global/GlobalDefines.h"
+#include "Global/Macros.h"
+
+namespace Natron {
+class EffectInstance;
+
+enum ProfiledActionEnum
+{
+    eProfiledActionRenderRoI = 0, //< EffectInstance::renderRoI, including the time spent rendering the inputs
+    eProfiledActionRender, //< EffectInstance::render_public, i.e the render action of the plug-in
+    eProfiledActionGetImage, //< EffectInstance::getImage, i.e the plug-in fetching an input image
+    eProfiledActionConvertImage, //< Image::convertToFormat
+    eProfiledActionCount
+};
+
+struct ProfiledActionTimes
+{
+    U64 calls;
+    double wallTime; //< in seconds
+    double threadTime; //< CPU time of the calling threads, in seconds
+
+    ProfiledActionTimes()
+        : calls(0)
+          , wallTime(0.)
+          , threadTime(0.)
+    {
+    }
+};
+
+/**
+ * @brief What was measured for one node at one frame.
+ * Times of nested actions are included in the time of the action calling them: for instance the render
+ * action includes the time the plug-in spent in getImage. The render "self" times exclude it and are what
+ * the plug-in itself cost.
+ **/
+struct NodeFrameProfile
+{
+    ProfiledActionTimes actions[eProfiledActionCount];
+    double renderSelfWallTime;
+    double renderSelfThreadTime;
+    U64 cacheHits; //< look-ups of the node's images in the node/disk caches that found an image
+    U64 cacheMisses; //< look-ups that did not
+    U64 bytesAllocated; //< bytes of the images created in the caches for the node
+
+    NodeFrameProfile()
+        : renderSelfWallTime(0.)
+          , renderSelfThreadTime(0.)
+          , cacheHits(0)
+          , cacheMisses(0)
+          , bytesAllocated(0)
+    {
+    }
+
+    void merge(const NodeFrameProfile& other);
+};
+
+/**
+ * @brief How long renders took to stop once aborted: from the abort request until all the threads
+ * rendering were idle.
+ **/
+struct AbortLatencies
+{
+    U64 count;
+    double totalTime; //< in seconds
+    double maxTime; //< in seconds
+
+    AbortLatencies()
+        : count(0)
+          , totalTime(0.)
+          , maxTime(0.)
+    {
+    }
+};
+
+///Per frame profile of a node
+typedef std::map<int,NodeFrameProfile> NodeProfile;
+
+///Profiles by node name
+typedef std::map<std::string,NodeProfile> RenderProfile;
+
+/**
+ * @brief Opt-in instrumentation of the renders. While it is disabled (the default) the instrumented functions
+ * only pay for a relaxed atomic read. While enabled, every RenderProfilerScope and cache access is recorded
+ * against the node (and frame) being rendered by the calling thread.
+ **/
+class RenderProfiler
+{
+public:
+
+    static bool isEnabled() WARN_UNUSED_RETURN;
+
+    /**
+     * @brief Starts/stops recording. The profile recorded so far is kept.
+     **/
+    static void setEnabled(bool enabled);
+
+    static void clear();
+
+    static void getProfile(RenderProfile* profile);
+
+    /**
+     * @brief Records a look-up in an image cache for the node rendered by the calling thread.
+     * @param bytesAllocated If the look-up created an image, its size
+     **/
+    static void recordCacheAccess(bool hit,U64 bytesAllocated);
+
+    /**
+     * @brief Records the time an aborted render took to stop, @see RenderAbortToken
+     **/
+    static void recordAbortLatency(double seconds);
+
+    static void getAbortLatencies(AbortLatencies* latencies);
+
+    /**
+     * @brief Writes the profile as JSON: one object per node with its totals and its frames, followed by the abort latencies.
+     **/
+    static void writeReport(std::ostream& stream);
+
+    /**
+     * @brief Same as above but into a file. Returns false and sets error if the file could not be written.
+     **/
+    static bool writeReport(const std::string& filename,std::string* error);
+};
+
+/**
+ * @brief Measures the action it is created for until it is destroyed.
+ * For renderRoI, render and getImage, effect and time identify what is measured. Image::convertToFormat
+ * does not know them: it is attributed to the renderRoI in progress on the calling thread.
+ **/
+class RenderProfilerScope
+{
+public:
+
+    RenderProfilerScope(ProfiledActionEnum action,const EffectInstance* effect,int time);
+
+    explicit RenderProfilerScope(ProfiledActionEnum action);
+
+    ~RenderProfilerScope();
+
+private:
+
+    void begin(ProfiledActionEnum action,const EffectInstance* effect,int time);
+
+    bool _active;
+    ProfiledActionEnum _action;
+    QElapsedTimer _timer;
+    double _threadTimeStart;
+};
+} // namespace Natron
+
+#endif // NATRON_ENGINE_RENDERPROFILER_H_
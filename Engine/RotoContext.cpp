@@ -5148,19 +5148,23 @@ RotoContext::renderMask(bool useCache,
     ///We could also propose the user to render a mask to SVG
     _imp->renderInternal(cr, cairoImg, splines,mipmapLevel,time);
 
-    switch (depth) {
-    case Natron::eImageBitDepthFloat:
-        convertCairoImageToNatronImage<float, 1>(cairoImg, image.get(), pixelRod);
-        break;
-    case Natron::eImageBitDepthByte:
-        convertCairoImageToNatronImage<unsigned char, 255>(cairoImg, image.get(), pixelRod);
-        break;
-    case Natron::eImageBitDepthShort:
-        convertCairoImageToNatronImage<unsigned short, 65535>(cairoImg, image.get(), pixelRod);
-        break;
-    case Natron::eImageBitDepthNone:
-        assert(false);
-        break;
+    ///The mask is thrown away below if the render was aborted
+    bool renderAborted = _imp->node->aborted();
+    if (!renderAborted) {
+        switch (depth) {
+        case Natron::eImageBitDepthFloat:
+            convertCairoImageToNatronImage<float, 1>(cairoImg, image.get(), pixelRod);
+            break;
+        case Natron::eImageBitDepthByte:
+            convertCairoImageToNatronImage<unsigned char, 255>(cairoImg, image.get(), pixelRod);
+            break;
+        case Natron::eImageBitDepthShort:
+            convertCairoImageToNatronImage<unsigned short, 65535>(cairoImg, image.get(), pixelRod);
+            break;
+        case Natron::eImageBitDepthNone:
+            assert(false);
+            break;
+        }
     }
 
     cairo_destroy(cr);
@@ -5169,7 +5173,7 @@ RotoContext::renderMask(bool useCache,
 
 
     ////////////////////////////////////
-    if ( _imp->node->aborted() ) {
+    if ( renderAborted || _imp->node->aborted() ) {
         //if render was aborted, remove the frame from the cache as it contains only garbage
         appPTR->removeFromNodeCache(image);
     } else {
@@ -5200,6 +5204,10 @@ RotoContextPrivate::renderInternal(cairo_t* cr,
     // maybe the inner polygon should be made of mesh patterns too?
     cairo_set_antialias(cr, CAIRO_ANTIALIAS_NONE);
     for (std::list<boost::shared_ptr<Bezier> >::const_iterator it2 = splines.begin(); it2 != splines.end(); ++it2) {
+        ///Shapes with many points and a feather are expensive: don't finish the mask of an aborted frame
+        if ( node->aborted() ) {
+            return;
+        }
         ///render the bezier only if finished (closed) and activated
         if ( !(*it2)->isCurveFinished() || !(*it2)->isActivated(time) || ( (*it2)->getControlPointsCount() <= 1 ) ) {
             continue;
@@ -374,7 +374,9 @@ Settings::initializeKnobs()
     helpStringsTextureModes.push_back("Post-processing done by the viewer (such as colorspace conversion) is done "
                                       "by the CPU. As a results, the size of cached textures is smaller.");
     textureModes.push_back("16bits half-float");
-    helpStringsTextureModes.push_back("Not available yet. Similar to 32bits fp.");
+    helpStringsTextureModes.push_back("Post-processing done by the viewer (such as colorspace conversion) is done "
+                                      "by the GPU, using GLSL. Textures are stored as 16 bits floating-point, "
+                                      "which holds twice as many frames as 32bits floating-point in the playback cache.");
     textureModes.push_back("32bits floating-point");
     helpStringsTextureModes.push_back("Post-processing done by the viewer (such as colorspace conversion) is done "
                                       "by the GPU, using GLSL. As a results, the size of cached textures is larger.");
@@ -396,6 +398,18 @@ Settings::initializeKnobs()
     _powerOf2Tiling->setAnimationEnabled(false);
     _viewersTab->addKnob(_powerOf2Tiling);
     
+    _interactiveDownscaleLevel = Natron::createKnob<Int_Knob>(this, "Downscale level while editing");
+    _interactiveDownscaleLevel->setName("interactiveDownscaleLevel");
+    _interactiveDownscaleLevel->setHintToolTip("When the viewer cannot keep up with the edition of a parameter, it first renders "
+                                               "the image at 1/2^n of its resolution and refines it to full resolution once the "
+                                               "parameter stops changing. 0 always renders at full resolution.");
+    _interactiveDownscaleLevel->setMinimum(0);
+    _interactiveDownscaleLevel->setDisplayMinimum(0);
+    _interactiveDownscaleLevel->setMaximum(3);
+    _interactiveDownscaleLevel->setDisplayMaximum(3);
+    _interactiveDownscaleLevel->setAnimationEnabled(false);
+    _viewersTab->addKnob(_interactiveDownscaleLevel);
+    
     _checkerboardTileSize = Natron::createKnob<Int_Knob>(this, "Checkerboard tile size (pixels)");
     _checkerboardTileSize->setName("checkerboardTileSize");
     _checkerboardTileSize->setMinimum(1);
@@ -681,6 +695,36 @@ Settings::initializeKnobs()
     _maxDiskCacheNodeGB->setHintToolTip("The maximum size that may be used by the DiskCache node on disk (in GiB)");
     _cachingTab->addKnob(_maxDiskCacheNodeGB);
 
+    _readAheadMB = Natron::createKnob<Int_Knob>(this, "Read-ahead memory during playback and renders (MiB)");
+    _readAheadMB->setName("readAheadMB");
+    _readAheadMB->setAnimationEnabled(false);
+    _readAheadMB->setMinimum(0);
+    _readAheadMB->setMaximum(16384);
+    _readAheadMB->setHintToolTip("While playing back or rendering on disk, the readers upstream are asked to read the frames "
+                                 "that are about to be rendered in advance, on a separate thread, so that reading files "
+                                 "overlaps with the processing of the previous frames. This is the maximum amount of memory "
+                                 "used by the frames read in advance (in MiB). Set it to 0 to disable reading ahead.");
+    _cachingTab->addKnob(_readAheadMB);
+
+    _diskCacheCompression = Natron::createKnob<Bool_Knob>(this, "Compress disk caches");
+    _diskCacheCompression->setName("diskCacheCompression");
+    _diskCacheCompression->setAnimationEnabled(false);
+    _diskCacheCompression->setHintToolTip("When checked, images and playback frames written to the on-disk caches "
+                                          "(playback cache and DiskCache node) are compressed without loss. "
+                                          "More frames fit in the same disk space and they are read back faster from slow disks, "
+                                          "at the cost of some CPU time to compress and decompress them. "
+                                          "Only frames cached after this parameter is changed are affected.");
+    _cachingTab->addKnob(_diskCacheCompression);
+
+    _diskCacheFloatAsHalf = Natron::createKnob<Bool_Knob>(this, "Store 32-bit floating point images as half floats");
+    _diskCacheFloatAsHalf->setName("diskCacheFloatAsHalf");
+    _diskCacheFloatAsHalf->setAnimationEnabled(false);
+    _diskCacheFloatAsHalf->setHintToolTip("When checked along with disk caches compression, 32-bit floating point images "
+                                          "are stored as 16-bit half floats in the on-disk caches, which halves their size again. "
+                                          "WARNING: This is lossy, values read back from the disk caches are rounded to the nearest "
+                                          "half float.");
+    _cachingTab->addKnob(_diskCacheFloatAsHalf);
+
 
     _diskCachePath = Natron::createKnob<Path_Knob>(this, "Disk cache path (empty = default)");
     _diskCachePath->setName("diskCachePath");
@@ -803,6 +847,7 @@ Settings::setDefaultValues()
     _loadBundledPlugins->setDefaultValue(true);
     _texturesMode->setDefaultValue(0,0);
     _powerOf2Tiling->setDefaultValue(8,0);
+    _interactiveDownscaleLevel->setDefaultValue(1,0);
     _checkerboardTileSize->setDefaultValue(5);
     _checkerboardColor1->setDefaultValue(0.5,0);
     _checkerboardColor1->setDefaultValue(0.5,1);
@@ -823,6 +868,9 @@ Settings::setDefaultValues()
     _unreachableRAMPercent->setDefaultValue(5);
     _maxViewerDiskCacheGB->setDefaultValue(5,0);
     _maxDiskCacheNodeGB->setDefaultValue(10,0);
+    _readAheadMB->setDefaultValue(512,0);
+    _diskCacheCompression->setDefaultValue(false);
+    _diskCacheFloatAsHalf->setDefaultValue(false);
     setCachingLabels();
     _autoTurbo->setDefaultValue(false);
     _defaultNodeColor->setDefaultValue(0.7,0);
@@ -1164,10 +1212,14 @@ Settings::onKnobValueChanged(KnobI* k,
         if (!_restoringSettings) {
             appPTR->setApplicationsCachesMaximumViewerDiskSpace( getMaximumViewerDiskCacheSize() );
         }
-    } else if ( k == _maxViewerDiskCacheGB.get() ) {
+    } else if ( k == _maxDiskCacheNodeGB.get() ) {
         if (!_restoringSettings) {
             appPTR->setApplicationsCachesMaximumDiskSpace(getMaximumDiskCacheNodeSize());
         }
+    } else if ( ( k == _diskCacheCompression.get() ) || ( k == _diskCacheFloatAsHalf.get() ) ) {
+        if (!_restoringSettings) {
+            appPTR->setDiskCachesCompression( isDiskCacheCompressionEnabled(), isDiskCacheFloatAsHalfEnabled() );
+        }
     } else if ( k == _maxRAMPercent.get() ) {
         if (!_restoringSettings) {
             appPTR->setApplicationsCachesMaximumMemoryPercent( getRamMaximumPercent() );
@@ -1267,6 +1319,12 @@ Settings::getViewerTilesPowerOf2() const
     return _powerOf2Tiling->getValue();
 }
 
+int
+Settings::getViewerInteractiveDownscaleLevel() const
+{
+    return _interactiveDownscaleLevel->getValue();
+}
+
 double
 Settings::getRamMaximumPercent() const
 {
@@ -2199,6 +2257,24 @@ Settings::isAggressiveCachingEnabled() const
     return _aggressiveCaching->getValue();
 }
 
+U64
+Settings::getReadAheadMemoryBudget() const
+{
+    return (U64)( _readAheadMB->getValue() ) * 1024ULL * 1024ULL;
+}
+
+bool
+Settings::isDiskCacheCompressionEnabled() const
+{
+    return _diskCacheCompression->getValue();
+}
+
+bool
+Settings::isDiskCacheFloatAsHalfEnabled() const
+{
+    return _diskCacheFloatAsHalf->getValue();
+}
+
 bool
 Settings::isAutoTurboEnabled() const
 {
@@ -63,6 +63,9 @@ public:
     int getViewersBitDepth() const;
 
     int getViewerTilesPowerOf2() const;
+    
+    ///The number of mipmap levels below the viewer's at which drafts are rendered while editing, 0 if disabled
+    int getViewerInteractiveDownscaleLevel() const;
 
     double getRamMaximumPercent() const;
 
@@ -72,6 +75,13 @@ public:
     
     U64 getMaximumDiskCacheNodeSize() const;
 
+    ///In bytes, 0 if reading ahead is disabled
+    U64 getReadAheadMemoryBudget() const;
+
+    bool isDiskCacheCompressionEnabled() const;
+
+    bool isDiskCacheFloatAsHalfEnabled() const;
+
     double getUnreachableRamPercent() const;
 
     bool getColorPickerLinear() const;
@@ -287,11 +297,15 @@ private:
     ///The total disk space allowed for all Natron's caches
     boost::shared_ptr<Int_Knob> _maxViewerDiskCacheGB;
     boost::shared_ptr<Int_Knob> _maxDiskCacheNodeGB;
+    boost::shared_ptr<Int_Knob> _readAheadMB;
+    boost::shared_ptr<Bool_Knob> _diskCacheCompression;
+    boost::shared_ptr<Bool_Knob> _diskCacheFloatAsHalf;
     boost::shared_ptr<Path_Knob> _diskCachePath;
     
     boost::shared_ptr<Page_Knob> _viewersTab;
     boost::shared_ptr<Choice_Knob> _texturesMode;
     boost::shared_ptr<Int_Knob> _powerOf2Tiling;
+    boost::shared_ptr<Int_Knob> _interactiveDownscaleLevel;
     boost::shared_ptr<Int_Knob> _checkerboardTileSize;
     boost::shared_ptr<Color_Knob> _checkerboardColor1;
     boost::shared_ptr<Color_Knob> _checkerboardColor2;
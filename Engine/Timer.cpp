@@ -37,8 +37,13 @@
 
 #include "Timer.h"
 #include <iostream>
+#include <cassert>
+#include <cmath>
+#include <limits>
+#include <algorithm>
 #include <time.h>
 #include <QMutexLocker>
+#include <QThread>
 #define NATRON_FPS_REFRESH_RATE_SECONDS 1.5
 
 
@@ -65,16 +70,62 @@ gettimeofday (struct timeval *tv,
 #endif
 
 
+///The coarse sleep ends this long before the deadline, the rest is spent yielding: a sleep may last longer
+///than requested by up to the granularity of the system scheduler, which is larger on Windows
+#ifdef _WIN32
+#define NATRON_TIMER_SPIN_MARGIN_NS 2000000
+#else
+#define NATRON_TIMER_SPIN_MARGIN_NS 500000
+#endif
+
+PlaybackStats::PlaybackStats()
+    : frames(0)
+      , droppedFrames(0)
+      , seconds(0.)
+      , effectiveFps(0.)
+      , meanOffset(0.)
+      , maxLateness(0.)
+      , maxEarliness(0.)
+      , intervalJitter(0.)
+{
+    for (int i = 0; i < NATRON_PLAYBACK_OFFSET_BINS; ++i) {
+        offsetHistogram[i] = 0;
+    }
+}
+
+double
+PlaybackStats::getOffsetBinUpperBound(int bin)
+{
+    static const double bounds[NATRON_PLAYBACK_OFFSET_BINS - 1] = {
+        -2e-3, -1e-3, -0.5e-3, 0.5e-3, 1e-3, 2e-3, 4e-3, 8e-3, 16e-3
+    };
+
+    assert(bin >= 0 && bin < NATRON_PLAYBACK_OFFSET_BINS);
+    if (bin >= NATRON_PLAYBACK_OFFSET_BINS - 1) {
+        return std::numeric_limits<double>::infinity();
+    }
+
+    return bounds[bin];
+}
+
 Timer::Timer ()
     : playState (ePlayStateRunning),
       _spf (1 / 24.0),
-      _timingError (0),
+      _clock(),
+      _deadlineValid(false),
+      _nextFrameDeadline(0),
+      _lastFrameTime(0),
+      _playbackStartTime(0),
+      _lastFpsFrameTime(0),
       _framesSinceLastFpsFrame (0),
       _actualFrameRate (0),
+      _stats(),
+      _offsetSum(0.),
+      _intervalSum(0.),
+      _intervalSquaredSum(0.),
       _mutex(new QMutex)
 {
-    gettimeofday (&_lastFrameTime, 0);
-    _lastFpsFrameTime = _lastFrameTime;
+    _clock.start();
 }
 
 Timer::~Timer()
@@ -82,6 +133,73 @@ Timer::~Timer()
     delete _mutex;
 }
 
+void
+Timer::sleepUntil(qint64 deadline)
+{
+    for (;;) {
+        qint64 remaining = deadline - _clock.nsecsElapsed();
+        if (remaining <= 0) {
+            return;
+        }
+        if (remaining > NATRON_TIMER_SPIN_MARGIN_NS) {
+            qint64 timeToSleep = remaining - NATRON_TIMER_SPIN_MARGIN_NS;
+#ifdef _WIN32
+            Sleep( (DWORD)(timeToSleep / 1000000) );
+#else
+            timespec ts;
+            ts.tv_sec = (time_t)(timeToSleep / 1000000000);
+            ts.tv_nsec = (long)(timeToSleep % 1000000000);
+            nanosleep (&ts, 0);
+#endif
+        } else {
+            QThread::yieldCurrentThread();
+        }
+    }
+}
+
+void
+Timer::recordFrame(qint64 now,
+                   qint64 offset)
+{
+    QMutexLocker l(_mutex);
+    double offsetSecs = offset * 1e-9;
+
+    ++_stats.frames;
+    if (_stats.frames > 1) {
+        double interval = (now - _lastFrameTime) * 1e-9;
+        _intervalSum += interval;
+        _intervalSquaredSum += interval * interval;
+        U64 intervals = _stats.frames - 1;
+        double mean = _intervalSum / intervals;
+        _stats.intervalJitter = std::sqrt( std::max(0., _intervalSquaredSum / intervals - mean * mean) );
+    }
+    _offsetSum += offsetSecs;
+    _stats.meanOffset = _offsetSum / _stats.frames;
+    _stats.maxLateness = std::max(_stats.maxLateness, offsetSecs);
+    _stats.maxEarliness = std::max(_stats.maxEarliness, -offsetSecs);
+    int bin = 0;
+    while ( bin < NATRON_PLAYBACK_OFFSET_BINS - 1 && offsetSecs > PlaybackStats::getOffsetBinUpperBound(bin) ) {
+        ++bin;
+    }
+    ++_stats.offsetHistogram[bin];
+    _stats.seconds = (now - _playbackStartTime) * 1e-9;
+    ///The first frame is presented at the start of the playback, count the periods of the others
+    _stats.effectiveFps = _stats.seconds > 0 ? (_stats.frames - 1) / _stats.seconds : 0.;
+}
+
+void
+Timer::resetPlayback ()
+{
+    QMutexLocker l(_mutex);
+
+    _deadlineValid = false;
+    _framesSinceLastFpsFrame = 0;
+    _stats = PlaybackStats();
+    _offsetSum = 0.;
+    _intervalSum = 0.;
+    _intervalSquaredSum = 0.;
+}
+
 void
 Timer::waitUntilNextFrameIsDue ()
 {
@@ -91,80 +209,62 @@ Timer::waitUntilNextFrameIsDue ()
         // variables and return without waiting.
         //
 
-        gettimeofday (&_lastFrameTime, 0);
-        _timingError = 0;
-        _lastFpsFrameTime = _lastFrameTime;
-        _framesSinceLastFpsFrame = 0;
+        resetPlayback();
 
         return;
     }
 
     
     double spf;
+    bool deadlineValid;
     {
         QMutexLocker l(_mutex);
         spf = _spf;
+        deadlineValid = _deadlineValid;
+        _deadlineValid = true;
     }
-    //
-    // If less than _spf seconds have passed since the last frame
-    // was displayed, sleep until exactly _spf seconds have gone by.
-    //
-
-    timeval now;
-    gettimeofday (&now, 0);
-
-    double timeSinceLastFrame =  now.tv_sec  - _lastFrameTime.tv_sec +
-                               (now.tv_usec - _lastFrameTime.tv_usec) * 1e-6f;
-    double timeToSleep = spf - timeSinceLastFrame - _timingError;
+    qint64 period = (qint64)(spf * 1e9);
 
-    #ifdef _WIN32
-
-    if (timeToSleep > 0) {
-        Sleep ( int (timeToSleep * 1000.0f) );
+    if (!deadlineValid) {
+        //
+        // First frame of a playback: it is due now and the
+        // following ones every period from now on.
+        //
+        qint64 now = _clock.nsecsElapsed();
+        _nextFrameDeadline = now;
+        _playbackStartTime = now;
+        _lastFpsFrameTime = now;
+    } else {
+        sleepUntil(_nextFrameDeadline);
     }
 
-    #else
-
-    if (timeToSleep > 0) {
-        timespec ts;
-        ts.tv_sec = (time_t) timeToSleep;
-        ts.tv_nsec = (long) ( (timeToSleep - ts.tv_sec) * 1e9f );
-        nanosleep (&ts, 0);
-    }
+    qint64 now = _clock.nsecsElapsed();
+    qint64 offset = now - _nextFrameDeadline;
 
-    #endif
+    recordFrame(now, offset);
+    _lastFrameTime = now;
 
     //
-    // If we slept, it is possible that we woke up a little too early
-    // or a little too late.  Keep track of the difference between
-    // now and the exact time when we wanted to wake up; next time
-    // we'll try sleep that much longer or shorter.  This should
-    // keep our average frame rate close to one fame every _spf seconds.
+    // Schedule the next frame one period after the deadline of this
+    // one, not after the time we actually woke up, so that the
+    // errors of the sleeps do not accumulate. If the frame was so
+    // late that the next deadline is already over, the frames that
+    // should have been presented meanwhile are dropped rather than
+    // presented in a burst.
     //
-
-    gettimeofday (&now, 0);
-
-    timeSinceLastFrame =  now.tv_sec  - _lastFrameTime.tv_sec +
-                         (now.tv_usec - _lastFrameTime.tv_usec) * 1e-6f;
-
-    _timingError += timeSinceLastFrame - spf;
-
-    if (_timingError < -2 * spf) {
-        _timingError = -2 * spf;
-    }
-
-    if (_timingError >  2 * spf) {
-        _timingError =  2 * spf;
+    if ( (period > 0) && (offset > period) ) {
+        QMutexLocker l(_mutex);
+        _stats.droppedFrames += (U64)(offset / period);
+        _nextFrameDeadline = now + period;
+    } else {
+        _nextFrameDeadline += period;
     }
 
-    _lastFrameTime = now;
-
     //
     // Calculate our actual frame rate, averaged over several frames.
     //
     
-    double t =  now.tv_sec  - _lastFpsFrameTime.tv_sec +
-    (now.tv_usec - _lastFpsFrameTime.tv_usec) * 1e-6f;
+    double t = (now - _lastFpsFrameTime) * 1e-9;
     
     if (t > NATRON_FPS_REFRESH_RATE_SECONDS) {
         double actualFrameRate = _framesSinceLastFpsFrame / t;
@@ -183,6 +283,14 @@ Timer::waitUntilNextFrameIsDue ()
     _framesSinceLastFpsFrame += 1;
 } // waitUntilNextFrameIsDue
 
+void
+Timer::getPlaybackStats(PlaybackStats* stats) const
+{
+    assert(stats);
+    QMutexLocker l(_mutex);
+    *stats = _stats;
+}
+
 void
 Timer::setDesiredFrameRate (double fps)
 {
@@ -43,6 +43,8 @@
 //----------------------------------------------------------------------------
 
 #include <QObject>
+#include <QElapsedTimer>
+#include "Global/GlobalDefines.h"
 #ifdef _WIN32
     #include <windows.h>
 #else
@@ -59,6 +61,34 @@ enum PlayStateEnum
     ePlayStatePause,
 };
 
+///Number of bins of PlaybackStats::offsetHistogram
+#define NATRON_PLAYBACK_OFFSET_BINS 10
+
+/**
+ * @brief How regularly the frames of a playback were presented. The offset of a frame is the time at which
+ * waitUntilNextFrameIsDue() returned minus the time the frame was due: positive if late, negative if early.
+ **/
+struct PlaybackStats
+{
+    U64 frames; //< frames presented since the playback started
+    U64 droppedFrames; //< frame periods during which no new frame could be presented because frames were late
+    double seconds; //< time since the first frame of the playback
+    double effectiveFps; //< frame periods presented per second
+    double meanOffset; //< in seconds
+    double maxLateness; //< largest positive offset, in seconds
+    double maxEarliness; //< largest negative offset as a positive value, in seconds
+    double intervalJitter; //< standard deviation of the time between 2 frames, in seconds
+    U64 offsetHistogram[NATRON_PLAYBACK_OFFSET_BINS]; //< frames per offset range, @see getOffsetBinUpperBound
+
+    PlaybackStats();
+
+    /**
+     * @brief The offsets counted in the given bin are lower than or equal to this value (in seconds) and greater
+     * than the bound of the previous bin. The last bin has no bound.
+     **/
+    static double getOffsetBinUpperBound(int bin);
+};
+
 class QMutex;
 class Timer : public QObject
 {
@@ -81,14 +111,35 @@ public:
     // waitUntilNextFrameIsDue() before displaying each frame.
     //
     // If playState == ePlayStateRunning, then waitUntilNextFrameIsDue()
-    // sleeps until the apropriate amount of time has elapsed
-    // since the last call to waitUntilNextFrameIsDue().
+    // sleeps until the frame is due. Frames are due at absolute
+    // deadlines on a monotonic clock, one frame period apart, so
+    // that the timing errors of the sleeps do not accumulate.
+    // A frame more than a period late moves the following deadlines:
+    // the missed periods are counted as dropped frames instead of
+    // presenting the next frames in a burst to catch up.
     // If playState != ePlayStateRunning, then waitUntilNextFrameIsDue()
     // returns immediately.
     //--------------------------------------------------------
 
     void    waitUntilNextFrameIsDue ();
 
+    //-------------------------------------------------
+    // Starts a new playback: the next frame is due
+    // immediately and the statistics are reset. This is
+    // also done when waitUntilNextFrameIsDue() is called
+    // while playState != ePlayStateRunning.
+    //-------------------------------------------------
+
+    void    resetPlayback ();
+
+    //-------------------------------------------------
+    // Statistics of the current playback, or of the last
+    // one if it is stopped. They are reset by
+    // resetPlayback().
+    //-------------------------------------------------
+
+    void getPlaybackStats(PlaybackStats* stats) const;
+
 
     //-------------------------------------------------
     // Set and get the frame rate, in frames per second
@@ -110,16 +161,31 @@ signals:
 
 private:
 
+    void sleepUntil(qint64 deadline);
+
+    void recordFrame(qint64 now,qint64 offset);
+
     double _spf;                 // desired frame rate,
     // in seconds per frame
-    timeval _lastFrameTime;         // time when we displayed the
+    QElapsedTimer _clock;           // monotonic clock, all times below
+    // are in nanoseconds on this clock
+    bool _deadlineValid;            // false until the first frame of
+    // a playback
+    qint64 _nextFrameDeadline;      // time when the next frame is due
+    qint64 _lastFrameTime;          // time when we displayed the
     // last frame
-    double _timingError;             // cumulative timing error
-    timeval _lastFpsFrameTime;      // state to keep track of the
+    qint64 _playbackStartTime;      // time when we displayed the first
+    // frame of the playback
+    qint64 _lastFpsFrameTime;       // state to keep track of the
     int _framesSinceLastFpsFrame;       // actual frame rate, averaged
     double _actualFrameRate;         // over several frames
     
-    QMutex* _mutex; //< protects _spf which is the only member that can 
+    PlaybackStats _stats;
+    double _offsetSum;              // to compute the means
+    double _intervalSum;
+    double _intervalSquaredSum;
+
+    QMutex* _mutex; //< protects _spf and the statistics, which are read by other threads
 };
 
 
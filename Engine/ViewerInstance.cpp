@@ -11,6 +11,8 @@
 
 #include "ViewerInstancePrivate.h"
 
+#include <vector>
+
 #include <boost/shared_ptr.hpp>
 #include <boost/bind.hpp>
 
@@ -18,6 +20,7 @@ CLANG_DIAG_OFF(deprecated)
 #include <QtCore/QtGlobal>
 #include <QtConcurrentMap> // QtCore on Qt4, QtConcurrent on Qt<<(
 #include <QtCore/QFutureWatcher>
+#include <QtCore/QElapsedTimer>
 #include <QtCore/QMutex>
 #include <QtCore/QWaitCondition>
 #include <QtCore/QCoreApplication>
@@ -40,6 +43,7 @@ CLANG_DIAG_ON(deprecated)
 #include "Engine/OpenGLViewerI.h"
 #include "Engine/Image.h"
 #include "Engine/OutputSchedulerThread.h"
+#include "Engine/RenderPriorityScheduler.h"
 
 #ifndef M_LN2
 #define M_LN2       0.693147180559945309417232121458176568  /* loge(2)        */
@@ -57,7 +61,7 @@ static void scaleToTexture8bits(std::pair<int,int> yRange,
 static void scaleToTexture32bits(std::pair<int,int> yRange,
                                  const RenderViewerArgs & args,
                                  ViewerInstance* viewer,
-                                 float *output);
+                                 void *output);
 static std::pair<double, double>
 findAutoContrastVminVmax(boost::shared_ptr<const Natron::Image> inputImage,
                          ViewerInstance::DisplayChannelsEnum channels,
@@ -153,6 +157,7 @@ ViewerInstance::ViewerInstance(boost::shared_ptr<Node> node)
     QObject::connect( this,SIGNAL( disconnectTextureRequest(int) ),this,SLOT( executeDisconnectTextureRequestOnMainThread(int) ) );
     QObject::connect( _imp.get(),SIGNAL( mustRedrawViewer() ),this,SLOT( redrawViewer() ) );
     QObject::connect( this,SIGNAL( s_callRedrawOnMainThread() ), this, SLOT( redrawViewer() ) );
+    QObject::connect( &_imp->refinementTimer,SIGNAL( timeout() ), this, SLOT( refineDraftRender() ) );
 }
 
 ViewerInstance::~ViewerInstance()
@@ -310,6 +315,18 @@ ViewerInstance::renderViewer(int view,
     Natron::StatusEnum ret[2] = {
         eStatusReplyDefault, eStatusReplyDefault
     };
+    bool isDraft = false;
+    SequenceTime time = 0;
+    for (int i = 0; i < 2; ++i) {
+        if (args[i] && args[i]->draftRender) {
+            isDraft = true;
+        }
+        if (args[i] && args[i]->params) {
+            time = args[i]->params->time;
+        }
+    }
+    QElapsedTimer timer;
+    timer.start();
     for (int i = 0; i < 2; ++i) {
         if ( (i == 1) && (_imp->uiContext->getCompositingOperator() == Natron::eViewerCompositingOperatorNone) ) {
             break;
@@ -328,6 +345,11 @@ ViewerInstance::renderViewer(int view,
     if ( (ret[0] == eStatusFailed) && (ret[1] == eStatusFailed) ) {
         return eStatusFailed;
     }
+    
+    ///Aborted renders return eStatusReplyDefault: only measure the ones that went through
+    if ( !isSequentialRender && ( (ret[0] == eStatusOK) || (ret[1] == eStatusOK) ) ) {
+        _imp->draftRender.onRenderFinished(time, isDraft, timer.elapsed());
+    }
 
     return eStatusOK;
 }
@@ -364,8 +386,10 @@ static bool checkTreeCanRender(Node* node)
 
 Natron::StatusEnum
 ViewerInstance::getRenderViewerArgsAndCheckCache(SequenceTime time, int view, int textureIndex, U64 viewerHash,
+                                                 bool isSequentialRender,
                                                  ViewerArgs* outArgs)
 {
+    outArgs->draftRender = false;
     if (textureIndex == 0) {
         QMutexLocker l(&_imp->activeInputsMutex);
         outArgs->activeInputIndex =  _imp->activeInputs[0];
@@ -416,11 +440,8 @@ ViewerInstance::getRenderViewerArgsAndCheckCache(SequenceTime time, int view, in
     RenderScale scaleOne;
     scaleOne.x = scaleOne.y = 1.;
     EffectInstance::SupportsEnum supportsRS = outArgs->activeInputToRender->supportsRenderScaleMaybe();
-    scale.x = scale.y = Natron::Image::getScaleFromMipMapLevel(mipMapLevel);
-    
-    
-    int closestPowerOf2 = 1 << mipMapLevel;
     
+    scale.x = scale.y = Natron::Image::getScaleFromMipMapLevel(mipMapLevel);
     
     
     //The hash of the node to render
@@ -456,6 +477,17 @@ ViewerInstance::getRenderViewerArgsAndCheckCache(SequenceTime time, int view, in
     
     isRodProjectFormat = ifInfiniteclipRectToProjectDefault(&rod);
     
+    ///The user is editing a parameter: render a coarser draft first. This is pointless if the input would
+    ///render at full scale anyway.
+    if ( !isSequentialRender && (supportsRS != eSupportsNo) ) {
+        mipMapLevel = _imp->draftRender.getRenderMipMapLevel(mipMapLevel, rod, par, &outArgs->draftRender);
+        if (outArgs->draftRender) {
+            scale.x = scale.y = Natron::Image::getScaleFromMipMapLevel(mipMapLevel);
+        }
+    }
+    
+    int closestPowerOf2 = 1 << mipMapLevel;
+    
     assert(_imp->uiContext);
     
     bool autoContrast;
@@ -502,9 +534,10 @@ ViewerInstance::getRenderViewerArgsAndCheckCache(SequenceTime time, int view, in
     assert(_imp->uiContext);
     OpenGLViewerI::BitDepthEnum bitDepth = _imp->uiContext->getBitDepth();
     
-    //half float is not supported yet so it is the same as float
-    if ( (bitDepth == OpenGLViewerI::eBitDepthFloat) || (bitDepth == OpenGLViewerI::eBitDepthHalf) ) {
+    if (bitDepth == OpenGLViewerI::eBitDepthFloat) {
         outArgs->params->bytesCount *= sizeof(float);
+    } else if (bitDepth == OpenGLViewerI::eBitDepthHalf) {
+        outArgs->params->bytesCount *= sizeof(unsigned short);
     }
     
     outArgs->params->time = time;
@@ -519,13 +552,18 @@ ViewerInstance::getRenderViewerArgsAndCheckCache(SequenceTime time, int view, in
     }
     std::string inputToRenderName = outArgs->activeInputToRender->getNode()->getName_mt_safe();
     
+    ///With floating point textures the gain, the colorspace and the channels selection are applied
+    ///by the viewer's shader at draw time: the texture only holds the linear RGBA data and doesn't
+    ///depend on them. Keep them out of the key so that tweaking the display doesn't miss the cache.
+    const bool displayTransformOnGPU = bitDepth != OpenGLViewerI::eBitDepthByte;
+    
     outArgs->key.reset(new FrameKey(time,
                  viewerHash,
-                 outArgs->params->gain,
-                 outArgs->params->lut,
+                 displayTransformOnGPU ? 1. : outArgs->params->gain,
+                 displayTransformOnGPU ? (int)eViewerColorSpaceLinear : (int)outArgs->params->lut,
                  (int)bitDepth,
-                 channels,
-                 view,
+                 displayTransformOnGPU ? (int)eDisplayChannelsRGB : (int)channels,
+                 outArgs->activeInputToRender->getViewForCache(view),
                  outArgs->params->textureRect,
                  scale,
                  inputToRenderName));
@@ -731,7 +769,8 @@ ViewerInstance::renderViewer_internal(int view,
                                                        canAbort,
                                                        inArgs.activeInputHash,
                                                        false,
-                                                       getTimeline().get());
+                                                       getTimeline().get(),
+                                                       inArgs.memoryBudget);
         
         
         
@@ -792,6 +831,10 @@ ViewerInstance::renderViewer_internal(int view,
     
     ViewerColorSpaceEnum srcColorSpace = getApp()->getDefaultColorSpaceForBitDepth( inArgs.params->image->getBitDepth() );
     
+    ///The shader selects the channels of floating point textures, see getRenderViewerArgsAndCheckCache
+    const ViewerInstance::DisplayChannelsEnum textureChannels =
+        inArgs.key->getBitDepth() == OpenGLViewerI::eBitDepthByte ? channels : eDisplayChannelsRGB;
+    
     
     if (singleThreaded) {
         if (autoContrast) {
@@ -811,7 +854,7 @@ ViewerInstance::renderViewer_internal(int view,
         
         const RenderViewerArgs args( inArgs.params->image,
                                     inArgs.params->textureRect,
-                                    channels,
+                                    textureChannels,
                                     inArgs.params->srcPremult,
                                     1,
                                     inArgs.key->getBitDepth(),
@@ -830,7 +873,8 @@ ViewerInstance::renderViewer_internal(int view,
         // group of group of rows where first is image coordinate, second is texture coordinate
         QList< std::pair<int, int> > splitRows;
         
-        bool runInCurrentThread = QThreadPool::globalInstance()->activeThreadCount() >= QThreadPool::globalInstance()->maxThreadCount();
+        ///Renders of a higher priority in progress get the threads of the pool, @see RenderPriorityScheduler
+        bool runInCurrentThread = RenderPriorityScheduler::getAvailablePoolThreads(RenderPriorityScheduler::getCurrentThreadPriority()) == 0;
         
         if (!runInCurrentThread) {
             int k = roi.y1;
@@ -893,7 +937,7 @@ ViewerInstance::renderViewer_internal(int view,
         
         const RenderViewerArgs args(inArgs.params->image,
                                     inArgs.params->textureRect,
-                                    channels,
+                                    textureChannels,
                                     inArgs.params->srcPremult,
                                     1,
                                     inArgs.key->getBitDepth(),
@@ -937,7 +981,8 @@ renderFunctor(std::pair<int,int> yRange,
 
     if ( (args.bitDepth == OpenGLViewerI::eBitDepthFloat) || (args.bitDepth == OpenGLViewerI::eBitDepthHalf) ) {
         // image is stored as linear, the OpenGL shader with do gamma/sRGB/Rec709 decompression, as well as gain and offset
-        scaleToTexture32bits(yRange, args,viewer, (float*)buffer);
+        // in half-float mode, each scan-line is converted to IEEE half float before being written to the buffer
+        scaleToTexture32bits(yRange, args,viewer, buffer);
     } else {
         // texture is stored as sRGB/Rec709 compressed 8-bit RGBA
         scaleToTexture8bits(yRange, args,viewer, (U32*)buffer);
@@ -1284,16 +1329,27 @@ void
 scaleToTexture32bitsInternal(const std::pair<int,int> & yRange,
                              const RenderViewerArgs & args,
                              ViewerInstance* viewer,
-                             float *output)
+                             void *output)
 {
     size_t pixelSize = sizeof(PIX);
     const bool luminance = (args.channels == ViewerInstance::eDisplayChannelsY);
 
     ///the width of the output buffer multiplied by the channels count
     int dst_width = args.texRect.w * 4;
-
+    
+    ///In half float mode, each scan-line is first computed in 32 bits and then converted at once
+    const bool halfOutput = args.bitDepth == OpenGLViewerI::eBitDepthHalf;
+    std::vector<float> halfScanLine;
+    unsigned short* halfOutputPixels = 0;
+    float* floatOutputPixels = 0;
+    
     ///offset the output buffer at the starting point
-    output += ( (yRange.first - args.texRect.y1) / args.closestPowerOf2 ) * dst_width;
+    if (halfOutput) {
+        halfScanLine.resize(dst_width);
+        halfOutputPixels = (unsigned short*)output + ( (yRange.first - args.texRect.y1) / args.closestPowerOf2 ) * dst_width;
+    } else {
+        floatOutputPixels = (float*)output + ( (yRange.first - args.texRect.y1) / args.closestPowerOf2 ) * dst_width;
+    }
 
     ///iterating over the scan-lines of the input image
     int dstY = 0;
@@ -1304,7 +1360,7 @@ scaleToTexture32bitsInternal(const std::pair<int,int> & yRange,
         }
         
         const float* src_pixels = (const float*)args.inputImage->pixelAt(args.texRect.x1, y);
-        float* dst_pixels = output + dstY * dst_width;
+        float* dst_pixels = halfOutput ? &halfScanLine.front() : floatOutputPixels + dstY * dst_width;
 
         ///we fill the scan-line with all the pixels of the input image
         for (int x = args.texRect.x1; x < args.texRect.x2; x += args.closestPowerOf2) {
@@ -1328,9 +1384,9 @@ scaleToTexture32bitsInternal(const std::pair<int,int> & yRange,
                     a = 1.;
                     break;
                 case 1:
-                    a = (nComps < 4) ? 1. : *src_pixels;
-                    r = g = b = a;
-                    a = 1.;
+                    ///keep the value in the alpha channel too so that the shader can display it
+                    ///whichever channel is selected
+                    r = g = b = a = *src_pixels;
                     break;
                 default:
                     assert(false);
@@ -1385,6 +1441,9 @@ scaleToTexture32bitsInternal(const std::pair<int,int> & yRange,
 
             src_pixels += args.closestPowerOf2 * nComps;
         }
+        if (halfOutput) {
+            Natron::Color::to_half_row(&halfScanLine.front(), dst_width, halfOutputPixels + dstY * dst_width);
+        }
         ++dstY;
     }
 } // scaleToTexture32bitsInternal
@@ -1395,7 +1454,7 @@ void
 scaleToTexture32bitsForPremult(const std::pair<int,int> & yRange,
                              const RenderViewerArgs & args,
                             ViewerInstance* viewer,
-                             float *output)
+                             void *output)
 {
     switch (args.srcPremult) {
         case Natron::eImagePremultiplicationOpaque:
@@ -1415,7 +1474,7 @@ void
 scaleToTexture32bitsForDepthForComponents(const std::pair<int,int> & yRange,
                              const RenderViewerArgs & args,
                             ViewerInstance* viewer,
-                             float *output)
+                             void *output)
 {
     switch (args.channels) {
         case ViewerInstance::eDisplayChannelsRGB:
@@ -1484,7 +1543,7 @@ void
 scaleToTexture32bitsForDepth(const std::pair<int,int> & yRange,
                              const RenderViewerArgs & args,
                              ViewerInstance* viewer,
-                             float *output)
+                             void *output)
 {
     Natron::ImageComponentsEnum comps = args.inputImage->getComponents();
     switch (comps) {
@@ -1506,7 +1565,7 @@ void
 scaleToTexture32bits(std::pair<int,int> yRange,
                      const RenderViewerArgs & args,
                      ViewerInstance* viewer,
-                     float *output)
+                     void *output)
 {
     assert(output);
 
@@ -1602,6 +1661,34 @@ ViewerInstance::onGainChanged(double exp)
     }
 }
 
+void
+ViewerInstance::renderCurrentFrameInteractively()
+{
+    // always running in the main thread
+    assert( qApp && qApp->thread() == QThread::currentThread() );
+    
+    int downscaleLevel = appPTR->getCurrentSettings()->getViewerInteractiveDownscaleLevel();
+    bool renderDraft = _imp->draftRender.onEdit(getTimeline()->currentFrame(), downscaleLevel);
+    if (renderDraft) {
+        ///Each edit pushes the refinement back until the user stops
+        _imp->refinementTimer.start();
+    } else {
+        _imp->refinementTimer.stop();
+    }
+    renderCurrentFrame(true);
+}
+
+void
+ViewerInstance::refineDraftRender()
+{
+    // always running in the main thread
+    assert( qApp && qApp->thread() == QThread::currentThread() );
+    if ( !_imp->draftRender.refine() ) {
+        return;
+    }
+    renderCurrentFrame(true);
+}
+
 void
 ViewerInstance::onMipMapLevelChanged(int level)
 {
@@ -1674,8 +1761,12 @@ ViewerInstance::setDisplayChannels(DisplayChannelsEnum channels)
         QMutexLocker l(&_imp->viewerParamsMutex);
         _imp->viewerParamsChannels = channels;
     }
-    if ( !getApp()->getProject()->isLoadingProject() ) {
+    assert(_imp->uiContext);
+    if ( ( (_imp->uiContext->getBitDepth() == OpenGLViewerI::eBitDepthByte) || !_imp->uiContext->supportsGLSL() || isAutoContrastEnabled() )
+         && !getApp()->getProject()->isLoadingProject() ) {
         renderCurrentFrame(true);
+    } else {
+        _imp->uiContext->redraw();
     }
 }
 
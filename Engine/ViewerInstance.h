@@ -73,14 +73,18 @@ public:
         bool forceRender;
         int activeInputIndex;
         U64 activeInputHash;
+        bool draftRender; //< true if rendered at a coarser mipmap level than the viewer's, @see renderCurrentFrameInteractively
         boost::shared_ptr<Natron::FrameKey> key;
         boost::shared_ptr<UpdateViewerParams> params;
+        boost::shared_ptr<FrameMemoryBudget> memoryBudget; //< shared by the textures of a frame in playback, if NULL the frame gets its own budget
     };
     
     /**
      * @brief Look-up the cache and try to find a matching texture for the portion to render.
+     * Unless isSequentialRender is true, the texture may be a draft, @see renderCurrentFrameInteractively
      **/
     Natron::StatusEnum getRenderViewerArgsAndCheckCache(SequenceTime time, int view, int textureIndex, U64 viewerHash,
+                                                        bool isSequentialRender,
                                                         ViewerArgs* outArgs);
 
     
@@ -102,6 +106,15 @@ public:
 
     void updateViewer(boost::shared_ptr<UpdateViewerParams> & frame);
     
+    /**
+     * @brief Same as renderCurrentFrame(true) but for renders following an edit of the user: if the last render at
+     * full resolution could not keep up with the mouse, the frame is first rendered a few mipmap levels below
+     * (@see Settings::getViewerInteractiveDownscaleLevel) and refined to full resolution once the user stops editing.
+     * A newer edit changes the hash of the tree which aborts the refinement still running.
+     * Can only be called on the main-thread.
+     **/
+    void renderCurrentFrameInteractively();
+    
     /**
      *@brief Bypasses the cache so the next frame will be rendered fully
      **/
@@ -189,6 +202,11 @@ public slots:
      * @brief Redraws the OpenGL viewer. Can only be called on the main-thread.
      **/
     void redrawViewer();
+    
+    /**
+     * @brief Renders the current frame at full resolution if the last one was a draft.
+     **/
+    void refineDraftRender();
 
   
     void executeDisconnectTextureRequestOnMainThread(int index);
@@ -17,12 +17,20 @@
 #include <QtCore/QMutex>
 #include <QtCore/QWaitCondition>
 #include <QtCore/QThread>
+#include <QtCore/QTimer>
 #include <QtCore/QCoreApplication>
 
 #include "Engine/OutputSchedulerThread.h"
 #include "Engine/FrameEntry.h"
 #include "Engine/Settings.h"
 #include "Engine/TextureRect.h"
+#include "Engine/DraftRenderState.h"
+
+///How long the viewer waits after the last edit of a parameter before refining a draft render to full resolution
+#define NATRON_VIEWER_REFINEMENT_DELAY_MS 150
+
+///Current frame renders faster than this keep up with the mouse: they are never preceded by a draft
+#define NATRON_VIEWER_INTERACTIVE_RENDER_BUDGET_MS 40
 
 namespace Natron {
 class FrameEntry;
@@ -147,7 +155,11 @@ public:
           , lastRenderedHashMutex()
           , lastRenderedHash(0)
           , lastRenderedHashValid(false)
+          , draftRender(NATRON_VIEWER_INTERACTIVE_RENDER_BUDGET_MS)
+          , refinementTimer()
     {
+        refinementTimer.setSingleShot(true);
+        refinementTimer.setInterval(NATRON_VIEWER_REFINEMENT_DELAY_MS);
 
         activeInputs[0] = -1;
         activeInputs[1] = -1;
@@ -254,6 +266,10 @@ public:
     mutable QMutex textureBeingRenderedMutex;
     QWaitCondition textureBeingRenderedCond;
     std::list<boost::shared_ptr<Natron::FrameEntry> > textureBeingRendered; ///< a list of all the texture being rendered simultaneously
+    
+    // draftRender: progressive refinement while the user edits a parameter, @see ViewerInstance::renderCurrentFrameInteractively
+    Natron::DraftRenderState draftRender;
+    QTimer refinementTimer; //< main thread only, restarted by each edit and firing the full resolution render
 };
 
 
@@ -339,6 +339,14 @@ enum SchedulingPolicyEnum
     eSchedulingPolicyFFA = 0, ///frames will be rendered concurrently without ordering (free for all)
     eSchedulingPolicyOrdered ///frames will be rendered in order
 };
+
+enum RenderPriorityEnum
+{
+    eRenderPriorityInteractive = 0, ///renders of the viewer in response to a user interaction
+    eRenderPriorityPlayback, ///renders of the viewer during playback
+    eRenderPriorityBackground, ///writers, DiskCache pre-caching, previews and frames prefetching
+    eRenderPriorityCount
+};
     
 }
 Q_DECLARE_METATYPE(Natron::StandardButtons)
@@ -38,7 +38,9 @@
 #define NATRON_ENV_VAR_VALUE_START_TAG "<Value>"
 #define NATRON_ENV_VAR_VALUE_END_TAG "</Value>"
 #define NATRON_PROJECT_ENV_VAR_MAX_RECURSION 100
-#define NATRON_MAX_CACHE_FILES_OPENED 20000
+#define NATRON_CACHE_SLAB_SIZE 268435456 // 256 MiB per slab file of the disk caches
+#define NATRON_CACHE_SLAB_ALIGNMENT 65536 // extents are aligned so they can be flushed independently
+#define NATRON_CACHE_CODEC_BLOCK_SIZE 262144 // disk cache entries are compressed by independent blocks of 256 KiB
 #define NATRON_CUSTOM_HTML_TAG_START "<" NATRON_APPLICATION_NAME ">"
 #define NATRON_CUSTOM_HTML_TAG_END "</" NATRON_APPLICATION_NAME ">"
 
@@ -20,6 +20,8 @@
  *          http://creativecommons.org/licenses/by/3.0/deed.en_US
  */
 #include <vector>
+#include <string>
+#include <algorithm>
 #include <iostream>
 #include <cmath>
 #if defined(_WIN32)
@@ -97,20 +99,119 @@ getSystemTotalRAM()
 #endif
 }
 
+#if defined(__linux__) || defined(__linux) || defined(linux) || defined(__gnu_linux__)
+/**
+ * @brief Reads a single number from a cgroup file. Returns false if the file does not exist
+ * or holds "max" (no limit).
+ **/
+inline bool
+readCGroupValue(const char* filePath,
+                unsigned long long* value)
+{
+    FILE* fp = fopen(filePath, "r");
+    if (!fp) {
+        return false;
+    }
+    bool ok = fscanf(fp, "%llu", value) == 1;
+    fclose(fp);
+
+    return ok;
+}
+
+/**
+ * @brief Returns the value of the given key in a cgroup memory.stat file, or 0.
+ **/
+inline unsigned long long
+readCGroupStat(const char* filePath,
+               const char* key)
+{
+    FILE* fp = fopen(filePath, "r");
+    if (!fp) {
+        return 0;
+    }
+    char name[64];
+    unsigned long long value;
+    unsigned long long ret = 0;
+    while (fscanf(fp, "%63s %llu", name, &value) == 2) {
+        if (std::string(name) == key) {
+            ret = value;
+            break;
+        }
+    }
+    fclose(fp);
+
+    return ret;
+}
+
+#endif
+
+/**
+ * @brief If the process runs in a memory-limited control group (e.g. in a Linux container), returns true and
+ * the limit of the group as well as how much of it is still available. Page cache that the kernel can reclaim
+ * (inactive file pages) is counted as available.
+ * This looks at the cgroup mounted at /sys/fs/cgroup (v2, or v1 memory controller), which is the group
+ * of the process when it runs in a container with its own cgroup namespace.
+ **/
+inline bool
+getCGroupMemoryInfo(size_t* limit,
+                    size_t* available)
+{
+#if defined(__linux__) || defined(__linux) || defined(linux) || defined(__gnu_linux__)
+    unsigned long long limitValue, usage, reclaimable;
+    if ( readCGroupValue("/sys/fs/cgroup/memory.max", &limitValue) ) {
+        if ( !readCGroupValue("/sys/fs/cgroup/memory.current", &usage) ) {
+            return false;
+        }
+        reclaimable = readCGroupStat("/sys/fs/cgroup/memory.stat", "inactive_file");
+    } else if ( readCGroupValue("/sys/fs/cgroup/memory/memory.limit_in_bytes", &limitValue) ) {
+        if ( !readCGroupValue("/sys/fs/cgroup/memory/memory.usage_in_bytes", &usage) ) {
+            return false;
+        }
+        reclaimable = readCGroupStat("/sys/fs/cgroup/memory/memory.stat", "total_inactive_file");
+    } else {
+        return false;
+    }
+    ///cgroup v1 reports a huge value when there is no limit
+    if ( limitValue >= (unsigned long long)getSystemTotalRAM() ) {
+        return false;
+    }
+    usage = reclaimable > usage ? 0 : usage - reclaimable;
+    *limit = (size_t)limitValue;
+    *available = usage > limitValue ? 0 : (size_t)(limitValue - usage);
+
+    return true;
+#else
+    (void)limit;
+    (void)available;
+
+    return false;
+#endif
+}
+
 inline bool
 isApplication32Bits()
 {
     return sizeof(void*) == 4;
 }
 
+/**
+ * @brief Returns the RAM the application can address: the RAM of the system, limited to 4GB for 32 bits
+ * builds and to the memory limit of the control group of the process if any.
+ **/
 inline size_t
 getSystemTotalRAM_conditionnally()
 {
+    size_t ret = getSystemTotalRAM();
+
     if ( isApplication32Bits() ) {
-        return std::min( (size_t)0xFFFFFFFF,getSystemTotalRAM() );
-    } else {
-        return getSystemTotalRAM();
+        ret = std::min( (size_t)0xFFFFFFFF,ret );
     }
+    size_t cgroupLimit, cgroupAvailable;
+    if ( getCGroupMemoryInfo(&cgroupLimit, &cgroupAvailable) ) {
+        ret = std::min(ret, cgroupLimit);
+    }
+
+    return ret;
 }
 
 // prints RAM value as KB, MB or GB
@@ -295,4 +396,21 @@ getAmountFreePhysicalRAM()
 #endif
 }
 
+/**
+ * @brief Returns how much RAM can still be allocated before the system, or the control group of the
+ * process, runs out of memory.
+ **/
+inline size_t
+getAmountAvailableRAM()
+{
+    size_t ret = getAmountFreePhysicalRAM();
+    size_t cgroupLimit, cgroupAvailable;
+
+    if ( getCGroupMemoryInfo(&cgroupLimit, &cgroupAvailable) ) {
+        ret = std::min(ret, cgroupAvailable);
+    }
+
+    return ret;
+}
+
 #endif // ifndef NATRON_GLOBAL_MEMORYINFO_H_
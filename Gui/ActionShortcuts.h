@@ -92,6 +92,12 @@
 #define kShortcutIDActionRenderAll "renderAll"
 #define kShortcutDescActionRenderAll "Render all writers"
 
+#define kShortcutIDActionProfileRenders "profileRenders"
+#define kShortcutDescActionProfileRenders "Profile renders"
+
+#define kShortcutIDActionExportRenderProfile "exportRenderProfile"
+#define kShortcutDescActionExportRenderProfile "Export render profile..."
+
 #define kShortcutIDActionConnectViewerToInput1 "connectViewerInput1"
 #define kShortcutDescActionConnectViewerToInput1 "Connect viewer to input 1"
 
@@ -69,6 +69,7 @@ CLANG_DIAG_ON(unused-parameter)
 #include "Engine/Node.h"
 #include "Engine/KnobSerialization.h"
 #include "Engine/OutputSchedulerThread.h"
+#include "Engine/RenderProfiler.h"
 
 #include "Gui/GuiApplicationManager.h"
 #include "Gui/GuiAppInstance.h"
@@ -234,6 +235,8 @@ struct GuiPrivate
     QAction *actionsOpenRecentFile[NATRON_MAX_RECENT_FILES];
     ActionWithShortcut *renderAllWriters;
     ActionWithShortcut *renderSelectedNode;
+    ActionWithShortcut *actionProfileRenders;
+    ActionWithShortcut *actionExportRenderProfile;
     ActionWithShortcut* actionConnectInput1;
     ActionWithShortcut* actionConnectInput2;
     ActionWithShortcut* actionConnectInput3;
@@ -392,6 +395,8 @@ struct GuiPrivate
           , actionsOpenRecentFile()
           , renderAllWriters(0)
           , renderSelectedNode(0)
+          , actionProfileRenders(0)
+          , actionExportRenderProfile(0)
           , actionConnectInput1(0)
           , actionConnectInput2(0)
           , actionConnectInput3(0)
@@ -862,6 +867,14 @@ Gui::createMenuActions()
     _imp->renderSelectedNode = new ActionWithShortcut(kShortcutGroupGlobal,kShortcutIDActionRenderSelected,kShortcutDescActionRenderSelected,this);
     QObject::connect( _imp->renderSelectedNode,SIGNAL( triggered() ),this,SLOT( renderSelectedNode() ) );
 
+    _imp->actionProfileRenders = new ActionWithShortcut(kShortcutGroupGlobal,kShortcutIDActionProfileRenders,kShortcutDescActionProfileRenders,this);
+    _imp->actionProfileRenders->setCheckable(true);
+    _imp->actionProfileRenders->setChecked( Natron::RenderProfiler::isEnabled() );
+    QObject::connect( _imp->actionProfileRenders,SIGNAL( toggled(bool) ),this,SLOT( setRenderProfilingEnabled(bool) ) );
+
+    _imp->actionExportRenderProfile = new ActionWithShortcut(kShortcutGroupGlobal,kShortcutIDActionExportRenderProfile,kShortcutDescActionExportRenderProfile,this);
+    QObject::connect( _imp->actionExportRenderProfile,SIGNAL( triggered() ),this,SLOT( exportRenderProfile() ) );
+
 
     for (int c = 0; c < NATRON_MAX_RECENT_FILES; ++c) {
         _imp->actionsOpenRecentFile[c] = new QAction(this);
@@ -961,6 +974,9 @@ Gui::createMenuActions()
 
     _imp->menuRender->addAction(_imp->renderAllWriters);
     _imp->menuRender->addAction(_imp->renderSelectedNode);
+    _imp->menuRender->addSeparator();
+    _imp->menuRender->addAction(_imp->actionProfileRenders);
+    _imp->menuRender->addAction(_imp->actionExportRenderProfile);
 
     _imp->cacheMenu->addAction(_imp->actionClearDiskCache);
     _imp->cacheMenu->addAction(_imp->actionClearPlayBackCache);
@@ -3994,6 +4010,38 @@ Gui::renderSelectedNode()
     }
 }
 
+void
+Gui::setRenderProfilingEnabled(bool enabled)
+{
+    if (enabled) {
+        ///Start a new profile each time profiling is turned on
+        Natron::RenderProfiler::clear();
+    }
+    Natron::RenderProfiler::setEnabled(enabled);
+}
+
+void
+Gui::exportRenderProfile()
+{
+    std::vector<std::string> filters;
+
+    filters.push_back("json");
+    SequenceFileDialog dialog( this,filters,false,SequenceFileDialog::eFileDialogModeSave,_imp->_lastSaveProjectOpenedDir.toStdString(),this,false );
+    if ( dialog.exec() ) {
+        std::string filename = dialog.filesToSave();
+        QString filenameCpy( filename.c_str() );
+        QString ext = Natron::removeFileExtension(filenameCpy);
+        if (ext != "json") {
+            filename.append(".json");
+        }
+
+        std::string error;
+        if ( !Natron::RenderProfiler::writeReport(filename, &error) ) {
+            Natron::errorDialog( tr("Error").toStdString(), error, false );
+        }
+    }
+}
+
 void
 Gui::setUndoRedoStackLimit(int limit)
 {
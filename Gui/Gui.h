@@ -540,6 +540,10 @@ public slots:
 
     void renderSelectedNode();
 
+    void setRenderProfilingEnabled(bool enabled);
+
+    void exportRenderProfile();
+
     void onRotoSelectedToolChanged(int tool);
 
     void onMaxVisibleDockablePanelChanged(int maxPanels);
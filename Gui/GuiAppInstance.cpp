@@ -27,6 +27,7 @@
 #include "Engine/EffectInstance.h"
 #include "Engine/Node.h"
 #include "Engine/Plugin.h"
+#include "Engine/PreviewScheduler.h"
 #include "Engine/ProcessHandler.h"
 #include "Engine/Settings.h"
 #include "Engine/DiskCacheNode.h"
@@ -121,6 +122,8 @@ GuiAppInstance::deletePreviewProvider()
 void
 GuiAppInstance::aboutToQuit()
 {
+    ///Stop rendering node previews before the GUI of the nodes goes away
+    getPreviewScheduler()->quitThread();
     
     deletePreviewProvider();
     _imp->_isClosing = true;
@@ -1562,6 +1562,8 @@ GuiApplicationManager::populateShortcuts()
     registerKeybind(kShortcutGroupGlobal, kShortcutIDActionRenderSelected, kShortcutDescActionRenderSelected, Qt::NoModifier, Qt::Key_F7);
 
     registerKeybind(kShortcutGroupGlobal, kShortcutIDActionRenderAll, kShortcutDescActionRenderAll, Qt::NoModifier, Qt::Key_F5);
+    registerKeybind(kShortcutGroupGlobal, kShortcutIDActionProfileRenders, kShortcutDescActionProfileRenders, Qt::NoModifier,(Qt::Key)0);
+    registerKeybind(kShortcutGroupGlobal, kShortcutIDActionExportRenderProfile, kShortcutDescActionExportRenderProfile, Qt::NoModifier,(Qt::Key)0);
 
 
     registerKeybind(kShortcutGroupGlobal, kShortcutIDActionConnectViewerToInput1, kShortcutDescActionConnectViewerToInput1, Qt::NoModifier, Qt::Key_1);
@@ -22,6 +22,8 @@
 #include "Engine/ViewerInstance.h"
 #include "Engine/Lut.h"
 #include "Engine/Image.h"
+#include "Engine/OutputSchedulerThread.h"
+#include "Engine/Timer.h"
 #include "Gui/ViewerGL.h"
 
 using std::cout; using std::endl;
@@ -157,11 +159,54 @@ InfoViewerWidget::setFps(double actualFps,
     .arg(font.pixelSize());
 
     _fpsLabel->setText(str);
+    _fpsLabel->setToolTip( getPlaybackStatsToolTip() );
     if ( !_fpsLabel->isVisible() ) {
         _fpsLabel->show();
     }
 }
 
+QString
+InfoViewerWidget::getPlaybackStatsToolTip() const
+{
+    ViewerInstance* internalNode = viewer->getInternalNode();
+    RenderEngine* engine = internalNode ? internalNode->getRenderEngine() : 0;
+    PlaybackStats stats;
+
+    if ( !engine || !engine->getPlaybackStats(&stats) || (stats.frames == 0) ) {
+        return QString();
+    }
+
+    QString ret = tr("Frames: %1 (%2 dropped)").arg(stats.frames).arg(stats.droppedFrames);
+    ret.append("<br/>");
+    ret.append( tr("Effective: %1 fps").arg(stats.effectiveFps, 0, 'f', 2) );
+    ret.append("<br/>");
+    ret.append( tr("Frame interval jitter: %1 ms").arg(stats.intervalJitter * 1000., 0, 'f', 2) );
+    ret.append("<br/>");
+    ret.append( tr("Mean offset: %1 ms, latest %2 ms, earliest %3 ms")
+                .arg(stats.meanOffset * 1000., 0, 'f', 2)
+                .arg(stats.maxLateness * 1000., 0, 'f', 2)
+                .arg(stats.maxEarliness * 1000., 0, 'f', 2) );
+    ret.append("<br/>");
+    ret.append( tr("Offset from the due time:") );
+    for (int i = 0; i < NATRON_PLAYBACK_OFFSET_BINS; ++i) {
+        if (stats.offsetHistogram[i] == 0) {
+            continue;
+        }
+        QString range;
+        if (i == 0) {
+            range = QString("&lt; %1 ms").arg(PlaybackStats::getOffsetBinUpperBound(i) * 1000.);
+        } else if (i == NATRON_PLAYBACK_OFFSET_BINS - 1) {
+            range = QString("&gt; %1 ms").arg(PlaybackStats::getOffsetBinUpperBound(i - 1) * 1000.);
+        } else {
+            range = QString("%1 .. %2 ms").arg(PlaybackStats::getOffsetBinUpperBound(i - 1) * 1000.)
+                    .arg(PlaybackStats::getOffsetBinUpperBound(i) * 1000.);
+        }
+        ret.append( QString("<br/>&nbsp;&nbsp;%1: %2").arg(range).arg(stats.offsetHistogram[i]) );
+    }
+
+    return ret;
+}
+
 void
 InfoViewerWidget::hideFps()
 {
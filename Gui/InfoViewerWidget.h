@@ -61,6 +61,9 @@ public slots:
 
 private:
     
+    ///The statistics of the playback of the viewer, as rich text
+    QString getPlaybackStatsToolTip() const;
+
     virtual QSize sizeHint() const OVERRIDE FINAL;
     virtual QSize minimumSizeHint() const OVERRIDE FINAL;
     virtual void paintEvent(QPaintEvent* e) OVERRIDE FINAL;
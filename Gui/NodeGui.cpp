@@ -17,7 +17,6 @@ CLANG_DIAG_OFF(deprecated)
 CLANG_DIAG_OFF(uninitialized)
 #include <QLayout>
 #include <QAction>
-#include <QtConcurrentRun>
 #include <QFontMetrics>
 #include <QMenu>
 #include <QTextDocument> // for Qt::convertFromPlainText
@@ -45,6 +44,7 @@ CLANG_DIAG_ON(uninitialized)
 #include "Engine/OfxEffectInstance.h"
 #include "Engine/ViewerInstance.h"
 #include "Engine/OfxImageEffectInstance.h"
+#include "Engine/PreviewScheduler.h"
 #include "Engine/Project.h"
 #include "Engine/Node.h"
 #include "Engine/NodeSerialization.h"
@@ -152,6 +152,7 @@ NodeGui::initialize(NodeGraph* dag,
     QObject::connect( _internalNode.get(), SIGNAL( inputsInitialized() ),this,SLOT( initializeInputs() ) );
     QObject::connect( _internalNode.get(), SIGNAL( previewImageChanged(int) ), this, SLOT( updatePreviewImage(int) ) );
     QObject::connect( _internalNode.get(), SIGNAL( previewRefreshRequested(int) ), this, SLOT( forceComputePreview(int) ) );
+    QObject::connect( _internalNode.get(), SIGNAL( previewRendered(int) ), this, SLOT( onPreviewRendered(int) ) );
     QObject::connect( _internalNode.get(), SIGNAL( deactivated(bool) ),this,SLOT( deactivate(bool) ) );
     QObject::connect( _internalNode.get(), SIGNAL( activated(bool) ), this, SLOT( activate(bool) ) );
     QObject::connect( _internalNode.get(), SIGNAL( inputChanged(int) ), this, SLOT( connectEdge(int) ) );
@@ -737,7 +738,7 @@ NodeGui::updatePreviewImage(int time)
         
         ensurePreviewCreated();
 
-        QtConcurrent::run(this,&NodeGui::computePreviewImage,time);
+        _internalNode->getApp()->getPreviewScheduler()->requestPreview(_internalNode, time);
     }
 }
 
@@ -754,43 +755,25 @@ NodeGui::forceComputePreview(int time)
         
         ensurePreviewCreated();
 
-        QtConcurrent::run(this,&NodeGui::computePreviewImage,time);
+        _internalNode->getApp()->getPreviewScheduler()->requestPreview(_internalNode, time);
     }
 }
 
 void
-NodeGui::computePreviewImage(int time)
+NodeGui::onPreviewRendered(int /*time*/)
 {
-    if ( _internalNode->isRenderingPreview() ) {
+    int w,h;
+    std::vector<unsigned int> buf;
+    if ( !_internalNode->getPreviewImage(&w, &h, &buf) ) {
         return;
     }
-    
-
-    int w = NATRON_PREVIEW_WIDTH;
-    int h = NATRON_PREVIEW_HEIGHT;
-    size_t dataSize = 4 * w * h;
-    {
-#ifndef __NATRON_WIN32__
-        unsigned int* buf = (unsigned int*)calloc(dataSize,1);
-#else
-        unsigned int* buf = (unsigned int*)malloc(dataSize);
-        for (int i = 0; i < w * h; ++i) {
-            buf[i] = qRgba(0,0,0,255);
-        }
-#endif
-        bool success = _internalNode->makePreviewImage(time, &w, &h, buf);
-        
-        if (success) {
-            QImage img(reinterpret_cast<const uchar*>(buf), w, h, QImage::Format_ARGB32_Premultiplied);
-            QPixmap prev_pixmap = QPixmap::fromImage(img);
-            _previewPixmap->setPixmap(prev_pixmap);
-            QPointF topLeft = mapFromParent( pos() );
-            QRectF bbox = boundingRect();
-            _previewPixmap->setPos(topLeft.x() + bbox.width() / 2 - w / 2,
-                                   topLeft.y() + bbox.height() / 2 - h / 2 + 10);
-        }
-        free(buf);
-    }
+    QImage img(reinterpret_cast<const uchar*>(&buf.front()), w, h, QImage::Format_ARGB32_Premultiplied);
+    QPixmap prev_pixmap = QPixmap::fromImage(img);
+    _previewPixmap->setPixmap(prev_pixmap);
+    QPointF topLeft = mapFromParent( pos() );
+    QRectF bbox = boundingRect();
+    _previewPixmap->setPos(topLeft.x() + bbox.width() / 2 - w / 2,
+                           topLeft.y() + bbox.height() / 2 - h / 2 + 10);
 }
 
 void
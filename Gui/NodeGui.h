@@ -338,6 +338,9 @@ public slots:
     /*Updates the preview image no matter what*/
     void forceComputePreview(int time);
 
+    /*Displays the preview rendered by the PreviewScheduler*/
+    void onPreviewRendered(int time);
+
     void setName(const QString & _nameItem);
 
     void onInternalNameChanged(const QString &);
@@ -435,8 +438,6 @@ private:
     
     void setAboveItem(QGraphicsItem* item);
 
-    void computePreviewImage(int time);
-
     void populateMenu();
 
     void refreshCurrentBrush();
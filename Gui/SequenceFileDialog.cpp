@@ -249,6 +249,7 @@ SequenceFileDialog::SequenceFileDialog( QWidget* parent, // necessary to transmi
     _view->setModel( _model.get() );
     _view->setItemDelegate( _itemDelegate.get() );
 
+    QObject::connect( _model.get(),SIGNAL( directoryPartiallyLoaded(QString) ),this,SLOT( updateView(QString) ) );
     QObject::connect( _model.get(),SIGNAL( directoryLoaded(QString) ),this,SLOT( updateView(QString) ) );
     QObject::connect( _view, SIGNAL( doubleClicked(QModelIndex) ), this, SLOT( doubleClickOpen(QModelIndex) ) );
 
@@ -948,8 +949,8 @@ SequenceFileDialog::proxyAndSetLineEditText(const QString& text)
     _selectionLineEdit->setText(stdText.c_str());
 }
 
-/*This function is called when a directory has successfully been loaded (i.e
-   when the filesystem finished to load thoroughly the directory requested)*/
+/*This function is called when the first entries of a directory have been loaded
+   and when the filesystem finished to load thoroughly the directory requested*/
 void
 SequenceFileDialog::updateView(const QString &directory)
 {
@@ -960,6 +961,11 @@ SequenceFileDialog::updateView(const QString &directory)
     
     QModelIndex index = _model->index(directoryItem.get());
     
+    /*the directory is already shown while the rest of it is loaded: keep the selection the user made meanwhile*/
+    if (_view->rootIndex() == index) {
+        return;
+    }
+    
     /*update the view to show the newly loaded directory*/
     setRootIndex(index);
     
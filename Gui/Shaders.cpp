@@ -15,6 +15,7 @@ const char* fragRGB =
     "uniform float gain;\n"
     "uniform float offset;\n"
     "uniform int lut;\n"
+    "uniform int channels;\n"
     "\n"
     "float linear_to_srgb(float c) {\n"
     "    return (c<=0.0031308) ? (12.92*c) : (((1.0+0.055)*pow(c,1.0/2.4))-0.055);\n"
@@ -24,6 +25,21 @@ const char* fragRGB =
     "}\n"
     "void main(){\n"
     "    vec4 color_tmp = texture2D(Tex,gl_TexCoord[0].st);\n"
+    "    if(channels == 1){ // R\n"
+    "       color_tmp.rgb = vec3(color_tmp.r);\n"
+    "    }\n"
+    "    else if(channels == 2){ // G\n"
+    "       color_tmp.rgb = vec3(color_tmp.g);\n"
+    "    }\n"
+    "    else if(channels == 3){ // B\n"
+    "       color_tmp.rgb = vec3(color_tmp.b);\n"
+    "    }\n"
+    "    else if(channels == 4){ // A\n"
+    "       color_tmp.rgb = vec3(color_tmp.a);\n"
+    "    }\n"
+    "    else if(channels == 5){ // Luminance\n"
+    "       color_tmp.rgb = vec3(dot(color_tmp.rgb, vec3(0.299,0.587,0.114)));\n"
+    "    }\n"
     "    color_tmp.rgb = (color_tmp.rgb * gain) + offset;\n"
     "    if(lut == 0){ // srgb\n"
 // << TO SRGB
@@ -59,6 +59,14 @@ Texture::fillOrAllocateTexture(const TextureRect & texRect,
                                 GL_RGBA,            // format
                                 GL_FLOAT,       // type
                                 0);
+            } else if (_type == Texture::eDataTypeHalf) {
+                glTexSubImage2D(_target,
+                                0,              // level
+                                0, 0,               // xoffset, yoffset
+                                w(), h(),
+                                GL_RGBA,            // format
+                                GL_HALF_FLOAT_ARB,       // type
+                                0);
             }
             glCheckError();
         } else {
@@ -89,6 +97,15 @@ Texture::fillOrAllocateTexture(const TextureRect & texRect,
                               GL_RGBA,      // format
                               GL_FLOAT, // type
                               0);           // pixels
+            } else if (type == eDataTypeHalf) {
+                glTexImage2D (_target,
+                              0,            // level
+                              GL_RGBA16F_ARB, //internalFormat
+                              w(), h(),
+                              0,            // border
+                              GL_RGBA,      // format
+                              GL_HALF_FLOAT_ARB, // type
+                              0);           // pixels
             }
             
             glCheckError();
@@ -22,6 +22,7 @@ CLANG_DIAG_ON(unused-private-field)
 #include "Global/GlobalDefines.h"
 
 #include "Engine/Cache.h"
+#include "Engine/CacheSignalEmitter.h"
 #include "Engine/Node.h"
 #include "Engine/Project.h"
 #include "Engine/ViewerInstance.h"
@@ -849,12 +850,8 @@ TimeLineGui::connectSlotsToViewerCache()
     assert( qApp && qApp->thread() == QThread::currentThread() );
 
     Natron::CacheSignalEmitter* emitter = appPTR->getOrActivateViewerCacheSignalEmitter();
-    QObject::connect( emitter, SIGNAL( addedEntry(SequenceTime) ), this, SLOT( onCachedFrameAdded(SequenceTime) ) );
-    QObject::connect( emitter, SIGNAL( removedEntry(SequenceTime,int) ), this, SLOT( onCachedFrameRemoved(SequenceTime,int) ) );
-    QObject::connect( emitter, SIGNAL( entryStorageChanged(SequenceTime,int,int) ), this,
-                      SLOT( onCachedFrameStorageChanged(SequenceTime,int,int) ) );
-    QObject::connect( emitter, SIGNAL( clearedDiskPortion() ), this, SLOT( onDiskCacheCleared() ) );
-    QObject::connect( emitter, SIGNAL( clearedInMemoryPortion() ), this, SLOT( onMemoryCacheCleared() ) );
+    QObject::connect( emitter, SIGNAL( entriesChanged(Natron::CacheEventsBatch) ), this,
+                      SLOT( onCachedFramesChanged(Natron::CacheEventsBatch) ) );
 }
 
 void
@@ -864,12 +861,8 @@ TimeLineGui::disconnectSlotsFromViewerCache()
     assert( qApp && qApp->thread() == QThread::currentThread() );
 
     Natron::CacheSignalEmitter* emitter = appPTR->getOrActivateViewerCacheSignalEmitter();
-    QObject::disconnect( emitter, SIGNAL( addedEntry(SequenceTime) ), this, SLOT( onCachedFrameAdded(SequenceTime) ) );
-    QObject::disconnect( emitter, SIGNAL( removedEntry(SequenceTime,int) ), this, SLOT( onCachedFrameRemoved(SequenceTime,int) ) );
-    QObject::disconnect( emitter, SIGNAL( entryStorageChanged(SequenceTime,int,int) ), this,
-                         SLOT( onCachedFrameStorageChanged(SequenceTime,int,int) ) );
-    QObject::disconnect( emitter, SIGNAL( clearedDiskPortion() ), this, SLOT( onDiskCacheCleared() ) );
-    QObject::disconnect( emitter, SIGNAL( clearedInMemoryPortion() ), this, SLOT( onMemoryCacheCleared() ) );
+    QObject::disconnect( emitter, SIGNAL( entriesChanged(Natron::CacheEventsBatch) ), this,
+                         SLOT( onCachedFramesChanged(Natron::CacheEventsBatch) ) );
 }
 
 bool
@@ -887,63 +880,46 @@ TimeLineGui::setFrameRangeEdited(bool edited)
 }
 
 void
-TimeLineGui::onCachedFrameAdded(SequenceTime time)
+TimeLineGui::onCachedFramesChanged(const Natron::CacheEventsBatch & batch)
 {
-    _imp->cachedFrames.insert( CachedFrame(time, eStorageModeRAM) );
-}
-
-void
-TimeLineGui::onCachedFrameRemoved(SequenceTime time,
-                                  int /*storage*/)
-{
-    for (CachedFrames::iterator it = _imp->cachedFrames.begin(); it != _imp->cachedFrames.end(); ++it) {
-        if (it->time == time) {
-            _imp->cachedFrames.erase(it);
-            break;
-        }
-    }
-    update();
-}
-
-void
-TimeLineGui::onCachedFrameStorageChanged(SequenceTime time,
-                                         int /*oldStorage*/,
-                                         int newStorage)
-{
-    for (CachedFrames::iterator it = _imp->cachedFrames.begin(); it != _imp->cachedFrames.end(); ++it) {
-        if (it->time == time) {
-            _imp->cachedFrames.erase(it);
-            _imp->cachedFrames.insert( CachedFrame(time,(StorageModeEnum)newStorage) );
-            break;
+    if ( batch.isMemoryCleared() || batch.isDiskCleared() ) {
+        CachedFrames copy;
+        for (CachedFrames::iterator it = _imp->cachedFrames.begin(); it != _imp->cachedFrames.end(); ++it) {
+            if ( !( (it->mode == eStorageModeRAM) && batch.isMemoryCleared() ) && !( (it->mode == eStorageModeDisk) && batch.isDiskCleared() ) ) {
+                copy.insert(copy.end(), *it);
+            }
         }
+        _imp->cachedFrames = copy;
     }
-}
-
-void
-TimeLineGui::onMemoryCacheCleared()
-{
-    CachedFrames copy;
 
-    for (CachedFrames::iterator it = _imp->cachedFrames.begin(); it != _imp->cachedFrames.end(); ++it) {
-        if (it->mode == eStorageModeDisk) {
-            copy.insert(*it);
+    ///Both are sorted by time: walk them together so that a range of frames costs a single pass
+    const Natron::CacheEventsBatch::EntriesEvents & events = batch.getEntriesEvents();
+    CachedFrames::iterator hint = _imp->cachedFrames.begin();
+    for (Natron::CacheEventsBatch::EntriesEvents::const_iterator it = events.begin(); it != events.end(); ++it) {
+        while ( hint != _imp->cachedFrames.end() && (hint->time < it->first) ) {
+            ++hint;
         }
-    }
-    _imp->cachedFrames = copy;
-    update();
-}
-
-void
-TimeLineGui::onDiskCacheCleared()
-{
-    CachedFrames copy;
-
-    for (CachedFrames::iterator it = _imp->cachedFrames.begin(); it != _imp->cachedFrames.end(); ++it) {
-        if (it->mode == eStorageModeRAM) {
-            copy.insert(*it);
+        bool exists = hint != _imp->cachedFrames.end() && hint->time == it->first;
+        switch (it->second.type) {
+        case Natron::CacheEntryEvent::eTypeAdded:
+            if (exists) {
+                _imp->cachedFrames.erase(hint++);
+            }
+            hint = _imp->cachedFrames.insert( hint, CachedFrame(it->first, (StorageModeEnum)it->second.storage) );
+            break;
+        case Natron::CacheEntryEvent::eTypeRemoved:
+            if (exists) {
+                _imp->cachedFrames.erase(hint++);
+            }
+            break;
+        case Natron::CacheEntryEvent::eTypeStorageChanged:
+            if (exists) {
+                _imp->cachedFrames.erase(hint++);
+                hint = _imp->cachedFrames.insert( hint, CachedFrame(it->first, (StorageModeEnum)it->second.storage) );
+            }
+            break;
         }
     }
-    _imp->cachedFrames = copy;
     update();
 }
 
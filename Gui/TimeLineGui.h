@@ -30,6 +30,9 @@ CLANG_DIAG_ON(uninitialized)
 #include "Global/GlobalDefines.h"
 
 class Gui;
+namespace Natron {
+class CacheEventsBatch;
+}
 class ViewerTab;
 class QMouseEvent;
 class TimeLine;
@@ -110,11 +113,8 @@ public slots:
 
     void onFrameChanged(SequenceTime,int);
 
-    void onCachedFrameAdded(SequenceTime time);
-    void onCachedFrameRemoved(SequenceTime time,int storage);
-    void onCachedFrameStorageChanged(SequenceTime time,int oldStorage,int newStorage);
-    void onMemoryCacheCleared();
-    void onDiskCacheCleared();
+    ///Applies the changes of the viewer cache since the last batch, @see Natron::CacheSignalEmitter
+    void onCachedFramesChanged(const Natron::CacheEventsBatch & batch);
 
     void clearCachedFrames();
 
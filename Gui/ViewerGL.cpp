@@ -165,6 +165,7 @@ struct ViewerGL::Implementation
           , displayingImageMipMapLevel(0)
           , displayingImagePremult()
           , displayingImageLut(Natron::eViewerColorSpaceSRGB)
+          , displayingImageChannels(0)
           , ms(eMouseStateUndefined)
           , hs(eHoverStateNothing)
           , textRenderingColor(200,200,200,255)
@@ -257,6 +258,7 @@ struct ViewerGL::Implementation
     Natron::ImagePremultiplicationEnum displayingImagePremult[2];
     int displayingImageTime[2];
     Natron::ViewerColorSpaceEnum displayingImageLut;
+    int displayingImageChannels; //< ViewerInstance::DisplayChannelsEnum, applied by the shader
     MouseStateEnum ms; /*!< Holds the mouse state*/
     HoverStateEnum hs;
     const QColor textRenderingColor;
@@ -2305,6 +2307,7 @@ ViewerGL::Implementation::activateShaderRGB(int texIndex)
     shaderRGB->setUniformValue("gain", (float)displayingImageGain[texIndex]);
     shaderRGB->setUniformValue("offset", (float)displayingImageOffset[texIndex]);
     shaderRGB->setUniformValue("lut", (GLint)displayingImageLut);
+    shaderRGB->setUniformValue("channels", (GLint)displayingImageChannels);
 }
 
 void
@@ -2380,13 +2383,17 @@ ViewerGL::transferBufferFromRAMtoGPU(const unsigned char* ramBuffer,
     glUnmapBufferARB(GL_PIXEL_UNPACK_BUFFER_ARB);
     glCheckError();
 
-    OpenGLViewerI::BitDepthEnum bd = getBitDepth();
+    ///Deduce the depth of the buffer from its size rather than from the current setting:
+    ///the setting may have changed since the buffer was rendered.
     assert(textureIndex == 0 || textureIndex == 1);
-    if (bd == OpenGLViewerI::eBitDepthByte) {
-        _imp->displayTextures[textureIndex]->fillOrAllocateTexture(region, Texture::eDataTypeByte);
-    } else if ( (bd == OpenGLViewerI::eBitDepthFloat) || (bd == OpenGLViewerI::eBitDepthHalf) ) {
-        //do 32bit fp textures either way, don't bother with half float. We might support it further on.
+    std::size_t bytesPerPixel = bytesCount / ( (std::size_t)region.w * region.h );
+    if ( bytesPerPixel == 4 * sizeof(float) ) {
         _imp->displayTextures[textureIndex]->fillOrAllocateTexture(region, Texture::eDataTypeFloat);
+    } else if ( bytesPerPixel == 4 * sizeof(unsigned short) ) {
+        _imp->displayTextures[textureIndex]->fillOrAllocateTexture(region, Texture::eDataTypeHalf);
+    } else {
+        assert(bytesPerPixel == 4);
+        _imp->displayTextures[textureIndex]->fillOrAllocateTexture(region, Texture::eDataTypeByte);
     }
     glBindBufferARB(GL_PIXEL_UNPACK_BUFFER_ARB, currentBoundPBO);
     //glBindTexture(GL_TEXTURE_2D, 0); // why should we bind texture 0?
@@ -2473,6 +2480,14 @@ ViewerGL::setLut(int lut)
     _imp->displayingImageLut = (Natron::ViewerColorSpaceEnum)lut;
 }
 
+void
+ViewerGL::setDisplayChannels(int channels)
+{
+    // always running in the main thread
+    assert( qApp && qApp->thread() == QThread::currentThread() );
+    _imp->displayingImageChannels = channels;
+}
+
 /**
  *@returns Returns true if the graphic card supports GLSL.
  **/
@@ -302,6 +302,12 @@ public:
 
     void setLut(int lut);
 
+    /**
+     * @brief Channels selected by the shader when displaying floating point textures.
+     * can only be called on the main-thread
+     **/
+    void setDisplayChannels(int channels);
+
     bool isWipeHandleVisible() const;
 
     void setZoomOrPannedSinceLastFit(bool enabled);
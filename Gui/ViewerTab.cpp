@@ -1468,6 +1468,7 @@ ViewerTab::onViewerChannelsChanged(int i)
         channels = ViewerInstance::eDisplayChannelsRGB;
         break;
     }
+    _imp->viewer->setDisplayChannels( (int)channels );
     _imp->viewerNode->setDisplayChannels(channels);
 }
 
@@ -19,6 +19,7 @@
 #include <QCoreApplication>
 
 #include "Engine/AppManager.h"
+#include "Engine/RenderProfiler.h"
 
 static void setShutDownSignal(int signalId);
 static void handleShutDownSignal(int signalId);
@@ -28,10 +29,10 @@ main(int argc,
      char *argv[])
 {
     bool isBackground;
-    QString projectName,mainProcessServerName;
+    QString projectName,mainProcessServerName,profileFilename;
     QStringList writers;
     std::list<std::pair<int,int> > frameRanges;
-    AppManager::parseCmdLineArgs(argc,argv,&isBackground,projectName,writers,frameRanges,mainProcessServerName);
+    AppManager::parseCmdLineArgs(argc,argv,&isBackground,projectName,writers,frameRanges,mainProcessServerName,profileFilename);
 
     setShutDownSignal(SIGINT);   // shut down on ctrl-c
     setShutDownSignal(SIGTERM);   // shut down on killall
@@ -45,6 +46,9 @@ main(int argc,
 
         return 1;
     }
+    if ( !profileFilename.isEmpty() ) {
+        Natron::RenderProfiler::setEnabled(true);
+    }
     AppManager manager;
 
     if ( !manager.load(argc,argv,projectName,writers,frameRanges,mainProcessServerName) ) {
@@ -52,6 +56,10 @@ main(int argc,
 
         return 1;
     } else {
+        if ( !profileFilename.isEmpty() && !AppManager::writeRenderProfile(profileFilename) ) {
+            return 1;
+        }
+
         return 0;
     }
 
@@ -0,0 +1,87 @@
+//  Natron
+//
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include <gtest/gtest.h>
+#include "Engine/ActionsCacheVersions.h"
+
+using namespace Natron;
+
+namespace {
+int gEffectsDestroyed = 0;
+
+///Stands for the results of an effect: rod does not reference other effects, roi does
+struct TestVersion
+{
+    U64 hash;
+    int effectsDestroyedCount;
+    int rod;
+    int roi;
+
+    TestVersion(U64 hash)
+        : hash(hash)
+          , effectsDestroyedCount(gEffectsDestroyed)
+          , rod(0)
+          , roi(0)
+    {
+    }
+
+    void dropResultsReferencingEffects()
+    {
+        roi = 0;
+    }
+};
+
+typedef ActionsCacheVersions<TestVersion> TestVersions;
+}
+
+TEST(ActionsCacheVersions,LeastRecentlyUsedVersionIsEvicted) {
+    TestVersions versions(8);
+
+    for (U64 hash = 1; hash <= 8; ++hash) {
+        versions.getOrCreate(hash)->rod = (int)hash;
+    }
+    EXPECT_EQ( (std::size_t)8, versions.size() );
+
+    ///Using the 1st version makes the 2nd one the least recently used
+    ASSERT_TRUE( versions.find(1) != NULL );
+    EXPECT_EQ( 1, versions.find(1)->rod );
+
+    ///The 9th version evicts the 2nd one
+    versions.getOrCreate(9)->rod = 9;
+    EXPECT_EQ( (std::size_t)8, versions.size() );
+    EXPECT_TRUE( versions.find(2) == NULL );
+    for (U64 hash = 3; hash <= 9; ++hash) {
+        ASSERT_TRUE( versions.find(hash) != NULL );
+        EXPECT_EQ( (int)hash, versions.find(hash)->rod );
+    }
+    EXPECT_EQ( 1, versions.find(1)->rod );
+
+    ///Getting an existing version keeps its results
+    EXPECT_EQ( 9, versions.getOrCreate(9)->rod );
+    EXPECT_EQ( (std::size_t)8, versions.size() );
+}
+
+TEST(ActionsCacheVersions,ResultsReferencingDestroyedEffectsAreDropped) {
+    TestVersions versions(8);
+    TestVersion* version = versions.getOrCreate(1);
+
+    version->rod = 1;
+    version->roi = 2;
+
+    ///No effect was destroyed since the results were computed
+    TestVersions::dropDanglingResults(version, gEffectsDestroyed);
+    EXPECT_EQ(2, version->roi);
+
+    ++gEffectsDestroyed;
+    TestVersions::dropDanglingResults(version, gEffectsDestroyed);
+    EXPECT_EQ(0, version->roi);
+    EXPECT_EQ(1, version->rod) << "Results that do not reference other effects are kept";
+
+    ///Results computed after the destruction are kept
+    version->roi = 3;
+    TestVersions::dropDanglingResults(version, gEffectsDestroyed);
+    EXPECT_EQ(3, version->roi);
+}
@@ -0,0 +1,98 @@
+//  Natron
+//
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+#include <gtest/gtest.h>
+#include "Engine/CacheCodec.h"
+
+using namespace Natron;
+
+namespace {
+///A smooth RGBA float image with a flat alpha, as rendered by most nodes
+std::vector<float>
+makeFloatImage(int width,
+               int height)
+{
+    std::vector<float> pixels(width * height * 4);
+
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            float* p = &pixels[(y * width + x) * 4];
+            p[0] = (float)x / width;
+            p[1] = (float)y / height;
+            p[2] = 0.5f + 0.25f * std::sin(x * 0.01f);
+            p[3] = 1.f;
+        }
+    }
+
+    return pixels;
+}
+}
+
+TEST(CacheCodec,RoundTrip) {
+    ///Sizes around the block size, including a size that does not make whole elements
+    const std::size_t sizes[] = { 0, 1, 13, 4096, NATRON_CACHE_CODEC_BLOCK_SIZE, 3 * NATRON_CACHE_CODEC_BLOCK_SIZE + 7 };
+
+    std::srand(1);
+    for (int s = 0; s < 6; ++s) {
+        const std::size_t size = sizes[s];
+        std::vector<unsigned char> smooth(size + 1), noise(size + 1);
+        for (std::size_t i = 0; i < size; ++i) {
+            smooth[i] = (unsigned char)( (i / 64) & 0xff );
+            noise[i] = (unsigned char)( std::rand() & 0xff );
+        }
+        for (int elementSize = 1; elementSize <= 4; elementSize *= 2) {
+            const std::vector<unsigned char>* inputs[2] = { &smooth, &noise };
+            for (int i = 0; i < 2; ++i) {
+                std::vector<char> compressed;
+                CacheCodec::compress(&inputs[i]->front(), size, elementSize, false, &compressed);
+                ASSERT_EQ( size, CacheCodec::getUncompressedSize( &compressed.front(), compressed.size() ) );
+
+                std::vector<unsigned char> decompressed(size + 1);
+                ASSERT_TRUE( CacheCodec::decompress(&compressed.front(), compressed.size(), &decompressed.front(), size) );
+                EXPECT_TRUE( std::memcmp(&decompressed.front(), &inputs[i]->front(), size) == 0 ) << "size " << size;
+            }
+        }
+    }
+}
+
+TEST(CacheCodec,Ratio) {
+    std::vector<float> image = makeFloatImage(512, 512);
+    const std::size_t size = image.size() * sizeof(float);
+
+    std::vector<char> compressed;
+    CacheCodec::compress(&image.front(), size, 4 * sizeof(float), false, &compressed);
+    EXPECT_TRUE( compressed.size() < size / 2 ) << "a smooth image compresses at least 2:1";
+
+    std::vector<char> packed;
+    CacheCodec::compress(&image.front(), size, 4 * sizeof(float), true, &packed);
+    EXPECT_TRUE( packed.size() < compressed.size() );
+
+    std::vector<float> decompressed( image.size() );
+    ASSERT_TRUE( CacheCodec::decompress(&packed.front(), packed.size(), &decompressed.front(), size) );
+    for (std::size_t i = 0; i < image.size(); ++i) {
+        ///Half floats have 11 significant bits
+        EXPECT_NEAR( image[i], decompressed[i], std::fabs(image[i]) / 1024. );
+    }
+}
+
+TEST(CacheCodec,Corruption) {
+    std::vector<float> image = makeFloatImage(256, 256);
+    const std::size_t size = image.size() * sizeof(float);
+    std::vector<char> compressed;
+
+    CacheCodec::compress(&image.front(), size, 4 * sizeof(float), false, &compressed);
+
+    std::vector<float> decompressed( image.size() );
+    EXPECT_FALSE( CacheCodec::decompress(&compressed.front(), compressed.size() / 2, &decompressed.front(), size) );
+    EXPECT_FALSE( CacheCodec::decompress(&compressed.front(), compressed.size(), &decompressed.front(), size - 4) );
+
+    std::vector<char> notCompressed( compressed.size() );
+    EXPECT_EQ( (std::size_t)0, CacheCodec::getUncompressedSize( &notCompressed.front(), notCompressed.size() ) );
+    EXPECT_FALSE( CacheCodec::decompress(&notCompressed.front(), notCompressed.size(), &decompressed.front(), size) );
+}
@@ -0,0 +1,68 @@
+//  Natron
+//
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include <gtest/gtest.h>
+#include "Engine/CacheSignalEmitter.h"
+
+using namespace Natron;
+
+TEST(CacheEventsBatch,KeepsOnlyTheLastEventOfAFrame)
+{
+    CacheEventsBatch batch;
+
+    EXPECT_TRUE( batch.isEmpty() );
+
+    batch.addEntry(1, eStorageModeRAM);
+    batch.changeEntryStorage(1, eStorageModeDisk);
+    batch.removeEntry(2);
+    batch.addEntry(2, eStorageModeRAM);
+    batch.addEntry(3, eStorageModeRAM);
+    batch.removeEntry(3);
+    ///A removed entry stays removed even if the cache reports it was moved
+    batch.changeEntryStorage(3, eStorageModeDisk);
+
+    EXPECT_FALSE( batch.isEmpty() );
+    const CacheEventsBatch::EntriesEvents & events = batch.getEntriesEvents();
+    ASSERT_EQ( (std::size_t)3, events.size() );
+
+    CacheEventsBatch::EntriesEvents::const_iterator it = events.begin();
+    EXPECT_EQ(1, it->first);
+    EXPECT_EQ(CacheEntryEvent::eTypeAdded, it->second.type);
+    EXPECT_EQ(eStorageModeDisk, it->second.storage);
+    ++it;
+    EXPECT_EQ(2, it->first);
+    EXPECT_EQ(CacheEntryEvent::eTypeAdded, it->second.type);
+    EXPECT_EQ(eStorageModeRAM, it->second.storage);
+    ++it;
+    EXPECT_EQ(3, it->first);
+    EXPECT_EQ(CacheEntryEvent::eTypeRemoved, it->second.type);
+}
+
+TEST(CacheEventsBatch,ClearFoldsPreviousEventsOfThatStorage)
+{
+    CacheEventsBatch batch;
+
+    batch.addEntry(10, eStorageModeRAM);
+    batch.changeEntryStorage(11, eStorageModeDisk);
+    batch.clearStorage(eStorageModeRAM);
+    ///Added after the clear: must survive it
+    batch.addEntry(12, eStorageModeRAM);
+
+    EXPECT_TRUE( batch.isMemoryCleared() );
+    EXPECT_FALSE( batch.isDiskCleared() );
+
+    const CacheEventsBatch::EntriesEvents & events = batch.getEntriesEvents();
+    ASSERT_EQ( (std::size_t)3, events.size() );
+    EXPECT_EQ(CacheEntryEvent::eTypeRemoved, events.find(10)->second.type);
+    EXPECT_EQ(CacheEntryEvent::eTypeStorageChanged, events.find(11)->second.type);
+    EXPECT_EQ(eStorageModeDisk, events.find(11)->second.storage);
+    EXPECT_EQ(CacheEntryEvent::eTypeAdded, events.find(12)->second.type);
+
+    batch.clearStorage(eStorageModeDisk);
+    EXPECT_TRUE( batch.isDiskCleared() );
+    EXPECT_EQ(CacheEntryEvent::eTypeRemoved, events.find(11)->second.type);
+    EXPECT_EQ(CacheEntryEvent::eTypeAdded, events.find(12)->second.type);
+}
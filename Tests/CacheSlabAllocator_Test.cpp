@@ -0,0 +1,142 @@
+//  Natron
+//
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include <cstdio>
+#include <cstring>
+#include <gtest/gtest.h>
+#include "Engine/CacheSlabAllocator.h"
+
+using namespace Natron;
+
+namespace {
+const U64 kSlabSize = 16 * NATRON_CACHE_SLAB_ALIGNMENT;
+
+void
+removeSlabFiles()
+{
+    for (int i = 0; i < 4; ++i) {
+        char name[64];
+        std::sprintf(name, "./slab%d." NATRON_CACHE_FILE_EXT, i);
+        std::remove(name);
+    }
+}
+
+bool
+fileExists(const char* name)
+{
+    std::FILE* f = std::fopen(name, "rb");
+    if (f) {
+        std::fclose(f);
+    }
+
+    return f != NULL;
+}
+}
+
+TEST(CacheSlabAllocator,AllocateAndFree) {
+    removeSlabFiles();
+    {
+        CacheSlabAllocator slabs(".", kSlabSize);
+
+        CacheSlabExtent a,b,c;
+        ASSERT_TRUE( slabs.allocate(100, &a) );
+        ASSERT_TRUE( slabs.allocate(3 * NATRON_CACHE_SLAB_ALIGNMENT, &b) );
+        ASSERT_TRUE( slabs.allocate(NATRON_CACHE_SLAB_ALIGNMENT + 1, &c) );
+        EXPECT_EQ(1, slabs.getSlabsCount()) << "Small extents are packed in the same slab";
+        EXPECT_EQ( (U64)NATRON_CACHE_SLAB_ALIGNMENT, a.size );
+        EXPECT_EQ( (U64)3 * NATRON_CACHE_SLAB_ALIGNMENT, b.size );
+        EXPECT_EQ( (U64)2 * NATRON_CACHE_SLAB_ALIGNMENT, c.size );
+        EXPECT_EQ(kSlabSize - 6 * NATRON_CACHE_SLAB_ALIGNMENT, slabs.getFreeSize() );
+
+        std::memset(slabs.data(a), 1, a.size);
+        std::memset(slabs.data(b), 2, b.size);
+        std::memset(slabs.data(c), 3, c.size);
+        EXPECT_EQ( 1, slabs.data(a)[a.size - 1] );
+        EXPECT_EQ( 3, slabs.data(c)[0] );
+
+        ///Freeing a and b leaves a hole of 4 units at the start of the slab which is reused
+        slabs.deallocate(a);
+        slabs.deallocate(b);
+        CacheSlabExtent d;
+        ASSERT_TRUE( slabs.allocate(4 * NATRON_CACHE_SLAB_ALIGNMENT, &d) );
+        EXPECT_EQ(a.slab, d.slab);
+        EXPECT_EQ(a.offset, d.offset);
+        EXPECT_EQ( 3, slabs.data(c)[0] ) << "Other extents are left untouched";
+
+        ///An entry bigger than the slab size gets a slab of its own
+        CacheSlabExtent big;
+        ASSERT_TRUE( slabs.allocate(2 * kSlabSize, &big) );
+        EXPECT_EQ(2, slabs.getSlabsCount());
+        EXPECT_EQ(3 * kSlabSize, slabs.getTotalSize());
+
+        slabs.deallocate(c);
+        slabs.deallocate(d);
+        slabs.deallocate(big);
+        EXPECT_EQ(slabs.getTotalSize(), slabs.getFreeSize()) << "Free ranges are merged back";
+    }
+    removeSlabFiles();
+}
+
+TEST(CacheSlabAllocator,Restore) {
+    removeSlabFiles();
+    CacheSlabExtent a,b;
+    {
+        CacheSlabAllocator slabs(".", kSlabSize);
+        ASSERT_TRUE( slabs.allocate(NATRON_CACHE_SLAB_ALIGNMENT, &a) );
+        ASSERT_TRUE( slabs.allocate(NATRON_CACHE_SLAB_ALIGNMENT, &b) );
+        std::memset(slabs.data(b), 7, b.size);
+        EXPECT_TRUE( slabs.flush(b) );
+    }
+    {
+        ///Simulates the next session: only b is in the table of contents
+        CacheSlabAllocator slabs(".", kSlabSize);
+        ASSERT_TRUE( slabs.restore(b) );
+        EXPECT_FALSE( slabs.restore(b) ) << "An extent cannot be restored twice";
+        EXPECT_EQ( 7, slabs.data(b)[0] );
+        EXPECT_EQ( 7, slabs.data(b)[b.size - 1] );
+
+        CacheSlabExtent missing;
+        missing.slab = 3;
+        missing.size = NATRON_CACHE_SLAB_ALIGNMENT;
+        EXPECT_FALSE( slabs.restore(missing) ) << "The slab file does not exist";
+
+        ///The range of a is free again and must not overlap b
+        CacheSlabExtent c;
+        ASSERT_TRUE( slabs.allocate(NATRON_CACHE_SLAB_ALIGNMENT, &c) );
+        EXPECT_EQ(b.slab, c.slab);
+        EXPECT_EQ(a.offset, c.offset);
+    }
+    removeSlabFiles();
+}
+
+TEST(CacheSlabAllocator,RemoveUnusedSlabs) {
+    removeSlabFiles();
+    {
+        CacheSlabAllocator slabs(".", kSlabSize);
+        CacheSlabExtent a,big;
+        ASSERT_TRUE( slabs.allocate(NATRON_CACHE_SLAB_ALIGNMENT, &a) );
+        ASSERT_TRUE( slabs.allocate(2 * kSlabSize, &big) );
+        EXPECT_EQ(2, slabs.getSlabsCount());
+
+        ///The slab of a is still used
+        slabs.deallocate(big);
+        EXPECT_EQ( 2 * kSlabSize, slabs.removeUnusedSlabs() );
+        EXPECT_EQ(1, slabs.getSlabsCount());
+        EXPECT_EQ(kSlabSize, slabs.getTotalSize());
+        EXPECT_FALSE( fileExists("./slab1." NATRON_CACHE_FILE_EXT) );
+
+        slabs.deallocate(a);
+        EXPECT_EQ( kSlabSize, slabs.removeUnusedSlabs() );
+        EXPECT_EQ(0, slabs.getSlabsCount());
+        EXPECT_EQ( (U64)0, slabs.getTotalSize() );
+        EXPECT_FALSE( fileExists("./slab0." NATRON_CACHE_FILE_EXT) );
+
+        ///The allocator can still be used
+        ASSERT_TRUE( slabs.allocate(NATRON_CACHE_SLAB_ALIGNMENT, &a) );
+        EXPECT_EQ(0, a.slab);
+    }
+    removeSlabFiles();
+}
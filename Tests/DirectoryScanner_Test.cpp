@@ -0,0 +1,116 @@
+//  Natron
+//
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include <gtest/gtest.h>
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <SequenceParsing.h>
+#include "Engine/DirectoryScanner.h"
+
+using namespace Natron;
+
+namespace {
+class DirectoryScannerTest
+    : public ::testing::Test
+{
+protected:
+
+    virtual void SetUp()
+    {
+        _path = QDir::tempPath() + QString("/NatronDirectoryScannerTest%1").arg( QCoreApplication::applicationPid() );
+        ASSERT_TRUE( QDir().mkpath(_path + "/subdir") );
+        QStringList names;
+        for (int i = 1; i <= 10; ++i) {
+            names.push_back( QString("render.%1.exr").arg(i, 4, 10, QChar('0')) );
+        }
+        names << "readme.txt" << ".hidden";
+        for (int i = 0; i < names.size(); ++i) {
+            QFile f(_path + '/' + names[i]);
+            ASSERT_TRUE( f.open(QIODevice::WriteOnly) );
+        }
+    }
+
+    virtual void TearDown()
+    {
+        QDir dir(_path);
+        QStringList names = dir.entryList(QDir::Files | QDir::Hidden);
+        for (int i = 0; i < names.size(); ++i) {
+            dir.remove(names[i]);
+        }
+        dir.rmdir("subdir");
+        QDir().rmdir(_path);
+    }
+
+    QString _path;
+};
+}
+
+TEST_F(DirectoryScannerTest,ListsEntriesLikeQDir)
+{
+    DirectoryEntries entries;
+
+    ASSERT_TRUE( listDirectory(_path, QDir::AllEntries | QDir::NoDotAndDotDot, false, &entries) );
+    sortDirectoryEntries(QDir::Name, false, &entries);
+
+    QStringList expected = QDir(_path).entryList(QDir::AllEntries | QDir::NoDotAndDotDot, QDir::Name);
+    ASSERT_EQ( expected.size(), (int)entries.size() );
+    for (std::size_t i = 0; i < entries.size(); ++i) {
+        EXPECT_EQ( expected[(int)i], entries[i].name );
+        EXPECT_EQ( entries[i].name == QString("subdir"), entries[i].isDir );
+        EXPECT_FALSE(entries[i].hasInfo);
+    }
+
+    entries.clear();
+    ASSERT_TRUE( listDirectory(_path, QDir::Files | QDir::Hidden, true, &entries) );
+    EXPECT_EQ( 12u, entries.size() );
+    for (std::size_t i = 0; i < entries.size(); ++i) {
+        EXPECT_FALSE(entries[i].isDir);
+        EXPECT_TRUE(entries[i].hasInfo);
+    }
+
+    EXPECT_FALSE( listDirectory(_path + "/missing", QDir::AllEntries, false, &entries) );
+}
+
+TEST_F(DirectoryScannerTest,GroupsSequencesAcrossBatches)
+{
+    FileSequenceGrouper grouper(_path, false);
+    QStringList first,second;
+
+    for (int i = 1; i <= 10; ++i) {
+        (i <= 5 ? first : second).push_back( QString("render.%1.exr").arg(i, 4, 10, QChar('0')) );
+    }
+    second.push_back("readme.txt");
+
+    std::vector<boost::shared_ptr<SequenceParsing::SequenceFromFiles> > sequences;
+    std::vector<bool> created;
+    grouper.addFiles(first, &sequences, &created);
+    ASSERT_EQ( 5u, sequences.size() );
+    EXPECT_TRUE(created[0]);
+    for (std::size_t i = 1; i < sequences.size(); ++i) {
+        EXPECT_FALSE(created[i]);
+        EXPECT_EQ(sequences[0], sequences[i]);
+    }
+    boost::shared_ptr<SequenceParsing::SequenceFromFiles> render = sequences[0];
+
+    grouper.addFiles(second, &sequences, &created);
+    ASSERT_EQ( 6u, sequences.size() );
+    for (std::size_t i = 0; i < 5; ++i) {
+        EXPECT_FALSE(created[i]);
+        EXPECT_EQ(render, sequences[i]);
+    }
+    EXPECT_TRUE(created[5]);
+    EXPECT_EQ( 10u, render->getFrameIndexes().size() );
+
+    ///A closed sequence is not extended anymore
+    grouper.closeSequence(render);
+    QStringList late;
+    late.push_back("render.0011.exr");
+    grouper.addFiles(late, &sequences, &created);
+    ASSERT_EQ( 1u, sequences.size() );
+    EXPECT_TRUE(created[0]);
+    EXPECT_NE(render, sequences[0]);
+}
@@ -0,0 +1,75 @@
+//  Natron
+//
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include <gtest/gtest.h>
+#include "Engine/DraftRenderState.h"
+
+using namespace Natron;
+
+namespace {
+const qint64 kBudget = 40;
+}
+
+TEST(DraftRenderState,DraftThenRefine) {
+    DraftRenderState state(kBudget);
+    RectD rod(0., 0., 1920., 1080.);
+    bool isDraft = true;
+
+    ///Nothing measured yet: the edit renders at the viewer's level
+    EXPECT_FALSE( state.onEdit(1, 1) );
+    EXPECT_EQ( 0, state.getRenderMipMapLevel(0, rod, 1., &isDraft) );
+    EXPECT_FALSE(isDraft);
+    state.onRenderFinished(1, isDraft, 100);
+
+    ///The frame is slow: the next edit renders a draft, which is not measured
+    EXPECT_TRUE( state.onEdit(1, 2) );
+    EXPECT_EQ( 3, state.getRenderMipMapLevel(1, rod, 1., &isDraft) );
+    EXPECT_TRUE(isDraft);
+    state.onRenderFinished(1, isDraft, 5);
+
+    ///The refinement renders at the viewer's level again, only once
+    EXPECT_TRUE( state.refine() );
+    EXPECT_EQ( 1, state.getRenderMipMapLevel(1, rod, 1., &isDraft) );
+    EXPECT_FALSE(isDraft);
+    EXPECT_FALSE( state.refine() );
+
+    ///The refined render was fast: no draft for the next edit
+    state.onRenderFinished(1, isDraft, 10);
+    EXPECT_FALSE( state.onEdit(1, 2) );
+    EXPECT_FALSE( state.refine() );
+}
+
+TEST(DraftRenderState,DurationsArePerFrame) {
+    DraftRenderState state(kBudget);
+
+    state.onRenderFinished(1, false, 100);
+    state.onRenderFinished(2, false, 10);
+    EXPECT_TRUE( state.onEdit(1, 1) );
+    EXPECT_FALSE( state.onEdit(2, 1) );
+    EXPECT_FALSE( state.onEdit(3, 1) );
+    EXPECT_TRUE( state.onEdit(1, 1) );
+    EXPECT_FALSE( state.onEdit(1, 0) ) << "A downscale level of 0 disables drafts";
+}
+
+TEST(DraftRenderState,DraftLevelIsClampedToTheRoD) {
+    DraftRenderState state(kBudget);
+    bool isDraft = false;
+
+    state.onRenderFinished(1, false, 100);
+    ASSERT_TRUE( state.onEdit(1, 5) );
+
+    ///A 16x8 RoD is a single pixel high at level 3
+    EXPECT_EQ( 3, state.getRenderMipMapLevel(0, RectD(0., 0., 16., 8.), 1., &isDraft) );
+    EXPECT_TRUE(isDraft);
+
+    ///The pixel aspect ratio shrinks the width in pixels: 16 canonical units at par 2 are 8 pixels wide
+    EXPECT_EQ( 3, state.getRenderMipMapLevel(0, RectD(0., 0., 16., 64.), 2., &isDraft) );
+    EXPECT_TRUE(isDraft);
+
+    ///Never finer than the viewer's level
+    EXPECT_EQ( 4, state.getRenderMipMapLevel(4, RectD(0., 0., 16., 8.), 1., &isDraft) );
+    EXPECT_FALSE(isDraft);
+}
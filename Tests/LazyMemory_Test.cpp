@@ -0,0 +1,58 @@
+//  Natron
+//
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include <gtest/gtest.h>
+#include "Engine/LazyMemory.h"
+
+using namespace Natron;
+
+TEST(LazyMemory,StartsAtZero)
+{
+    ///Small enough to come from the heap
+    LazyMemory<float> small(100);
+    ///Large enough to be mapped
+    LazyMemory<float> large(4 * 1024 * 1024);
+
+    for (std::size_t i = 0; i < small.size(); ++i) {
+        ASSERT_EQ(0.f, small[i]);
+    }
+    for (std::size_t i = 0; i < large.size(); i += 1021) {
+        ASSERT_EQ(0.f, large[i]);
+    }
+    large[large.size() - 1] = 1.f;
+    EXPECT_EQ(1.f, large[large.size() - 1]);
+}
+
+TEST(LazyMemory,ResizeKeepsTheFirstElements)
+{
+    LazyMemory<int> mem(10);
+
+    for (int i = 0; i < 10; ++i) {
+        mem[i] = i + 1;
+    }
+    ///Growing past the mapping threshold
+    mem.resize(1024 * 1024);
+    ASSERT_EQ(1024u * 1024u, mem.size());
+    for (int i = 0; i < 10; ++i) {
+        EXPECT_EQ(i + 1, mem[i]);
+    }
+    EXPECT_EQ(0, mem[10]);
+    EXPECT_EQ(0, mem[mem.size() - 1]);
+
+    mem.resize(5);
+    ASSERT_EQ(5u, mem.size());
+    EXPECT_EQ(5, mem[4]);
+
+    LazyMemory<int> other;
+    other.swap(mem);
+    EXPECT_TRUE( mem.empty() );
+    EXPECT_EQ(5u, other.size());
+    EXPECT_EQ(1, other.front());
+
+    other.clear();
+    EXPECT_TRUE( other.empty() );
+    EXPECT_TRUE(other.data() == NULL);
+}
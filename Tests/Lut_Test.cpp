@@ -5,8 +5,11 @@
  * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
 
 #include <cstdlib>
+#include <vector>
+#include <limits>
 #include <gtest/gtest.h>
 #include "Engine/Lut.h"
+#include "Engine/Rect.h"
 
 using namespace Natron::Color;
 
@@ -30,3 +33,206 @@ TEST(Lut,IntConversions) {
         EXPECT_EQ( i, uint8xxToChar( charToUint8xx(i) ) );
     }
 }
+
+TEST(Lut,BulkConversionsMatchScalar) {
+    const Lut* lut = LutManager::sRGBLut();
+    lut->validate();
+
+    std::vector<float> linear(0x10000);
+    for (int i = 0; i < 0x10000; ++i) {
+        linear[i] = intToFloat<0x10000>(i) * 1.2f - 0.1f;
+    }
+    std::vector<unsigned short> uint8xx(0x10000);
+    lut->toColorSpaceUint8xxFromLinearFloatFast(&linear.front(), 0x10000, 1, &uint8xx.front());
+    for (int i = 0; i < 0x10000; ++i) {
+        EXPECT_EQ( lut->toColorSpaceUint8xxFromLinearFloatFast(linear[i]), uint8xx[i] );
+    }
+
+    std::vector<unsigned short> shorts(0x10000);
+    for (int i = 0; i < 0x10000; ++i) {
+        shorts[i] = i;
+    }
+    std::vector<float> decoded(0x10000);
+    lut->fromColorSpaceUint16ToLinearFloatFast(&shorts.front(), 0x10000, 1, &decoded.front(), 1);
+    for (int i = 0; i < 0x10000; ++i) {
+        EXPECT_EQ( lut->fromColorSpaceUint16ToLinearFloatFast(shorts[i]), decoded[i] );
+    }
+}
+
+///Differs between rows so that a wrong Y inversion changes the result
+static int
+bytePattern(int x,
+            int y,
+            int c)
+{
+    return (x + c * 17 + y * 61) % 256;
+}
+
+TEST(Lut,BytePackedRoundTrip) {
+    ///Values coming from a byte round-trip exactly: the error diffusion has nothing to diffuse
+    const Lut* lut = LutManager::sRGBLut();
+    const int w = 256;
+    const int h = 3;
+    RectI bounds(0, 0, w, h);
+
+    std::vector<float> linear(w * h * 4);
+    for (int y = 0; y < h; ++y) {
+        for (int x = 0; x < w; ++x) {
+            for (int c = 0; c < 4; ++c) {
+                linear[(y * w + x) * 4 + c] = lut->fromColorSpaceFloatToLinearFloat( intToFloat<256>( bytePattern(x, y, c) ) );
+            }
+        }
+    }
+    std::vector<unsigned char> bytes(w * h * 4);
+    lut->to_byte_packed(&bytes.front(), &linear.front(), bounds, bounds, bounds, ePixelPackingRGBA, ePixelPackingRGBA, true, false);
+    for (int y = 0; y < h; ++y) {
+        for (int x = 0; x < w; ++x) {
+            for (int c = 0; c < 3; ++c) {
+                EXPECT_EQ( bytePattern(x, y, c), bytes[( (h - y - 1) * w + x ) * 4 + c] );
+            }
+        }
+    }
+
+    std::vector<float> back(w * h * 4);
+    lut->from_byte_packed(&back.front(), &bytes.front(), bounds, bounds, bounds, ePixelPackingRGBA, ePixelPackingRGBA, true, false);
+    for (int y = 0; y < h; ++y) {
+        for (int x = 0; x < w; ++x) {
+            for (int c = 0; c < 3; ++c) {
+                ///inverting Y twice gives back the original rows
+                EXPECT_EQ( linear[(y * w + x) * 4 + c], back[(y * w + x) * 4 + c] );
+            }
+        }
+    }
+}
+
+TEST(Lut,ShortConversions) {
+    const Lut* lut = LutManager::sRGBLut();
+    const int w = 1024;
+    const int h = 3;
+    RectI bounds(0, 0, w, h);
+
+    std::vector<float> linear(w * h * 4);
+    for (int y = 0; y < h; ++y) {
+        for (int x = 0; x < w; ++x) {
+            for (int c = 0; c < 4; ++c) {
+                linear[(y * w + x) * 4 + c] = intToFloat<1024>( (x + y * 331 + c * 97) % 1024 );
+            }
+        }
+    }
+
+    std::vector<unsigned short> shorts(w * h * 3);
+    ///to_short_packed always flips the destination rows, invertY flips the source rows too
+    lut->to_short_packed(&shorts.front(), &linear.front(), bounds, bounds, bounds, ePixelPackingRGBA, ePixelPackingRGB, false, false);
+    for (int y = 0; y < h; ++y) {
+        for (int x = 0; x < w; ++x) {
+            for (int c = 0; c < 3; ++c) {
+                float l = linear[(y * w + x) * 4 + c];
+                unsigned short s = shorts[( (h - y - 1) * w + x ) * 3 + c];
+                EXPECT_EQ(lut->toColorSpaceUint16FromLinearFloatFast(l), s);
+                ///within 1 LSB of the exact encoding
+                EXPECT_NEAR(lut->toColorSpaceFloatFromLinearFloat(l) * 65535., (double)s, 1.);
+            }
+        }
+    }
+
+    std::vector<float> back(w * h * 3);
+    lut->from_short_packed(&back.front(), &shorts.front(), bounds, bounds, bounds, ePixelPackingRGB, ePixelPackingRGB, true, false);
+    for (int y = 0; y < h; ++y) {
+        for (int x = 0; x < w; ++x) {
+            for (int c = 0; c < 3; ++c) {
+                unsigned short s = shorts[( (h - y - 1) * w + x ) * 3 + c];
+                float b = back[(y * w + x) * 3 + c];
+                EXPECT_EQ(lut->fromColorSpaceUint16ToLinearFloatFast(s), b);
+                ///encoding the decoded value gives back the 16 bits value within 1 LSB
+                EXPECT_NEAR( (double)s, (double)lut->toColorSpaceUint16FromLinearFloatFast(b), 1. );
+            }
+        }
+    }
+
+    std::vector<unsigned short> planar(w);
+    lut->to_short_planar(&planar.front(), &linear.front(), w, NULL, 4, 1);
+    std::vector<float> planarBack(w);
+    lut->from_short_planar(&planarBack.front(), &planar.front(), w);
+    for (int x = 0; x < w; ++x) {
+        EXPECT_EQ(shorts[( (h - 1) * w + x ) * 3], planar[x]);
+        EXPECT_EQ(back[x * 3], planarBack[x]);
+    }
+
+    ///linear 16 bits conversions are exact on 16 bits values
+    std::vector<float> exact(w);
+    for (int x = 0; x < w; ++x) {
+        exact[x] = intToFloat<65536>(x * 64);
+    }
+    Natron::Color::Linear::to_short_planar(&planar.front(), &exact.front(), w);
+    for (int x = 0; x < w; ++x) {
+        EXPECT_EQ(x * 64, planar[x]);
+    }
+}
+
+TEST(Lut,Uint16Table) {
+    const Lut* lut = LutManager::Rec709Lut();
+    lut->validate();
+    EXPECT_TRUE( lut->isInitialized() );
+    ///16 bits values that are byte values must decode like the byte value
+    for (int i = 0; i < 0x100; ++i) {
+        EXPECT_EQ( lut->fromColorSpaceUint8ToLinearFloatFast(i), lut->fromColorSpaceUint16ToLinearFloatFast( charToUint16(i) ) );
+    }
+    for (int i = 0; i < 0x10000; i += 7) {
+        EXPECT_NEAR( lut->fromColorSpaceFloatToLinearFloat( intToFloat<0x10000>(i) ), lut->fromColorSpaceUint16ToLinearFloatFast(i), 1e-6 );
+    }
+}
+
+TEST(Lut,Uint16Encoding) {
+    const Lut* lut = LutManager::sRGBLut();
+    lut->validate();
+
+    ///every 16 bits value survives a round trip within 1 LSB
+    std::vector<unsigned short> codes(0x10000);
+    std::vector<float> decoded(0x10000);
+    for (int i = 0; i < 0x10000; ++i) {
+        codes[i] = i;
+    }
+    lut->fromColorSpaceUint16ToLinearFloatFast(&codes.front(), 0x10000, 1, &decoded.front(), 1);
+    std::vector<unsigned short> encoded(0x10000);
+    lut->toColorSpaceUint16FromLinearFloatFast(&decoded.front(), 0x10000, 1, &encoded.front(), 1);
+    for (int i = 0; i < 0x10000; ++i) {
+        EXPECT_NEAR( (double)i, (double)encoded[i], 1. );
+    }
+
+    ///out of range values are clamped
+    EXPECT_EQ( 0, lut->toColorSpaceUint16FromLinearFloatFast(-1.f) );
+    EXPECT_EQ( 0, lut->toColorSpaceUint16FromLinearFloatFast( -std::numeric_limits<float>::infinity() ) );
+    EXPECT_EQ( 0xffff, lut->toColorSpaceUint16FromLinearFloatFast(2.f) );
+    EXPECT_EQ( 0xffff, lut->toColorSpaceUint16FromLinearFloatFast( std::numeric_limits<float>::infinity() ) );
+}
+
+TEST(Lut,HalfFloat) {
+    EXPECT_EQ(0x0000, floatToHalf(0.f));
+    EXPECT_EQ(0x8000, floatToHalf(-0.f));
+    EXPECT_EQ(0x3c00, floatToHalf(1.f));
+    EXPECT_EQ(0xc000, floatToHalf(-2.f));
+    EXPECT_EQ(0x7bff, floatToHalf(65504.f));
+    EXPECT_EQ(0x7c00, floatToHalf(65520.f));
+    EXPECT_EQ(0x0001, floatToHalf(5.9604645e-8f));
+    EXPECT_EQ(0x0000, floatToHalf(2.9e-8f));
+    EXPECT_EQ( 0x7c00, floatToHalf( std::numeric_limits<float>::infinity() ) );
+    EXPECT_EQ( 0x7e00, floatToHalf( std::numeric_limits<float>::quiet_NaN() ) & 0x7e00 );
+
+    ///every finite half must survive a round trip, and the value half-way to the next half must round to even
+    std::vector<float> values;
+    std::vector<unsigned short> expected;
+    for (int h = 0; h < 0x7c00; ++h) {
+        float f = halfToFloat(h);
+        EXPECT_EQ( h, floatToHalf(f) );
+        EXPECT_EQ( h | 0x8000, floatToHalf(-f) );
+        values.push_back(f);
+        expected.push_back(h);
+        if (h < 0x7bff) {
+            float mid = (f + halfToFloat(h + 1)) / 2.f;
+            EXPECT_EQ( (h & 1) ? h + 1 : h, floatToHalf(mid) );
+        }
+    }
+    std::vector<unsigned short> row( values.size() );
+    to_half_row(&values.front(), (int)values.size(), &row.front());
+    EXPECT_TRUE(row == expected);
+}
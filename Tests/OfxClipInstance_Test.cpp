@@ -0,0 +1,59 @@
+//  Natron
+//
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include <stdexcept>
+
+#include "BaseTest.h"
+
+#include "Engine/Node.h"
+#include "Engine/OfxEffectInstance.h"
+#include "Engine/OfxImageEffectInstance.h"
+#include "Engine/OfxClipInstance.h"
+
+using namespace Natron;
+
+TEST_F(BaseTest,OfxClipPreferencesFollowTheProperties)
+{
+    boost::shared_ptr<Node> generator = createNode(_dotGeneratorPluginID);
+    OfxEffectInstance* effect = dynamic_cast<OfxEffectInstance*>( generator->getLiveInstance() );
+
+    ASSERT_TRUE(effect != NULL);
+    OfxClipInstance* clip = dynamic_cast<OfxClipInstance*>( effect->effectInstance()->getClip(kOfxImageEffectOutputClipName) );
+    ASSERT_TRUE(clip != NULL);
+
+    ImageComponentsEnum comps;
+    ImageBitDepthEnum depth;
+
+    ///Set through the base class, as the OFX host does when computing the clip preferences
+    OFX::Host::ImageEffect::ClipInstance* ofxClip = clip;
+    ofxClip->setComponents(kOfxImageComponentRGBA);
+    ofxClip->setPixelDepth(kOfxBitDepthFloat);
+    clip->getNatronPreferences(&comps, &depth);
+    EXPECT_EQ(eImageComponentRGBA, comps);
+    EXPECT_EQ(eImageBitDepthFloat, depth);
+
+    ofxClip->setComponents(kOfxImageComponentAlpha);
+    ofxClip->setPixelDepth(kOfxBitDepthByte);
+    clip->getNatronPreferences(&comps, &depth);
+    EXPECT_EQ(eImageComponentAlpha, comps);
+    EXPECT_EQ(eImageBitDepthByte, depth);
+
+    ///Set on the property set directly
+    clip->getProps().setStringProperty(kOfxImageClipPropComponents, kOfxImageComponentRGB);
+    clip->getNatronPreferences(&comps, &depth);
+    EXPECT_EQ(eImageComponentRGB, comps);
+    EXPECT_EQ(eImageBitDepthByte, depth);
+
+    ///A preference without Natron counterpart is reported on every fetch
+    clip->getProps().setStringProperty(kOfxImageEffectPropPixelDepth, "NotADepth");
+    EXPECT_THROW(clip->getNatronPreferences(&comps, &depth), std::runtime_error);
+    EXPECT_THROW(clip->getNatronPreferences(&comps, &depth), std::runtime_error);
+
+    clip->getProps().setStringProperty(kOfxImageEffectPropPixelDepth, kOfxBitDepthShort);
+    clip->getNatronPreferences(&comps, &depth);
+    EXPECT_EQ(eImageComponentRGB, comps);
+    EXPECT_EQ(eImageBitDepthShort, depth);
+}
@@ -0,0 +1,42 @@
+//  Natron
+//
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include <gtest/gtest.h>
+#include "Engine/RenderAbortToken.h"
+
+using namespace Natron;
+
+namespace {
+///The tokens only compare the app they belong to, they never dereference it
+char gAppA,gAppB;
+const AppInstance* appA = reinterpret_cast<const AppInstance*>(&gAppA);
+const AppInstance* appB = reinterpret_cast<const AppInstance*>(&gAppB);
+}
+
+TEST(RenderAbortToken,StaysAbortedOnceAborted)
+{
+    RenderAbortToken token(appA, true);
+
+    EXPECT_FALSE( token.isAborted() );
+    token.abort();
+    EXPECT_TRUE( token.isAborted() );
+    token.abort();
+    EXPECT_TRUE( token.isAborted() );
+}
+
+TEST(RenderAbortToken,PlaybackAbortOnlyReachesPlaybackFramesOfTheApp)
+{
+    RenderAbortToken playbackA(appA, false);
+    RenderAbortToken interactiveA(appA, true);
+    RenderAbortToken playbackB(appB, false);
+
+    RenderAbortToken::abortRendersFromPlayback(appA);
+
+    EXPECT_TRUE( playbackA.isAborted() );
+    ///Renders made in response to a user interaction are aborted when the tree or the time changes
+    EXPECT_FALSE( interactiveA.isAborted() );
+    EXPECT_FALSE( playbackB.isAborted() );
+}
@@ -0,0 +1,57 @@
+//  Natron
+//
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include <gtest/gtest.h>
+#include <boost/scoped_ptr.hpp>
+#include <QCoreApplication>
+#include "Engine/RenderPriorityScheduler.h"
+
+using namespace Natron;
+
+TEST(RenderPriorityScheduler,PoolTasksOfHigherPrioritiesAreQueuedFirst)
+{
+    EXPECT_GT( RenderPriorityScheduler::getPoolTaskPriority(eRenderPriorityInteractive),
+               RenderPriorityScheduler::getPoolTaskPriority(eRenderPriorityPlayback) );
+    EXPECT_GT( RenderPriorityScheduler::getPoolTaskPriority(eRenderPriorityPlayback),
+               RenderPriorityScheduler::getPoolTaskPriority(eRenderPriorityBackground) );
+    ///QtConcurrent queues its tasks with priority 0
+    EXPECT_EQ( 0, RenderPriorityScheduler::getPoolTaskPriority(eRenderPriorityBackground) );
+}
+
+TEST(RenderPriorityScheduler,PlaybackHoldsBackBackgroundRendersOnly)
+{
+    ///The scopes use thread-local storage, which requires an application
+    boost::scoped_ptr<QCoreApplication> app;
+    int argc = 1;
+    char arg0[] = "Tests";
+    char* argv[] = { arg0 };
+    if (!qApp) {
+        app.reset( new QCoreApplication(argc, argv) );
+    }
+
+    RenderPriorityScheduler::clearStatistics();
+    EXPECT_EQ( eRenderPriorityInteractive, RenderPriorityScheduler::getCurrentThreadPriority() );
+    {
+        RenderPriorityScope scope(eRenderPriorityPlayback);
+
+        EXPECT_EQ( eRenderPriorityPlayback, RenderPriorityScheduler::getCurrentThreadPriority() );
+        EXPECT_TRUE( RenderPriorityScheduler::hasHigherPriorityRenders(eRenderPriorityBackground) );
+        EXPECT_FALSE( RenderPriorityScheduler::hasHigherPriorityRenders(eRenderPriorityPlayback) );
+        EXPECT_EQ( 0, RenderPriorityScheduler::getAvailablePoolThreads(eRenderPriorityBackground) );
+    }
+    EXPECT_EQ( eRenderPriorityInteractive, RenderPriorityScheduler::getCurrentThreadPriority() );
+
+    RenderPoolStats stats[eRenderPriorityCount];
+    RenderPriorityScheduler::getStatistics(stats);
+    EXPECT_EQ(1u, stats[eRenderPriorityPlayback].renders);
+    EXPECT_EQ(1, stats[eRenderPriorityPlayback].peakActiveRenders);
+    EXPECT_EQ(0, stats[eRenderPriorityPlayback].activeRenders);
+    EXPECT_EQ(0u, stats[eRenderPriorityBackground].renders);
+
+    ///Once the grace period after the playback frame elapsed, background renders may start again
+    EXPECT_TRUE( RenderPriorityScheduler::waitForHigherPriorityRenders(eRenderPriorityBackground, 5000) );
+    EXPECT_FALSE( RenderPriorityScheduler::hasHigherPriorityRenders(eRenderPriorityBackground) );
+}
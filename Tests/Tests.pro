@@ -156,6 +156,18 @@ SOURCES += \
     Hash64_Test.cpp \
     Image_Test.cpp \
     Lut_Test.cpp \
+    OfxClipInstance_Test.cpp \
+    ActionsCacheVersions_Test.cpp \
+    DraftRenderState_Test.cpp \
+    CacheCodec_Test.cpp \
+    CacheEventsBatch_Test.cpp \
+    CacheSlabAllocator_Test.cpp \
+    RenderAbortToken_Test.cpp \
+    RenderPriorityScheduler_Test.cpp \
+    LazyMemory_Test.cpp \
+    Timer_Test.cpp \
+    ViewInvariance_Test.cpp \
+    DirectoryScanner_Test.cpp \
     File_Knob_Test.cpp \
     Curve_Test.cpp
 
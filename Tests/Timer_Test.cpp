@@ -0,0 +1,91 @@
+//  Natron
+//
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include <gtest/gtest.h>
+#include <QElapsedTimer>
+#include "Engine/Timer.h"
+
+TEST(Timer,FramesAreDueOnePeriodApart)
+{
+    Timer timer;
+
+    timer.setDesiredFrameRate(100.);
+    timer.playState = ePlayStateRunning;
+
+    QElapsedTimer elapsed;
+    elapsed.start();
+    for (int i = 0; i < 11; ++i) {
+        timer.waitUntilNextFrameIsDue();
+    }
+    ///The first frame is due immediately, the 10 others every 10 ms
+    EXPECT_GE(elapsed.nsecsElapsed(), (qint64)100000000);
+
+    PlaybackStats stats;
+    timer.getPlaybackStats(&stats);
+    EXPECT_EQ(11u, stats.frames);
+    EXPECT_GE(stats.maxEarliness, 0.);
+    EXPECT_GT(stats.effectiveFps, 0.);
+    U64 histogramTotal = 0;
+    for (int i = 0; i < NATRON_PLAYBACK_OFFSET_BINS; ++i) {
+        histogramTotal += stats.offsetHistogram[i];
+    }
+    EXPECT_EQ(stats.frames, histogramTotal);
+}
+
+TEST(Timer,LateFramesAreDroppedNotCaughtUp)
+{
+    Timer timer;
+
+    timer.setDesiredFrameRate(100.);
+    timer.playState = ePlayStateRunning;
+    timer.waitUntilNextFrameIsDue();
+
+    ///Rendering the second frame took 4 periods
+    QElapsedTimer busy;
+    busy.start();
+    while (busy.elapsed() < 45) {
+    }
+    timer.waitUntilNextFrameIsDue();
+
+    PlaybackStats stats;
+    timer.getPlaybackStats(&stats);
+    EXPECT_GE(stats.droppedFrames, 3u);
+    EXPECT_GT(stats.maxLateness, 0.03);
+
+    ///The next frame is due one period after the late one, not immediately
+    QElapsedTimer elapsed;
+    elapsed.start();
+    timer.waitUntilNextFrameIsDue();
+    EXPECT_GE(elapsed.elapsed(), 5);
+
+    ///A new playback starts with fresh statistics
+    timer.resetPlayback();
+    timer.getPlaybackStats(&stats);
+    EXPECT_EQ(0u, stats.frames);
+    EXPECT_EQ(0u, stats.droppedFrames);
+}
+
+TEST(Timer,ResetPlaybackMakesTheNextFrameDueImmediately)
+{
+    Timer timer;
+
+    ///The period is longer than the test would take if the next frame was not due immediately
+    timer.setDesiredFrameRate(1.);
+    timer.playState = ePlayStateRunning;
+    timer.waitUntilNextFrameIsDue();
+
+    ///The playback restarts as the output scheduler does: the timer was never paused
+    timer.resetPlayback();
+    QElapsedTimer elapsed;
+    elapsed.start();
+    timer.waitUntilNextFrameIsDue();
+    EXPECT_LT(elapsed.elapsed(), 500);
+
+    PlaybackStats stats;
+    timer.getPlaybackStats(&stats);
+    EXPECT_EQ(1u, stats.frames);
+    EXPECT_EQ(0u, stats.droppedFrames);
+}
@@ -0,0 +1,41 @@
+//  Natron
+//
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "BaseTest.h"
+
+#include "Engine/Node.h"
+#include "Engine/EffectInstance.h"
+#include "Engine/ImageKey.h"
+
+using namespace Natron;
+
+TEST_F(BaseTest,ViewDependentLeafIsCachedPerView)
+{
+    ///A generator has no input: nothing tells its image is the same for all views
+    boost::shared_ptr<Node> generator = createNode(_dotGeneratorPluginID);
+    EffectInstance* generatorEffect = generator->getLiveInstance();
+
+    EXPECT_TRUE( generatorEffect->isViewAware() );
+    EXPECT_FALSE( generatorEffect->isViewInvariant_Recursive() );
+    EXPECT_EQ( 1, generatorEffect->getViewForCache(1) );
+
+    ///A Dot only passes its input through, but the tree upstream depends on the view
+    boost::shared_ptr<Node> dot = createNode(PLUGINID_NATRON_DOT);
+    EffectInstance* dotEffect = dot->getLiveInstance();
+    EXPECT_FALSE( dotEffect->isViewAware() );
+    EXPECT_TRUE( dotEffect->isViewInvariant_Recursive() );
+    EXPECT_EQ( NATRON_IMAGE_KEY_ALL_VIEWS, dotEffect->getViewForCache(1) );
+
+    connectNodes(generator, dot, 0, true);
+    EXPECT_FALSE( dotEffect->isViewInvariant_Recursive() );
+    EXPECT_EQ( 1, dotEffect->getViewForCache(1) );
+
+    ///Readers and writers are view aware
+    boost::shared_ptr<Node> reader = createNode(_readOIIOPluginID);
+    EXPECT_TRUE( reader->getLiveInstance()->isViewAware() );
+    boost::shared_ptr<Node> writer = createNode(_writeOIIOPluginID);
+    EXPECT_TRUE( writer->getLiveInstance()->isViewAware() );
+}